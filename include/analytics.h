@@ -0,0 +1,54 @@
+/**
+ * @file analytics.h
+ * @brief Whole-graph metrics over the adjacency snapshot.
+ *
+ * All kernels run on the thread pool. Their results do not depend on the
+ * number of threads, except for rounding in the betweenness sums.
+ */
+
+#ifndef ANALYTICS_H
+#define ANALYTICS_H
+
+#include "graph.h"
+
+#include <functional>
+#include <vector>
+
+// Minimum spanning tree, or forest of a disconnected graph
+typedef struct
+{
+  std::vector<int> ends;      // external ids of the endpoints, two per tree edge
+  std::vector<float> weights; // weight of each tree edge
+  float sum;
+} MstResult;
+
+// Labels nodes 0..k-1 by connected component, numbered by their lowest node;
+// returns k
+int connected_components(const Adjacency &adj, std::vector<int> *component);
+// Hop count of every node from source, -1 if unreachable; returns the number
+// of layers. bottom_up_steps, if given, receives how many layers were
+// expanded bottom-up.
+int bfs_layers(const Adjacency &adj, int source, std::vector<int> *level,
+               int *bottom_up_steps);
+// PageRank with uniform teleport; returns the iterations run
+int pagerank(const Adjacency &adj, float damping, int max_iterations,
+             float tolerance, std::vector<float> *rank);
+// Brandes betweenness over weighted shortest paths. With more than
+// max_sources nodes, evenly spaced pivots are used and the result is scaled
+// up to estimate the exact value. Returns the number of sources used.
+int betweenness(const Adjacency &adj, int max_sources,
+                std::vector<float> *centrality);
+// Prim over the adjacency; ids maps node indices to the external ids the
+// result is given in. Gives up when the calling task is cancelled.
+void minimum_spanning_tree(const Adjacency &adj, const std::vector<int> &ids,
+                           MstResult *out);
+// Brings a forest up to date after the edges in changed (endpoints by
+// external id) were added, removed or reweighted and the nodes in deleted
+// went away. weight_of(a, b) gives the current weight of an edge, or a
+// negative value if it is gone. Returns false, leaving out alone, when a
+// tree edge got heavier or went away; that needs a full recomputation.
+bool update_spanning_tree(const MstResult &tree, const std::vector<Edge> &changed,
+                          const std::vector<int> &deleted,
+                          const std::function<float(int, int)> &weight_of, MstResult *out);
+
+#endif
@@ -0,0 +1,48 @@
+/**
+ * @file arena.h
+ * @brief Bump allocators for transient per-frame and per-query buffers.
+ *
+ * An arena hands out memory by advancing a cursor and frees everything at
+ * once on reset. When a cycle needs more than the arena holds, extra blocks
+ * are chained in and merged into one block of the combined size at the next
+ * reset, so after the first frame at a given graph size the arena no longer
+ * touches the heap.
+ */
+
+#ifndef ARENA_H
+#define ARENA_H
+
+#include <stddef.h>
+
+#define ARENA_MIN_BLOCK (64 * 1024)
+
+typedef struct ArenaBlock ArenaBlock;
+
+typedef struct
+{
+  ArenaBlock *head; // block allocations currently come from
+  size_t used;      // bytes used in head
+  size_t reserved;  // total capacity of all blocks
+} Arena;
+
+// Reset after every layout tick and every redraw
+extern Arena frame_arena;
+// Reset when an interactive query (path, tree, metric, reorder) finishes
+extern Arena query_arena;
+
+// Returns size bytes aligned to align; memory is not cleared
+void *arena_alloc(Arena *arena, size_t size, size_t align);
+// Frees everything allocated since the last reset
+void arena_reset(Arena *arena);
+
+// Uninitialized array of count elements of type T
+template <typename T>
+T *arena_array(Arena *arena, size_t count)
+{
+  return (T *)arena_alloc(arena, count * sizeof(T), alignof(T));
+}
+
+// Number of heap allocations made by operator new and by arenas so far
+unsigned long long heap_allocations();
+
+#endif
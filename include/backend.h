@@ -0,0 +1,61 @@
+/**
+ * @file backend.h
+ * @brief Selectable execution backends for the layout and path kernels.
+ *
+ * Kernels split their work into a fixed number of chunks and hand them to
+ * backend_for(), which runs them serially, with std::execution::par_unseq,
+ * with OpenMP or on the thread pool of parallel.h. Since the split never
+ * depends on the backend or the thread count, a kernel that derives its
+ * output from the chunk index alone gives bit-identical results on all of
+ * them.
+ */
+
+#ifndef BACKEND_H
+#define BACKEND_H
+
+#define BACKEND_SERIAL 1
+#define BACKEND_PAR_UNSEQ 2 // std::execution::par_unseq, needs TBB
+#define BACKEND_OPENMP 3    // needs -fopenmp
+#define BACKEND_POOL 4      // persistent pool of parallel.h
+#define BACKEND_COUNT 4
+
+// When false, kernels may trade bit-exact reproducibility for speed, e.g.
+// by accumulating into per-worker buffers whose summation order depends on
+// scheduling. Defaults to true.
+extern bool backend_deterministic;
+
+// Whether a backend was compiled in
+bool backend_available(int backend);
+// Selects the backend used by backend_for; returns false if unavailable
+bool backend_select(int backend);
+// Currently selected backend
+int backend_current();
+// Short name of a backend ("serial", "par_unseq", "openmp", "pool")
+const char *backend_name(int backend);
+// Looks a backend up by its short name; returns 0 if unknown
+int backend_lookup(const char *name);
+// Number of worker slots of the current backend (at least 1)
+int backend_slots();
+// Slot of the calling worker in [0, backend_slots()), for per-worker scratch
+int backend_slot();
+
+// Runs call(fn, chunk) for every chunk in [0, chunks) on the current backend
+void backend_run(int chunks, void (*call)(const void *fn, int chunk), const void *fn);
+
+// Calls a kernel through the type-erased pointer of backend_run
+template <typename F>
+void backend_call(const void *fn, int chunk)
+{
+  (*(const F *)fn)(chunk);
+}
+
+// Runs fn(chunk) for every chunk in [0, chunks) and waits for all of them.
+// Unlike std::function, the kernel is passed by reference and never copied,
+// so issuing a job does not allocate.
+template <typename F>
+void backend_for(int chunks, const F &fn)
+{
+  backend_run(chunks, backend_call<F>, &fn);
+}
+
+#endif
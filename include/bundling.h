@@ -0,0 +1,93 @@
+/**
+ * @file bundling.h
+ * @brief Force-directed edge bundling.
+ *
+ * Every edge is subdivided into a polyline whose interior points are pulled
+ * towards the matching points of compatible edges (similar direction, length
+ * and position) while springs keep the polyline smooth. Compatible edges are
+ * found through a grid over the edge midpoints and capped per edge, so a
+ * pass costs O(edges) instead of the O(edges^2) of the original formulation.
+ * Subdivision doubles over a few cycles while the step size halves.
+ *
+ * Bundling only saves fill once the shared parts are drawn once: the bends
+ * of a result are merged per cell of a pixel grid, and every segment between
+ * merged vertices is kept once with the number of edges along it.
+ */
+
+#ifndef BUNDLING_H
+#define BUNDLING_H
+
+#include <memory>
+#include <vector>
+
+#define BUNDLE_CYCLES 4            // subdivision cycles: 1, 3, 7, 15 points
+#define BUNDLE_POINTS 15           // interior points per edge after the last cycle
+#define BUNDLE_ITERATIONS 30       // iterations of the first cycle; 2/3 as many in each next one
+#define BUNDLE_REFINE_ITERATIONS 8 // iterations of an update from a previous result
+#define BUNDLE_STEP 0.02f          // first step size in GL units; halved every cycle
+#define BUNDLE_SPRING 0.1f         // stiffness of the polyline springs
+#define BUNDLE_COMPATIBILITY 0.6f  // minimum compatibility of two bundled edges
+#define BUNDLE_NEIGHBORS 8         // compatible edges kept per edge
+#define BUNDLE_CELL_OCCUPANCY 16   // average edges per grid cell
+#define BUNDLE_SEARCH_RADIUS 1     // grid cells searched around an edge midpoint
+#define BUNDLE_REGROUP_DISTANCE 0.1f // node movement after which compatible edges are searched again
+#define BUNDLE_MERGE_PIXELS 2      // width of the grid cells bends are merged in
+
+// The most compatible edges of every edge
+typedef struct
+{
+  std::vector<float> node_xy; // positions they were found for
+  // BUNDLE_NEIGHBORS entries per edge: an edge index, its complement if the
+  // edge runs the other way, or INT_MIN for an empty slot
+  std::vector<int> neighbors;
+  std::vector<float> weights; // compatibility of each entry
+} BundleNeighbors;
+
+// Bundles as a set of shared segments. Vertex v sits at xy for the node
+// positions of the bundles and follows the layout like point t of edge
+// anchor_edge[v] (t = anchor_t[v], 0 at src and 1 at dest).
+typedef struct
+{
+  std::vector<float> xy;         // (x, y) per vertex
+  std::vector<int> anchor_edge;  // per vertex
+  std::vector<float> anchor_t;   // per vertex
+  std::vector<int> segments;     // (a, b) vertex pairs, a < b, each pair once
+  std::vector<int> counts;       // edges along each segment
+} MergedBundles;
+
+// Bundled edges for one set of node positions. The shared parts are handed
+// on to the next update rather than copied.
+typedef struct
+{
+  std::vector<float> node_xy; // positions the bundles were computed for, (x, y) per node
+  // BUNDLE_POINTS (x, y) interior points per edge
+  std::shared_ptr<const std::vector<float>> points;
+  std::shared_ptr<const BundleNeighbors> compatible;
+  std::shared_ptr<const MergedBundles> merged;
+} BundleResult;
+
+// Pixels drawn by a set of polylines on the CPU model of GL wide lines
+typedef struct
+{
+  long long fragments; // pixel writes, counting overdraw
+  long long covered;   // distinct pixels written
+} FillCost;
+
+// Bundles the edges (src, dest pairs of node indices in ends). If previous
+// holds bundles of the same edges, they are moved along with their end
+// points and refined instead of being computed from scratch, keeping the
+// compatible edges until some node moved by BUNDLE_REGROUP_DISTANCE. Reports
+// progress and stops early when the calling task is cancelled.
+void bundle_edges(const std::vector<float> &node_xy, const std::vector<int> &ends,
+                  const BundleResult *previous, BundleResult *out);
+// Merges the bends of bundles that fall in the same cell_w x cell_h cell
+// into one vertex and lists every segment between vertices once. Nodes are
+// vertices of their own. Sets bundles->merged.
+void bundle_merge(const std::vector<int> &ends, float cell_w, float cell_h,
+                  BundleResult *bundles);
+// Adds the fill cost of strips polylines of stride (x, y) points each, drawn
+// line_width pixels wide into a width x height viewport over [-1, 1]^2
+void polyline_fill(const float *xy, int strips, int stride, int line_width, int width,
+                   int height, FillCost *cost);
+
+#endif
@@ -0,0 +1,47 @@
+/**
+ * @file checkpoint.h
+ * @brief Periodic session checkpoints written on a background thread.
+ *
+ * A checkpoint file holds one compressed base snapshot of the nodes, edges
+ * and current mode, followed by append-only delta records of the node
+ * positions and mode. A structural change of the graph, or too many deltas,
+ * starts a new file with a fresh base. The frame loop only copies the arrays;
+ * encoding, compression and disk writes happen on the writer thread.
+ */
+
+#ifndef CHECKPOINT_H
+#define CHECKPOINT_H
+
+#include <stddef.h>
+
+#define CHECKPOINT_MAGIC "GRPS"
+#define CHECKPOINT_VERSION 1
+#define CHECKPOINT_INTERVAL_MS 2000 // between checkpoints of a running session
+#define CHECKPOINT_MAX_DELTAS 32    // deltas before a new base is written
+
+// What the writer or the last restore did
+typedef struct
+{
+  int bases;          // base snapshots written
+  int deltas;         // delta records written or applied
+  size_t base_bytes;  // compressed size of the last base
+  size_t raw_bytes;   // uncompressed size of the last base
+  size_t delta_bytes; // compressed size of the last delta
+  double ms;          // time spent on the last record or the whole restore
+} CheckpointStats;
+
+// Starts the writer thread; checkpoints go to path
+void checkpoint_start(const char *path);
+// Hands a copy of the session to the writer once the interval has passed.
+// Never waits: a checkpoint is skipped while the writer is still busy.
+void checkpoint_poll(int mode);
+// Writes a checkpoint now and waits until it is on disk
+void checkpoint_flush(int mode);
+// Counters of the writer thread
+void checkpoint_stats(CheckpointStats *stats);
+// Loads the session in path into the graph store; returns false, leaving the
+// graph untouched, if the file is missing or its base is damaged. A damaged
+// delta ends the restore at the previous record.
+bool checkpoint_restore(const char *path, int *mode, CheckpointStats *stats);
+
+#endif
@@ -0,0 +1,53 @@
+/**
+ * @file community.h
+ * @brief Community detection by modularity (Louvain with the Leiden
+ *        connectivity guarantee).
+ *
+ * Every level moves nodes between communities to raise modularity, splits
+ * communities that came apart into their connected pieces, and collapses
+ * each community into one node of the next level's graph. Candidate moves
+ * are found in parallel and then applied in node order, so the result does
+ * not depend on the number of threads.
+ */
+
+#ifndef COMMUNITY_H
+#define COMMUNITY_H
+
+#include "graph.h"
+
+#include <vector>
+
+#define COMMUNITY_MAX_LEVELS 12
+#define COMMUNITY_MAX_SWEEPS 32   // local moving sweeps per level
+#define COMMUNITY_MIN_GAIN 1e-6   // modularity gain below which a level stops
+
+typedef struct
+{
+  int count;         // communities found
+  double modularity; // of the final partition, in [-0.5, 1]
+  int levels;        // levels that merged anything
+} CommunityStats;
+
+// Communities as the nodes of a smaller graph, for views that draw and lay
+// out one supernode per community
+typedef struct
+{
+  int count;
+  std::vector<int> member_offsets; // members of c: members[member_offsets[c]..[c + 1])
+  std::vector<int> members;        // in node order within each community
+  std::vector<int> link_ends;      // (a, b) per linked pair of communities, a < b
+  std::vector<int> link_edges;     // edges between the ends of each link
+} CommunityGraph;
+
+// Labels nodes 0..k-1 by community, numbered by their lowest node; every
+// community is connected. Edges count once whatever their weight, since
+// weights are lengths here. Gives up early when the calling task is
+// cancelled. Returns k.
+int detect_communities(const Adjacency &adj, std::vector<int> *community,
+                       CommunityStats *stats);
+// Lists the members of the communities 0..count-1 and aggregates the edges
+// between them into one link per pair; O(N + E)
+void community_graph(const Adjacency &adj, const std::vector<int> &community, int count,
+                     CommunityGraph *out);
+
+#endif
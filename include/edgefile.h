@@ -0,0 +1,72 @@
+/**
+ * @file edgefile.h
+ * @brief On-disk adjacency for graphs whose edges do not fit in memory.
+ *
+ * An edge file is a CSR adjacency laid out for memory mapping: a header, the
+ * arc offset of every node, then the arcs of node 0, node 1 and so on. Every
+ * edge is stored once in each direction, so the neighbors of a node are one
+ * contiguous range and passes over node ranges read the file sequentially.
+ * Files are built by partitioning the input by source node into a spill file
+ * and sorting one partition at a time, which keeps memory bounded by the
+ * budget plus eight bytes per node.
+ */
+
+#ifndef EDGEFILE_H
+#define EDGEFILE_H
+
+#include "graph.h"
+
+#include <functional>
+#include <stddef.h>
+#include <stdint.h>
+
+#define EDGEFILE_MAGIC "GRPE"
+#define EDGEFILE_VERSION 1
+
+// One direction of an edge
+typedef struct
+{
+  int32_t dest;
+  float weight;
+} Arc;
+
+// Open, memory-mapped edge file
+typedef struct
+{
+  int fd;
+  const uint8_t *map;
+  size_t map_size;
+  int node_count;
+  long long edge_count;    // undirected edges; arcs are twice as many
+  const uint64_t *offsets; // node_count + 1 entries
+  const Arc *arcs;
+  size_t budget;  // resident bytes allowed before pages are released
+  size_t touched; // bytes paged in since the last release
+} EdgeFile;
+
+// Calls emit(edge) for every input edge; returns false on a read error
+typedef std::function<bool(const std::function<void(const Edge &)> &emit)> EdgeScan;
+
+// Builds an edge file from two passes of scan. node_count < 0 takes the
+// highest endpoint + 1. Self loops are dropped.
+bool edgefile_build(const char *path, int node_count, const EdgeScan &scan,
+                    size_t budget);
+// Builds an edge file from a text edge list ("src dest [weight]" per line)
+bool edgefile_import_text(const char *text_path, const char *path, size_t budget);
+// Builds an edge file from the in-memory graph
+bool edgefile_save_graph(const char *path, size_t budget);
+
+bool edgefile_open(const char *path, size_t budget, EdgeFile *file);
+void edgefile_close(EdgeFile *file);
+// Visits the nodes in windows of about budget / 2 bytes of arcs, prefetching
+// the next window and releasing each one once fn(lo, hi) returns
+void edgefile_for_each_window(EdgeFile *file,
+                              const std::function<void(int lo, int hi)> &fn);
+// Accounts for random reads of node u's arcs, releasing mapped pages when
+// the budget is exceeded
+void edgefile_touch(EdgeFile *file, int u);
+
+// Peak resident set size of the process in kilobytes
+long peak_rss_kb();
+
+#endif
@@ -0,0 +1,62 @@
+/**
+ * @file forces.h
+ * @brief Force laws of the force-directed layout.
+ *
+ * Every law is a struct of inline functions that the layout kernels take as
+ * a template parameter, so each law is compiled into its own kernels with
+ * the force arithmetic inlined into the inner loops; the layout picks the
+ * instantiation once per tick. Forces are returned as factors on the offset
+ * (dx, dy) between two nodes, which keeps the loops free of branches and
+ * square roots where the law allows. All laws balance attraction and
+ * repulsion of two nodes at the optimal edge length k.
+ */
+
+#ifndef FORCES_H
+#define FORCES_H
+
+#include <math.h>
+
+#define FORCE_FR 0     // Fruchterman-Reingold
+#define FORCE_LINLOG 1 // Noack's LinLog energy model
+#define FORCE_ATLAS 2  // ForceAtlas2-style, repulsion weighted by degree
+#define FORCE_LAWS 3
+
+#define FORCE_MIN_DIST2 1e-6f // squared distance below which nodes count as 0.001 apart
+#define FORCE_CENTERING 4.0f  // pull towards the origin per unit of distance
+
+// Squared distance of an offset, at least FORCE_MIN_DIST2
+static inline float force_dist2(float dx, float dy)
+{
+  float d2 = dx * dx + dy * dy;
+  return d2 < FORCE_MIN_DIST2 ? FORCE_MIN_DIST2 : d2;
+}
+
+// Repulsion k^2 / d, attraction d^2 / k
+struct ForceFR
+{
+  static const bool weighted = false; // repulsion and gravity scaled by degree + 1
+  static inline float repulsion(float d2, float k2) { return k2 / d2; }
+  static inline float attraction(float d2, float k) { return sqrtf(d2) / k; }
+  static inline float gravity(float) { return FORCE_CENTERING; }
+};
+
+// Repulsion k^2 / d, constant attraction k: clusters separate more clearly
+struct ForceLinLog
+{
+  static const bool weighted = false;
+  static inline float repulsion(float d2, float k2) { return k2 / d2; }
+  static inline float attraction(float d2, float k) { return k / sqrtf(d2); }
+  static inline float gravity(float) { return FORCE_CENTERING; }
+};
+
+// Repulsion (deg_i + 1)(deg_j + 1) k^2 / d, linear attraction d and gravity
+// scaled by degree + 1: hubs push apart and leaves gather around them
+struct ForceAtlas
+{
+  static const bool weighted = true;
+  static inline float repulsion(float d2, float k2) { return k2 / d2; }
+  static inline float attraction(float, float) { return 1.0f; }
+  static inline float gravity(float mass) { return FORCE_CENTERING * mass; }
+};
+
+#endif
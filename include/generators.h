@@ -0,0 +1,43 @@
+/**
+ * @file generators.h
+ * @brief Random and structured graph generators.
+ *
+ * Generators replace the contents of the graph store. They run in parallel
+ * over a fixed number of chunks, each with its own random stream derived from
+ * the seed and the chunk index, so the output depends only on the parameters
+ * and never on the number of cores.
+ */
+
+#ifndef GENERATORS_H
+#define GENERATORS_H
+
+#define GEN_ERDOS_RENYI 1
+#define GEN_BARABASI_ALBERT 2
+#define GEN_GRID 3
+#define GEN_GEOMETRIC 4
+#define GEN_RMAT 5
+#define GEN_COUNT 5
+
+typedef struct
+{
+  int type;          // GEN_*
+  int nodes;         // node count; R-MAT rounds up to a power of two and
+                     // the grid uses the largest square that fits
+  int edges;         // R-MAT edge count
+  float probability; // Erdos-Renyi edge probability
+  int degree;        // Barabasi-Albert edges per new node
+  float radius;      // random geometric connection radius (unit square)
+  unsigned int seed;
+  float x0, y0, x1, y1; // region the nodes are placed in
+} GeneratorParams;
+
+// Short name used on the command line ("er", "ba", "grid", "geometric", "rmat")
+const char *generator_name(int type);
+// Looks a generator up by its short name; returns 0 if unknown
+int generator_type(const char *name);
+// Fills in sizes suitable for interactive use
+void generator_defaults(int type, GeneratorParams *params);
+// Replaces the graph with a generated one; returns the number of edges
+int generate_graph(const GeneratorParams *params);
+
+#endif
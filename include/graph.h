@@ -0,0 +1,104 @@
+/**
+ * @file graph.h
+ * @brief Graph storage shared by the renderer, layout and algorithms.
+ *
+ * All structural mutations of the node and edge arrays go through the
+ * functions declared here so that higher level features (undo/redo, layout)
+ * see a single, consistent set of primitives.
+ */
+
+#ifndef GRAPH_H
+#define GRAPH_H
+
+#include <memory>
+#include <vector>
+
+// Duplicate policies for graph_add_edges(): which weight survives
+#define DEDUP_MIN 0
+#define DEDUP_MAX 1
+#define DEDUP_FIRST 2
+#define DEDUP_LAST 3
+#define DEDUP_SUM 4
+
+typedef struct
+{
+  float x, y;
+  char label;
+  int id; // external id; stays with the node when indices are renumbered
+} Node;
+
+typedef struct
+{
+  int src, dest;
+  float weight;
+} Edge;
+
+// Compressed sparse row view of the undirected graph. Every edge appears
+// once from each endpoint. A snapshot is immutable once built.
+typedef struct
+{
+  int node_count;
+  std::vector<int> offsets; // node_count + 1 entries
+  std::vector<int> targets; // neighbor of each entry
+  std::vector<float> weights;
+  std::vector<int> edge_ids; // index into edges[] of each entry
+} Adjacency;
+
+extern Node *nodes;
+extern Edge *edges;
+extern int node_count, edge_count;
+// Incremented by every structural or weight change
+extern unsigned int graph_version;
+
+// Grows the node and edge arrays to hold at least the given counts
+void graph_reserve(int node_capacity, int edge_capacity);
+// Appends a node at (x, y); returns its index
+int graph_add_node(float x, float y);
+// Appends a node with the given external id; returns its index, or -1 if
+// the id is in use
+int graph_add_node_with_id(float x, float y, int id);
+// Inserts a node at index, shifting later nodes and edge endpoints up
+void graph_insert_node(int index, Node node);
+// Appends an edge; returns its index
+int add_edge(int src, int dest, float weight);
+// Merges edges back in at the given ascending final indices in one pass
+void graph_insert_edges(const int *indices, const Edge *list, int count);
+// Removes the edge at index, preserving the order of the others
+void graph_remove_edge(int index);
+// Removes the edge at index in O(1), moving the last edge into its place
+void graph_remove_edge_unordered(int index);
+// Removes a node together with its incident edges
+void delete_node(int node_index);
+// Gives a node a negative id, so that a new node can take its id before
+// the node is removed
+void graph_release_node_id(int index);
+// Removes the nodes marked in drop (node_count entries) and their edges in
+// one pass, keeping the order of the rest
+void graph_remove_nodes(const unsigned char *drop);
+// Changes the weight of an edge
+void graph_set_weight(int edge_index, float weight);
+// Removes every node and edge
+void graph_clear();
+// Marks the graph as changed after writing the arrays directly
+void graph_touch();
+// Renumbers nodes so that new index i holds old node order[i]; edges are
+// remapped and sorted by their new endpoints. edge_order, if not NULL,
+// receives the old index of every edge.
+void graph_permute(const int *order, int *edge_order);
+// Reverts graph_permute(order) given the edge order it returned
+void graph_unpermute(const int *order, const int *edge_order);
+// Current index of the node with the given external id, or -1
+int graph_node_index(int id);
+
+// Bulk-loads edges: drops self loops, merges duplicates of either direction
+// (also against existing edges) using policy, sorts the edge array and builds
+// the adjacency. Returns the resulting edge count.
+int graph_add_edges(const Edge *list, int count, int policy);
+// O(1) expected lookup of the edge joining u and v in either direction
+bool has_edge(int u, int v);
+// Index of the edge joining u and v, or -1
+int graph_find_edge(int u, int v);
+// Adjacency snapshot of the current graph, rebuilt when it changed
+std::shared_ptr<const Adjacency> graph_adjacency();
+
+#endif
@@ -0,0 +1,40 @@
+/**
+ * @file history.h
+ * @brief Undo/redo journal for graph edits.
+ *
+ * Every user edit is executed through one of the history_* functions, which
+ * apply the change to the graph store and record just enough state to revert
+ * it. Entries only hold what the edit touched, so undoing or redoing costs
+ * time and memory proportional to the change rather than to the graph.
+ */
+
+#ifndef HISTORY_H
+#define HISTORY_H
+
+#include <functional>
+
+// Adds a node at (x, y); returns its index
+int history_add_node(float x, float y);
+// Adds an edge between two nodes
+void history_add_edge(int src, int dest, float weight);
+// Changes the weight of an existing edge
+void history_set_weight(int edge_index, float weight);
+// Deletes a node together with its incident edges
+void history_delete_node(int node_index);
+// Removes every node and edge
+void history_clear();
+// Replaces the whole graph with whatever fill() builds in the graph store;
+// keeps one copy of the graph for undo
+void history_replace(const std::function<void()> &fill);
+// Renumbers the nodes as graph_permute() does; keeps only the orders
+void history_permute(const int *order);
+
+// Drops every recorded edit, after the graph changed outside the journal
+void history_forget();
+
+// Reverts the most recent edit; returns false if there is nothing to undo
+bool history_undo();
+// Re-applies the most recently undone edit; returns false if there is none
+bool history_redo();
+
+#endif
@@ -0,0 +1,74 @@
+/**
+ * @file ingest.h
+ * @brief Live graph updates from a stream of edge events.
+ *
+ * A reader thread parses a file or pipe of text events into a queue. Once
+ * per frame, the GLUT thread takes what has arrived, up to
+ * INGEST_FRAME_EVENTS, and applies it to the graph store in order as one
+ * batch. Edge additions and reweights are O(1) and removals swap the last
+ * edge into the gap. Node deletions are only marked during the batch and
+ * compacted in one pass at its end, so a batch costs time linear in its
+ * events plus at most one O(N + E) pass.
+ *
+ * One event per line; node ids are the graph's external ids:
+ *
+ *   a SRC DEST [WEIGHT]  add an edge (weight 1 by default), creating missing
+ *                        nodes; an existing edge gets the weight
+ *   r SRC DEST           remove an edge
+ *   w SRC DEST WEIGHT    change the weight of an existing edge
+ *   d NODE               delete a node and its edges
+ *
+ * A line of just SRC DEST [WEIGHT] adds that edge too, so a plain edge list
+ * is a valid feed. Blank lines and lines starting with '#' or '%' are
+ * skipped. Feed changes bypass the undo history, which is dropped by the
+ * first batch.
+ */
+
+#ifndef INGEST_H
+#define INGEST_H
+
+#include "graph.h"
+
+#include <vector>
+
+#define INGEST_FRAME_EVENTS 262144 // most events applied in one batch
+#define INGEST_MAX_QUEUED 1048576  // parsed events before the reader waits
+
+// What a batch changed, for the caches that update incrementally. Edges
+// name their endpoints by external id.
+typedef struct
+{
+  int events;                // events applied
+  std::vector<int> touched;  // ids of nodes that gained or lost edges
+  std::vector<Edge> changed; // edges added, removed or reweighted
+  std::vector<int> deleted;  // ids of deleted nodes
+  bool cheaper_only;         // no edge got heavier or went away
+} IngestBatch;
+
+// Counters for the instrumentation overlay
+typedef struct
+{
+  unsigned long long parsed;    // events parsed by the reader
+  unsigned long long applied;   // events applied to the graph
+  unsigned long long malformed; // lines that were not an event
+  unsigned long long batches;   // frames that applied at least one event
+  int largest_batch;
+  int queued;   // parsed, not applied yet
+  bool reading; // the reader has not reached the end of its input
+} IngestStats;
+
+// Starts reading events from path, or standard input for "-". A regular
+// file is followed past its end when follow is set, like tail -f. With
+// rate > 0, reading is paced to that many events per second. Returns false
+// if the input cannot be opened.
+bool ingest_start(const char *path, bool follow, double rate);
+// Applies up to limit of the events queued since the last call, usually
+// INGEST_FRAME_EVENTS; GLUT thread only. New nodes are placed next to their
+// other endpoint, or at random in the box [x0, x1] x [y0, y1]. Returns false
+// if nothing was applied.
+bool ingest_poll(float x0, float y0, float x1, float y1, int limit, IngestBatch *batch);
+// Waits up to timeout_ms for events; returns true if some are queued
+bool ingest_wait(int timeout_ms);
+void ingest_stats(IngestStats *stats);
+
+#endif
@@ -0,0 +1,68 @@
+/**
+ * @file ipc.h
+ * @brief Unix-domain-socket server for driving the graph from other
+ *        processes.
+ *
+ * Clients send framed binary requests and may pipeline any number of them
+ * without waiting for replies. A server thread reads and parses the frames.
+ * Once per frame, the GLUT thread applies all queued mutations in arrival
+ * order and then hands the queued queries to the scheduler. Those queries
+ * all see one adjacency snapshot, taken after the frame's mutations. Replies
+ * carry the tag of their request and may arrive out of order.
+ *
+ * All integers and floats are little-endian. Nodes are addressed by their
+ * external id, which survives the renumbering caused by deletions.
+ */
+
+#ifndef IPC_H
+#define IPC_H
+
+#include <stdint.h>
+
+// Every request and reply starts with this header, followed by length
+// bytes of payload
+typedef struct
+{
+  uint32_t length; // payload bytes
+  uint32_t tag;    // chosen by the client, echoed in the reply
+  uint8_t code;    // IPC_OP_* in a request, IPC_STATUS_* in a reply
+  uint8_t reserved[3];
+} IpcHeader;
+
+// Requests: payload -> reply payload
+#define IPC_OP_STATS 1       // -> u32 nodes, u32 edges, u32 graph version, i32 highest id + 1
+#define IPC_OP_ADD_NODE 2    // f32 x, f32 y -> i32 id
+#define IPC_OP_ADD_EDGE 3    // i32 src, i32 dest, f32 weight; an existing edge gets the weight
+#define IPC_OP_DELETE_NODE 4 // i32 id
+#define IPC_OP_PATH 5        // i32 src, i32 dest -> f32 distance, u32 count, i32 ids[count]
+#define IPC_OP_MST 6         // -> f32 sum, u32 edges, i32 ends[2 * edges]
+
+#define IPC_MAX_REQUEST 12 // largest request payload
+
+// Reply codes
+#define IPC_STATUS_OK 0
+#define IPC_STATUS_BAD_REQUEST 1 // unknown op, wrong payload size or self loop
+#define IPC_STATUS_NOT_FOUND 2   // no node with that id
+#define IPC_STATUS_NO_PATH 3
+
+// Counters for the instrumentation overlay
+typedef struct
+{
+  int connections;              // open client connections
+  unsigned long long requests;  // requests parsed
+  unsigned long long mutations; // mutations applied
+  unsigned long long batches;   // frames that applied at least one request
+  int largest_batch;            // most requests handled in one frame
+} IpcStats;
+
+// Listens on path, replacing a stale socket file, and starts the server
+// thread. Returns false if the socket cannot be set up.
+bool ipc_start(const char *path);
+// Handles the requests queued since the last call; GLUT thread only. touch,
+// if given, is called with the index of every node a mutation changed.
+void ipc_poll(void (*touch)(int node));
+// Waits up to timeout_ms for requests; returns true if some are queued
+bool ipc_wait(int timeout_ms);
+void ipc_stats(IpcStats *stats);
+
+#endif
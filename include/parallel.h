@@ -0,0 +1,69 @@
+/**
+ * @file parallel.h
+ * @brief Work-stealing task scheduler and fork-join helper.
+ *
+ * One pool of threads serves every subsystem. Each worker owns a deque per
+ * priority; it pops its own work from the back and steals from the front of
+ * the others' deques when it runs dry. Interactive tasks are always taken
+ * before background ones.
+ */
+
+#ifndef PARALLEL_H
+#define PARALLEL_H
+
+#include <atomic>
+#include <functional>
+#include <memory>
+
+#define TASK_INTERACTIVE 0 // queries the user is waiting for
+#define TASK_BACKGROUND 1  // layout and other continuous work
+#define TASK_PRIORITIES 2
+
+#define SCHED_MAX_WORKERS 64
+
+// Shared between the submitter and the task
+typedef struct
+{
+  std::atomic<bool> cancelled;
+  std::atomic<bool> done;    // finished or dropped after cancellation
+  std::atomic<int> progress; // per mille, as reported by task_progress()
+} TaskState;
+
+typedef std::shared_ptr<TaskState> TaskHandle;
+
+// Snapshot of the scheduler for the instrumentation overlay
+typedef struct
+{
+  int workers;                      // pool threads
+  int depth[SCHED_MAX_WORKERS + 1]; // queued tasks per deque; 0 = outside the pool
+  int queued[TASK_PRIORITIES];      // queued tasks per priority
+  unsigned long long executed;      // tasks run, including parallel_for helpers
+  unsigned long long steals;        // tasks taken from another worker's deque
+  unsigned long long cancelled;     // tasks dropped before they started
+} SchedulerStats;
+
+// Number of worker slots: the pool threads plus the threads outside it
+int parallel_threads();
+// Slot of the calling thread in [0, parallel_threads()), for per-thread
+// scratch; 0 for every thread outside the pool
+int parallel_worker_id();
+// Runs fn(chunk) for every chunk in [0, chunks) and waits for all of them
+void parallel_for(int chunks, const std::function<void(int)> &fn);
+
+// Queues fn to run on the pool
+TaskHandle task_submit(int priority, std::function<void()> fn);
+// Asks a task to stop; a task that has not started yet is dropped
+void task_cancel(const TaskHandle &task);
+// Waits for a task, running other queued tasks meanwhile
+void task_wait(const TaskHandle &task);
+// Whether the task the calling thread works for has been cancelled
+bool task_cancelled();
+// Reports how far the task the calling thread works for has come, in [0, 1]
+void task_progress(float fraction);
+// Sets the priority of parallel_for chunks issued by the calling thread;
+// returns the previous one. Threads outside the pool start interactive.
+int task_set_priority(int priority);
+// Fills in queue depths and counters
+void scheduler_stats(SchedulerStats *stats);
+
+#endif
@@ -0,0 +1,51 @@
+/**
+ * @file paths.h
+ * @brief Shortest path searches over the adjacency snapshot.
+ */
+
+#ifndef PATHS_H
+#define PATHS_H
+
+#include "graph.h"
+
+#include <utility>
+#include <vector>
+
+// Reusable state of one Dijkstra search; keep one per thread
+typedef struct
+{
+  std::vector<float> dist;
+  std::vector<int> parent; // predecessor on the shortest path, -1 at a source
+  std::vector<std::pair<float, int>> heap;
+} DijkstraScratch;
+
+// Result of a multi-source query
+typedef struct
+{
+  std::vector<float> dist;   // distance to the nearest source
+  std::vector<int> parent;   // predecessor towards that source
+  std::vector<int> nearest;  // index into the source list, -1 if unreachable
+} FacilityResult;
+
+// One of the K shortest loopless paths
+typedef struct
+{
+  std::vector<int> nodes; // from source to target
+  float length;
+  int deviation;          // index of the node where it left the path it was derived from
+} Route;
+
+// Dijkstra from the given sources; stops once stop_at is settled (-1 = never).
+// Returns false if the calling task was cancelled during the search.
+bool dijkstra_search(const Adjacency &adj, const int *sources, int source_count,
+                     int stop_at, DijkstraScratch *scratch);
+// Yen's K shortest loopless paths, shortest first; fewer if the graph has no
+// more. Spur searches run concurrently. Returns false if the calling task was
+// cancelled.
+bool k_shortest_paths(const Adjacency &adj, int source, int target, int k,
+                      std::vector<Route> *routes);
+// Runs one full search per source concurrently and keeps the nearest per node
+void nearest_facilities(const Adjacency &adj, const std::vector<int> &sources,
+                        FacilityResult *result);
+
+#endif
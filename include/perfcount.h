@@ -0,0 +1,40 @@
+/**
+ * @file perfcount.h
+ * @brief Hardware cache counters of the calling thread via perf_event.
+ *
+ * Counting needs a PMU and perf_event_paranoid <= 2 (user space only). When
+ * the counters cannot be opened, samples still carry the wall time and
+ * report the counters as unavailable.
+ */
+
+#ifndef PERFCOUNT_H
+#define PERFCOUNT_H
+
+#define PERF_CACHE_REFERENCES 0 // last level cache accesses
+#define PERF_CACHE_MISSES 1     // last level cache misses
+#define PERF_L1D_MISSES 2       // L1 data cache read misses
+#define PERF_COUNTER_COUNT 3
+
+typedef struct
+{
+  int fd[PERF_COUNTER_COUNT]; // -1 when a counter is unavailable
+  long long start_ns;
+} PerfCounters;
+
+typedef struct
+{
+  long long value[PERF_COUNTER_COUNT]; // -1 when unavailable
+  double ms;
+} PerfSample;
+
+// Opens the counters for the calling thread; returns false if none opened
+bool perf_open(PerfCounters *counters);
+void perf_close(PerfCounters *counters);
+// Resets and starts counting
+void perf_start(PerfCounters *counters);
+// Stops counting and reads the counts since perf_start
+void perf_stop(PerfCounters *counters, PerfSample *sample);
+// Prints a sample as one line prefixed by name
+void perf_print(const char *name, const PerfSample *sample);
+
+#endif
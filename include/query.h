@@ -0,0 +1,77 @@
+/**
+ * @file query.h
+ * @brief Double-buffered results of queries that run on the scheduler.
+ *
+ * The renderer only ever reads a query's front buffer. A new request
+ * cancels the task in flight and starts one that fills a fresh back buffer;
+ * once it is done, query_collect() swaps it in on the GLUT thread. Until
+ * then the previous result stays on screen.
+ */
+
+#ifndef QUERY_H
+#define QUERY_H
+
+#include "graph.h"
+#include "parallel.h"
+
+#include <memory>
+#include <utility>
+
+template <typename T>
+struct Query
+{
+  T front;                 // last completed result, read by the renderer
+  unsigned int shown;      // graph_version front was computed for
+  std::shared_ptr<T> back; // buffer the running task fills
+  TaskHandle task;         // running task, or empty
+  unsigned int version;    // graph_version the running task was issued at
+};
+
+// Cancels the running task and starts fn(T *back), by default as an
+// interactive task. fn runs on a worker; it must only read the adjacency
+// snapshot and values it captured, never the live node and edge arrays.
+template <typename T, typename F>
+void query_start(Query<T> *q, F fn, int priority = TASK_INTERACTIVE)
+{
+  task_cancel(q->task);
+  std::shared_ptr<T> back = std::make_shared<T>();
+  q->back = back;
+  q->version = graph_version;
+  q->task = task_submit(priority, [back, fn]()
+                        { fn(back.get()); });
+}
+
+// Swaps in the result of a finished task; returns true if front changed.
+// Results of cancelled tasks are dropped, and so are those of older graph
+// versions unless keep_stale is set for a caller that can update them.
+template <typename T>
+bool query_collect(Query<T> *q, bool keep_stale = false)
+{
+  if (!q->task || !q->task->done.load())
+    return false;
+  bool fresh = !q->task->cancelled.load() && (keep_stale || q->version == graph_version);
+  if (fresh)
+  {
+    std::swap(q->front, *q->back);
+    q->shown = q->version;
+  }
+  q->task.reset();
+  q->back.reset();
+  return fresh;
+}
+
+// Cancels the running task, if any
+template <typename T>
+void query_cancel(Query<T> *q)
+{
+  task_cancel(q->task);
+}
+
+// Progress of the running task in [0, 1], or -1 when idle
+template <typename T>
+float query_progress(const Query<T> &q)
+{
+  return q.task ? q.task->progress.load() / 1000.0f : -1;
+}
+
+#endif
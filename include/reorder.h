@@ -0,0 +1,29 @@
+/**
+ * @file reorder.h
+ * @brief Node orderings that place related nodes at nearby indices.
+ *
+ * Both functions return order[new index] = old index, ready for
+ * graph_permute().
+ */
+
+#ifndef REORDER_H
+#define REORDER_H
+
+#include "graph.h"
+
+#include <vector>
+
+#define REORDER_RCM 1
+#define REORDER_HILBERT 2
+
+// Reverse Cuthill-McKee: BFS from a pseudo-peripheral node of every
+// component, visiting neighbors by increasing degree, then reversed
+void order_rcm(const Adjacency &adj, std::vector<int> *order);
+// Position along a Hilbert curve over the bounding box of the layout
+void order_hilbert(const Node *list, int count, std::vector<int> *order);
+// Short name of an ordering ("rcm", "hilbert")
+const char *reorder_name(int method);
+// Looks an ordering up by its short name; returns 0 if unknown
+int reorder_method(const char *name);
+
+#endif
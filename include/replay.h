@@ -0,0 +1,61 @@
+/**
+ * @file replay.h
+ * @brief Recording and replay of input events.
+ *
+ * Mouse, motion, keyboard and resize events are written to a compact binary log
+ * together with their timestamp and the number of layout ticks that ran
+ * before them. Replaying feeds the events back through the same handlers
+ * after exactly the same number of layout ticks, so the resulting graph and
+ * layout are reproduced bit for bit, either at the recorded pace or as fast
+ * as possible for benchmarking.
+ */
+
+#ifndef REPLAY_H
+#define REPLAY_H
+
+#include <stdint.h>
+
+#define EVENT_MOUSE 1
+#define EVENT_KEY 2
+#define EVENT_RESIZE 3
+#define EVENT_END 4
+#define EVENT_MOTION 5
+
+typedef struct
+{
+  int type;         // EVENT_*
+  int code;         // mouse button or key
+  int state;        // GLUT_DOWN / GLUT_UP for mouse events
+  int x, y;         // cursor position, or the new size for EVENT_RESIZE
+  uint64_t time_us; // time since the start of the recording
+  uint32_t tick;    // layout ticks that ran before the event
+} InputEvent;
+
+typedef struct
+{
+  void (*mouse)(int button, int state, int x, int y);
+  void (*motion)(int x, int y);
+  void (*keyboard)(unsigned char key, int x, int y);
+  void (*resize)(int w, int h);
+  void (*tick)(); // runs one layout step
+} ReplayHandlers;
+
+// Seed for every randomized step; stored in the log so replays reproduce it
+extern unsigned int session_seed;
+// Number of layout ticks since startup
+extern uint32_t layout_tick;
+
+// Starts writing events to path; the window size is stored in the header
+bool record_open(const char *path, int width, int height);
+bool record_active();
+void record_event(int type, int code, int state, int x, int y);
+
+// Loads a log for replay and applies its seed; reports the recorded size
+bool replay_open(const char *path, int *width, int *height);
+bool replay_active();
+// Dispatches every event that is due and runs layout ticks up to it
+void replay_poll(const ReplayHandlers *handlers, bool max_speed);
+// Replays the whole log without waiting, then prints timing statistics
+void replay_run(const ReplayHandlers *handlers);
+
+#endif
@@ -0,0 +1,47 @@
+/**
+ * @file stream.h
+ * @brief Layout, MST and shortest paths over a memory-mapped edge file.
+ *
+ * Streamed mode keeps per-node state (positions, distances, components) in
+ * memory and reads edges only through an EdgeFile, so graphs with far more
+ * edges than fit in RAM can be processed within a fixed resident budget.
+ */
+
+#ifndef STREAM_H
+#define STREAM_H
+
+#include "edgefile.h"
+
+#include <vector>
+
+typedef struct
+{
+  const char *path;
+  size_t budget;  // resident bytes allowed for mapped edge pages
+  int iterations; // layout iterations to run
+  int from, to;   // shortest path endpoints; -1 picks the first and last node
+  unsigned int seed;
+} StreamOptions;
+
+// Node positions and per-iteration scratch of a streamed layout
+typedef struct
+{
+  std::vector<float> x, y;
+  std::vector<float> dx, dy;
+  std::vector<int> cell_start, cell_nodes;
+  std::vector<float> cell_x, cell_y; // positions in cell_nodes order
+} StreamLayout;
+
+// Places the nodes at hashed random positions in [-1, 1]^2
+void stream_layout_init(const EdgeFile *file, unsigned int seed, StreamLayout *layout);
+// One force-directed iteration; edges are read window by window
+void stream_layout_step(EdgeFile *file, StreamLayout *layout);
+// Minimum spanning forest by Boruvka rounds, one pass over the file per
+// round; returns its total weight
+double stream_mst(EdgeFile *file, long long *tree_edges, int *rounds);
+// Dijkstra with random arc reads; returns the distance or -1 if unreachable
+float stream_shortest_path(EdgeFile *file, int from, int to, std::vector<int> *path);
+// Runs the streamed benchmark and prints its timings; returns an exit status
+int stream_run(const StreamOptions *options);
+
+#endif
@@ -0,0 +1,64 @@
+/**
+ * @file stress.h
+ * @brief Sparse stress majorization layout with pivot-MDS placement.
+ *
+ * Stress layouts place nodes so that their distance in the drawing matches
+ * their weighted shortest path distance. Full stress needs all pairwise
+ * distances; the sparse model keeps every edge plus one term per pivot, so
+ * memory and time per iteration are O(N * (pivots + degree)). Distances come
+ * from one Dijkstra search per pivot. The far terms of a pivot are weighted
+ * by the number of nodes it stands in for, as in Ortmann, Klimenta and
+ * Brandes' sparse stress model. Pivot MDS gives the initial placement.
+ */
+
+#ifndef STRESS_H
+#define STRESS_H
+
+#include "graph.h"
+
+#include <vector>
+
+#define STRESS_PIVOTS 50      // pivots, or every node in smaller graphs
+#define STRESS_MARGIN 0.9f    // share of the drawing box the placement fills
+#define STRESS_POWER_STEPS 64 // power iterations per pivot-MDS axis
+
+// Drawing area; positions are kept inside it
+typedef struct
+{
+  float x0, y0, x1, y1;
+} LayoutBox;
+
+// Sparse stress terms of one graph, with distances already scaled to layout
+// units
+typedef struct
+{
+  int node_count;
+  int pivot_count;
+  std::vector<int> pivots;
+  std::vector<float> pivot_dist;   // node_count x pivot_count, by node
+  std::vector<float> pivot_weight; // node_count x pivot_count, by node
+  std::vector<int> offsets;        // edge terms of each node, like Adjacency
+  std::vector<int> targets;
+  std::vector<float> edge_dist;
+  std::vector<float> x, y; // pivot-MDS placement inside the box
+  float scale;             // layout units per unit of edge weight
+  double build_ms;
+} StressModel;
+
+// Builds the model for a graph and places it inside box. Gives up, leaving
+// the model incomplete, when the calling task is cancelled.
+void stress_build(const Adjacency &adj, const LayoutBox &box, unsigned int seed,
+                  StressModel *model);
+// Only the pivot-MDS placement of stress_build, for a quick first drawing;
+// x and y stay empty when the calling task is cancelled
+void stress_place(const Adjacency &adj, const LayoutBox &box, unsigned int seed,
+                  std::vector<float> *x, std::vector<float> *y);
+// One majorization step of every node: reads list, writes the new positions
+// to next and then back into list, clamped to box. Returns the normalized
+// stress of the positions before the step.
+double stress_step(const StressModel &model, Node *list, const LayoutBox &box,
+                   float (*next)[2]);
+// Scale-free stress of a drawing, as returned by stress_step
+double stress_measure(const StressModel &model, const Node *list);
+
+#endif
@@ -0,0 +1,646 @@
+/**
+ * @file analytics.cpp
+ * @brief Connected components, BFS layers, PageRank, betweenness and the
+ *        minimum spanning tree.
+ *
+ * Node ranges are split into ANALYTICS_CHUNKS slices independent of the core
+ * count, and every reduction adds the per-slice partial results in slice
+ * order, so results are reproducible across machines.
+ */
+
+#include "analytics.h"
+#include "parallel.h"
+
+#include <algorithm>
+#include <atomic>
+#include <float.h>
+#include <functional>
+#include <math.h>
+#include <memory>
+#include <mutex>
+#include <stdint.h>
+#include <unordered_map>
+#include <unordered_set>
+#include <utility>
+
+#define ANALYTICS_CHUNKS 64
+
+// Direction-optimizing BFS switch thresholds (Beamer et al.)
+#define BFS_ALPHA 14 // go bottom-up once frontier edges > unexplored edges / alpha
+#define BFS_BETA 24  // go back top-down once the frontier < nodes / beta
+
+#define INF FLT_MAX
+
+/**
+ * @brief Runs fn(chunk, lo, hi) over ANALYTICS_CHUNKS equal slices of
+ * [0, total).
+ *
+ * @param total Size of the range
+ * @param fn Function called with the chunk index and its slice
+ */
+static void for_each_slice(int total, const std::function<void(int, int, int)> &fn)
+{
+  parallel_for(ANALYTICS_CHUNKS, [&](int c)
+               {
+                 int lo = (int)((long long)total * c / ANALYTICS_CHUNKS);
+                 int hi = (int)((long long)total * (c + 1) / ANALYTICS_CHUNKS);
+                 if (lo < hi)
+                   fn(c, lo, hi);
+               });
+}
+
+/**
+ * @brief Finds the root of x, halving the path on the way.
+ *
+ * @param parent Union-find forest
+ * @param x Node
+ * @return Root of the tree holding x
+ */
+static int uf_find(std::atomic<int> *parent, int x)
+{
+  for (;;)
+  {
+    int p = parent[x].load(std::memory_order_relaxed);
+    if (p == x)
+      return x;
+    int gp = parent[p].load(std::memory_order_relaxed);
+    if (gp != p)
+      parent[x].compare_exchange_weak(p, gp, std::memory_order_relaxed);
+    x = p;
+  }
+}
+
+/**
+ * @brief Labels connected components with a concurrent union-find.
+ *
+ * Unions link the larger root below the smaller one with a compare-and-swap
+ * and retry if another thread got there first, so every tree ends up rooted
+ * at the lowest node of its component regardless of scheduling.
+ *
+ * @param adj Adjacency snapshot
+ * @param component Component index of every node
+ * @return Number of components
+ */
+int connected_components(const Adjacency &adj, std::vector<int> *component)
+{
+  int n = adj.node_count;
+  std::unique_ptr<std::atomic<int>[]> parent(new std::atomic<int>[n]);
+  for_each_slice(n, [&](int, int lo, int hi)
+                 {
+                   for (int v = lo; v < hi; v++)
+                     parent[v].store(v, std::memory_order_relaxed);
+                 });
+
+  for_each_slice(n, [&](int, int lo, int hi)
+                 {
+                   for (int u = lo; u < hi; u++)
+                   {
+                     for (int k = adj.offsets[u]; k < adj.offsets[u + 1]; k++)
+                     {
+                       int v = adj.targets[k];
+                       if (v <= u)
+                         continue; // each edge is stored in both lists
+                       for (;;)
+                       {
+                         int ru = uf_find(parent.get(), u);
+                         int rv = uf_find(parent.get(), v);
+                         if (ru == rv)
+                           break;
+                         if (ru < rv)
+                           std::swap(ru, rv);
+                         if (parent[ru].compare_exchange_strong(ru, rv))
+                           break;
+                       }
+                     }
+                   }
+                 });
+
+  component->resize(n);
+  for_each_slice(n, [&](int, int lo, int hi)
+                 {
+                   for (int v = lo; v < hi; v++)
+                     (*component)[v] = uf_find(parent.get(), v);
+                 });
+
+  // Roots are the lowest node of their component, so one ordered pass
+  // numbers components densely
+  int count = 0;
+  for (int v = 0; v < n; v++)
+  {
+    if ((*component)[v] == v)
+      (*component)[v] = count++;
+    else
+      (*component)[v] = (*component)[(*component)[v]];
+  }
+  return count;
+}
+
+/**
+ * @brief Computes BFS hop layers with a direction-optimizing search.
+ *
+ * Small frontiers expand top-down, claiming neighbors with a
+ * compare-and-swap. Once the edges leaving the frontier outweigh those left
+ * to explore, the search switches to bottom-up steps in which every
+ * unvisited node scans its own neighbors for a parent and stops at the first
+ * one, which skips most edges of the large middle layers.
+ *
+ * @param adj Adjacency snapshot
+ * @param source Start node
+ * @param level Hop count of every node, -1 if unreachable
+ * @param bottom_up_steps Receives the number of bottom-up steps, may be NULL
+ * @return Number of layers
+ */
+int bfs_layers(const Adjacency &adj, int source, std::vector<int> *level,
+               int *bottom_up_steps)
+{
+  int n = adj.node_count;
+  if (bottom_up_steps)
+    *bottom_up_steps = 0;
+  level->assign(n, -1);
+  if (source < 0 || source >= n)
+    return 0;
+
+  std::unique_ptr<std::atomic<int>[]> seen(new std::atomic<int>[n]);
+  for_each_slice(n, [&](int, int lo, int hi)
+                 {
+                   for (int v = lo; v < hi; v++)
+                     seen[v].store(-1, std::memory_order_relaxed);
+                 });
+  seen[source].store(0, std::memory_order_relaxed);
+
+  std::vector<int> frontier(1, source);
+  std::vector<std::vector<int>> next(ANALYTICS_CHUNKS);
+  long long unexplored = adj.offsets[n] - (adj.offsets[source + 1] - adj.offsets[source]);
+  long long frontier_edges = adj.offsets[source + 1] - adj.offsets[source];
+  bool bottom_up = false;
+  int depth = 0;
+
+  while (!frontier.empty())
+  {
+    if (!bottom_up && frontier_edges > unexplored / BFS_ALPHA)
+      bottom_up = true;
+    else if (bottom_up && (long long)frontier.size() < n / BFS_BETA)
+      bottom_up = false;
+
+    for (int c = 0; c < ANALYTICS_CHUNKS; c++)
+      next[c].clear();
+    if (bottom_up)
+    {
+      if (bottom_up_steps)
+        (*bottom_up_steps)++;
+      for_each_slice(n, [&](int c, int lo, int hi)
+                     {
+                       for (int v = lo; v < hi; v++)
+                       {
+                         if (seen[v].load(std::memory_order_relaxed) != -1)
+                           continue;
+                         for (int k = adj.offsets[v]; k < adj.offsets[v + 1]; k++)
+                         {
+                           // Nodes found in this step hold depth + 1, so
+                           // they are never taken as parents within it
+                           if (seen[adj.targets[k]].load(std::memory_order_relaxed) == depth)
+                           {
+                             seen[v].store(depth + 1, std::memory_order_relaxed);
+                             next[c].push_back(v);
+                             break;
+                           }
+                         }
+                       }
+                     });
+    }
+    else
+    {
+      for_each_slice((int)frontier.size(), [&](int c, int lo, int hi)
+                     {
+                       for (int i = lo; i < hi; i++)
+                       {
+                         int u = frontier[i];
+                         for (int k = adj.offsets[u]; k < adj.offsets[u + 1]; k++)
+                         {
+                           int v = adj.targets[k];
+                           int expected = -1;
+                           if (seen[v].load(std::memory_order_relaxed) == -1 &&
+                               seen[v].compare_exchange_strong(expected, depth + 1))
+                             next[c].push_back(v);
+                         }
+                       }
+                     });
+    }
+
+    frontier.clear();
+    frontier_edges = 0;
+    for (int c = 0; c < ANALYTICS_CHUNKS; c++)
+    {
+      for (int v : next[c])
+      {
+        frontier.push_back(v);
+        frontier_edges += adj.offsets[v + 1] - adj.offsets[v];
+      }
+    }
+    unexplored -= frontier_edges;
+    depth++;
+  }
+
+  for_each_slice(n, [&](int, int lo, int hi)
+                 {
+                   for (int v = lo; v < hi; v++)
+                     (*level)[v] = seen[v].load(std::memory_order_relaxed);
+                 });
+  return depth;
+}
+
+/**
+ * @brief Computes PageRank by pull-style power iteration.
+ *
+ * Each iteration first spreads every node's rank over its degree, then lets
+ * every node sum the shares of its neighbors, so no two threads ever write
+ * the same entry. Rank held by isolated nodes is redistributed uniformly.
+ *
+ * @param adj Adjacency snapshot
+ * @param damping Probability of following an edge, typically 0.85
+ * @param max_iterations Iteration limit
+ * @param tolerance Stops once the L1 change of an iteration drops below it
+ * @param rank PageRank of every node; sums to 1
+ * @return Number of iterations run
+ */
+int pagerank(const Adjacency &adj, float damping, int max_iterations,
+             float tolerance, std::vector<float> *rank)
+{
+  int n = adj.node_count;
+  rank->assign(n, n > 0 ? 1.0f / n : 0);
+  if (n == 0)
+    return 0;
+
+  std::vector<float> share(n);
+  std::vector<double> partial(ANALYTICS_CHUNKS);
+  int iteration = 0;
+  while (iteration < max_iterations)
+  {
+    iteration++;
+    std::fill(partial.begin(), partial.end(), 0.0);
+    for_each_slice(n, [&](int c, int lo, int hi)
+                   {
+                     double dangling = 0;
+                     for (int v = lo; v < hi; v++)
+                     {
+                       int degree = adj.offsets[v + 1] - adj.offsets[v];
+                       if (degree == 0)
+                       {
+                         share[v] = 0;
+                         dangling += (*rank)[v];
+                       }
+                       else
+                         share[v] = (*rank)[v] / degree;
+                     }
+                     partial[c] = dangling;
+                   });
+    double dangling = 0;
+    for (int c = 0; c < ANALYTICS_CHUNKS; c++)
+      dangling += partial[c];
+    float base = (float)((1.0 - damping + damping * dangling) / n);
+
+    std::fill(partial.begin(), partial.end(), 0.0);
+    for_each_slice(n, [&](int c, int lo, int hi)
+                   {
+                     double change = 0;
+                     for (int v = lo; v < hi; v++)
+                     {
+                       float sum = 0;
+                       for (int k = adj.offsets[v]; k < adj.offsets[v + 1]; k++)
+                         sum += share[adj.targets[k]];
+                       float r = base + damping * sum;
+                       change += fabsf(r - (*rank)[v]);
+                       (*rank)[v] = r; // shares were taken before this pass
+                     }
+                     partial[c] = change;
+                   });
+    double change = 0;
+    for (int c = 0; c < ANALYTICS_CHUNKS; c++)
+      change += partial[c];
+    if (change < tolerance || task_cancelled())
+      break;
+    task_progress((float)iteration / max_iterations);
+  }
+  return iteration;
+}
+
+// Per-worker state of the betweenness kernel
+typedef struct
+{
+  std::vector<float> dist;
+  std::vector<double> sigma; // number of shortest paths from the source
+  std::vector<double> delta; // dependency of the source on each node
+  std::vector<int> order;    // nodes in the order they were settled
+  std::vector<std::pair<float, int>> heap;
+  std::vector<double> centrality;
+} BrandesScratch;
+
+/**
+ * @brief Adds the dependencies of one source to the worker's centrality.
+ *
+ * Predecessors are not stored: during the backward pass a neighbor v of w
+ * is a predecessor exactly when dist[v] + weight == dist[w], the same float
+ * expression the forward pass used. Only the settled nodes are reset
+ * afterwards, so the cost stays proportional to the reached part of the
+ * graph.
+ *
+ * @param adj Adjacency snapshot
+ * @param s Source node
+ * @param sc Worker scratch, sized to the graph with dist at INF
+ */
+static void brandes_source(const Adjacency &adj, int s, BrandesScratch &sc)
+{
+  auto greater = std::greater<std::pair<float, int>>();
+  sc.order.clear();
+  sc.heap.clear();
+  sc.dist[s] = 0;
+  sc.sigma[s] = 1;
+  sc.heap.push_back(std::make_pair(0.0f, s));
+  while (!sc.heap.empty())
+  {
+    std::pop_heap(sc.heap.begin(), sc.heap.end(), greater);
+    float d = sc.heap.back().first;
+    int u = sc.heap.back().second;
+    sc.heap.pop_back();
+    if (d > sc.dist[u] || sc.delta[u] < 0)
+      continue; // stale entry, or already settled
+    sc.delta[u] = -1; // settled marker until the backward pass
+    sc.order.push_back(u);
+    for (int k = adj.offsets[u]; k < adj.offsets[u + 1]; k++)
+    {
+      int v = adj.targets[k];
+      float nd = d + adj.weights[k];
+      if (nd < sc.dist[v])
+      {
+        sc.dist[v] = nd;
+        sc.sigma[v] = sc.sigma[u];
+        sc.heap.push_back(std::make_pair(nd, v));
+        std::push_heap(sc.heap.begin(), sc.heap.end(), greater);
+      }
+      else if (nd == sc.dist[v] && sc.delta[v] >= 0)
+        sc.sigma[v] += sc.sigma[u];
+    }
+  }
+
+  for (int u : sc.order)
+    sc.delta[u] = 0;
+  for (int i = (int)sc.order.size() - 1; i > 0; i--)
+  {
+    int w = sc.order[i];
+    double coefficient = (1.0 + sc.delta[w]) / sc.sigma[w];
+    for (int k = adj.offsets[w]; k < adj.offsets[w + 1]; k++)
+    {
+      int v = adj.targets[k];
+      if (sc.dist[v] + adj.weights[k] == sc.dist[w])
+        sc.delta[v] += sc.sigma[v] * coefficient;
+    }
+    sc.centrality[w] += sc.delta[w];
+  }
+
+  for (int u : sc.order)
+  {
+    sc.dist[u] = INF;
+    sc.sigma[u] = 0;
+    sc.delta[u] = 0;
+  }
+}
+
+/**
+ * @brief Computes betweenness centrality with Brandes' algorithm.
+ *
+ * Sources are processed concurrently; each worker accumulates into its own
+ * array, and the arrays are summed over node slices at the end. The sum is
+ * taken in worker order, which can differ from run to run only in the last
+ * bits of the result.
+ *
+ * @param adj Adjacency snapshot
+ * @param max_sources Largest number of single-source searches to run
+ * @param centrality Betweenness of every node (each unordered pair counted
+ * once)
+ * @return Number of sources searched
+ */
+int betweenness(const Adjacency &adj, int max_sources,
+                std::vector<float> *centrality)
+{
+  // The scratch is shared by all calls; a cancelled query still unwinding
+  // finishes before the next one starts
+  static std::mutex busy;
+  std::lock_guard<std::mutex> lock(busy);
+  int n = adj.node_count;
+  int sources = n < max_sources ? n : max_sources;
+  int workers = parallel_threads();
+  static std::vector<BrandesScratch> scratch;
+  scratch.resize(workers);
+  for (int w = 0; w < workers; w++)
+  {
+    scratch[w].dist.assign(n, INF);
+    scratch[w].sigma.assign(n, 0);
+    scratch[w].delta.assign(n, 0);
+    scratch[w].centrality.assign(n, 0);
+  }
+
+  std::atomic<int> done(0);
+  parallel_for(sources, [&](int i)
+               {
+                 if (task_cancelled())
+                   return;
+                 int s = (int)((long long)n * i / sources);
+                 brandes_source(adj, s, scratch[parallel_worker_id()]);
+                 task_progress((float)++done / sources);
+               });
+
+  // Undirected paths are found from both ends; sampled pivots scale up
+  double scale = 0.5 * (sources > 0 ? (double)n / sources : 0);
+  centrality->resize(n);
+  for_each_slice(n, [&](int, int lo, int hi)
+                 {
+                   for (int v = lo; v < hi; v++)
+                   {
+                     double sum = 0;
+                     for (int w = 0; w < workers; w++)
+                       sum += scratch[w].centrality[v];
+                     (*centrality)[v] = (float)(sum * scale);
+                   }
+                 });
+  return sources;
+}
+
+/**
+ * @brief Computes the Minimum Spanning Tree (MST) with Prim's algorithm.
+ *
+ * Each tree of the forest is grown from its lowest node index with a
+ * lazy-deletion binary heap, reading every node's adjacency row once. This
+ * avoids sorting all edges up front, which made Kruskal several times
+ * slower on large graphs. Ties in weight go to the first neighbor offering
+ * it, which keeps the tree stable while the graph does not change. Runs on
+ * a worker.
+ *
+ * @param adj Adjacency snapshot
+ * @param ids External id of every node, for a result that survives edits
+ * @param out Receives the endpoints of the tree edges and their total weight
+ */
+void minimum_spanning_tree(const Adjacency &adj, const std::vector<int> &ids, MstResult *out)
+{
+  int n = adj.node_count;
+  std::vector<float> key(n, INF);
+  std::vector<int> parent(n, -1);
+  std::vector<char> done(n, 0);
+  std::vector<std::pair<float, int>> heap;
+  auto greater = std::greater<std::pair<float, int>>();
+
+  out->sum = 0;
+  int added = 0;
+  for (int root = 0; root < n; root++)
+  {
+    if (done[root])
+      continue;
+    key[root] = 0;
+    heap.push_back(std::make_pair(0.0f, root));
+    while (!heap.empty())
+    {
+      std::pop_heap(heap.begin(), heap.end(), greater);
+      float k = heap.back().first;
+      int u = heap.back().second;
+      heap.pop_back();
+      if (done[u] || k > key[u])
+        continue; // stale entry
+      done[u] = 1;
+      if (++added % 4096 == 0)
+      {
+        if (task_cancelled())
+          return;
+        task_progress((float)added / n);
+      }
+      if (parent[u] != -1)
+      {
+        out->ends.push_back(ids[parent[u]]);
+        out->ends.push_back(ids[u]);
+        out->weights.push_back(k);
+        out->sum += k;
+      }
+      for (int e = adj.offsets[u]; e < adj.offsets[u + 1]; e++)
+      {
+        int v = adj.targets[e];
+        if (!done[v] && adj.weights[e] < key[v])
+        {
+          key[v] = adj.weights[e];
+          parent[v] = u;
+          heap.push_back(std::make_pair(adj.weights[e], v));
+          std::push_heap(heap.begin(), heap.end(), greater);
+        }
+      }
+    }
+  }
+}
+
+/**
+ * @brief Returns the direction-independent key of an id pair.
+ *
+ * @param a One endpoint
+ * @param b Other endpoint
+ * @return Key with the smaller id in the high half
+ */
+static inline uint64_t pair_key(int a, int b)
+{
+  if (a > b)
+    std::swap(a, b);
+  return ((uint64_t)(uint32_t)a << 32) | (uint32_t)b;
+}
+
+/**
+ * @brief Updates a minimum spanning forest after edge changes.
+ *
+ * As long as every tree edge still exists at no higher weight, the new
+ * forest lies within the old one plus the edges that were added or got
+ * lighter (cycle property), so Kruskal over those O(N + changes) edges
+ * gives it without looking at the rest of the graph. Edges that were
+ * removed or got heavier outside the tree cannot enter it and are skipped.
+ * Old tree edges win ties, which keeps the tree stable.
+ *
+ * @param tree Forest before the changes
+ * @param changed Edges changed since, by external id, in any order and
+ *        possibly repeated
+ * @param deleted External ids of nodes deleted since
+ * @param weight_of Current weight of the edge between two ids, negative if
+ *        there is none
+ * @param out Receives the updated forest
+ * @return false if the changes need a full recomputation
+ */
+bool update_spanning_tree(const MstResult &tree, const std::vector<Edge> &changed,
+                          const std::vector<int> &deleted,
+                          const std::function<float(int, int)> &weight_of, MstResult *out)
+{
+  size_t tree_edges = tree.weights.size();
+  std::unordered_set<int> gone(deleted.begin(), deleted.end());
+  std::unordered_map<uint64_t, int> in_tree;
+  in_tree.reserve(tree_edges);
+  for (size_t t = 0; t < tree_edges; t++)
+  {
+    int a = tree.ends[2 * t], b = tree.ends[2 * t + 1];
+    if (gone.count(a) || gone.count(b))
+      return false;
+    in_tree.emplace(pair_key(a, b), (int)t);
+  }
+
+  std::vector<Edge> list; // tree edges first, then the candidates
+  list.reserve(tree_edges + changed.size());
+  for (size_t t = 0; t < tree_edges; t++)
+    list.push_back((Edge){tree.ends[2 * t], tree.ends[2 * t + 1], tree.weights[t]});
+  std::unordered_set<uint64_t> seen;
+  for (const Edge &e : changed)
+  {
+    uint64_t key = pair_key(e.src, e.dest);
+    if (!seen.insert(key).second)
+      continue;
+    float w = weight_of(e.src, e.dest);
+    auto it = in_tree.find(key);
+    if (it != in_tree.end())
+    {
+      if (w < 0 || w > tree.weights[it->second])
+        return false;
+      list[it->second].weight = w;
+    }
+    else if (w >= 0)
+      list.push_back((Edge){e.src, e.dest, w});
+  }
+
+  std::vector<int> order(list.size());
+  for (size_t i = 0; i < order.size(); i++)
+    order[i] = (int)i;
+  std::stable_sort(order.begin(), order.end(), [&](int a, int b)
+                   { return list[a].weight < list[b].weight; });
+
+  std::unordered_map<int, int> slot; // union-find entry of every id
+  slot.reserve(2 * list.size());
+  std::vector<int> parent;
+  auto find = [&](int id) -> int
+  {
+    auto it = slot.emplace(id, (int)parent.size());
+    if (it.second)
+      parent.push_back(it.first->second);
+    int x = it.first->second;
+    while (parent[x] != x)
+    {
+      parent[x] = parent[parent[x]];
+      x = parent[x];
+    }
+    return x;
+  };
+
+  out->ends.clear();
+  out->weights.clear();
+  out->sum = 0;
+  for (int i : order)
+  {
+    const Edge &e = list[i];
+    int ru = find(e.src), rv = find(e.dest);
+    if (ru == rv)
+      continue;
+    parent[ru] = rv;
+    out->ends.push_back(e.src);
+    out->ends.push_back(e.dest);
+    out->weights.push_back(e.weight);
+    out->sum += e.weight;
+  }
+  return true;
+}
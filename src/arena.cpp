@@ -0,0 +1,134 @@
+/**
+ * @file arena.cpp
+ * @brief Arena blocks and the process-wide heap allocation counter.
+ *
+ * The counter replaces the global operator new so that every allocation
+ * made through new, std::vector, std::function and friends is counted; the
+ * frame loop can then check that it runs without touching the heap.
+ */
+
+#include "arena.h"
+
+#include <atomic>
+#include <new>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+struct ArenaBlock
+{
+  ArenaBlock *prev; // earlier block of the same cycle, freed at reset
+  size_t capacity;  // usable bytes after the header
+};
+
+Arena frame_arena = {NULL, 0, 0};
+Arena query_arena = {NULL, 0, 0};
+
+static std::atomic<unsigned long long> allocations(0);
+
+/**
+ * @brief Allocates a block and links it in front of the arena's blocks.
+ *
+ * @param arena Arena to grow
+ * @param capacity Usable bytes
+ */
+static void push_block(Arena *arena, size_t capacity)
+{
+  ArenaBlock *block = (ArenaBlock *)malloc(sizeof(ArenaBlock) + capacity);
+  if (!block)
+  {
+    fprintf(stderr, "Out of memory growing an arena to %zu bytes\n", capacity);
+    abort();
+  }
+  allocations++;
+  block->prev = arena->head;
+  block->capacity = capacity;
+  arena->head = block;
+  arena->used = 0;
+  arena->reserved += capacity;
+}
+
+/**
+ * @brief Allocates from an arena.
+ *
+ * @param arena Arena to allocate from
+ * @param size Number of bytes
+ * @param align Alignment, a power of two no larger than 16
+ * @return Pointer valid until the next arena_reset
+ */
+void *arena_alloc(Arena *arena, size_t size, size_t align)
+{
+  size_t start = (arena->used + align - 1) & ~(align - 1);
+  if (!arena->head || start + size > arena->head->capacity)
+  {
+    size_t capacity = arena->reserved > ARENA_MIN_BLOCK ? arena->reserved : ARENA_MIN_BLOCK;
+    while (capacity < size + align)
+      capacity *= 2;
+    push_block(arena, capacity);
+    start = 0;
+  }
+  arena->used = start + size;
+  return (char *)(arena->head + 1) + start;
+}
+
+/**
+ * @brief Releases everything allocated from an arena.
+ *
+ * If the cycle spilled into several blocks, they are replaced by one block
+ * as large as all of them together, so the next cycle of the same size fits
+ * without allocating.
+ *
+ * @param arena Arena to reset
+ */
+void arena_reset(Arena *arena)
+{
+  if (arena->head && arena->head->prev)
+  {
+    size_t total = arena->reserved;
+    while (arena->head)
+    {
+      ArenaBlock *prev = arena->head->prev;
+      free(arena->head);
+      arena->head = prev;
+    }
+    arena->reserved = 0;
+    push_block(arena, total);
+  }
+  arena->used = 0;
+}
+
+/**
+ * @brief Returns the number of heap allocations so far.
+ *
+ * @return Calls to operator new plus arena blocks
+ */
+unsigned long long heap_allocations() { return allocations.load(std::memory_order_relaxed); }
+
+/**
+ * @brief Counting replacement of the global operator new.
+ *
+ * @param size Number of bytes
+ * @return Allocated memory
+ */
+void *operator new(size_t size)
+{
+  allocations.fetch_add(1, std::memory_order_relaxed);
+  void *p = malloc(size ? size : 1);
+  if (!p)
+    throw std::bad_alloc();
+  return p;
+}
+
+/**
+ * @brief Array form of the counting operator new.
+ *
+ * @param size Number of bytes
+ * @return Allocated memory
+ */
+void *operator new[](size_t size) { return operator new(size); }
+
+// The matching deletes release memory from the counting operator new
+void operator delete(void *p) noexcept { free(p); }
+void operator delete[](void *p) noexcept { free(p); }
+void operator delete(void *p, size_t) noexcept { free(p); }
+void operator delete[](void *p, size_t) noexcept { free(p); }
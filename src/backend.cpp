@@ -0,0 +1,204 @@
+/**
+ * @file backend.cpp
+ * @brief Dispatch of chunked kernels to the selected execution backend.
+ *
+ * The std::execution backend needs libstdc++'s parallel algorithms, which run
+ * on TBB; it is compiled in when the TBB headers are found. The OpenMP
+ * backend is compiled in when building with -fopenmp.
+ */
+
+#include "backend.h"
+#include "parallel.h"
+
+#include <string.h>
+#include <vector>
+
+#if __has_include(<execution>) && __has_include(<tbb/task_arena.h>)
+#define HAVE_PAR_UNSEQ 1
+#include <algorithm>
+#include <execution>
+#include <tbb/task_arena.h>
+#endif
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+bool backend_deterministic = true;
+
+static int selected = BACKEND_POOL;
+
+static const char *backend_names[] = {NULL, "serial", "par_unseq", "openmp", "pool"};
+
+/**
+ * @brief Tells whether a backend was compiled in.
+ *
+ * @param backend BACKEND_* constant
+ * @return true if backend_select accepts it
+ */
+bool backend_available(int backend)
+{
+  switch (backend)
+  {
+  case BACKEND_SERIAL:
+  case BACKEND_POOL:
+    return true;
+#ifdef HAVE_PAR_UNSEQ
+  case BACKEND_PAR_UNSEQ:
+    return true;
+#endif
+#ifdef _OPENMP
+  case BACKEND_OPENMP:
+    return true;
+#endif
+  default:
+    return false;
+  }
+}
+
+/**
+ * @brief Selects the backend for subsequent kernels.
+ *
+ * @param backend BACKEND_* constant
+ * @return false, keeping the current backend, if it is not available
+ */
+bool backend_select(int backend)
+{
+  if (!backend_available(backend))
+    return false;
+  selected = backend;
+  return true;
+}
+
+/**
+ * @brief Returns the selected backend.
+ *
+ * @return BACKEND_* constant
+ */
+int backend_current() { return selected; }
+
+/**
+ * @brief Returns the short name of a backend.
+ *
+ * @param backend BACKEND_* constant
+ * @return Short name, or "unknown"
+ */
+const char *backend_name(int backend)
+{
+  if (backend < BACKEND_SERIAL || backend > BACKEND_COUNT)
+    return "unknown";
+  return backend_names[backend];
+}
+
+/**
+ * @brief Looks a backend up by its short name.
+ *
+ * @param name Short name
+ * @return BACKEND_* constant, or 0 if unknown
+ */
+int backend_lookup(const char *name)
+{
+  for (int b = BACKEND_SERIAL; b <= BACKEND_COUNT; b++)
+  {
+    if (strcmp(name, backend_names[b]) == 0)
+      return b;
+  }
+  return 0;
+}
+
+/**
+ * @brief Returns the number of worker slots of the selected backend.
+ *
+ * @return Upper bound of backend_slot() plus one
+ */
+int backend_slots()
+{
+  switch (selected)
+  {
+#ifdef HAVE_PAR_UNSEQ
+  case BACKEND_PAR_UNSEQ:
+    return tbb::this_task_arena::max_concurrency();
+#endif
+#ifdef _OPENMP
+  case BACKEND_OPENMP:
+    return omp_get_max_threads();
+#endif
+  case BACKEND_POOL:
+    return parallel_threads();
+  default:
+    return 1;
+  }
+}
+
+/**
+ * @brief Returns the slot of the calling worker.
+ *
+ * @return Index in [0, backend_slots())
+ */
+int backend_slot()
+{
+  switch (selected)
+  {
+#ifdef HAVE_PAR_UNSEQ
+  case BACKEND_PAR_UNSEQ:
+  {
+    int slot = tbb::this_task_arena::current_thread_index();
+    return slot < 0 ? 0 : slot; // not a TBB thread: the caller itself
+  }
+#endif
+#ifdef _OPENMP
+  case BACKEND_OPENMP:
+    return omp_get_thread_num();
+#endif
+  case BACKEND_POOL:
+    return parallel_worker_id();
+  default:
+    return 0;
+  }
+}
+
+/**
+ * @brief Runs a chunked kernel on the selected backend.
+ *
+ * Every backend claims chunks dynamically, so uneven chunks still balance.
+ *
+ * @param chunks Number of chunks
+ * @param call Invokes the kernel for one chunk
+ * @param fn Kernel passed to call
+ */
+void backend_run(int chunks, void (*call)(const void *fn, int chunk), const void *fn)
+{
+  switch (selected)
+  {
+#ifdef HAVE_PAR_UNSEQ
+  case BACKEND_PAR_UNSEQ:
+  {
+    // The parallel algorithms take an iterator range; the chunk indices are
+    // kept per thread and only grow
+    static thread_local std::vector<int> indices;
+    for (int i = (int)indices.size(); i < chunks; i++)
+      indices.push_back(i);
+    std::for_each(std::execution::par_unseq, indices.begin(), indices.begin() + chunks,
+                  [&](int c)
+                  { call(fn, c); });
+    return;
+  }
+#endif
+#ifdef _OPENMP
+  case BACKEND_OPENMP:
+  {
+#pragma omp parallel for schedule(dynamic)
+    for (int c = 0; c < chunks; c++)
+      call(fn, c);
+    return;
+  }
+#endif
+  case BACKEND_POOL:
+    parallel_for(chunks, [&](int c)
+                 { call(fn, c); });
+    return;
+  default:
+    for (int c = 0; c < chunks; c++)
+      call(fn, c);
+  }
+}
@@ -0,0 +1,537 @@
+/**
+ * @file bundling.cpp
+ * @brief Force-directed edge bundling on the execution backend.
+ *
+ * Follows Holten and van Wijk's force-directed edge bundling: the
+ * compatibility of two edges is the product of their angle, scale, position
+ * and visibility compatibilities, and the electrostatic pull between matching
+ * points is a unit vector weighted by it. Edges pointing in opposite
+ * directions are matched back to front. Each iteration reads the previous
+ * points and writes a second buffer, so the edges are independent and the
+ * result does not depend on the backend or thread count.
+ */
+
+#include "bundling.h"
+#include "backend.h"
+#include "parallel.h"
+
+#include <algorithm>
+#include <limits.h>
+#include <math.h>
+#include <stdint.h>
+#include <string.h>
+#include <unordered_map>
+
+#define BUNDLE_CHUNKS 64
+
+// Geometry of one edge
+typedef struct
+{
+  float ax, ay, bx, by; // end points
+  float length;
+} Segment;
+
+/**
+ * @brief Projects a point onto the line through a segment.
+ *
+ * @param s Segment
+ * @param x X-coordinate of the point
+ * @param y Y-coordinate of the point
+ * @param px Receives the x-coordinate of the projection
+ * @param py Receives the y-coordinate of the projection
+ */
+static void project(const Segment &s, float x, float y, float *px, float *py)
+{
+  float dx = s.bx - s.ax, dy = s.by - s.ay;
+  float t = ((x - s.ax) * dx + (y - s.ay) * dy) / (s.length * s.length);
+  *px = s.ax + t * dx;
+  *py = s.ay + t * dy;
+}
+
+/**
+ * @brief Visibility compatibility of q as seen from p.
+ *
+ * @param p Segment whose line q is projected onto
+ * @param q Other segment
+ * @return 1 when q's projection is centered on p, falling to 0
+ */
+static float visibility(const Segment &p, const Segment &q)
+{
+  float x0, y0, x1, y1;
+  project(p, q.ax, q.ay, &x0, &y0);
+  project(p, q.bx, q.by, &x1, &y1);
+  float span = sqrtf((x1 - x0) * (x1 - x0) + (y1 - y0) * (y1 - y0));
+  if (span < 1e-9f)
+    return 0;
+  float mx = (p.ax + p.bx) * 0.5f - (x0 + x1) * 0.5f;
+  float my = (p.ay + p.by) * 0.5f - (y0 + y1) * 0.5f;
+  return fmaxf(1 - 2 * sqrtf(mx * mx + my * my) / span, 0);
+}
+
+/**
+ * @brief Compatibility of two edges for bundling.
+ *
+ * @param p First segment
+ * @param q Second segment
+ * @param flipped Set to true if q runs against p
+ * @return Compatibility in [0, 1]
+ */
+static float compatibility(const Segment &p, const Segment &q, bool *flipped)
+{
+  // Each factor is at most 1, so a pair fails as soon as one of them is
+  // below the threshold; the cheapest are tested first
+  float dot = (p.bx - p.ax) * (q.bx - q.ax) + (p.by - p.ay) * (q.by - q.ay);
+  float angle = fabsf(dot) / (p.length * q.length);
+  if (angle < BUNDLE_COMPATIBILITY)
+    return 0;
+  float average = (p.length + q.length) * 0.5f;
+  float scale = 2 / (average / fminf(p.length, q.length) + fmaxf(p.length, q.length) / average);
+  if (angle * scale < BUNDLE_COMPATIBILITY)
+    return 0;
+  float mx = (p.ax + p.bx - q.ax - q.bx) * 0.5f;
+  float my = (p.ay + p.by - q.ay - q.by) * 0.5f;
+  float position = average / (average + sqrtf(mx * mx + my * my));
+  float c = angle * scale * position;
+  if (c < BUNDLE_COMPATIBILITY)
+    return 0;
+  *flipped = dot < 0;
+  return c * fminf(visibility(p, q), visibility(q, p));
+}
+
+/**
+ * @brief Finds the most compatible edges of every edge.
+ *
+ * Edges are bucketed by midpoint into a grid sized for
+ * BUNDLE_CELL_OCCUPANCY edges per cell; only the cells around an edge's own
+ * midpoint are searched.
+ *
+ * @param seg Segments
+ * @param found Receives the lists
+ */
+static void find_neighbors(const std::vector<Segment> &seg, BundleNeighbors *found)
+{
+  int m = (int)seg.size();
+  float x0 = INFINITY, y0 = INFINITY, x1 = -INFINITY, y1 = -INFINITY;
+  for (const Segment &s : seg)
+  {
+    float mx = (s.ax + s.bx) * 0.5f, my = (s.ay + s.by) * 0.5f;
+    x0 = fminf(x0, mx);
+    y0 = fminf(y0, my);
+    x1 = fmaxf(x1, mx);
+    y1 = fmaxf(y1, my);
+  }
+  float area = fmaxf((x1 - x0) * (y1 - y0), 1e-6f);
+  float cell = sqrtf(area * BUNDLE_CELL_OCCUPANCY / m);
+  int cols = (int)((x1 - x0) / cell) + 1, rows = (int)((y1 - y0) / cell) + 1;
+
+  std::vector<int> cell_of(m), cell_start((size_t)cols * rows + 1, 0), cell_edges(m);
+  for (int i = 0; i < m; i++)
+  {
+    int cx = (int)(((seg[i].ax + seg[i].bx) * 0.5f - x0) / cell);
+    int cy = (int)(((seg[i].ay + seg[i].by) * 0.5f - y0) / cell);
+    cell_of[i] = std::min(cy, rows - 1) * cols + std::min(cx, cols - 1);
+    cell_start[cell_of[i] + 1]++;
+  }
+  for (size_t c = 0; c + 1 < cell_start.size(); c++)
+    cell_start[c + 1] += cell_start[c];
+  std::vector<int> fill(cell_start.begin(), cell_start.end() - 1);
+  for (int i = 0; i < m; i++)
+    cell_edges[fill[cell_of[i]]++] = i;
+
+  std::vector<int> &neighbors = found->neighbors;
+  std::vector<float> &weights = found->weights;
+  neighbors.assign((size_t)m * BUNDLE_NEIGHBORS, INT_MIN);
+  weights.assign((size_t)m * BUNDLE_NEIGHBORS, 0);
+  backend_for(BUNDLE_CHUNKS, [&](int chunk)
+              {
+                int lo = (int)((long long)m * chunk / BUNDLE_CHUNKS);
+                int hi = (int)((long long)m * (chunk + 1) / BUNDLE_CHUNKS);
+                for (int i = lo; i < hi && !task_cancelled(); i++)
+                {
+                  if (seg[i].length < 1e-6f)
+                    continue;
+                  int *slot = &neighbors[(size_t)i * BUNDLE_NEIGHBORS];
+                  float *best = &weights[(size_t)i * BUNDLE_NEIGHBORS];
+                  int cx = cell_of[i] % cols, cy = cell_of[i] / cols;
+                  for (int gy = std::max(cy - BUNDLE_SEARCH_RADIUS, 0);
+                       gy <= std::min(cy + BUNDLE_SEARCH_RADIUS, rows - 1); gy++)
+                  {
+                    for (int gx = std::max(cx - BUNDLE_SEARCH_RADIUS, 0);
+                         gx <= std::min(cx + BUNDLE_SEARCH_RADIUS, cols - 1); gx++)
+                    {
+                      int c = gy * cols + gx;
+                      for (int k = cell_start[c]; k < cell_start[c + 1]; k++)
+                      {
+                        int j = cell_edges[k];
+                        if (j == i || seg[j].length < 1e-6f)
+                          continue;
+                        bool flipped = false;
+                        float w = compatibility(seg[i], seg[j], &flipped);
+                        if (w < BUNDLE_COMPATIBILITY || w <= best[BUNDLE_NEIGHBORS - 1])
+                          continue;
+                        // Insertion into the list sorted by falling weight
+                        int at = BUNDLE_NEIGHBORS - 1;
+                        for (; at > 0 && best[at - 1] < w; at--)
+                        {
+                          best[at] = best[at - 1];
+                          slot[at] = slot[at - 1];
+                        }
+                        best[at] = w;
+                        slot[at] = flipped ? ~j : j;
+                      }
+                    }
+                  }
+                }
+              });
+}
+
+/**
+ * @brief Inserts a midpoint into every segment of every polyline.
+ *
+ * @param seg Segments
+ * @param points Interior points, count per edge
+ * @param count Interior points per edge before
+ * @param out Receives 2 * count + 1 interior points per edge
+ */
+static void subdivide(const std::vector<Segment> &seg, const std::vector<float> &points,
+                      int count, std::vector<float> &out)
+{
+  int m = (int)seg.size();
+  int next = 2 * count + 1;
+  out.resize((size_t)m * next * 2);
+  for (int i = 0; i < m; i++)
+  {
+    const float *p = &points[(size_t)i * count * 2];
+    float *q = &out[(size_t)i * next * 2];
+    float px = seg[i].ax, py = seg[i].ay;
+    for (int j = 0; j < count; j++)
+    {
+      q[4 * j] = (px + p[2 * j]) * 0.5f;
+      q[4 * j + 1] = (py + p[2 * j + 1]) * 0.5f;
+      q[4 * j + 2] = px = p[2 * j];
+      q[4 * j + 3] = py = p[2 * j + 1];
+    }
+    q[4 * count] = (px + seg[i].bx) * 0.5f;
+    q[4 * count + 1] = (py + seg[i].by) * 0.5f;
+  }
+}
+
+/**
+ * @brief Moves every interior point once along its spring and
+ *        electrostatic forces.
+ *
+ * @param seg Segments
+ * @param found Compatible edges from find_neighbors
+ * @param count Interior points per edge
+ * @param step Step size
+ * @param in Current points
+ * @param out Receives the moved points
+ */
+static void iterate(const std::vector<Segment> &seg, const BundleNeighbors &found, int count,
+                    float step, const std::vector<float> &in, std::vector<float> &out)
+{
+  int m = (int)seg.size();
+  const std::vector<int> &neighbors = found.neighbors;
+  const std::vector<float> &weights = found.weights;
+  backend_for(BUNDLE_CHUNKS, [&](int chunk)
+              {
+                int lo = (int)((long long)m * chunk / BUNDLE_CHUNKS);
+                int hi = (int)((long long)m * (chunk + 1) / BUNDLE_CHUNKS);
+                for (int i = lo; i < hi; i++)
+                {
+                  const float *p = &in[(size_t)i * count * 2];
+                  float *q = &out[(size_t)i * count * 2];
+                  if (seg[i].length < 1e-6f)
+                  {
+                    memcpy(q, p, sizeof(float) * 2 * count);
+                    continue;
+                  }
+                  // Springs pull towards the neighbors on the polyline; the
+                  // pull per step is capped so short edges stay stable
+                  float spring = fminf(step * BUNDLE_SPRING * (count + 1) / seg[i].length, 0.25f);
+                  const int *slot = &neighbors[(size_t)i * BUNDLE_NEIGHBORS];
+                  const float *w = &weights[(size_t)i * BUNDLE_NEIGHBORS];
+                  for (int j = 0; j < count; j++)
+                  {
+                    float x = p[2 * j], y = p[2 * j + 1];
+                    float prev_x = j > 0 ? p[2 * j - 2] : seg[i].ax;
+                    float prev_y = j > 0 ? p[2 * j - 1] : seg[i].ay;
+                    float next_x = j < count - 1 ? p[2 * j + 2] : seg[i].bx;
+                    float next_y = j < count - 1 ? p[2 * j + 3] : seg[i].by;
+                    float fx = 0, fy = 0;
+                    for (int k = 0; k < BUNDLE_NEIGHBORS && slot[k] != INT_MIN; k++)
+                    {
+                      int other = slot[k] >= 0 ? slot[k] : ~slot[k];
+                      int at = slot[k] >= 0 ? j : count - 1 - j;
+                      const float *o = &in[((size_t)other * count + at) * 2];
+                      float dx = o[0] - x, dy = o[1] - y;
+                      float r = sqrtf(dx * dx + dy * dy);
+                      if (r > 1e-6f)
+                      {
+                        fx += w[k] * dx / r;
+                        fy += w[k] * dy / r;
+                      }
+                    }
+                    q[2 * j] = x + spring * (prev_x + next_x - 2 * x) +
+                               step * fx / BUNDLE_NEIGHBORS;
+                    q[2 * j + 1] = y + spring * (prev_y + next_y - 2 * y) +
+                                   step * fy / BUNDLE_NEIGHBORS;
+                  }
+                }
+              });
+}
+
+/**
+ * @brief Bundles a set of edges.
+ *
+ * A full run takes BUNDLE_CYCLES cycles. An update from a previous result
+ * for the same edges moves every old point by the blend of its end points'
+ * movements, weighted by its position along the edge, and runs only
+ * BUNDLE_REFINE_ITERATIONS iterations at the final subdivision.
+ *
+ * @param node_xy Node positions, (x, y) per node
+ * @param ends src, dest node indices per edge
+ * @param previous Earlier bundles of the same edges, or NULL
+ * @param out Receives the bundles; incomplete if the task was cancelled
+ */
+void bundle_edges(const std::vector<float> &node_xy, const std::vector<int> &ends,
+                  const BundleResult *previous, BundleResult *out)
+{
+  int m = (int)ends.size() / 2;
+  std::vector<Segment> seg(m);
+  for (int i = 0; i < m; i++)
+  {
+    Segment &s = seg[i];
+    s.ax = node_xy[2 * ends[2 * i]];
+    s.ay = node_xy[2 * ends[2 * i] + 1];
+    s.bx = node_xy[2 * ends[2 * i + 1]];
+    s.by = node_xy[2 * ends[2 * i + 1] + 1];
+    s.length = sqrtf((s.bx - s.ax) * (s.bx - s.ax) + (s.by - s.ay) * (s.by - s.ay));
+  }
+  out->node_xy = node_xy;
+  if (m == 0)
+  {
+    out->points = std::make_shared<std::vector<float>>();
+    out->compatible = std::make_shared<BundleNeighbors>();
+    return;
+  }
+
+  std::vector<float> points, next;
+  bool refine = previous && previous->points && previous->compatible &&
+                previous->points->size() == (size_t)m * BUNDLE_POINTS * 2 &&
+                previous->node_xy.size() == node_xy.size();
+  std::shared_ptr<const BundleNeighbors> compatible;
+  if (refine)
+  {
+    const std::vector<float> &found_xy = previous->compatible->node_xy;
+    float moved = 0;
+    for (size_t i = 0; i < node_xy.size() && moved < BUNDLE_REGROUP_DISTANCE; i++)
+      moved = fabsf(node_xy[i] - found_xy[i]);
+    if (moved < BUNDLE_REGROUP_DISTANCE)
+      compatible = previous->compatible;
+  }
+  if (!compatible)
+  {
+    std::shared_ptr<BundleNeighbors> found = std::make_shared<BundleNeighbors>();
+    found->node_xy = node_xy;
+    find_neighbors(seg, found.get());
+    compatible = found;
+  }
+  out->compatible = compatible;
+  if (refine)
+  {
+    const std::vector<float> &old_xy = previous->node_xy;
+    points = *previous->points;
+    for (int i = 0; i < m; i++)
+    {
+      int a = ends[2 * i], b = ends[2 * i + 1];
+      float move_ax = node_xy[2 * a] - old_xy[2 * a], move_ay = node_xy[2 * a + 1] - old_xy[2 * a + 1];
+      float move_bx = node_xy[2 * b] - old_xy[2 * b], move_by = node_xy[2 * b + 1] - old_xy[2 * b + 1];
+      float *p = &points[(size_t)i * BUNDLE_POINTS * 2];
+      for (int j = 0; j < BUNDLE_POINTS; j++)
+      {
+        float t = (j + 1) / (float)(BUNDLE_POINTS + 1);
+        p[2 * j] += (1 - t) * move_ax + t * move_bx;
+        p[2 * j + 1] += (1 - t) * move_ay + t * move_by;
+      }
+    }
+    next.resize(points.size());
+    float step = BUNDLE_STEP / (1 << (BUNDLE_CYCLES - 1));
+    for (int it = 0; it < BUNDLE_REFINE_ITERATIONS && !task_cancelled(); it++)
+    {
+      iterate(seg, *compatible, BUNDLE_POINTS, step, points, next);
+      points.swap(next);
+      task_progress((it + 1) / (float)BUNDLE_REFINE_ITERATIONS);
+    }
+  }
+  else
+  {
+    // One interior point at the midpoint, doubled every cycle
+    int count = 1;
+    points.resize((size_t)m * 2);
+    for (int i = 0; i < m; i++)
+    {
+      points[2 * i] = (seg[i].ax + seg[i].bx) * 0.5f;
+      points[2 * i + 1] = (seg[i].ay + seg[i].by) * 0.5f;
+    }
+    int total = 0, iterations = BUNDLE_ITERATIONS;
+    for (int c = 0; c < BUNDLE_CYCLES; c++, iterations = iterations * 2 / 3)
+      total += iterations * ((1 << (c + 1)) - 1);
+    int done = 0;
+    float step = BUNDLE_STEP;
+    iterations = BUNDLE_ITERATIONS;
+    for (int c = 0; c < BUNDLE_CYCLES && !task_cancelled(); c++)
+    {
+      if (c > 0)
+      {
+        subdivide(seg, points, count, next);
+        points.swap(next);
+        count = 2 * count + 1;
+      }
+      next.resize(points.size());
+      for (int it = 0; it < iterations && !task_cancelled(); it++)
+      {
+        iterate(seg, *compatible, count, step, points, next);
+        points.swap(next);
+        done += count;
+        task_progress(done / (float)total);
+      }
+      step *= 0.5f;
+      iterations = iterations * 2 / 3;
+    }
+  }
+  out->points = std::make_shared<const std::vector<float>>(std::move(points));
+}
+
+/**
+ * @brief Measures the pixels drawn by a set of polylines.
+ *
+ * Models non-antialiased GL wide lines: every step along the major axis of a
+ * segment writes line_width pixels across it.
+ *
+ * @param xy Polyline points in GL coordinates
+ * @param strips Number of polylines
+ * @param stride Points per polyline
+ * @param line_width Line width in pixels
+ * @param width Viewport width in pixels
+ * @param height Viewport height in pixels
+ * @param cost Receives the number of pixel writes and of distinct pixels
+ */
+void polyline_fill(const float *xy, int strips, int stride, int line_width, int width,
+                   int height, FillCost *cost)
+{
+  std::vector<unsigned char> written((size_t)width * height, 0);
+  cost->fragments = 0;
+  cost->covered = 0;
+  for (int s = 0; s < strips; s++)
+  {
+    const float *p = xy + (size_t)s * stride * 2;
+    for (int k = 0; k + 1 < stride; k++)
+    {
+      float x0 = (p[2 * k] + 1) * 0.5f * width, y0 = (1 - p[2 * k + 1]) * 0.5f * height;
+      float x1 = (p[2 * k + 2] + 1) * 0.5f * width, y1 = (1 - p[2 * k + 3]) * 0.5f * height;
+      bool steep = fabsf(y1 - y0) > fabsf(x1 - x0);
+      int steps = (int)fmaxf(fabsf(x1 - x0), fabsf(y1 - y0));
+      for (int t = 0; t <= steps; t++)
+      {
+        float f = steps ? t / (float)steps : 0;
+        int x = (int)(x0 + (x1 - x0) * f), y = (int)(y0 + (y1 - y0) * f);
+        for (int w = 0; w < line_width; w++)
+        {
+          int px = steep ? x + w - line_width / 2 : x;
+          int py = steep ? y : y + w - line_width / 2;
+          if (px < 0 || py < 0 || px >= width || py >= height)
+            continue;
+          cost->fragments++;
+          unsigned char &pixel = written[(size_t)py * width + px];
+          if (!pixel)
+          {
+            pixel = 1;
+            cost->covered++;
+          }
+        }
+      }
+    }
+  }
+}
+
+/**
+ * @brief Merges the bends of bundles into shared vertices and segments.
+ *
+ * Bends are keyed by their grid cell; the first bend in a cell becomes the
+ * vertex, at its own position, and anchors it to its edge. Node vertices
+ * anchor to the first edge that reaches them. Segments that collapse into
+ * one vertex are dropped. Runs serially in edge order, so the result is the
+ * same on every backend.
+ *
+ * @param ends src, dest node indices per edge
+ * @param cell_w Cell width in GL units
+ * @param cell_h Cell height in GL units
+ * @param bundles Bundles with points; receives merged
+ */
+void bundle_merge(const std::vector<int> &ends, float cell_w, float cell_h,
+                  BundleResult *bundles)
+{
+  auto merged = std::make_shared<MergedBundles>();
+  const std::vector<float> &node_xy = bundles->node_xy;
+  const std::vector<float> &points = *bundles->points;
+  int n = (int)node_xy.size() / 2, m = (int)ends.size() / 2;
+  const int stride = BUNDLE_POINTS + 2;
+
+  std::vector<int> node_vertex(n, -1);
+  std::unordered_map<uint64_t, int> cell_vertex;
+  cell_vertex.reserve((size_t)m * BUNDLE_POINTS / 2);
+  std::unordered_map<uint64_t, int> segment_index;
+  segment_index.reserve((size_t)m * stride / 2);
+  auto add_vertex = [&](float x, float y, int edge, float t)
+  {
+    merged->xy.push_back(x);
+    merged->xy.push_back(y);
+    merged->anchor_edge.push_back(edge);
+    merged->anchor_t.push_back(t);
+    return (int)merged->anchor_edge.size() - 1;
+  };
+
+  std::vector<int> strip(stride);
+  for (int e = 0; e < m && !task_cancelled(); e++)
+  {
+    int a = ends[2 * e], b = ends[2 * e + 1];
+    if (node_vertex[a] == -1)
+      node_vertex[a] = add_vertex(node_xy[2 * a], node_xy[2 * a + 1], e, 0);
+    if (node_vertex[b] == -1)
+      node_vertex[b] = add_vertex(node_xy[2 * b], node_xy[2 * b + 1], e, 1);
+    strip[0] = node_vertex[a];
+    strip[stride - 1] = node_vertex[b];
+    const float *p = &points[(size_t)e * BUNDLE_POINTS * 2];
+    for (int j = 0; j < BUNDLE_POINTS; j++)
+    {
+      int64_t cx = (int64_t)floorf(p[2 * j] / cell_w);
+      int64_t cy = (int64_t)floorf(p[2 * j + 1] / cell_h);
+      uint64_t key = ((uint64_t)cx << 32) ^ (uint64_t)(uint32_t)cy;
+      auto it = cell_vertex.find(key);
+      if (it == cell_vertex.end())
+        it = cell_vertex.emplace(key, add_vertex(p[2 * j], p[2 * j + 1], e,
+                                                 (j + 1) / (float)(BUNDLE_POINTS + 1)))
+                 .first;
+      strip[j + 1] = it->second;
+    }
+    for (int k = 0; k + 1 < stride; k++)
+    {
+      int u = std::min(strip[k], strip[k + 1]), v = std::max(strip[k], strip[k + 1]);
+      if (u == v)
+        continue;
+      uint64_t key = ((uint64_t)u << 32) | (uint64_t)v;
+      auto it = segment_index.find(key);
+      if (it != segment_index.end())
+      {
+        merged->counts[it->second]++;
+        continue;
+      }
+      segment_index.emplace(key, (int)merged->counts.size());
+      merged->segments.push_back(u);
+      merged->segments.push_back(v);
+      merged->counts.push_back(1);
+    }
+  }
+  bundles->merged = merged;
+}
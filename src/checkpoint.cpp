@@ -0,0 +1,751 @@
+/**
+ * @file checkpoint.cpp
+ * @brief Checkpoint writer thread, record encoding and restore.
+ *
+ * File layout: a CheckpointHeader, then records, each a RecordHeader followed
+ * by a zlib stream. The first record is the base; the others are deltas.
+ * Before compression every array is split into byte planes (all low bytes,
+ * then all second bytes and so on). Node ids and edge sources are stored as
+ * differences to the previous entry and edge targets relative to their
+ * source, so sorted arrays turn into runs of small numbers. Delta records
+ * store the XOR of each position with the one written before it; once the
+ * layout settles the high planes are all zero and compress to almost
+ * nothing.
+ *
+ * A new base is written to a temporary file and renamed over the old one, so
+ * a crash leaves either the old or the new session. A delta torn by a crash
+ * fails its length or CRC check and the restore stops before it.
+ */
+
+#include "checkpoint.h"
+#include "graph.h"
+
+#include <chrono>
+#include <condition_variable>
+#include <errno.h>
+#include <fcntl.h>
+#include <mutex>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <string>
+#include <thread>
+#include <unistd.h>
+#include <utility>
+#include <vector>
+#include <zlib.h>
+
+#define RECORD_BASE 1
+#define RECORD_DELTA 2
+
+typedef struct
+{
+  char magic[4];
+  uint32_t version;
+} CheckpointHeader;
+
+typedef struct
+{
+  uint32_t type;
+  uint32_t raw_size;    // bytes after decompression
+  uint32_t packed_size; // bytes of the zlib stream that follows
+  uint32_t crc;         // CRC-32 of the zlib stream
+} RecordHeader;
+
+typedef struct
+{
+  int32_t node_count, edge_count;
+  int32_t mode;
+  int32_t reserved;
+} BaseHeader;
+
+typedef struct
+{
+  int32_t node_count;
+  int32_t mode;
+} DeltaHeader;
+
+// Copy of the session taken on the main thread
+typedef struct
+{
+  bool base;
+  int mode;
+  std::vector<Node> nodes;
+  std::vector<Edge> edges; // empty for a delta
+} Snapshot;
+
+// Allocated once and never destroyed, so that exit does not tear the mutex
+// and condition variables down under the waiting writer thread
+typedef struct
+{
+  std::string path;
+  std::mutex lock;
+  std::condition_variable wake;    // pending was filled
+  std::condition_variable written; // the writer finished a record
+  Snapshot pending;
+  bool full;      // pending holds a snapshot
+  bool writing;   // the writer is working on one
+  bool need_base; // the last write failed; the file must be restarted
+  CheckpointStats stats;
+
+  // Main thread only
+  Snapshot staging;
+  bool started;         // a base has been handed over
+  unsigned int version; // graph_version of that base
+  int deltas;           // deltas handed over since it
+  std::chrono::steady_clock::time_point due;
+
+  // Writer thread only
+  Snapshot working;
+  int fd;         // current file, open for appending deltas; -1 if none
+  int file_nodes; // node count of its base
+  int last_mode;
+  std::vector<uint32_t> last_x, last_y; // positions of the last record
+  std::vector<uint32_t> words;
+  std::vector<uint8_t> raw, packed;
+} Writer;
+
+static Writer *writer = NULL;
+
+/**
+ * @brief Returns the bit pattern of a float.
+ *
+ * @param f Value
+ * @return Its IEEE 754 bits
+ */
+static uint32_t float_bits(float f)
+{
+  uint32_t w;
+  memcpy(&w, &f, sizeof(w));
+  return w;
+}
+
+/**
+ * @brief Returns the float with the given bit pattern.
+ *
+ * @param w IEEE 754 bits
+ * @return Value
+ */
+static float bits_float(uint32_t w)
+{
+  float f;
+  memcpy(&f, &w, sizeof(f));
+  return f;
+}
+
+/**
+ * @brief Appends 32-bit words to a buffer as four byte planes.
+ *
+ * @param raw Buffer to append to
+ * @param words Words to store
+ * @param count Number of words
+ */
+static void put_planes(std::vector<uint8_t> &raw, const uint32_t *words, size_t count)
+{
+  size_t at = raw.size();
+  raw.resize(at + count * 4);
+  uint8_t *p = raw.data() + at;
+  for (size_t i = 0; i < count; i++)
+  {
+    uint32_t w = words[i];
+    p[i] = (uint8_t)w;
+    p[count + i] = (uint8_t)(w >> 8);
+    p[2 * count + i] = (uint8_t)(w >> 16);
+    p[3 * count + i] = (uint8_t)(w >> 24);
+  }
+}
+
+/**
+ * @brief Reads 32-bit words stored as four byte planes.
+ *
+ * @param p Start of the planes
+ * @param count Number of words
+ * @param words Receives the words
+ */
+static void get_planes(const uint8_t *p, size_t count, uint32_t *words)
+{
+  for (size_t i = 0; i < count; i++)
+  {
+    words[i] = (uint32_t)p[i] | (uint32_t)p[count + i] << 8 |
+               (uint32_t)p[2 * count + i] << 16 | (uint32_t)p[3 * count + i] << 24;
+  }
+}
+
+/**
+ * @brief Writes a whole buffer, retrying short writes.
+ *
+ * @param fd File descriptor
+ * @param data Bytes to write
+ * @param size Number of bytes
+ * @return false on a write error
+ */
+static bool write_all(int fd, const void *data, size_t size)
+{
+  const char *p = (const char *)data;
+  while (size > 0)
+  {
+    ssize_t n = write(fd, p, size);
+    if (n < 0 && errno == EINTR)
+      continue;
+    if (n <= 0)
+      return false;
+    p += n;
+    size -= n;
+  }
+  return true;
+}
+
+/**
+ * @brief Compresses the writer's raw buffer into a record and writes it.
+ *
+ * @param w Writer
+ * @param fd File to append to
+ * @param type RECORD_BASE or RECORD_DELTA
+ * @return Bytes written, or 0 on error
+ */
+static size_t write_record(Writer *w, int fd, uint32_t type)
+{
+  uLongf packed_size = compressBound(w->raw.size());
+  w->packed.resize(sizeof(RecordHeader) + packed_size);
+  uint8_t *body = w->packed.data() + sizeof(RecordHeader);
+  if (compress2(body, &packed_size, w->raw.data(), w->raw.size(), Z_BEST_SPEED) != Z_OK)
+    return 0;
+  RecordHeader header = {type, (uint32_t)w->raw.size(), (uint32_t)packed_size,
+                         (uint32_t)crc32(0L, body, packed_size)};
+  memcpy(w->packed.data(), &header, sizeof(header));
+  size_t size = sizeof(RecordHeader) + packed_size;
+  return write_all(fd, w->packed.data(), size) ? size : 0;
+}
+
+/**
+ * @brief Encodes the working snapshot as a base and starts a new file.
+ *
+ * @param w Writer
+ * @return Compressed bytes written, or 0 on error
+ */
+static size_t write_base(Writer *w)
+{
+  const Snapshot &s = w->working;
+  size_t n = s.nodes.size(), m = s.edges.size();
+  w->raw.clear();
+  BaseHeader base = {(int32_t)n, (int32_t)m, s.mode, 0};
+  w->raw.insert(w->raw.end(), (const uint8_t *)&base, (const uint8_t *)(&base + 1));
+
+  w->words.resize(n > m ? n : m);
+  w->last_x.resize(n);
+  w->last_y.resize(n);
+  for (size_t i = 0; i < n; i++)
+    w->last_x[i] = float_bits(s.nodes[i].x);
+  put_planes(w->raw, w->last_x.data(), n);
+  for (size_t i = 0; i < n; i++)
+    w->last_y[i] = float_bits(s.nodes[i].y);
+  put_planes(w->raw, w->last_y.data(), n);
+  int previous = 0;
+  for (size_t i = 0; i < n; i++)
+  {
+    w->words[i] = (uint32_t)(s.nodes[i].id - previous);
+    previous = s.nodes[i].id;
+  }
+  put_planes(w->raw, w->words.data(), n);
+  previous = 0;
+  for (size_t i = 0; i < m; i++)
+  {
+    w->words[i] = (uint32_t)(s.edges[i].src - previous);
+    previous = s.edges[i].src;
+  }
+  put_planes(w->raw, w->words.data(), m);
+  for (size_t i = 0; i < m; i++)
+    w->words[i] = (uint32_t)(s.edges[i].dest - s.edges[i].src);
+  put_planes(w->raw, w->words.data(), m);
+  for (size_t i = 0; i < m; i++)
+    w->words[i] = float_bits(s.edges[i].weight);
+  put_planes(w->raw, w->words.data(), m);
+  for (size_t i = 0; i < n; i++)
+    w->raw.push_back((uint8_t)s.nodes[i].label);
+
+  std::string temp = w->path + ".tmp";
+  int fd = open(temp.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+  if (fd < 0)
+  {
+    perror(temp.c_str());
+    return 0;
+  }
+  CheckpointHeader header = {{CHECKPOINT_MAGIC[0], CHECKPOINT_MAGIC[1], CHECKPOINT_MAGIC[2],
+                              CHECKPOINT_MAGIC[3]},
+                             CHECKPOINT_VERSION};
+  size_t size = 0;
+  if (write_all(fd, &header, sizeof(header)))
+    size = write_record(w, fd, RECORD_BASE);
+  if (size == 0 || fsync(fd) != 0)
+  {
+    perror(temp.c_str());
+    close(fd);
+    unlink(temp.c_str());
+    return 0;
+  }
+  // Emptying a session is the one change that is easy to make by accident,
+  // so the session it replaces is kept next to it
+  if (n == 0 && w->fd >= 0 && w->file_nodes > 0)
+    rename(w->path.c_str(), (w->path + ".prev").c_str());
+  if (rename(temp.c_str(), w->path.c_str()) != 0)
+  {
+    perror(w->path.c_str());
+    close(fd);
+    return 0;
+  }
+  if (w->fd >= 0)
+    close(w->fd);
+  w->fd = fd;
+  w->file_nodes = (int)n;
+  w->last_mode = s.mode;
+  return size;
+}
+
+/**
+ * @brief Appends the working snapshot as a delta to the current file.
+ *
+ * @param w Writer
+ * @param wrote Set to false if nothing changed since the last record
+ * @return Compressed bytes written, or 0 on error or when skipped
+ */
+static size_t write_delta(Writer *w, bool *wrote)
+{
+  const Snapshot &s = w->working;
+  size_t n = s.nodes.size();
+  *wrote = false;
+  if (w->fd < 0 || (int)n != w->file_nodes)
+    return 0;
+
+  w->raw.clear();
+  DeltaHeader delta = {(int32_t)n, s.mode};
+  w->raw.insert(w->raw.end(), (const uint8_t *)&delta, (const uint8_t *)(&delta + 1));
+  w->words.resize(n);
+  uint32_t changed = s.mode != w->last_mode;
+  for (size_t i = 0; i < n; i++)
+  {
+    uint32_t bits = float_bits(s.nodes[i].x);
+    w->words[i] = bits ^ w->last_x[i];
+    changed |= w->words[i];
+    w->last_x[i] = bits;
+  }
+  put_planes(w->raw, w->words.data(), n);
+  for (size_t i = 0; i < n; i++)
+  {
+    uint32_t bits = float_bits(s.nodes[i].y);
+    w->words[i] = bits ^ w->last_y[i];
+    changed |= w->words[i];
+    w->last_y[i] = bits;
+  }
+  put_planes(w->raw, w->words.data(), n);
+  if (!changed)
+    return 0;
+
+  *wrote = true;
+  w->last_mode = s.mode;
+  size_t size = write_record(w, w->fd, RECORD_DELTA);
+  if (size == 0 || fdatasync(w->fd) != 0)
+  {
+    perror(w->path.c_str());
+    return 0;
+  }
+  return size;
+}
+
+/**
+ * @brief Body of the writer thread: writes every snapshot handed over.
+ *
+ * @param w Writer
+ */
+static void writer_main(Writer *w)
+{
+  std::unique_lock<std::mutex> hold(w->lock);
+  for (;;)
+  {
+    w->wake.wait(hold, [w]
+                 { return w->full; });
+    std::swap(w->working, w->pending);
+    w->full = false;
+    w->writing = true;
+    hold.unlock();
+
+    auto start = std::chrono::steady_clock::now();
+    bool base = w->working.base;
+    bool wrote = true;
+    size_t size = base ? write_base(w) : write_delta(w, &wrote);
+    double ms = std::chrono::duration<double, std::milli>(
+                    std::chrono::steady_clock::now() - start)
+                    .count();
+
+    hold.lock();
+    w->writing = false;
+    if (size == 0 && wrote)
+      w->need_base = true;
+    else if (base)
+    {
+      w->stats.bases++;
+      w->stats.base_bytes = size;
+      w->stats.raw_bytes = w->raw.size();
+      w->stats.ms = ms;
+    }
+    else if (wrote)
+    {
+      w->stats.deltas++;
+      w->stats.delta_bytes = size;
+      w->stats.ms = ms;
+    }
+    w->written.notify_all();
+  }
+}
+
+/**
+ * @brief Starts the writer thread.
+ *
+ * @param path Checkpoint file; a new base replaces it on the first checkpoint
+ */
+void checkpoint_start(const char *path)
+{
+  if (writer)
+    return;
+  writer = new Writer();
+  writer->path = path;
+  writer->fd = -1;
+  writer->due = std::chrono::steady_clock::now() +
+                std::chrono::milliseconds(CHECKPOINT_INTERVAL_MS);
+  std::thread(writer_main, writer).detach();
+}
+
+/**
+ * @brief Copies the session into the staging snapshot.
+ *
+ * A base is taken for the first checkpoint, after a structural change, after
+ * a failed write and after CHECKPOINT_MAX_DELTAS deltas; otherwise only the
+ * nodes are copied for a delta.
+ *
+ * @param w Writer
+ * @param mode Current mode
+ * @param need_base Whether the writer asked for a new base
+ */
+static void capture(Writer *w, int mode, bool need_base)
+{
+  Snapshot &s = w->staging;
+  s.base = need_base || !w->started || w->version != graph_version ||
+           w->deltas >= CHECKPOINT_MAX_DELTAS;
+  s.mode = mode;
+  s.nodes.assign(nodes, nodes + node_count);
+  if (s.base)
+  {
+    s.edges.assign(edges, edges + edge_count);
+    w->started = true;
+    w->version = graph_version;
+    w->deltas = 0;
+  }
+  else
+  {
+    s.edges.clear();
+    w->deltas++;
+  }
+}
+
+/**
+ * @brief Hands the staging snapshot to the writer thread.
+ *
+ * @param w Writer whose pending slot is empty
+ */
+static void hand_over(Writer *w)
+{
+  std::lock_guard<std::mutex> hold(w->lock);
+  std::swap(w->staging, w->pending);
+  w->full = true;
+  w->wake.notify_one();
+}
+
+/**
+ * @brief Hands a checkpoint to the writer if one is due.
+ *
+ * Called once per frame. The snapshot buffers are reused, so after the first
+ * checkpoints of a given size this neither allocates nor waits.
+ *
+ * @param mode Current mode
+ */
+void checkpoint_poll(int mode)
+{
+  if (!writer)
+    return;
+  auto now = std::chrono::steady_clock::now();
+  if (now < writer->due)
+    return;
+  writer->due = now + std::chrono::milliseconds(CHECKPOINT_INTERVAL_MS);
+  bool need_base;
+  {
+    std::lock_guard<std::mutex> hold(writer->lock);
+    if (writer->full)
+      return; // still busy with the previous one
+    need_base = writer->need_base;
+    writer->need_base = false;
+  }
+  capture(writer, mode, need_base);
+  hand_over(writer);
+}
+
+/**
+ * @brief Writes a checkpoint and waits until it is on disk.
+ *
+ * @param mode Current mode
+ */
+void checkpoint_flush(int mode)
+{
+  if (!writer)
+    return;
+  bool need_base;
+  {
+    std::unique_lock<std::mutex> hold(writer->lock);
+    writer->written.wait(hold, []
+                         { return !writer->full; });
+    need_base = writer->need_base;
+    writer->need_base = false;
+  }
+  capture(writer, mode, need_base);
+  hand_over(writer);
+  std::unique_lock<std::mutex> hold(writer->lock);
+  writer->written.wait(hold, []
+                       { return !writer->full && !writer->writing; });
+}
+
+/**
+ * @brief Copies the writer's counters.
+ *
+ * @param stats Receives the counters; zeroed if no writer was started
+ */
+void checkpoint_stats(CheckpointStats *stats)
+{
+  if (!writer)
+  {
+    *stats = CheckpointStats();
+    return;
+  }
+  std::lock_guard<std::mutex> hold(writer->lock);
+  *stats = writer->stats;
+}
+
+/**
+ * @brief Checks and decompresses the record at an offset of a file image.
+ *
+ * @param data File contents
+ * @param size File size
+ * @param at Offset of the record; advanced past it on success
+ * @param type Receives the record type
+ * @param raw Receives the decompressed record
+ * @return false if the record is truncated or damaged
+ */
+static bool read_record(const uint8_t *data, size_t size, size_t *at, uint32_t *type,
+                        std::vector<uint8_t> &raw)
+{
+  RecordHeader header;
+  if (size - *at < sizeof(header))
+    return false;
+  memcpy(&header, data + *at, sizeof(header));
+  const uint8_t *body = data + *at + sizeof(header);
+  if (header.packed_size > size - *at - sizeof(header) ||
+      crc32(0L, body, header.packed_size) != header.crc)
+    return false;
+  raw.resize(header.raw_size);
+  uLongf raw_size = header.raw_size;
+  if (uncompress(raw.data(), &raw_size, body, header.packed_size) != Z_OK ||
+      raw_size != header.raw_size)
+    return false;
+  *type = header.type;
+  *at += sizeof(header) + header.packed_size;
+  return true;
+}
+
+/**
+ * @brief Decodes a base record.
+ *
+ * @param raw Decompressed record
+ * @param list_nodes Receives the nodes
+ * @param list_edges Receives the edges
+ * @param mode Receives the mode
+ * @return false if the record is inconsistent
+ */
+static bool decode_base(const std::vector<uint8_t> &raw, std::vector<Node> &list_nodes,
+                        std::vector<Edge> &list_edges, int *mode)
+{
+  BaseHeader base;
+  if (raw.size() < sizeof(base))
+    return false;
+  memcpy(&base, raw.data(), sizeof(base));
+  if (base.node_count < 0 || base.edge_count < 0 ||
+      raw.size() != sizeof(base) + (size_t)base.node_count * 13 + (size_t)base.edge_count * 12)
+    return false;
+  size_t n = base.node_count, m = base.edge_count;
+  const uint8_t *p = raw.data() + sizeof(base);
+  std::vector<uint32_t> words(n > m ? n : m);
+  list_nodes.resize(n);
+  list_edges.resize(m);
+
+  get_planes(p, n, words.data());
+  for (size_t i = 0; i < n; i++)
+    list_nodes[i].x = bits_float(words[i]);
+  p += n * 4;
+  get_planes(p, n, words.data());
+  for (size_t i = 0; i < n; i++)
+    list_nodes[i].y = bits_float(words[i]);
+  p += n * 4;
+  get_planes(p, n, words.data());
+  int previous = 0;
+  for (size_t i = 0; i < n; i++)
+  {
+    previous += (int)words[i];
+    list_nodes[i].id = previous;
+  }
+  p += n * 4;
+  get_planes(p, m, words.data());
+  previous = 0;
+  for (size_t i = 0; i < m; i++)
+  {
+    previous += (int)words[i];
+    list_edges[i].src = previous;
+  }
+  p += m * 4;
+  get_planes(p, m, words.data());
+  for (size_t i = 0; i < m; i++)
+  {
+    list_edges[i].dest = list_edges[i].src + (int)words[i];
+    if (list_edges[i].src < 0 || list_edges[i].src >= (int)n || list_edges[i].dest < 0 ||
+        list_edges[i].dest >= (int)n)
+      return false;
+  }
+  p += m * 4;
+  get_planes(p, m, words.data());
+  for (size_t i = 0; i < m; i++)
+    list_edges[i].weight = bits_float(words[i]);
+  p += m * 4;
+  for (size_t i = 0; i < n; i++)
+    list_nodes[i].label = (char)p[i];
+  *mode = base.mode;
+  return true;
+}
+
+/**
+ * @brief Applies a delta record to the restored positions.
+ *
+ * @param raw Decompressed record
+ * @param x Bits of the x coordinates, updated
+ * @param y Bits of the y coordinates, updated
+ * @param mode Receives the mode
+ * @return false if the record does not match the base
+ */
+static bool apply_delta(const std::vector<uint8_t> &raw, std::vector<uint32_t> &x,
+                        std::vector<uint32_t> &y, int *mode)
+{
+  DeltaHeader delta;
+  if (raw.size() < sizeof(delta))
+    return false;
+  memcpy(&delta, raw.data(), sizeof(delta));
+  size_t n = x.size();
+  if (delta.node_count != (int32_t)n || raw.size() != sizeof(delta) + n * 8)
+    return false;
+  const uint8_t *p = raw.data() + sizeof(delta);
+  for (size_t i = 0; i < n; i++)
+  {
+    x[i] ^= (uint32_t)p[i] | (uint32_t)p[n + i] << 8 | (uint32_t)p[2 * n + i] << 16 |
+            (uint32_t)p[3 * n + i] << 24;
+  }
+  p += n * 4;
+  for (size_t i = 0; i < n; i++)
+  {
+    y[i] ^= (uint32_t)p[i] | (uint32_t)p[n + i] << 8 | (uint32_t)p[2 * n + i] << 16 |
+            (uint32_t)p[3 * n + i] << 24;
+  }
+  *mode = delta.mode;
+  return true;
+}
+
+/**
+ * @brief Restores a session from a checkpoint file.
+ *
+ * @param path Checkpoint file
+ * @param mode Receives the mode of the last record
+ * @param stats Receives the number of deltas applied, the sizes and the time
+ * @return false, leaving the graph untouched, if the file is missing or its
+ *         base is damaged
+ */
+bool checkpoint_restore(const char *path, int *mode, CheckpointStats *stats)
+{
+  auto start = std::chrono::steady_clock::now();
+  FILE *file = fopen(path, "rb");
+  if (!file)
+    return false;
+  std::vector<uint8_t> data;
+  if (fseek(file, 0, SEEK_END) == 0)
+  {
+    long size = ftell(file);
+    if (size > 0)
+      data.resize(size);
+    rewind(file);
+  }
+  bool ok = !data.empty() && fread(data.data(), 1, data.size(), file) == data.size();
+  fclose(file);
+  CheckpointHeader header = {};
+  if (ok && data.size() >= sizeof(header))
+    memcpy(&header, data.data(), sizeof(header));
+  if (memcmp(header.magic, CHECKPOINT_MAGIC, 4) != 0 || header.version != CHECKPOINT_VERSION)
+  {
+    fprintf(stderr, "%s: not a checkpoint file\n", path);
+    return false;
+  }
+
+  *stats = CheckpointStats();
+  size_t at = sizeof(header);
+  uint32_t type;
+  std::vector<uint8_t> raw;
+  std::vector<Node> list_nodes;
+  std::vector<Edge> list_edges;
+  if (!read_record(data.data(), data.size(), &at, &type, raw) || type != RECORD_BASE ||
+      !decode_base(raw, list_nodes, list_edges, mode))
+  {
+    fprintf(stderr, "%s: damaged base snapshot\n", path);
+    return false;
+  }
+  stats->base_bytes = at;
+  stats->raw_bytes = raw.size();
+
+  size_t n = list_nodes.size();
+  std::vector<uint32_t> x(n), y(n);
+  for (size_t i = 0; i < n; i++)
+  {
+    x[i] = float_bits(list_nodes[i].x);
+    y[i] = float_bits(list_nodes[i].y);
+  }
+  while (at < data.size())
+  {
+    size_t record = at;
+    int delta_mode;
+    if (!read_record(data.data(), data.size(), &at, &type, raw) || type != RECORD_DELTA ||
+        !apply_delta(raw, x, y, &delta_mode))
+    {
+      fprintf(stderr, "%s: ignoring damaged record at byte %zu\n", path, record);
+      break;
+    }
+    *mode = delta_mode;
+    stats->deltas++;
+    stats->delta_bytes += at - record;
+  }
+  for (size_t i = 0; i < n; i++)
+  {
+    list_nodes[i].x = bits_float(x[i]);
+    list_nodes[i].y = bits_float(y[i]);
+  }
+
+  graph_clear();
+  graph_reserve((int)n, (int)list_edges.size());
+  memcpy(nodes, list_nodes.data(), n * sizeof(Node));
+  memcpy(edges, list_edges.data(), list_edges.size() * sizeof(Edge));
+  node_count = (int)n;
+  edge_count = (int)list_edges.size();
+  graph_touch();
+  stats->ms = std::chrono::duration<double, std::milli>(
+                  std::chrono::steady_clock::now() - start)
+                  .count();
+  return true;
+}
@@ -0,0 +1,480 @@
+/**
+ * @file community.cpp
+ * @brief Parallel Louvain community detection with Leiden-style splitting.
+ *
+ * A sweep of local moving first asks every node for its best community in
+ * parallel, reading only the state from before the sweep. The nodes that
+ * want to move are then checked again and moved in node order, as in
+ * sequential Louvain, since earlier moves of the sweep may have changed
+ * their best choice. After the first sweeps few nodes move, so the parallel
+ * pass carries most of the work. Two singletons that pick each other only
+ * merge towards the lower community id. After local moving, each community
+ * is split into its connected pieces (the guarantee the Leiden algorithm
+ * adds to Louvain), and the pieces become the nodes of the next level.
+ * Slices and their reductions follow the analytics kernels, so
+ * the result is the same on every machine.
+ */
+
+#include "community.h"
+#include "parallel.h"
+
+#include <algorithm>
+#include <functional>
+
+#define COMMUNITY_CHUNKS 64
+
+// One level: a weighted graph whose nodes are the communities of the level
+// below. Every edge appears once from each endpoint.
+typedef struct
+{
+  int n;
+  std::vector<int> offsets;
+  std::vector<int> targets;
+  std::vector<double> weights;
+  std::vector<double> loops;    // weight inside each node, every edge once
+  std::vector<double> strength; // weighted degree, loops counted twice
+  double total;                 // sum of strengths (2m)
+} LevelGraph;
+
+// Per-worker accumulator of edge weight by community
+typedef struct
+{
+  std::vector<double> weight; // zero outside of seen
+  std::vector<int> seen;
+} CommunityScratch;
+
+/**
+ * @brief Runs fn(chunk, lo, hi) over COMMUNITY_CHUNKS equal slices of
+ * [0, total).
+ *
+ * @param total Size of the range
+ * @param fn Function called with the chunk index and its slice
+ */
+static void for_each_slice(int total, const std::function<void(int, int, int)> &fn)
+{
+  parallel_for(COMMUNITY_CHUNKS, [&](int c)
+               {
+                 int lo = (int)((long long)total * c / COMMUNITY_CHUNKS);
+                 int hi = (int)((long long)total * (c + 1) / COMMUNITY_CHUNKS);
+                 if (lo < hi)
+                   fn(c, lo, hi);
+               });
+}
+
+/**
+ * @brief Builds the first level from the adjacency, one unit per edge.
+ *
+ * @param adj Adjacency snapshot
+ * @param g Receives the level graph
+ */
+static void base_level(const Adjacency &adj, LevelGraph *g)
+{
+  int n = adj.node_count;
+  g->n = n;
+  g->offsets = adj.offsets;
+  g->targets = adj.targets;
+  g->weights.assign(adj.targets.size(), 1.0);
+  g->loops.assign(n, 0.0);
+  g->strength.resize(n);
+  for (int u = 0; u < n; u++)
+    g->strength[u] = adj.offsets[u + 1] - adj.offsets[u];
+  g->total = (double)adj.targets.size();
+}
+
+/**
+ * @brief Computes the modularity of a partition of a level.
+ *
+ * @param g Level graph
+ * @param comm Community of every node
+ * @param tot Strength of every community
+ * @return Modularity
+ */
+static double modularity(const LevelGraph &g, const std::vector<int> &comm,
+                         const std::vector<double> &tot)
+{
+  if (g.total <= 0)
+    return 0;
+  double partial[COMMUNITY_CHUNKS] = {};
+  for_each_slice(g.n, [&](int c, int lo, int hi)
+                 {
+                   double inside = 0;
+                   for (int u = lo; u < hi; u++)
+                   {
+                     inside += 2 * g.loops[u];
+                     for (int k = g.offsets[u]; k < g.offsets[u + 1]; k++)
+                     {
+                       if (comm[g.targets[k]] == comm[u] && g.targets[k] != u)
+                         inside += g.weights[k];
+                     }
+                   }
+                   partial[c] = inside;
+                 });
+  double inside = 0, expected = 0;
+  for (int c = 0; c < COMMUNITY_CHUNKS; c++)
+    inside += partial[c];
+  for (double t : tot)
+    expected += (t / g.total) * (t / g.total);
+  return inside / g.total - expected;
+}
+
+/**
+ * @brief Picks the community a node gains most modularity by joining.
+ *
+ * @param g Level graph
+ * @param u Node
+ * @param comm Community of every node
+ * @param tot Strength of every community
+ * @param size Node count of every community
+ * @param sc Scratch of the calling worker
+ * @param side_by_side Picks are made in parallel; a singleton then does not
+ *        pick a singleton with a higher id
+ * @return Community to move to; the node's own if staying is best
+ */
+static int best_move(const LevelGraph &g, int u, const std::vector<int> &comm,
+                     const std::vector<double> &tot, const std::vector<int> &size,
+                     CommunityScratch &sc, bool side_by_side)
+{
+  int own = comm[u];
+  for (int k = g.offsets[u]; k < g.offsets[u + 1]; k++)
+  {
+    int v = g.targets[k];
+    if (v == u)
+      continue;
+    int c = comm[v];
+    if (sc.weight[c] == 0)
+      sc.seen.push_back(c);
+    sc.weight[c] += g.weights[k];
+  }
+  double ku = g.strength[u];
+  double best_gain = sc.weight[own] - ku * (tot[own] - ku) / g.total;
+  int best = own;
+  for (int c : sc.seen)
+  {
+    if (c == own)
+      continue;
+    double gain = sc.weight[c] - ku * tot[c] / g.total;
+    if (gain > best_gain || (gain == best_gain && best != own && c < best))
+    {
+      best_gain = gain;
+      best = c;
+    }
+  }
+  for (int c : sc.seen)
+    sc.weight[c] = 0;
+  sc.seen.clear();
+  if (side_by_side && best != own && size[own] == 1 && size[best] == 1 && best > own)
+    return own; // the other singleton moves instead
+  return best;
+}
+
+/**
+ * @brief Moves nodes between communities while modularity rises.
+ *
+ * @param g Level graph
+ * @param comm Receives the community of every node
+ * @param scratch One accumulator per worker, sized for g
+ * @return true if any node left its own community
+ */
+static bool local_moving(const LevelGraph &g, std::vector<int> &comm,
+                         std::vector<CommunityScratch> &scratch)
+{
+  int n = g.n;
+  comm.resize(n);
+  std::vector<double> tot(g.strength);
+  std::vector<int> size(n, 1);
+  for (int u = 0; u < n; u++)
+    comm[u] = u;
+  std::vector<int> proposal(n);
+  double q = modularity(g, comm, tot);
+  bool moved = false;
+  for (int sweep = 0; sweep < COMMUNITY_MAX_SWEEPS && !task_cancelled(); sweep++)
+  {
+    for_each_slice(n, [&](int, int lo, int hi)
+                   {
+                     CommunityScratch &sc = scratch[parallel_worker_id()];
+                     for (int u = lo; u < hi; u++)
+                       proposal[u] = best_move(g, u, comm, tot, size, sc, true);
+                   });
+    int moves = 0;
+    CommunityScratch &own = scratch[parallel_worker_id()];
+    for (int u = 0; u < n; u++)
+    {
+      if (proposal[u] == comm[u])
+        continue;
+      // Earlier moves of this sweep may have changed the best choice
+      int from = comm[u], to = best_move(g, u, comm, tot, size, own, false);
+      if (from == to)
+        continue;
+      tot[from] -= g.strength[u];
+      tot[to] += g.strength[u];
+      size[from]--;
+      size[to]++;
+      comm[u] = to;
+      moves++;
+    }
+    if (moves == 0)
+      break;
+    moved = true;
+    double next = modularity(g, comm, tot);
+    if (next - q < COMMUNITY_MIN_GAIN)
+      break;
+    q = next;
+  }
+  return moved;
+}
+
+/**
+ * @brief Splits every community into its connected pieces and numbers the
+ *        pieces 0..k-1 by their lowest node.
+ *
+ * @param g Level graph
+ * @param comm Community of every node; receives the piece of every node
+ * @return Number of pieces
+ */
+static int split_connected(const LevelGraph &g, std::vector<int> &comm)
+{
+  int n = g.n;
+  std::vector<int> piece(n, -1), stack;
+  int count = 0;
+  for (int s = 0; s < n; s++)
+  {
+    if (piece[s] != -1)
+      continue;
+    piece[s] = count;
+    stack.push_back(s);
+    while (!stack.empty())
+    {
+      int u = stack.back();
+      stack.pop_back();
+      for (int k = g.offsets[u]; k < g.offsets[u + 1]; k++)
+      {
+        int v = g.targets[k];
+        if (piece[v] == -1 && comm[v] == comm[s])
+        {
+          piece[v] = count;
+          stack.push_back(v);
+        }
+      }
+    }
+    count++;
+  }
+  comm.swap(piece);
+  return count;
+}
+
+/**
+ * @brief Collapses every community of a level into one node of the next.
+ *
+ * Communities are handled in parallel slices; each slice gathers the edges
+ * of its communities in order, and the slices are then concatenated.
+ *
+ * @param g Level graph
+ * @param comm Community of every node, in [0, k)
+ * @param k Number of communities
+ * @param scratch One accumulator per worker, sized for at least k
+ * @param out Receives the next level
+ */
+static void aggregate(const LevelGraph &g, const std::vector<int> &comm, int k,
+                      std::vector<CommunityScratch> &scratch, LevelGraph *out)
+{
+  std::vector<int> start(k + 1, 0), members(g.n);
+  for (int u = 0; u < g.n; u++)
+    start[comm[u] + 1]++;
+  for (int c = 0; c < k; c++)
+    start[c + 1] += start[c];
+  std::vector<int> fill(start.begin(), start.end() - 1);
+  for (int u = 0; u < g.n; u++)
+    members[fill[comm[u]]++] = u;
+
+  out->n = k;
+  out->loops.assign(k, 0.0);
+  out->strength.assign(k, 0.0);
+  out->offsets.assign(k + 1, 0);
+  std::vector<int> part_targets[COMMUNITY_CHUNKS];
+  std::vector<double> part_weights[COMMUNITY_CHUNKS];
+  for_each_slice(k, [&](int chunk, int lo, int hi)
+                 {
+                   CommunityScratch &sc = scratch[parallel_worker_id()];
+                   for (int c = lo; c < hi; c++)
+                   {
+                     double inside = 0;
+                     for (int m = start[c]; m < start[c + 1]; m++)
+                     {
+                       int u = members[m];
+                       out->strength[c] += g.strength[u];
+                       out->loops[c] += g.loops[u];
+                       for (int e = g.offsets[u]; e < g.offsets[u + 1]; e++)
+                       {
+                         int d = comm[g.targets[e]];
+                         if (d == c)
+                         {
+                           inside += g.weights[e];
+                           continue;
+                         }
+                         if (sc.weight[d] == 0)
+                           sc.seen.push_back(d);
+                         sc.weight[d] += g.weights[e];
+                       }
+                     }
+                     out->loops[c] += inside / 2; // seen from both ends
+                     for (int d : sc.seen)
+                     {
+                       part_targets[chunk].push_back(d);
+                       part_weights[chunk].push_back(sc.weight[d]);
+                       sc.weight[d] = 0;
+                     }
+                     out->offsets[c + 1] = (int)sc.seen.size();
+                     sc.seen.clear();
+                   }
+                 });
+  for (int c = 0; c < k; c++)
+    out->offsets[c + 1] += out->offsets[c];
+  out->targets.clear();
+  out->weights.clear();
+  out->targets.reserve(out->offsets[k]);
+  out->weights.reserve(out->offsets[k]);
+  for (int chunk = 0; chunk < COMMUNITY_CHUNKS; chunk++)
+  {
+    out->targets.insert(out->targets.end(), part_targets[chunk].begin(), part_targets[chunk].end());
+    out->weights.insert(out->weights.end(), part_weights[chunk].begin(), part_weights[chunk].end());
+  }
+  out->total = g.total;
+}
+
+/**
+ * @brief Detects communities by modularity.
+ *
+ * Levels repeat until local moving leaves every node of a level where it
+ * is. The labels of the original nodes are composed through the levels and
+ * finally renumbered by lowest node. Runs on a worker.
+ *
+ * @param adj Adjacency snapshot
+ * @param community Receives the community of every node
+ * @param stats Receives the community count, modularity and levels, or NULL
+ * @return Number of communities
+ */
+int detect_communities(const Adjacency &adj, std::vector<int> *community,
+                       CommunityStats *stats)
+{
+  int n = adj.node_count;
+  LevelGraph level, next;
+  base_level(adj, &level);
+  std::vector<CommunityScratch> scratch(parallel_threads());
+  for (CommunityScratch &sc : scratch)
+    sc.weight.assign(n, 0.0);
+
+  std::vector<int> label(n), comm;
+  for (int u = 0; u < n; u++)
+    label[u] = u;
+  int levels = 0;
+  while (levels < COMMUNITY_MAX_LEVELS && level.n > 0)
+  {
+    bool moved = local_moving(level, comm, scratch);
+    if (task_cancelled())
+      return 0;
+    int k = split_connected(level, comm);
+    for (int u = 0; u < n; u++)
+      label[u] = comm[label[u]];
+    if (!moved || k == level.n)
+      break;
+    aggregate(level, comm, k, scratch, &next);
+    std::swap(level, next);
+    levels++;
+    task_progress((float)levels / COMMUNITY_MAX_LEVELS);
+  }
+
+  // Number communities by their lowest node
+  std::vector<int> renumber(level.n, -1);
+  int count = 0;
+  community->resize(n);
+  for (int u = 0; u < n; u++)
+  {
+    int &c = renumber[label[u]];
+    if (c == -1)
+      c = count++;
+    (*community)[u] = c;
+  }
+  if (stats)
+  {
+    LevelGraph base;
+    base_level(adj, &base);
+    std::vector<double> tot(count, 0.0);
+    for (int u = 0; u < n; u++)
+      tot[(*community)[u]] += base.strength[u];
+    stats->count = count;
+    stats->modularity = modularity(base, *community, tot);
+    stats->levels = levels;
+  }
+  return count;
+}
+
+/**
+ * @brief Lists the members of every community and aggregates the edges
+ *        between communities into links.
+ *
+ * Communities are handled in parallel slices like the levels of
+ * detect_communities(), so the links come out in the same order on every
+ * machine: by lower end, then by the first edge that reaches the higher
+ * one.
+ *
+ * @param adj Adjacency snapshot
+ * @param community Community of every node, in [0, count)
+ * @param count Number of communities
+ * @param out Receives the members and links
+ */
+void community_graph(const Adjacency &adj, const std::vector<int> &community, int count,
+                     CommunityGraph *out)
+{
+  int n = adj.node_count;
+  out->count = count;
+  out->member_offsets.assign(count + 1, 0);
+  out->members.resize(n);
+  for (int u = 0; u < n; u++)
+    out->member_offsets[community[u] + 1]++;
+  for (int c = 0; c < count; c++)
+    out->member_offsets[c + 1] += out->member_offsets[c];
+  std::vector<int> fill(out->member_offsets.begin(), out->member_offsets.end() - 1);
+  for (int u = 0; u < n; u++)
+    out->members[fill[community[u]]++] = u;
+
+  std::vector<CommunityScratch> scratch(parallel_threads());
+  for (CommunityScratch &sc : scratch)
+    sc.weight.assign(count, 0.0);
+  std::vector<int> part_ends[COMMUNITY_CHUNKS];
+  std::vector<int> part_edges[COMMUNITY_CHUNKS];
+  for_each_slice(count, [&](int chunk, int lo, int hi)
+                 {
+                   CommunityScratch &sc = scratch[parallel_worker_id()];
+                   for (int c = lo; c < hi; c++)
+                   {
+                     for (int m = out->member_offsets[c]; m < out->member_offsets[c + 1]; m++)
+                     {
+                       int u = out->members[m];
+                       for (int e = adj.offsets[u]; e < adj.offsets[u + 1]; e++)
+                       {
+                         int d = community[adj.targets[e]];
+                         if (d <= c)
+                           continue;
+                         if (sc.weight[d] == 0)
+                           sc.seen.push_back(d);
+                         sc.weight[d] += 1;
+                       }
+                     }
+                     for (int d : sc.seen)
+                     {
+                       part_ends[chunk].push_back(c);
+                       part_ends[chunk].push_back(d);
+                       part_edges[chunk].push_back((int)sc.weight[d]);
+                       sc.weight[d] = 0;
+                     }
+                     sc.seen.clear();
+                   }
+                 });
+  out->link_ends.clear();
+  out->link_edges.clear();
+  for (int chunk = 0; chunk < COMMUNITY_CHUNKS; chunk++)
+  {
+    out->link_ends.insert(out->link_ends.end(), part_ends[chunk].begin(), part_ends[chunk].end());
+    out->link_edges.insert(out->link_edges.end(), part_edges[chunk].begin(), part_edges[chunk].end());
+  }
+}
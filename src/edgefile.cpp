@@ -0,0 +1,498 @@
+/**
+ * @file edgefile.cpp
+ * @brief Building, mapping and paging of on-disk edge files.
+ *
+ * File layout: an EdgeFileHeader, node_count + 1 little-endian uint64 arc
+ * offsets, then the Arc records. Building takes three passes: count the
+ * degree of every node, scatter both directions of every edge into one
+ * region per node partition of a spill file, then load each partition, sort
+ * it by source and write it to its final place.
+ */
+
+#include "edgefile.h"
+
+#include <algorithm>
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+#include <sys/mman.h>
+#include <sys/resource.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <vector>
+
+typedef struct
+{
+  char magic[4];
+  uint32_t version;
+  uint64_t node_count;
+  uint64_t edge_count;
+} EdgeFileHeader;
+
+/**
+ * @brief Writes a buffer at a file offset, retrying short writes.
+ *
+ * @param fd File descriptor
+ * @param data Bytes to write
+ * @param size Number of bytes
+ * @param offset File offset
+ * @return false on a write error
+ */
+static bool write_at(int fd, const void *data, size_t size, uint64_t offset)
+{
+  const char *p = (const char *)data;
+  while (size > 0)
+  {
+    ssize_t n = pwrite(fd, p, size, (off_t)offset);
+    if (n < 0 && errno == EINTR)
+      continue;
+    if (n <= 0)
+      return false;
+    p += n;
+    size -= n;
+    offset += n;
+  }
+  return true;
+}
+
+/**
+ * @brief Reads a buffer from a file offset, retrying short reads.
+ *
+ * @param fd File descriptor
+ * @param data Destination
+ * @param size Number of bytes
+ * @param offset File offset
+ * @return false on a read error or at end of file
+ */
+static bool read_at(int fd, void *data, size_t size, uint64_t offset)
+{
+  char *p = (char *)data;
+  while (size > 0)
+  {
+    ssize_t n = pread(fd, p, size, (off_t)offset);
+    if (n < 0 && errno == EINTR)
+      continue;
+    if (n <= 0)
+      return false;
+    p += n;
+    size -= n;
+    offset += n;
+  }
+  return true;
+}
+
+/**
+ * @brief Builds an edge file from two scans of an edge source.
+ *
+ * Partitions are contiguous node ranges holding about budget / 20 arcs, so
+ * that one partition of spilled edges and its sorted arcs fit the budget
+ * together. Each partition gets its own write buffer during the scatter pass,
+ * turning random arc placement into large sequential writes.
+ *
+ * @param path Output path; the spill file is path + ".spill"
+ * @param node_count Number of nodes, or < 0 to take the highest id + 1
+ * @param scan Edge source; must yield the same edges on both scans
+ * @param budget Memory budget in bytes
+ * @return false on an I/O error or if the two scans differ
+ */
+bool edgefile_build(const char *path, int node_count, const EdgeScan &scan,
+                    size_t budget)
+{
+  // Pass 1: degrees. offsets[u + 1] counts the arcs of u.
+  bool grow = node_count < 0;
+  int max_id = -1;
+  long long edge_count = 0;
+  std::vector<uint64_t> offsets(grow ? 1 : node_count + 1, 0);
+  auto valid = [&](const Edge &e)
+  {
+    return e.src != e.dest && e.src >= 0 && e.dest >= 0 &&
+           (grow || (e.src < node_count && e.dest < node_count));
+  };
+  bool ok = scan([&](const Edge &e)
+                 {
+                   if (!valid(e))
+                     return;
+                   int hi = std::max(e.src, e.dest);
+                   if (hi + 2 > (long long)offsets.size())
+                     offsets.resize(std::max((size_t)hi + 2, offsets.size() * 2), 0);
+                   max_id = std::max(max_id, hi);
+                   offsets[e.src + 1]++;
+                   offsets[e.dest + 1]++;
+                   edge_count++;
+                 });
+  if (!ok)
+    return false;
+  if (grow)
+  {
+    node_count = max_id + 1;
+    offsets.resize(node_count + 1);
+  }
+  for (int u = 0; u < node_count; u++)
+    offsets[u + 1] += offsets[u];
+  uint64_t arc_count = offsets[node_count];
+
+  // Node partitions sized to the budget
+  uint64_t part_arcs = std::max<uint64_t>(1, budget / (sizeof(Edge) + sizeof(Arc)));
+  std::vector<int> part_first(1, 0);
+  for (int u = 0; u < node_count; u++)
+  {
+    if (offsets[u + 1] - offsets[part_first.back()] > part_arcs && u > part_first.back())
+      part_first.push_back(u);
+  }
+  part_first.push_back(node_count);
+  int parts = (int)part_first.size() - 1;
+
+  std::string spill_path = std::string(path) + ".spill";
+  int spill = open(spill_path.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+  if (spill < 0)
+  {
+    perror(spill_path.c_str());
+    return false;
+  }
+  unlink(spill_path.c_str()); // removed once closed
+  int out = open(path, O_RDWR | O_CREAT | O_TRUNC, 0644);
+  if (out < 0)
+  {
+    perror(path);
+    close(spill);
+    return false;
+  }
+
+  // Pass 2: scatter both directions of every edge into partition regions
+  size_t buffer_edges = std::max<size_t>(256, budget / 2 / sizeof(Edge) / parts);
+  std::vector<std::vector<Edge>> buffers(parts);
+  std::vector<uint64_t> cursor(parts);
+  for (int p = 0; p < parts; p++)
+    cursor[p] = offsets[part_first[p]];
+  bool io_ok = true;
+  auto flush = [&](int p)
+  {
+    std::vector<Edge> &b = buffers[p];
+    if (io_ok && !b.empty() &&
+        (cursor[p] + b.size() > offsets[part_first[p + 1]] ||
+         !write_at(spill, b.data(), b.size() * sizeof(Edge), cursor[p] * sizeof(Edge))))
+      io_ok = false;
+    cursor[p] += b.size();
+    b.clear();
+  };
+  auto put = [&](int src, int dest, float weight)
+  {
+    int p = (int)(std::upper_bound(part_first.begin(), part_first.end(), src) -
+                  part_first.begin()) - 1;
+    buffers[p].push_back((Edge){src, dest, weight});
+    if (buffers[p].size() >= buffer_edges)
+      flush(p);
+  };
+  ok = scan([&](const Edge &e)
+            {
+              if (!valid(e) || std::max(e.src, e.dest) >= node_count)
+                return;
+              put(e.src, e.dest, e.weight);
+              put(e.dest, e.src, e.weight);
+            });
+  for (int p = 0; p < parts; p++)
+  {
+    flush(p);
+    if (cursor[p] != offsets[part_first[p + 1]])
+      io_ok = false;
+  }
+  if (!ok || !io_ok)
+  {
+    fprintf(stderr, "%s: the edge source changed between passes or the spill "
+                    "file could not be written\n", path);
+    close(spill);
+    close(out);
+    return false;
+  }
+
+  // Header and offsets
+  EdgeFileHeader header;
+  memcpy(header.magic, EDGEFILE_MAGIC, 4);
+  header.version = EDGEFILE_VERSION;
+  header.node_count = node_count;
+  header.edge_count = edge_count;
+  uint64_t arcs_at = sizeof(header) + offsets.size() * sizeof(uint64_t);
+  io_ok = write_at(out, &header, sizeof(header), 0) &&
+          write_at(out, offsets.data(), offsets.size() * sizeof(uint64_t), sizeof(header)) &&
+          ftruncate(out, (off_t)(arcs_at + arc_count * sizeof(Arc))) == 0;
+
+  // Pass 3: sort each partition by source and write its arcs
+  std::vector<Edge> spilled;
+  std::vector<Arc> sorted;
+  std::vector<uint64_t> fill;
+  for (int p = 0; p < parts && io_ok; p++)
+  {
+    int lo = part_first[p], hi = part_first[p + 1];
+    uint64_t base = offsets[lo];
+    size_t count = (size_t)(offsets[hi] - base);
+    if (count == 0)
+      continue;
+    spilled.resize(count);
+    sorted.resize(count);
+    if (!read_at(spill, spilled.data(), count * sizeof(Edge), base * sizeof(Edge)))
+    {
+      io_ok = false;
+      break;
+    }
+    fill.assign(offsets.begin() + lo, offsets.begin() + hi);
+    for (size_t i = 0; i < count; i++)
+    {
+      const Edge &e = spilled[i];
+      sorted[fill[e.src - lo]++ - base] = (Arc){e.dest, e.weight};
+    }
+    io_ok = write_at(out, sorted.data(), count * sizeof(Arc), arcs_at + base * sizeof(Arc));
+  }
+
+  close(spill);
+  if (!io_ok)
+    perror(path);
+  if (close(out) != 0)
+    io_ok = false;
+  return io_ok;
+}
+
+/**
+ * @brief Builds an edge file from a text edge list.
+ *
+ * Each line holds a source, a destination and an optional weight (default
+ * 1). Lines starting with '#' or '%' and lines that do not parse are skipped.
+ *
+ * @param text_path Text edge list
+ * @param path Output edge file
+ * @param budget Memory budget in bytes
+ * @return false on an I/O error
+ */
+bool edgefile_import_text(const char *text_path, const char *path, size_t budget)
+{
+  EdgeScan scan = [&](const std::function<void(const Edge &)> &emit)
+  {
+    FILE *f = fopen(text_path, "r");
+    if (!f)
+    {
+      perror(text_path);
+      return false;
+    }
+    char line[256];
+    while (fgets(line, sizeof(line), f))
+    {
+      if (line[0] == '#' || line[0] == '%')
+        continue;
+      char *end;
+      long src = strtol(line, &end, 10);
+      if (end == line)
+        continue;
+      char *p = end;
+      long dest = strtol(p, &end, 10);
+      if (end == p)
+        continue;
+      p = end;
+      float weight = strtof(p, &end);
+      if (end == p)
+        weight = 1.0f;
+      emit((Edge){(int)src, (int)dest, weight});
+    }
+    bool ok = !ferror(f);
+    fclose(f);
+    return ok;
+  };
+  return edgefile_build(path, -1, scan, budget);
+}
+
+/**
+ * @brief Builds an edge file from the in-memory graph.
+ *
+ * @param path Output edge file
+ * @param budget Memory budget in bytes
+ * @return false on an I/O error
+ */
+bool edgefile_save_graph(const char *path, size_t budget)
+{
+  EdgeScan scan = [](const std::function<void(const Edge &)> &emit)
+  {
+    for (int i = 0; i < edge_count; i++)
+      emit(edges[i]);
+    return true;
+  };
+  return edgefile_build(path, node_count, scan, budget);
+}
+
+/**
+ * @brief Maps an edge file read-only.
+ *
+ * @param path Edge file
+ * @param budget Resident bytes allowed before mapped pages are released
+ * @param file Receives the mapping
+ * @return false if the file cannot be mapped or is not a valid edge file
+ */
+bool edgefile_open(const char *path, size_t budget, EdgeFile *file)
+{
+  memset(file, 0, sizeof(*file));
+  file->fd = open(path, O_RDONLY);
+  struct stat st;
+  if (file->fd < 0 || fstat(file->fd, &st) != 0)
+  {
+    perror(path);
+    if (file->fd >= 0)
+      close(file->fd);
+    return false;
+  }
+  EdgeFileHeader header;
+  if ((size_t)st.st_size < sizeof(header) ||
+      !read_at(file->fd, &header, sizeof(header), 0) ||
+      memcmp(header.magic, EDGEFILE_MAGIC, 4) != 0 ||
+      header.version != EDGEFILE_VERSION ||
+      (uint64_t)st.st_size != sizeof(header) + (header.node_count + 1) * sizeof(uint64_t) +
+                                  header.edge_count * 2 * sizeof(Arc))
+  {
+    fprintf(stderr, "%s: not an edge file\n", path);
+    close(file->fd);
+    return false;
+  }
+  void *map = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, file->fd, 0);
+  if (map == MAP_FAILED)
+  {
+    perror(path);
+    close(file->fd);
+    return false;
+  }
+  file->map = (const uint8_t *)map;
+  file->map_size = st.st_size;
+  file->node_count = (int)header.node_count;
+  file->edge_count = (long long)header.edge_count;
+  file->offsets = (const uint64_t *)(file->map + sizeof(header));
+  file->arcs = (const Arc *)(file->offsets + header.node_count + 1);
+  file->budget = budget;
+  return true;
+}
+
+/**
+ * @brief Unmaps and closes an edge file.
+ *
+ * @param file Open edge file
+ */
+void edgefile_close(EdgeFile *file)
+{
+  if (file->map)
+    munmap((void *)file->map, file->map_size);
+  if (file->fd >= 0)
+    close(file->fd);
+  memset(file, 0, sizeof(*file));
+  file->fd = -1;
+}
+
+/**
+ * @brief Applies madvise to the offsets and arcs of a node range.
+ *
+ * @param file Open edge file
+ * @param lo First node
+ * @param hi One past the last node
+ * @param advice MADV_WILLNEED or MADV_DONTNEED
+ */
+static void advise_nodes(EdgeFile *file, int lo, int hi, int advice)
+{
+  uintptr_t page = (uintptr_t)sysconf(_SC_PAGESIZE);
+  const void *ranges[2][2] = {
+      {file->offsets + lo, file->offsets + hi + 1},
+      {file->arcs + file->offsets[lo], file->arcs + file->offsets[hi]}};
+  for (int r = 0; r < 2; r++)
+  {
+    uintptr_t start = (uintptr_t)ranges[r][0] & ~(page - 1);
+    uintptr_t end = ((uintptr_t)ranges[r][1] + page - 1) & ~(page - 1);
+    if (end > start)
+      madvise((void *)start, end - start, advice);
+  }
+}
+
+/**
+ * @brief Finds the end of a window starting at node lo.
+ *
+ * @param file Open edge file
+ * @param lo First node of the window
+ * @param arcs Arc count the window should not exceed
+ * @return One past the last node; at least lo + 1
+ */
+static int window_end(const EdgeFile *file, int lo, uint64_t arcs)
+{
+  const uint64_t *end = std::upper_bound(file->offsets + lo + 1,
+                                         file->offsets + file->node_count + 1,
+                                         file->offsets[lo] + arcs);
+  int hi = (int)(end - file->offsets) - 1;
+  return std::max(hi, lo + 1);
+}
+
+/**
+ * @brief Visits all nodes in windows that fit half of the budget.
+ *
+ * While fn works on one window, the kernel is asked to read the next one
+ * ahead; a window's pages are dropped from the mapping once fn returns, so
+ * the resident size stays near one or two windows.
+ *
+ * @param file Open edge file
+ * @param fn Called with each window's node range [lo, hi)
+ */
+void edgefile_for_each_window(EdgeFile *file,
+                              const std::function<void(int lo, int hi)> &fn)
+{
+  int n = file->node_count;
+  uint64_t window_arcs = std::max<uint64_t>(1, file->budget / 2 / sizeof(Arc));
+  int lo = 0;
+  int hi = n > 0 ? window_end(file, 0, window_arcs) : 0;
+  advise_nodes(file, lo, hi, MADV_WILLNEED);
+  while (lo < n)
+  {
+    int next_hi = hi < n ? window_end(file, hi, window_arcs) : n;
+    if (hi < n)
+      advise_nodes(file, hi, next_hi, MADV_WILLNEED);
+    fn(lo, hi);
+    advise_nodes(file, lo, hi, MADV_DONTNEED);
+    lo = hi;
+    hi = next_hi;
+  }
+  file->touched = 0;
+}
+
+/**
+ * @brief Accounts for a random read of one node's arcs.
+ *
+ * Each read is counted with a page of slack for the surrounding pages the
+ * kernel maps along with it. Past an eighth of the budget the mapped file
+ * pages are measured, and if they exceed the budget they are all dropped
+ * from the mapping; they stay in the page cache, so later reads fault them
+ * back in cheaply.
+ *
+ * @param file Open edge file
+ * @param u Node whose arcs are about to be read
+ */
+void edgefile_touch(EdgeFile *file, int u)
+{
+  size_t page = (size_t)sysconf(_SC_PAGESIZE);
+  file->touched += (file->offsets[u + 1] - file->offsets[u]) * sizeof(Arc) + page;
+  if (file->touched < file->budget / 8)
+    return;
+  file->touched = 0;
+  long size_pages = 0, resident = 0, shared = 0;
+  FILE *f = fopen("/proc/self/statm", "r");
+  if (f)
+  {
+    if (fscanf(f, "%ld %ld %ld", &size_pages, &resident, &shared) != 3)
+      shared = 0;
+    fclose(f);
+  }
+  if (!f || (size_t)shared * page > file->budget)
+    madvise((void *)file->map, file->map_size, MADV_DONTNEED);
+}
+
+/**
+ * @brief Returns the peak resident set size of the process.
+ *
+ * @return Peak RSS in kilobytes
+ */
+long peak_rss_kb()
+{
+  struct rusage usage;
+  getrusage(RUSAGE_SELF, &usage);
+  return usage.ru_maxrss;
+}
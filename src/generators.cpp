@@ -0,0 +1,591 @@
+/**
+ * @file generators.cpp
+ * @brief Parallel, seedable graph generators writing into the graph store.
+ *
+ * Work is split into GEN_CHUNKS chunks independent of the core count. Each
+ * chunk draws from a counter-based random stream keyed by (seed, chunk) or
+ * hashes (seed, element) directly, so a given seed always produces the same
+ * graph. Generators whose output size is known up front (grid, Barabasi-Albert,
+ * R-MAT) write straight into the edge array; the others collect per-chunk
+ * buffers that are copied into place in parallel once their sizes are known.
+ */
+
+#include "generators.h"
+#include "graph.h"
+#include "parallel.h"
+
+#include <limits.h>
+#include <math.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <vector>
+
+#define GEN_CHUNKS 256
+
+// R-MAT quadrant probabilities (Graph500 parameters); d = 1 - a - b - c
+#define RMAT_A 0.57
+#define RMAT_B 0.19
+#define RMAT_C 0.19
+
+/**
+ * @brief SplitMix64 finalizer, used both as a hash and as the stream step.
+ *
+ * @param x Input value
+ * @return Well-mixed 64-bit value
+ */
+static inline uint64_t mix64(uint64_t x)
+{
+  x ^= x >> 30;
+  x *= 0xbf58476d1ce4e5b9ULL;
+  x ^= x >> 27;
+  x *= 0x94d049bb133111ebULL;
+  x ^= x >> 31;
+  return x;
+}
+
+typedef struct
+{
+  uint64_t state;
+} Rng;
+
+static inline Rng rng_for(unsigned int seed, uint64_t stream)
+{
+  Rng rng = {mix64(((uint64_t)seed << 32) ^ mix64(stream + 0x9e3779b97f4a7c15ULL))};
+  return rng;
+}
+
+static inline uint64_t rng_next(Rng *rng)
+{
+  rng->state += 0x9e3779b97f4a7c15ULL;
+  return mix64(rng->state);
+}
+
+// Uniform double in [0, 1)
+static inline double rng_uniform(Rng *rng)
+{
+  return (rng_next(rng) >> 11) * (1.0 / 9007199254740992.0);
+}
+
+// Integer weight in [1, 9] from a hash value
+static inline float weight_from(uint64_t h) { return (float)(1 + h % 9); }
+
+// Hash keyed by the seed and a purpose tag, for per-element randomness
+static inline uint64_t element_hash(unsigned int seed, uint64_t tag, uint64_t i)
+{
+  return mix64(mix64(((uint64_t)seed << 32) ^ tag) ^ i);
+}
+
+static const char *generator_names[GEN_COUNT + 1] = {
+    NULL, "er", "ba", "grid", "geometric", "rmat"};
+
+/**
+ * @brief Returns the short name of a generator.
+ *
+ * @param type Generator type (GEN_*)
+ * @return Short name, or "unknown"
+ */
+const char *generator_name(int type)
+{
+  if (type < 1 || type > GEN_COUNT)
+    return "unknown";
+  return generator_names[type];
+}
+
+/**
+ * @brief Looks a generator up by its short name.
+ *
+ * @param name Short name
+ * @return Generator type, or 0 if the name is unknown
+ */
+int generator_type(const char *name)
+{
+  for (int t = 1; t <= GEN_COUNT; t++)
+  {
+    if (strcmp(name, generator_names[t]) == 0)
+      return t;
+  }
+  return 0;
+}
+
+/**
+ * @brief Fills in parameters that give a readable graph on screen.
+ *
+ * The seed and placement region are left untouched.
+ *
+ * @param type Generator type (GEN_*)
+ * @param params Parameters to fill in
+ */
+void generator_defaults(int type, GeneratorParams *params)
+{
+  params->type = type;
+  params->nodes = 40;
+  params->edges = 0;
+  params->probability = 0.08f;
+  params->degree = 2;
+  params->radius = 0.15f;
+  switch (type)
+  {
+  case GEN_BARABASI_ALBERT:
+    params->nodes = 50;
+    break;
+  case GEN_GRID:
+    params->nodes = 64;
+    break;
+  case GEN_GEOMETRIC:
+    params->nodes = 60;
+    break;
+  case GEN_RMAT:
+    params->nodes = 64;
+    params->edges = 128;
+    break;
+  }
+}
+
+/**
+ * @brief Runs fn(lo, hi) over GEN_CHUNKS equal slices of [0, total).
+ *
+ * @param total Size of the range
+ * @param fn Function called with the chunk index and its slice
+ */
+static void for_each_slice(long long total,
+                           const std::function<void(int, long long, long long)> &fn)
+{
+  parallel_for(GEN_CHUNKS, [&](int c)
+               {
+                 long long lo = total * c / GEN_CHUNKS;
+                 long long hi = total * (c + 1) / GEN_CHUNKS;
+                 if (lo < hi)
+                   fn(c, lo, hi);
+               });
+}
+
+/**
+ * @brief Resets the graph to n nodes at hashed random positions.
+ *
+ * @param params Generator parameters (seed and region)
+ * @param n Number of nodes
+ */
+static void place_random_nodes(const GeneratorParams *params, int n)
+{
+  graph_clear();
+  graph_reserve(n, 0);
+  node_count = n;
+  float w = params->x1 - params->x0;
+  float h = params->y1 - params->y0;
+  for_each_slice(n, [&](int, long long lo, long long hi)
+                 {
+                   for (long long i = lo; i < hi; i++)
+                   {
+                     uint64_t r = element_hash(params->seed, 1, i);
+                     float ux = (r >> 40) / 16777216.0f;
+                     float uy = (r & 0xffffff) / 16777216.0f;
+                     nodes[i] = (Node){params->x0 + ux * w, params->y0 + uy * h,
+                                       (char)('A' + i), (int)i};
+                   }
+                 });
+}
+
+/**
+ * @brief Reserves room for the edges of a generator and checks the size.
+ *
+ * @param total Number of edges about to be written
+ * @return false if the count does not fit the edge array
+ */
+static bool reserve_edges(long long total)
+{
+  if (total > INT_MAX)
+  {
+    fprintf(stderr, "Generator would produce %lld edges, more than %d\n", total,
+            INT_MAX);
+    return false;
+  }
+  graph_reserve(0, (int)total);
+  return true;
+}
+
+/**
+ * @brief Copies per-chunk edge buffers into the edge array in parallel.
+ *
+ * @param parts Edge buffers in chunk order
+ * @return Number of edges in the graph
+ */
+static int commit_parts(std::vector<std::vector<Edge>> &parts)
+{
+  std::vector<long long> offset(parts.size() + 1, 0);
+  for (size_t c = 0; c < parts.size(); c++)
+    offset[c + 1] = offset[c] + (long long)parts[c].size();
+  if (!reserve_edges(offset.back()))
+    return 0;
+  parallel_for((int)parts.size(), [&](int c)
+               {
+                 if (!parts[c].empty())
+                   memcpy(edges + offset[c], parts[c].data(),
+                          parts[c].size() * sizeof(Edge));
+               });
+  edge_count = (int)offset.back();
+  return edge_count;
+}
+
+/**
+ * @brief Erdos-Renyi G(n, p).
+ *
+ * The n(n-1)/2 candidate pairs are numbered row by row and split evenly over
+ * the chunks. Within a chunk, geometric skipping jumps directly from one
+ * chosen pair to the next, so the cost is proportional to the number of
+ * edges rather than the number of pairs.
+ *
+ * @param params Generator parameters
+ * @return Number of edges
+ */
+static int generate_erdos_renyi(const GeneratorParams *params)
+{
+  int n = params->nodes;
+  double p = params->probability;
+  place_random_nodes(params, n);
+  if (n < 2 || p <= 0)
+    return 0;
+
+  long long total = (long long)n * (n - 1) / 2;
+  double log_q = p < 1 ? log(1.0 - p) : 0;
+  // First pair index of row u
+  auto row_start = [n](long long u)
+  { return u * (2LL * n - u - 1) / 2; };
+
+  std::vector<std::vector<Edge>> parts(GEN_CHUNKS);
+  for_each_slice(total, [&](int c, long long lo, long long hi)
+                 {
+                   long long u_lo = 0, u_hi = n - 2;
+                   while (u_lo < u_hi)
+                   {
+                     long long mid = (u_lo + u_hi + 1) / 2;
+                     if (row_start(mid) <= lo)
+                       u_lo = mid;
+                     else
+                       u_hi = mid - 1;
+                   }
+                   long long u = u_lo;
+                   long long row_begin = row_start(u);
+
+                   Rng rng = rng_for(params->seed, c);
+                   std::vector<Edge> &out = parts[c];
+                   out.reserve((size_t)((hi - lo) * p) + 16);
+                   long long pos = lo - 1;
+                   while (true)
+                   {
+                     pos += 1;
+                     if (p < 1)
+                       pos += (long long)floor(log(1.0 - rng_uniform(&rng)) / log_q);
+                     if (pos >= hi)
+                       break;
+                     while (pos >= row_begin + (n - 1 - u))
+                     {
+                       row_begin += n - 1 - u;
+                       u++;
+                     }
+                     int v = (int)(u + 1 + (pos - row_begin));
+                     out.push_back((Edge){(int)u, v, weight_from(rng_next(&rng))});
+                   }
+                 });
+  return commit_parts(parts);
+}
+
+/**
+ * @brief Resolves the target of one Barabasi-Albert edge.
+ *
+ * Edge e belongs to node e / d + 1 and picks a uniformly random endpoint of
+ * the edges created before its node, which is exactly preferential
+ * attachment. If that endpoint is the target of an earlier edge, the same
+ * rule is applied to that edge. Each edge is thus resolved independently
+ * from hashes, which lets the edges be generated in parallel.
+ *
+ * @param seed Generator seed
+ * @param e Edge index
+ * @param d Edges per new node
+ * @return Target node of the edge
+ */
+static int barabasi_albert_target(unsigned int seed, long long e, int d)
+{
+  while (true)
+  {
+    long long earlier = (e / d) * d; // edges created by older nodes
+    if (earlier == 0)
+      return 0;
+    uint64_t r = element_hash(seed, 2, e) % (uint64_t)(2 * earlier);
+    if (r % 2 == 0)
+      return (int)((r / 2) / d + 1);
+    e = (long long)(r / 2);
+  }
+}
+
+/**
+ * @brief Barabasi-Albert preferential attachment.
+ *
+ * @param params Generator parameters
+ * @return Number of edges
+ */
+static int generate_barabasi_albert(const GeneratorParams *params)
+{
+  int n = params->nodes;
+  int d = params->degree > 0 ? params->degree : 1;
+  place_random_nodes(params, n);
+  if (n < 2)
+    return 0;
+
+  long long total = (long long)(n - 1) * d;
+  if (!reserve_edges(total))
+    return 0;
+  for_each_slice(total, [&](int, long long lo, long long hi)
+                 {
+                   for (long long e = lo; e < hi; e++)
+                   {
+                     edges[e] = (Edge){(int)(e / d + 1),
+                                       barabasi_albert_target(params->seed, e, d),
+                                       weight_from(element_hash(params->seed, 3, e))};
+                   }
+                 });
+  edge_count = (int)total;
+  return edge_count;
+}
+
+/**
+ * @brief Square 2D lattice with nodes placed on the grid points.
+ *
+ * @param params Generator parameters
+ * @return Number of edges
+ */
+static int generate_grid(const GeneratorParams *params)
+{
+  int side = (int)sqrt((double)params->nodes);
+  while ((long long)(side + 1) * (side + 1) <= params->nodes)
+    side++;
+  graph_clear();
+  if (side < 1)
+    return 0;
+  int n = side * side;
+  graph_reserve(n, 0);
+  node_count = n;
+
+  // Row r owns its side-1 horizontal edges and, except for the last row, the
+  // side vertical edges going down, so row r starts at r * (2 * side - 1).
+  long long total = 2LL * side * (side - 1);
+  if (!reserve_edges(total))
+    return 0;
+  float w = params->x1 - params->x0;
+  float h = params->y1 - params->y0;
+  for_each_slice(side, [&](int, long long lo, long long hi)
+                 {
+                   for (long long r = lo; r < hi; r++)
+                   {
+                     long long e = r * (2LL * side - 1);
+                     for (int c = 0; c < side; c++)
+                     {
+                       int i = (int)r * side + c;
+                       nodes[i] = (Node){params->x0 + w * (c + 0.5f) / side,
+                                         params->y1 - h * (r + 0.5f) / side,
+                                         (char)('A' + i), i};
+                       if (c + 1 < side)
+                       {
+                         edges[e] = (Edge){i, i + 1, weight_from(element_hash(params->seed, 4, e))};
+                         e++;
+                       }
+                       if (r + 1 < side)
+                       {
+                         edges[e] = (Edge){i, i + side, weight_from(element_hash(params->seed, 4, e))};
+                         e++;
+                       }
+                     }
+                   }
+                 });
+  edge_count = (int)total;
+  return edge_count;
+}
+
+/**
+ * @brief Random geometric graph in the unit square.
+ *
+ * Points are bucketed into a uniform grid whose cells are at least the
+ * connection radius wide, so each point only tests the 3x3 block of cells
+ * around it. Edge weights grow with the distance between the endpoints.
+ *
+ * @param params Generator parameters
+ * @return Number of edges
+ */
+static int generate_geometric(const GeneratorParams *params)
+{
+  int n = params->nodes;
+  float radius = params->radius > 0 ? params->radius : 0.1f;
+  place_random_nodes(params, n);
+  if (n < 2)
+    return 0;
+
+  // Positions in the unit square, recovered from the placement region
+  float w = params->x1 - params->x0;
+  float h = params->y1 - params->y0;
+  std::vector<float> ux(n), uy(n);
+  for (int i = 0; i < n; i++)
+  {
+    ux[i] = w > 0 ? (nodes[i].x - params->x0) / w : 0;
+    uy[i] = h > 0 ? (nodes[i].y - params->y0) / h : 0;
+  }
+
+  int cells = (int)(1.0f / radius);
+  int max_cells = (int)sqrt((double)n) + 1;
+  if (cells > max_cells)
+    cells = max_cells;
+  if (cells < 1)
+    cells = 1;
+  auto cell_of = [&](int i)
+  {
+    int cx = (int)(ux[i] * cells), cy = (int)(uy[i] * cells);
+    if (cx >= cells)
+      cx = cells - 1;
+    if (cy >= cells)
+      cy = cells - 1;
+    return cy * cells + cx;
+  };
+
+  // Counting sort of the points by cell
+  std::vector<int> cell_start((size_t)cells * cells + 1, 0);
+  std::vector<int> order(n);
+  for (int i = 0; i < n; i++)
+    cell_start[cell_of(i) + 1]++;
+  for (size_t c = 0; c + 1 < cell_start.size(); c++)
+    cell_start[c + 1] += cell_start[c];
+  std::vector<int> fill(cell_start.begin(), cell_start.end() - 1);
+  for (int i = 0; i < n; i++)
+    order[fill[cell_of(i)]++] = i;
+
+  float r2 = radius * radius;
+  std::vector<std::vector<Edge>> parts(GEN_CHUNKS);
+  for_each_slice(n, [&](int c, long long lo, long long hi)
+                 {
+                   for (long long i = lo; i < hi; i++)
+                   {
+                     int cell = cell_of((int)i);
+                     int cx = cell % cells, cy = cell / cells;
+                     for (int dy = -1; dy <= 1; dy++)
+                     {
+                       for (int dx = -1; dx <= 1; dx++)
+                       {
+                         int nx = cx + dx, ny = cy + dy;
+                         if (nx < 0 || ny < 0 || nx >= cells || ny >= cells)
+                           continue;
+                         int nc = ny * cells + nx;
+                         for (int k = cell_start[nc]; k < cell_start[nc + 1]; k++)
+                         {
+                           int j = order[k];
+                           if (j <= i)
+                             continue;
+                           float ddx = ux[i] - ux[j], ddy = uy[i] - uy[j];
+                           float d2 = ddx * ddx + ddy * ddy;
+                           if (d2 < r2)
+                           {
+                             float weight = 1.0f + 9.0f * sqrtf(d2) / radius;
+                             parts[c].push_back((Edge){(int)i, j, roundf(weight * 10) / 10});
+                           }
+                         }
+                       }
+                     }
+                   }
+                 });
+  return commit_parts(parts);
+}
+
+/**
+ * @brief Recursive-matrix (R-MAT) generator.
+ *
+ * Each edge descends log2(n) levels of the adjacency matrix, picking one of
+ * four quadrants per level with the Graph500 probabilities. Every chunk owns
+ * a fixed slice of the edge array and writes into it directly. Self loops are
+ * redrawn; duplicates are merged afterwards by generate_graph().
+ *
+ * @param params Generator parameters
+ * @return Number of edges
+ */
+static int generate_rmat(const GeneratorParams *params)
+{
+  int scale = 0;
+  while ((1LL << scale) < params->nodes)
+    scale++;
+  if (scale > 30)
+    scale = 30;
+  int n = 1 << scale;
+  place_random_nodes(params, n);
+  if (n < 2 || params->edges <= 0)
+    return 0;
+
+  long long total = params->edges;
+  if (!reserve_edges(total))
+    return 0;
+  const uint32_t ta = (uint32_t)(RMAT_A * 4294967296.0);
+  const uint32_t tb = (uint32_t)((RMAT_A + RMAT_B) * 4294967296.0);
+  const uint32_t tc = (uint32_t)((RMAT_A + RMAT_B + RMAT_C) * 4294967296.0);
+  for_each_slice(total, [&](int c, long long lo, long long hi)
+                 {
+                   Rng rng = rng_for(params->seed, c);
+                   for (long long e = lo; e < hi; e++)
+                   {
+                     int u, v;
+                     do
+                     {
+                       u = 0;
+                       v = 0;
+                       uint64_t bits = 0;
+                       for (int level = 0; level < scale; level++)
+                       {
+                         // One 64-bit draw covers two levels
+                         if ((level & 1) == 0)
+                           bits = rng_next(&rng);
+                         uint32_t r = (uint32_t)(bits >> ((level & 1) * 32));
+                         int bu = r >= tb;
+                         int bv = (r >= ta && r < tb) || r >= tc;
+                         u = (u << 1) | bu;
+                         v = (v << 1) | bv;
+                       }
+                     } while (u == v);
+                     edges[e] = (Edge){u, v, weight_from(rng_next(&rng))};
+                   }
+                 });
+  edge_count = (int)total;
+  return edge_count;
+}
+
+/**
+ * @brief Replaces the graph with a generated one.
+ *
+ * Generators that can emit the same pair twice are passed through the batch
+ * loader, which keeps one edge per pair with the smallest weight.
+ *
+ * @param params Generator parameters
+ * @return Number of edges in the generated graph
+ */
+int generate_graph(const GeneratorParams *params)
+{
+  switch (params->type)
+  {
+  case GEN_ERDOS_RENYI:
+    generate_erdos_renyi(params);
+    break;
+  case GEN_BARABASI_ALBERT:
+    generate_barabasi_albert(params);
+    break;
+  case GEN_GRID:
+    generate_grid(params);
+    break;
+  case GEN_GEOMETRIC:
+    generate_geometric(params);
+    break;
+  case GEN_RMAT:
+    generate_rmat(params);
+    break;
+  default:
+    fprintf(stderr, "Unknown generator type %d\n", params->type);
+    return 0;
+  }
+  graph_touch();
+  // Preferential attachment and R-MAT draw the same pair more than once
+  if (params->type == GEN_BARABASI_ALBERT || params->type == GEN_RMAT)
+    graph_add_edges(NULL, 0, DEDUP_MIN);
+  return edge_count;
+}
@@ -0,0 +1,735 @@
+/**
+ * @file graph.cpp
+ * @brief Node and edge storage together with its mutation primitives.
+ */
+
+#include "graph.h"
+#include "parallel.h"
+
+#include <algorithm>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unordered_map>
+
+Node *nodes = NULL;
+Edge *edges = NULL;
+int node_count = 0, edge_count = 0;
+unsigned int graph_version = 0;
+
+static int node_capacity = 0, edge_capacity = 0;
+
+// Edge lookup by endpoint pair. It is kept up to date by appends and
+// rebuilt lazily after anything that renumbers nodes or edges.
+static std::unordered_map<uint64_t, int> edge_lookup;
+static bool edge_lookup_valid = true;
+
+// Node lookup by external id, rebuilt lazily like the edge lookup. Ids are
+// never handed out twice while their node exists.
+static std::unordered_map<int, int> node_lookup;
+static bool node_lookup_valid = true;
+static int next_node_id = 0;
+
+static std::shared_ptr<const Adjacency> adjacency;
+static unsigned int adjacency_version = 0;
+
+/**
+ * @brief Returns the direction-independent key of an endpoint pair.
+ *
+ * @param u One endpoint
+ * @param v Other endpoint
+ * @return Key with the smaller index in the high half
+ */
+static inline uint64_t edge_key(int u, int v)
+{
+  if (u > v)
+    std::swap(u, v);
+  return ((uint64_t)(uint32_t)u << 32) | (uint32_t)v;
+}
+
+/**
+ * @brief Marks the graph as changed after writing the arrays directly.
+ *
+ * Bulk producers such as the generators and the undo journal fill nodes[]
+ * and edges[] without going through the primitives and call this afterwards.
+ */
+void graph_touch()
+{
+  graph_version++;
+  edge_lookup_valid = false;
+  node_lookup_valid = false;
+}
+
+/**
+ * @brief Grows the node and edge arrays.
+ *
+ * Capacity at least doubles on every growth so that appending one element at
+ * a time stays amortized O(1). Bulk producers reserve the final size up front
+ * and write into the arrays directly.
+ *
+ * @param min_nodes Number of nodes the array must be able to hold
+ * @param min_edges Number of edges the array must be able to hold
+ */
+void graph_reserve(int min_nodes, int min_edges)
+{
+  if (min_nodes > node_capacity)
+  {
+    int capacity = node_capacity * 2 > min_nodes ? node_capacity * 2 : min_nodes;
+    Node *grown = (Node *)realloc(nodes, (size_t)capacity * sizeof(Node));
+    if (!grown)
+    {
+      fprintf(stderr, "Out of memory growing the node array to %d\n", capacity);
+      exit(1);
+    }
+    nodes = grown;
+    node_capacity = capacity;
+  }
+  if (min_edges > edge_capacity)
+  {
+    int capacity = edge_capacity * 2 > min_edges ? edge_capacity * 2 : min_edges;
+    Edge *grown = (Edge *)realloc(edges, (size_t)capacity * sizeof(Edge));
+    if (!grown)
+    {
+      fprintf(stderr, "Out of memory growing the edge array to %d\n", capacity);
+      exit(1);
+    }
+    edges = grown;
+    edge_capacity = capacity;
+  }
+}
+
+/**
+ * @brief Rebuilds the id lookup from the node array.
+ *
+ * Also moves the next id past every id in use, since bulk producers assign
+ * ids themselves.
+ */
+static void rebuild_node_lookup()
+{
+  node_lookup.clear();
+  node_lookup.reserve(node_count);
+  for (int i = 0; i < node_count; i++)
+  {
+    node_lookup.emplace(nodes[i].id, i);
+    if (nodes[i].id >= next_node_id)
+      next_node_id = nodes[i].id + 1;
+  }
+  node_lookup_valid = true;
+}
+
+/**
+ * @brief Appends a node at the given position.
+ *
+ * @param x X-coordinate
+ * @param y Y-coordinate
+ * @return Index of the new node
+ */
+int graph_add_node(float x, float y)
+{
+  graph_reserve(node_count + 1, 0);
+  if (!node_lookup_valid)
+    rebuild_node_lookup();
+  int id = next_node_id++;
+  node_lookup.emplace(id, node_count);
+  nodes[node_count] = (Node){x, y, (char)('A' + node_count), id};
+  graph_version++;
+  return node_count++;
+}
+
+/**
+ * @brief Appends a node that takes a given external id.
+ *
+ * Used by producers that address nodes by their own ids, such as an edge
+ * event feed. Later ids handed out by graph_add_node() stay above it.
+ *
+ * @param x X-coordinate
+ * @param y Y-coordinate
+ * @param id External id, not negative
+ * @return Index of the new node, or -1 if a node already has the id
+ */
+int graph_add_node_with_id(float x, float y, int id)
+{
+  if (id < 0 || graph_node_index(id) != -1)
+    return -1;
+  graph_reserve(node_count + 1, 0);
+  node_lookup.emplace(id, node_count);
+  if (id >= next_node_id)
+    next_node_id = id + 1;
+  nodes[node_count] = (Node){x, y, (char)('A' + node_count), id};
+  graph_version++;
+  return node_count++;
+}
+
+/**
+ * @brief Inserts a node at the specified index.
+ *
+ * Later nodes move up by one and every edge endpoint at or above the index is
+ * renumbered, which is the exact inverse of delete_node() on the remaining
+ * edges.
+ *
+ * @param index Position of the new node
+ * @param node Node to insert
+ */
+void graph_insert_node(int index, Node node)
+{
+  graph_reserve(node_count + 1, 0);
+  for (int i = node_count; i > index; i--)
+  {
+    nodes[i] = nodes[i - 1];
+    nodes[i].label = 'A' + i;
+  }
+  nodes[index] = node;
+  nodes[index].label = 'A' + index;
+  node_count++;
+  graph_touch();
+
+  for (int i = 0; i < edge_count; i++)
+  {
+    if (edges[i].src >= index)
+      edges[i].src++;
+    if (edges[i].dest >= index)
+      edges[i].dest++;
+  }
+}
+
+/**
+ * @brief Adds an edge between two nodes with the specified weight.
+ *
+ * @param src Source node index
+ * @param dest Destination node index
+ * @param weight Weight of the edge
+ * @return Index of the new edge
+ */
+int add_edge(int src, int dest, float weight)
+{
+  graph_reserve(0, edge_count + 1);
+  edges[edge_count] = (Edge){src, dest, weight};
+  if (edge_lookup_valid)
+    edge_lookup.emplace(edge_key(src, dest), edge_count);
+  graph_version++;
+  return edge_count++;
+}
+
+/**
+ * @brief Merges a set of edges back into the edge array.
+ *
+ * The edges end up at exactly the given indices and the existing edges keep
+ * their relative order, so a node deletion can be reverted with one backwards
+ * pass over the array instead of one shift per restored edge.
+ *
+ * @param indices Final positions of the inserted edges, in ascending order
+ * @param list Edges to insert
+ * @param count Number of edges to insert
+ */
+void graph_insert_edges(const int *indices, const Edge *list, int count)
+{
+  int total = edge_count + count;
+  graph_reserve(0, total);
+  int src = edge_count - 1;
+  int k = count - 1;
+  for (int dst = total - 1; dst >= 0 && k >= 0; dst--)
+  {
+    if (indices[k] == dst)
+      edges[dst] = list[k--];
+    else
+      edges[dst] = edges[src--];
+  }
+  edge_count = total;
+  graph_touch();
+}
+
+/**
+ * @brief Removes a single edge, keeping the other edges in order.
+ *
+ * @param index Index of the edge to remove
+ */
+void graph_remove_edge(int index)
+{
+  for (int i = index; i < edge_count - 1; i++)
+  {
+    edges[i] = edges[i + 1];
+  }
+  edge_count--;
+  graph_touch();
+}
+
+/**
+ * @brief Removes an edge by moving the last edge into its slot.
+ *
+ * The endpoint-pair lookup is patched for the two edges involved instead of
+ * being rebuilt, so a stream of removals costs O(1) each.
+ *
+ * @param index Index of the edge to remove
+ */
+void graph_remove_edge_unordered(int index)
+{
+  int last = edge_count - 1;
+  if (edge_lookup_valid)
+  {
+    auto it = edge_lookup.find(edge_key(edges[index].src, edges[index].dest));
+    if (it != edge_lookup.end() && it->second == index)
+      edge_lookup.erase(it);
+    if (index != last)
+    {
+      it = edge_lookup.find(edge_key(edges[last].src, edges[last].dest));
+      if (it != edge_lookup.end() && it->second == last)
+        it->second = index;
+    }
+  }
+  edges[index] = edges[last];
+  edge_count--;
+  graph_version++;
+}
+
+/**
+ * @brief Deletes a node and updates the graph.
+ *
+ * One pass over the edges drops the incident ones and renumbers the
+ * endpoints above the node; one pass over the nodes closes the gap. Both
+ * keep their order, which graph_insert_node() and graph_insert_edges()
+ * rely on to revert the deletion.
+ *
+ * @param node_index Index of the node to delete
+ */
+void delete_node(int node_index)
+{
+  int kept = 0;
+  for (int i = 0; i < edge_count; i++)
+  {
+    Edge e = edges[i];
+    if (e.src == node_index || e.dest == node_index)
+      continue;
+    if (e.src > node_index)
+      e.src--;
+    if (e.dest > node_index)
+      e.dest--;
+    edges[kept++] = e;
+  }
+  edge_count = kept;
+  for (int i = node_index; i < node_count - 1; i++)
+  {
+    nodes[i] = nodes[i + 1];
+    nodes[i].label = 'A' + i;
+  }
+  node_count--;
+  graph_touch();
+}
+
+/**
+ * @brief Frees the external id of a node that is about to be removed.
+ *
+ * The node takes the id -1 - index, which no other node can hold, so a new
+ * node may take over its old id before graph_remove_nodes() runs.
+ *
+ * @param index Node
+ */
+void graph_release_node_id(int index)
+{
+  if (!node_lookup_valid)
+    rebuild_node_lookup();
+  node_lookup.erase(nodes[index].id);
+  nodes[index].id = -1 - index;
+  node_lookup.emplace(nodes[index].id, index);
+}
+
+/**
+ * @brief Deletes a set of nodes together with their incident edges.
+ *
+ * A prefix count over the mask gives every kept node its new index, so the
+ * whole set goes in one pass over the nodes and one over the edges,
+ * whatever its size. Nodes and edges keep their relative order.
+ *
+ * @param drop Nonzero for every node to delete; node_count entries
+ */
+void graph_remove_nodes(const unsigned char *drop)
+{
+  std::vector<int> new_index(node_count);
+  int kept = 0;
+  for (int i = 0; i < node_count; i++)
+  {
+    new_index[i] = drop[i] ? -1 : kept;
+    if (!drop[i])
+    {
+      nodes[kept] = nodes[i];
+      nodes[kept].label = 'A' + kept;
+      kept++;
+    }
+  }
+  node_count = kept;
+  kept = 0;
+  for (int i = 0; i < edge_count; i++)
+  {
+    int u = new_index[edges[i].src], v = new_index[edges[i].dest];
+    if (u == -1 || v == -1)
+      continue;
+    edges[kept++] = (Edge){u, v, edges[i].weight};
+  }
+  edge_count = kept;
+  graph_touch();
+}
+
+/**
+ * @brief Changes the weight of an edge.
+ *
+ * @param edge_index Index of the edge
+ * @param weight New weight
+ */
+void graph_set_weight(int edge_index, float weight)
+{
+  edges[edge_index].weight = weight;
+  graph_version++;
+}
+
+/**
+ * @brief Removes every node and edge from the graph.
+ */
+void graph_clear()
+{
+  node_count = 0;
+  edge_count = 0;
+  graph_touch();
+}
+
+/**
+ * @brief Stable LSD radix sort of edges by endpoint pair.
+ *
+ * The key is src followed by dest, each id_bits wide, sorted 11 bits per
+ * pass, so a graph with up to 2^20 nodes needs four passes.
+ *
+ * @tparam T Edge, or any record with src and dest fields
+ * @param a Edges to sort
+ * @param tmp Scratch space of the same size
+ * @param n Number of edges
+ * @param id_bits Bits needed to store a node index
+ */
+template <typename T>
+static void radix_sort_edges(T *a, T *tmp, int n, int id_bits)
+{
+  const int digit_bits = 11;
+  const int buckets = 1 << digit_bits;
+  std::vector<int> count(buckets + 1);
+  T *src = a, *dst = tmp;
+  for (int shift = 0; shift < 2 * id_bits; shift += digit_bits)
+  {
+    auto digit = [&](const T &e)
+    {
+      uint64_t key = ((uint64_t)e.src << id_bits) | (uint64_t)e.dest;
+      return (int)((key >> shift) & (buckets - 1));
+    };
+    std::fill(count.begin(), count.end(), 0);
+    for (int i = 0; i < n; i++)
+      count[digit(src[i]) + 1]++;
+    for (int b = 0; b < buckets; b++)
+      count[b + 1] += count[b];
+    for (int i = 0; i < n; i++)
+      dst[count[digit(src[i])]++] = src[i];
+    std::swap(src, dst);
+  }
+  if (src != a)
+    memcpy(a, src, (size_t)n * sizeof(T));
+}
+
+/**
+ * @brief Sorts edges by endpoint pair on all cores, keeping equal pairs in
+ * their original order.
+ *
+ * Contiguous blocks are radix-sorted in parallel and then merged pairwise,
+ * left block first, which preserves stability across blocks.
+ *
+ * @tparam T Edge, or any record with src and dest fields
+ * @param list Edges to sort, with src <= dest
+ */
+template <typename T>
+static void parallel_sort_edges(std::vector<T> &list)
+{
+  auto less = [](const T &a, const T &b)
+  { return a.src < b.src || (a.src == b.src && a.dest < b.dest); };
+  int n = (int)list.size();
+  int id_bits = 1;
+  while (id_bits < 31 && (1 << id_bits) < node_count)
+    id_bits++;
+  int blocks = parallel_threads();
+  if (blocks > n / 4096)
+    blocks = n / 4096 > 1 ? n / 4096 : 1;
+  std::vector<int> bound(blocks + 1);
+  for (int b = 0; b <= blocks; b++)
+    bound[b] = (int)((long long)n * b / blocks);
+
+  std::vector<T> scratch(n);
+  parallel_for(blocks, [&](int b)
+               {
+                 radix_sort_edges(list.data() + bound[b], scratch.data() + bound[b],
+                                  bound[b + 1] - bound[b], id_bits);
+               });
+  for (int width = 1; width < blocks; width *= 2)
+  {
+    int pairs = (blocks + 2 * width - 1) / (2 * width);
+    parallel_for(pairs, [&](int p)
+                 {
+                   int lo = bound[2 * p * width];
+                   int mid = bound[std::min(blocks, (2 * p + 1) * width)];
+                   int hi = bound[std::min(blocks, (2 * p + 2) * width)];
+                   std::merge(list.begin() + lo, list.begin() + mid, list.begin() + mid,
+                              list.begin() + hi, scratch.begin() + lo, less);
+                 });
+    list.swap(scratch);
+  }
+}
+
+/**
+ * @brief Bulk-loads a buffer of edges into the graph.
+ *
+ * The existing edges and the buffer are put in canonical (src <= dest) form
+ * and sorted in parallel. Chunks of the sorted array, aligned to runs of
+ * equal endpoint pairs, are then deduplicated in parallel: self loops are
+ * dropped and each run collapses to one edge whose weight follows the policy
+ * (buffer order decides first/last). The compacted result replaces the edge
+ * array and the adjacency and lookup are rebuilt from it in one go, so edge
+ * indices are not preserved across this call.
+ *
+ * @param list Edges to add
+ * @param count Number of edges in list
+ * @param policy DEDUP_* policy for duplicate edges
+ * @return Number of edges in the graph afterwards
+ */
+int graph_add_edges(const Edge *list, int count, int policy)
+{
+  int total = edge_count + count;
+  std::vector<Edge> sorted(total);
+  parallel_for(64, [&](int c)
+               {
+                 int lo = (int)((long long)total * c / 64);
+                 int hi = (int)((long long)total * (c + 1) / 64);
+                 for (int i = lo; i < hi; i++)
+                 {
+                   Edge e = i < edge_count ? edges[i] : list[i - edge_count];
+                   if (e.src > e.dest)
+                     std::swap(e.src, e.dest);
+                   sorted[i] = e;
+                 }
+               });
+  parallel_sort_edges(sorted);
+
+  // Align chunk starts to the beginning of a run of equal pairs
+  int chunks = total >= 65536 ? 64 : 1;
+  std::vector<int> start(chunks + 1), kept(chunks + 1, 0);
+  for (int c = 0; c <= chunks; c++)
+  {
+    int i = (int)((long long)total * c / chunks);
+    while (i > 0 && i < total && sorted[i].src == sorted[i - 1].src &&
+           sorted[i].dest == sorted[i - 1].dest)
+      i++;
+    start[c] = i;
+  }
+  parallel_for(chunks, [&](int c)
+               {
+                 int out = start[c];
+                 for (int i = start[c]; i < start[c + 1];)
+                 {
+                   int j = i + 1;
+                   float w = sorted[i].weight;
+                   while (j < start[c + 1] && sorted[j].src == sorted[i].src &&
+                          sorted[j].dest == sorted[i].dest)
+                   {
+                     float x = sorted[j].weight;
+                     if (policy == DEDUP_MIN)
+                       w = std::min(w, x);
+                     else if (policy == DEDUP_MAX)
+                       w = std::max(w, x);
+                     else if (policy == DEDUP_LAST)
+                       w = x;
+                     else if (policy == DEDUP_SUM)
+                       w += x;
+                     j++;
+                   }
+                   if (sorted[i].src != sorted[i].dest)
+                   {
+                     sorted[out] = sorted[i];
+                     sorted[out].weight = w;
+                     out++;
+                   }
+                   i = j;
+                 }
+                 kept[c + 1] = out - start[c];
+               });
+  for (int c = 0; c < chunks; c++)
+    kept[c + 1] += kept[c];
+
+  graph_reserve(0, kept[chunks]);
+  parallel_for(chunks, [&](int c)
+               {
+                 memcpy(edges + kept[c], sorted.data() + start[c],
+                        (size_t)(kept[c + 1] - kept[c]) * sizeof(Edge));
+               });
+  edge_count = kept[chunks];
+  graph_touch();
+  graph_adjacency();
+  return edge_count;
+}
+
+// An edge by its index, for sorting the edge order rather than the edges
+typedef struct
+{
+  int src, dest;
+  int index;
+} EdgeRef;
+
+/**
+ * @brief Renumbers the nodes and reorders the edges to match.
+ *
+ * Nodes keep their label and external id. Edges are sorted by their new
+ * (src, dest) so that a pass over edges[] walks nodes[] roughly in order,
+ * and their direction is left as it was. The sort is stable, so permuting
+ * the same graph again gives the same edge order.
+ *
+ * @param order Old index of the node that ends up at each new index; a
+ * permutation of [0, node_count)
+ * @param edge_order Receives the old index of the edge at each new index,
+ * edge_count entries; may be NULL
+ */
+void graph_permute(const int *order, int *edge_order)
+{
+  std::vector<int> new_index(node_count);
+  std::vector<Node> moved(node_count);
+  for (int i = 0; i < node_count; i++)
+  {
+    new_index[order[i]] = i;
+    moved[i] = nodes[order[i]];
+  }
+  memcpy(nodes, moved.data(), (size_t)node_count * sizeof(Node));
+
+  std::vector<EdgeRef> refs(edge_count);
+  for (int e = 0; e < edge_count; e++)
+    refs[e] = {new_index[edges[e].src], new_index[edges[e].dest], e};
+  parallel_sort_edges(refs);
+  std::vector<Edge> list(edge_count);
+  for (int e = 0; e < edge_count; e++)
+  {
+    list[e] = {refs[e].src, refs[e].dest, edges[refs[e].index].weight};
+    if (edge_order)
+      edge_order[e] = refs[e].index;
+  }
+  memcpy(edges, list.data(), (size_t)edge_count * sizeof(Edge));
+  graph_touch();
+}
+
+/**
+ * @brief Undoes graph_permute(), restoring the node and edge order from
+ *        before it.
+ *
+ * @param order Node order that was passed to graph_permute()
+ * @param edge_order Edge order it returned
+ */
+void graph_unpermute(const int *order, const int *edge_order)
+{
+  std::vector<Node> moved(node_count);
+  for (int i = 0; i < node_count; i++)
+    moved[order[i]] = nodes[i];
+  memcpy(nodes, moved.data(), (size_t)node_count * sizeof(Node));
+
+  std::vector<Edge> list(edge_count);
+  for (int e = 0; e < edge_count; e++)
+    list[edge_order[e]] = {order[edges[e].src], order[edges[e].dest], edges[e].weight};
+  memcpy(edges, list.data(), (size_t)edge_count * sizeof(Edge));
+  graph_touch();
+}
+
+/**
+ * @brief Rebuilds the endpoint-pair lookup from the edge array.
+ */
+static void rebuild_edge_lookup()
+{
+  edge_lookup.clear();
+  edge_lookup.reserve(edge_count);
+  for (int i = 0; i < edge_count; i++)
+    edge_lookup.emplace(edge_key(edges[i].src, edges[i].dest), i);
+  edge_lookup_valid = true;
+}
+
+/**
+ * @brief Finds the edge joining two nodes in either direction.
+ *
+ * @param u One endpoint
+ * @param v Other endpoint
+ * @return Index of the first such edge, or -1
+ */
+int graph_find_edge(int u, int v)
+{
+  if (!edge_lookup_valid)
+    rebuild_edge_lookup();
+  auto it = edge_lookup.find(edge_key(u, v));
+  return it == edge_lookup.end() ? -1 : it->second;
+}
+
+/**
+ * @brief Checks whether two nodes are joined by an edge.
+ *
+ * @param u One endpoint
+ * @param v Other endpoint
+ * @return true if an edge joins u and v
+ */
+bool has_edge(int u, int v) { return graph_find_edge(u, v) != -1; }
+
+/**
+ * @brief Finds a node by its external id.
+ *
+ * @param id External id
+ * @return Current index of the node, or -1 if no node has that id
+ */
+int graph_node_index(int id)
+{
+  if (!node_lookup_valid)
+    rebuild_node_lookup();
+  auto it = node_lookup.find(id);
+  return it == node_lookup.end() ? -1 : it->second;
+}
+
+/**
+ * @brief Returns the adjacency of the current graph.
+ *
+ * The CSR arrays are rebuilt from the edge array whenever graph_version has
+ * moved on since the last call: one counting pass over the edges sizes every
+ * neighbor list and a second pass scatters both directions of each edge.
+ * Callers may keep the returned snapshot; it is never modified afterwards.
+ *
+ * @return Adjacency snapshot
+ */
+std::shared_ptr<const Adjacency> graph_adjacency()
+{
+  if (adjacency && adjacency_version == graph_version &&
+      adjacency->node_count == node_count)
+    return adjacency;
+
+  std::shared_ptr<Adjacency> adj = std::make_shared<Adjacency>();
+  adj->node_count = node_count;
+  adj->offsets.assign(node_count + 1, 0);
+  for (int i = 0; i < edge_count; i++)
+  {
+    adj->offsets[edges[i].src + 1]++;
+    adj->offsets[edges[i].dest + 1]++;
+  }
+  for (int u = 0; u < node_count; u++)
+    adj->offsets[u + 1] += adj->offsets[u];
+
+  size_t entries = (size_t)adj->offsets[node_count];
+  adj->targets.resize(entries);
+  adj->weights.resize(entries);
+  adj->edge_ids.resize(entries);
+  std::vector<int> fill(adj->offsets.begin(), adj->offsets.end() - 1);
+  for (int i = 0; i < edge_count; i++)
+  {
+    int u = edges[i].src, v = edges[i].dest;
+    int a = fill[u]++, b = fill[v]++;
+    adj->targets[a] = v;
+    adj->weights[a] = edges[i].weight;
+    adj->edge_ids[a] = i;
+    adj->targets[b] = u;
+    adj->weights[b] = edges[i].weight;
+    adj->edge_ids[b] = i;
+  }
+
+  adjacency = adj;
+  adjacency_version = graph_version;
+  return adjacency;
+}
@@ -0,0 +1,321 @@
+/**
+ * @file history.cpp
+ * @brief Command journal backing undo and redo.
+ *
+ * The journal stores one Command per edit. A command keeps the inverse data
+ * of the edit (the removed node and its incident edges, the previous weight,
+ * the cleared arrays, the order a renumbering applied) instead of a copy of
+ * the graph, and since undo and redo are strictly LIFO, the indices recorded
+ * in a command are always valid when it is replayed. A replacement keeps
+ * only the version of the graph that is not current, swapping it in and out.
+ */
+
+#include "history.h"
+#include "graph.h"
+
+#include <string.h>
+#include <vector>
+
+#define CMD_ADD_NODE 1
+#define CMD_ADD_EDGE 2
+#define CMD_EDIT_WEIGHT 3
+#define CMD_DELETE_NODE 4
+#define CMD_CLEAR 5
+#define CMD_REPLACE 6
+#define CMD_PERMUTE 7
+
+typedef struct
+{
+  int type;
+  int index;        // node or edge index the command touched
+  Node node;        // CMD_ADD_NODE, CMD_DELETE_NODE
+  Edge edge;        // CMD_ADD_EDGE
+  float old_weight; // CMD_EDIT_WEIGHT
+  float new_weight;
+  std::vector<int> edge_indices; // CMD_DELETE_NODE: original edge positions
+  std::vector<Node> saved_nodes; // CMD_CLEAR; CMD_REPLACE: the graph not shown
+  std::vector<Edge> saved_edges; // CMD_DELETE_NODE, CMD_CLEAR, CMD_REPLACE
+  std::vector<int> order;        // CMD_PERMUTE: node order, as for graph_permute()
+  std::vector<int> edge_order;   // CMD_PERMUTE: the edge order it returned
+} Command;
+
+/**
+ * @brief Overwrites the graph with the given arrays.
+ *
+ * @param list_nodes Nodes to copy in
+ * @param list_edges Edges to copy in
+ */
+static void restore(const std::vector<Node> &list_nodes,
+                    const std::vector<Edge> &list_edges)
+{
+  graph_reserve((int)list_nodes.size(), (int)list_edges.size());
+  memcpy(nodes, list_nodes.data(), list_nodes.size() * sizeof(Node));
+  memcpy(edges, list_edges.data(), list_edges.size() * sizeof(Edge));
+  node_count = (int)list_nodes.size();
+  edge_count = (int)list_edges.size();
+  graph_touch();
+}
+
+/**
+ * @brief Exchanges the graph with the copy kept in a command.
+ *
+ * @param cmd CMD_REPLACE command; receives the graph that was current
+ */
+static void swap_graph(Command &cmd)
+{
+  std::vector<Node> current_nodes(nodes, nodes + node_count);
+  std::vector<Edge> current_edges(edges, edges + edge_count);
+  restore(cmd.saved_nodes, cmd.saved_edges);
+  cmd.saved_nodes.swap(current_nodes);
+  cmd.saved_edges.swap(current_edges);
+}
+
+static std::vector<Command> undo_stack;
+static std::vector<Command> redo_stack;
+
+/**
+ * @brief Applies a recorded command to the graph store.
+ *
+ * @param cmd Command to apply
+ */
+static void apply(Command &cmd)
+{
+  switch (cmd.type)
+  {
+  case CMD_ADD_NODE:
+    graph_insert_node(cmd.index, cmd.node);
+    break;
+  case CMD_ADD_EDGE:
+    add_edge(cmd.edge.src, cmd.edge.dest, cmd.edge.weight);
+    break;
+  case CMD_EDIT_WEIGHT:
+    graph_set_weight(cmd.index, cmd.new_weight);
+    break;
+  case CMD_DELETE_NODE:
+    delete_node(cmd.index);
+    break;
+  case CMD_CLEAR:
+    graph_clear();
+    break;
+  case CMD_REPLACE:
+    swap_graph(cmd);
+    break;
+  case CMD_PERMUTE:
+    graph_permute(cmd.order.data(), NULL);
+    break;
+  }
+}
+
+/**
+ * @brief Applies the inverse of a recorded command to the graph store.
+ *
+ * @param cmd Command to revert
+ */
+static void revert(Command &cmd)
+{
+  switch (cmd.type)
+  {
+  case CMD_ADD_NODE:
+    delete_node(cmd.index);
+    break;
+  case CMD_ADD_EDGE:
+    graph_remove_edge(edge_count - 1);
+    break;
+  case CMD_EDIT_WEIGHT:
+    graph_set_weight(cmd.index, cmd.old_weight);
+    break;
+  case CMD_DELETE_NODE:
+    graph_insert_node(cmd.index, cmd.node);
+    graph_insert_edges(cmd.edge_indices.data(), cmd.saved_edges.data(),
+                       (int)cmd.saved_edges.size());
+    break;
+  case CMD_CLEAR:
+    restore(cmd.saved_nodes, cmd.saved_edges);
+    break;
+  case CMD_REPLACE:
+    swap_graph(cmd);
+    break;
+  case CMD_PERMUTE:
+    graph_unpermute(cmd.order.data(), cmd.edge_order.data());
+    break;
+  }
+}
+
+/**
+ * @brief Pushes an executed command onto the undo stack.
+ *
+ * A new edit invalidates everything that was undone before it.
+ *
+ * @param cmd Command to record
+ */
+static void record(Command &cmd)
+{
+  undo_stack.push_back(std::move(cmd));
+  redo_stack.clear();
+}
+
+/**
+ * @brief Adds a node and records it in the journal.
+ *
+ * @param x X-coordinate
+ * @param y Y-coordinate
+ * @return Index of the new node
+ */
+int history_add_node(float x, float y)
+{
+  int index = graph_add_node(x, y);
+  Command cmd = {};
+  cmd.type = CMD_ADD_NODE;
+  cmd.index = index;
+  cmd.node = nodes[index];
+  record(cmd);
+  return index;
+}
+
+/**
+ * @brief Adds an edge and records it in the journal.
+ *
+ * @param src Source node index
+ * @param dest Destination node index
+ * @param weight Weight of the edge
+ */
+void history_add_edge(int src, int dest, float weight)
+{
+  Command cmd = {};
+  cmd.type = CMD_ADD_EDGE;
+  cmd.index = add_edge(src, dest, weight);
+  cmd.edge = edges[cmd.index];
+  record(cmd);
+}
+
+/**
+ * @brief Changes an edge weight and records the previous value.
+ *
+ * @param edge_index Index of the edge
+ * @param weight New weight
+ */
+void history_set_weight(int edge_index, float weight)
+{
+  Command cmd = {};
+  cmd.type = CMD_EDIT_WEIGHT;
+  cmd.index = edge_index;
+  cmd.old_weight = edges[edge_index].weight;
+  cmd.new_weight = weight;
+  graph_set_weight(edge_index, weight);
+  record(cmd);
+}
+
+/**
+ * @brief Deletes a node and records it together with its incident edges.
+ *
+ * @param node_index Index of the node to delete
+ */
+void history_delete_node(int node_index)
+{
+  Command cmd = {};
+  cmd.type = CMD_DELETE_NODE;
+  cmd.index = node_index;
+  cmd.node = nodes[node_index];
+  for (int i = 0; i < edge_count; i++)
+  {
+    if (edges[i].src == node_index || edges[i].dest == node_index)
+    {
+      cmd.edge_indices.push_back(i);
+      cmd.saved_edges.push_back(edges[i]);
+    }
+  }
+  delete_node(node_index);
+  record(cmd);
+}
+
+/**
+ * @brief Clears the graph and keeps its contents for undo.
+ */
+void history_clear()
+{
+  if (node_count == 0 && edge_count == 0)
+    return;
+  Command cmd = {};
+  cmd.type = CMD_CLEAR;
+  cmd.saved_nodes.assign(nodes, nodes + node_count);
+  cmd.saved_edges.assign(edges, edges + edge_count);
+  graph_clear();
+  record(cmd);
+}
+
+/**
+ * @brief Replaces the whole graph and keeps the previous one for undo.
+ *
+ * Undo and redo swap the kept copy with the graph, so the command holds one
+ * graph whichever way it was last replayed.
+ *
+ * @param fill Function that builds the new graph in the graph store
+ */
+void history_replace(const std::function<void()> &fill)
+{
+  Command cmd = {};
+  cmd.type = CMD_REPLACE;
+  cmd.saved_nodes.assign(nodes, nodes + node_count);
+  cmd.saved_edges.assign(edges, edges + edge_count);
+  fill();
+  record(cmd);
+}
+
+/**
+ * @brief Renumbers the nodes with graph_permute() and records the node and
+ *        edge orders, one int per node and edge, to invert it on undo.
+ *
+ * @param order Old index of the node that ends up at each new index
+ */
+void history_permute(const int *order)
+{
+  Command cmd = {};
+  cmd.type = CMD_PERMUTE;
+  cmd.order.assign(order, order + node_count);
+  cmd.edge_order.resize(edge_count);
+  graph_permute(order, cmd.edge_order.data());
+  record(cmd);
+}
+
+/**
+ * @brief Drops the undo and redo stacks.
+ *
+ * Commands refer to nodes and edges by index, so once something else has
+ * changed the graph, such as an edge event feed, none of them can be
+ * replayed safely.
+ */
+void history_forget()
+{
+  undo_stack.clear();
+  redo_stack.clear();
+}
+
+/**
+ * @brief Reverts the most recent edit.
+ *
+ * @return true if an edit was undone
+ */
+bool history_undo()
+{
+  if (undo_stack.empty())
+    return false;
+  revert(undo_stack.back());
+  redo_stack.push_back(std::move(undo_stack.back()));
+  undo_stack.pop_back();
+  return true;
+}
+
+/**
+ * @brief Re-applies the most recently undone edit.
+ *
+ * @return true if an edit was redone
+ */
+bool history_redo()
+{
+  if (redo_stack.empty())
+    return false;
+  apply(redo_stack.back());
+  undo_stack.push_back(std::move(redo_stack.back()));
+  redo_stack.pop_back();
+  return true;
+}
@@ -0,0 +1,540 @@
+/**
+ * @file ingest.cpp
+ * @brief Edge event feed: a reader thread that parses events and a
+ *        per-frame batch that applies them.
+ *
+ * The reader fills a queue in large reads and parses whole lines straight
+ * out of the read buffer into fixed-size records. The GLUT thread swaps the
+ * queue out under the lock once it has used up the previous one, so the
+ * reader is only held up when the queue is full. Applying goes through the
+ * O(1) graph primitives. A deleted node gives up its id at once, so that
+ * later events of the batch may bring the id back as a new node, and the
+ * one pass that renumbers nodes runs at the end of the batch.
+ */
+
+#include "ingest.h"
+#include "history.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <errno.h>
+#include <fcntl.h>
+#include <math.h>
+#include <mutex>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <thread>
+#include <unistd.h>
+
+#define INGEST_READ_BYTES 1048576 // read buffer; also the longest line
+#define INGEST_FOLLOW_MS 50       // wait before polling a followed file again
+#define INGEST_PACE_SLICES 100    // paced reading queues rate / this per slice
+#define INGEST_JITTER 0.05f       // new nodes land this far from their neighbor
+
+// A parsed event
+typedef struct
+{
+  char op; // 'a', 'r', 'w' or 'd'
+  int a, b;
+  float weight;
+} Event;
+
+// Allocated once and never destroyed, like the IPC server
+typedef struct
+{
+  int fd;
+  bool follow;
+  double rate;
+  std::mutex lock; // guards pending
+  std::condition_variable arrived; // events were queued or the input ended
+  std::condition_variable drained; // the GLUT thread took the queue
+  std::vector<Event> pending;      // parsed, not yet taken
+  std::vector<Event> batch;        // taken; GLUT thread only
+  size_t next;                     // first event of batch not applied
+
+  std::atomic<unsigned long long> parsed, malformed;
+  std::atomic<bool> reading;
+  unsigned long long applied, batches; // GLUT thread only
+  int largest_batch;
+  uint64_t seed; // placement of new nodes
+} Feed;
+
+static Feed *feed = NULL;
+
+/**
+ * @brief Reads a non-negative node id.
+ *
+ * @param p Cursor, moved past the id and the blanks before it
+ * @param end End of the line
+ * @param out Receives the id
+ * @return false if no id in int range follows
+ */
+static bool parse_id(const char **p, const char *end, int *out)
+{
+  const char *s = *p;
+  while (s < end && (*s == ' ' || *s == '\t'))
+    s++;
+  long long v = 0;
+  const char *digits = s;
+  while (s < end && *s >= '0' && *s <= '9' && v <= INT32_MAX)
+    v = v * 10 + (*s++ - '0');
+  if (s == digits || v > INT32_MAX)
+    return false;
+  *p = s;
+  *out = (int)v;
+  return true;
+}
+
+/**
+ * @brief Reads a positive finite weight.
+ *
+ * @param p Cursor, moved past the weight and the blanks before it
+ * @param end End of the line
+ * @param out Receives the weight
+ * @return false if no valid weight follows
+ */
+static bool parse_weight(const char **p, const char *end, float *out)
+{
+  const char *s = *p;
+  while (s < end && (*s == ' ' || *s == '\t'))
+    s++;
+  char token[32];
+  size_t n = 0;
+  while (s + n < end && s[n] != ' ' && s[n] != '\t' && n < sizeof(token) - 1)
+  {
+    token[n] = s[n];
+    n++;
+  }
+  token[n] = '\0';
+  char *stop;
+  float w = strtof(token, &stop);
+  if (n == 0 || *stop != '\0' || !(w > 0) || !isfinite(w))
+    return false;
+  *p = s + n;
+  *out = w;
+  return true;
+}
+
+/**
+ * @brief Parses one line into an event.
+ *
+ * @param line Start of the line, without its newline
+ * @param end End of the line
+ * @param out Receives the event
+ * @return 1 for an event, 0 for a blank or comment line, -1 if malformed
+ */
+static int parse_line(const char *line, const char *end, Event *out)
+{
+  while (line < end && (*line == ' ' || *line == '\t' || *line == '\r'))
+    line++;
+  while (end > line && (end[-1] == ' ' || end[-1] == '\t' || end[-1] == '\r'))
+    end--;
+  if (line == end || *line == '#' || *line == '%')
+    return 0;
+  // A line of a plain edge list, "SRC DEST [WEIGHT]", adds the edge
+  Event e = {'a', -1, -1, 1.0f};
+  if (*line < '0' || *line > '9')
+    e.op = *line++;
+  bool ok;
+  if (e.op == 'd')
+    ok = parse_id(&line, end, &e.a);
+  else if (e.op == 'a' || e.op == 'r' || e.op == 'w')
+  {
+    ok = parse_id(&line, end, &e.a) && parse_id(&line, end, &e.b) && e.a != e.b;
+    if (ok && (e.op == 'w' || (e.op == 'a' && line < end)))
+      ok = parse_weight(&line, end, &e.weight);
+  }
+  else
+    ok = false;
+  if (!ok || line != end)
+    return -1;
+  *out = e;
+  return 1;
+}
+
+/**
+ * @brief Hands parsed events to the GLUT thread, waiting while the queue is
+ *        full.
+ *
+ * @param list Events to queue; emptied
+ */
+static void enqueue(std::vector<Event> &list)
+{
+  if (list.empty())
+    return;
+  {
+    std::unique_lock<std::mutex> guard(feed->lock);
+    feed->drained.wait(guard, []
+                       { return feed->pending.size() < INGEST_MAX_QUEUED; });
+    feed->pending.insert(feed->pending.end(), list.begin(), list.end());
+  }
+  feed->arrived.notify_all();
+  list.clear();
+}
+
+/**
+ * @brief Queues parsed events, paced to the configured rate if there is one.
+ *
+ * @param list Events to queue; emptied
+ * @param start When reading started
+ * @param sent Events queued so far; advanced
+ */
+static void release(std::vector<Event> &list, std::chrono::steady_clock::time_point start,
+                    unsigned long long *sent)
+{
+  if (feed->rate <= 0)
+  {
+    *sent += list.size();
+    enqueue(list);
+    return;
+  }
+  size_t slice = std::max<size_t>(1, (size_t)(feed->rate / INGEST_PACE_SLICES));
+  std::vector<Event> part;
+  for (size_t at = 0; at < list.size(); at += slice)
+  {
+    size_t stop = std::min(list.size(), at + slice);
+    std::this_thread::sleep_until(start + std::chrono::duration<double>(*sent / feed->rate));
+    part.assign(list.begin() + at, list.begin() + stop);
+    *sent += part.size();
+    enqueue(part);
+  }
+  list.clear();
+}
+
+/**
+ * @brief Reader thread: parses the input until it ends.
+ *
+ * Lines are parsed in place from the read buffer; a line cut off by the end
+ * of a read is moved to the front of the buffer and completed by the next.
+ */
+static void read_events()
+{
+  std::vector<char> buffer(INGEST_READ_BYTES);
+  std::vector<Event> parsed;
+  size_t held = 0; // bytes of an unfinished line at the front of buffer
+  unsigned long long sent = 0;
+  auto start = std::chrono::steady_clock::now();
+  auto parse = [&](const char *line, const char *end)
+  {
+    Event e;
+    int kind = parse_line(line, end, &e);
+    if (kind == 1)
+      parsed.push_back(e);
+    else if (kind == -1)
+      feed->malformed++;
+  };
+  for (;;)
+  {
+    ssize_t got = read(feed->fd, buffer.data() + held, buffer.size() - held);
+    if (got < 0 && errno == EINTR)
+      continue;
+    if (got == 0 && feed->follow)
+    {
+      std::this_thread::sleep_for(std::chrono::milliseconds(INGEST_FOLLOW_MS));
+      continue;
+    }
+    if (got <= 0)
+    {
+      if (got < 0)
+        perror("ingest read");
+      break;
+    }
+    const char *line = buffer.data();
+    const char *end = buffer.data() + held + got;
+    for (const char *nl; (nl = (const char *)memchr(line, '\n', end - line)) != NULL; line = nl + 1)
+      parse(line, nl);
+    held = end - line;
+    if (held == buffer.size())
+    {
+      feed->malformed++; // a line longer than the buffer
+      held = 0;
+    }
+    memmove(buffer.data(), line, held);
+    feed->parsed += parsed.size();
+    release(parsed, start, &sent);
+  }
+  parse(buffer.data(), buffer.data() + held);
+  feed->parsed += parsed.size();
+  release(parsed, start, &sent);
+  {
+    std::lock_guard<std::mutex> guard(feed->lock);
+    feed->reading = false;
+  }
+  feed->arrived.notify_all();
+}
+
+/**
+ * @brief Opens the input and starts the reader thread.
+ *
+ * @param path File or pipe to read, or "-" for standard input
+ * @param follow Keep reading a regular file past its end
+ * @param rate Events per second to read at, or 0 for as fast as possible
+ * @return false if the input cannot be opened
+ */
+bool ingest_start(const char *path, bool follow, double rate)
+{
+  int fd = strcmp(path, "-") == 0 ? STDIN_FILENO : open(path, O_RDONLY);
+  if (fd < 0)
+  {
+    perror(path);
+    return false;
+  }
+  struct stat st;
+  feed = new Feed();
+  feed->fd = fd;
+  feed->follow = follow && fstat(fd, &st) == 0 && S_ISREG(st.st_mode);
+  feed->rate = rate;
+  feed->next = 0;
+  feed->parsed = 0;
+  feed->malformed = 0;
+  feed->reading = true;
+  feed->applied = feed->batches = 0;
+  feed->largest_batch = 0;
+  feed->seed = 0x9e3779b97f4a7c15ull;
+  std::thread(read_events).detach();
+  return true;
+}
+
+/**
+ * @brief Returns a uniform random number in [0, 1) from the feed's
+ *        placement generator (splitmix64).
+ *
+ * @return Random number
+ */
+static float next_unit()
+{
+  uint64_t z = (feed->seed += 0x9e3779b97f4a7c15ull);
+  z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ull;
+  z = (z ^ (z >> 27)) * 0x94d049bb133111ebull;
+  z ^= z >> 31;
+  return (z >> 40) * (1.0f / (1 << 24));
+}
+
+// State of the batch being applied
+typedef struct
+{
+  float x0, y0, x1, y1;           // placement box of unconnected new nodes
+  std::vector<unsigned char> drop; // nodes deleted by the batch, by index
+  bool dropping;                   // drop has a node marked
+  std::shared_ptr<const Adjacency> adj; // neighbors of deleted nodes
+  IngestBatch *out;
+} Apply;
+
+/**
+ * @brief Deletes the nodes marked by the batch.
+ *
+ * @param state Batch being applied
+ */
+static void flush_deletions(Apply *state)
+{
+  if (!state->dropping)
+    return;
+  state->drop.resize(node_count, 0);
+  graph_remove_nodes(state->drop.data());
+}
+
+/**
+ * @brief Finds or creates the endpoint of an added edge.
+ *
+ * A new node is placed around its other endpoint, if that exists, so that
+ * the local relayout starts close to its final position.
+ *
+ * @param state Batch being applied
+ * @param id External id
+ * @param other Index of the other endpoint, or -1
+ * @return Index of the node
+ */
+static int endpoint(Apply *state, int id, int other)
+{
+  int i = graph_node_index(id);
+  if (i != -1)
+    return i;
+  float x, y;
+  if (other != -1)
+  {
+    x = nodes[other].x + (2 * next_unit() - 1) * INGEST_JITTER;
+    y = nodes[other].y + (2 * next_unit() - 1) * INGEST_JITTER;
+    x = std::min(std::max(x, state->x0), state->x1);
+    y = std::min(std::max(y, state->y0), state->y1);
+  }
+  else
+  {
+    x = state->x0 + next_unit() * (state->x1 - state->x0);
+    y = state->y0 + next_unit() * (state->y1 - state->y0);
+  }
+  return graph_add_node_with_id(x, y, id);
+}
+
+/**
+ * @brief Applies one event to the graph store.
+ *
+ * @param state Batch being applied
+ * @param e Event
+ */
+static void apply_event(Apply *state, const Event &e)
+{
+  IngestBatch *out = state->out;
+  if (e.op == 'd')
+  {
+    int i = graph_node_index(e.a);
+    if (i == -1)
+      return;
+    if (!state->adj)
+      state->adj = graph_adjacency();
+    const Adjacency &adj = *state->adj;
+    if (i < adj.node_count)
+    {
+      for (int k = adj.offsets[i]; k < adj.offsets[i + 1]; k++)
+        out->touched.push_back(nodes[adj.targets[k]].id);
+    }
+    if ((int)state->drop.size() <= i)
+      state->drop.resize(node_count, 0);
+    state->drop[i] = 1;
+    state->dropping = true;
+    graph_release_node_id(i); // the id may come back later in the batch
+    out->deleted.push_back(e.a);
+    out->cheaper_only = false;
+    return;
+  }
+
+  if (e.op == 'a')
+  {
+    int u = graph_node_index(e.a);
+    int v = endpoint(state, e.b, u);
+    u = endpoint(state, e.a, v);
+    int k = graph_find_edge(u, v);
+    if (k == -1)
+      add_edge(u, v, e.weight);
+    else if (edges[k].weight != e.weight)
+    {
+      if (e.weight > edges[k].weight)
+        out->cheaper_only = false;
+      graph_set_weight(k, e.weight);
+    }
+    else
+      return;
+  }
+  else
+  {
+    int u = graph_node_index(e.a), v = graph_node_index(e.b);
+    int k = u == -1 || v == -1 ? -1 : graph_find_edge(u, v);
+    if (k == -1)
+      return;
+    if (e.op == 'r')
+    {
+      out->changed.push_back((Edge){e.a, e.b, edges[k].weight});
+      out->touched.push_back(e.a);
+      out->touched.push_back(e.b);
+      out->cheaper_only = false;
+      graph_remove_edge_unordered(k);
+      return;
+    }
+    if (edges[k].weight == e.weight)
+      return;
+    if (e.weight > edges[k].weight)
+      out->cheaper_only = false;
+    graph_set_weight(k, e.weight);
+  }
+  out->changed.push_back((Edge){e.a, e.b, e.weight});
+  out->touched.push_back(e.a);
+  out->touched.push_back(e.b);
+}
+
+/**
+ * @brief Applies the events that arrived since the last frame as one batch.
+ *
+ * Events apply in arrival order. A batch that changed anything drops the
+ * undo history, whose commands refer to indices the feed has moved.
+ *
+ * @param x0 Left edge of the box new unconnected nodes are placed in
+ * @param y0 Bottom edge of the box
+ * @param x1 Right edge of the box
+ * @param y1 Top edge of the box
+ * @param limit Most events to apply; the rest wait for the next call
+ * @param batch Receives what the batch changed
+ * @return true if events were applied
+ */
+bool ingest_poll(float x0, float y0, float x1, float y1, int limit, IngestBatch *batch)
+{
+  batch->events = 0;
+  batch->touched.clear();
+  batch->changed.clear();
+  batch->deleted.clear();
+  batch->cheaper_only = true;
+  if (!feed)
+    return false;
+  if (feed->next == feed->batch.size())
+  {
+    feed->batch.clear();
+    feed->next = 0;
+    {
+      std::lock_guard<std::mutex> guard(feed->lock);
+      feed->batch.swap(feed->pending);
+    }
+    feed->drained.notify_all();
+  }
+  size_t end = std::min(feed->batch.size(), feed->next + limit);
+  if (feed->next == end)
+    return false;
+
+  Apply state = {x0, y0, x1, y1, {}, false, NULL, batch};
+  unsigned int version = graph_version;
+  for (size_t i = feed->next; i < end; i++)
+    apply_event(&state, feed->batch[i]);
+  flush_deletions(&state);
+  batch->events = (int)(end - feed->next);
+  feed->next = end;
+
+  if (graph_version != version)
+    history_forget();
+  feed->applied += batch->events;
+  feed->batches++;
+  feed->largest_batch = std::max(feed->largest_batch, batch->events);
+  return true;
+}
+
+/**
+ * @brief Waits until events arrive or the input ends.
+ *
+ * @param timeout_ms Longest wait in milliseconds
+ * @return true if events are queued
+ */
+bool ingest_wait(int timeout_ms)
+{
+  if (!feed)
+    return false;
+  if (feed->next < feed->batch.size())
+    return true;
+  std::unique_lock<std::mutex> guard(feed->lock);
+  return feed->arrived.wait_for(guard, std::chrono::milliseconds(timeout_ms),
+                                []
+                                { return !feed->pending.empty() || !feed->reading; }) &&
+         !feed->pending.empty();
+}
+
+/**
+ * @brief Fills in the feed counters.
+ *
+ * @param stats Receives the counters; all zero if no feed runs
+ */
+void ingest_stats(IngestStats *stats)
+{
+  *stats = IngestStats();
+  if (!feed)
+    return;
+  stats->parsed = feed->parsed;
+  stats->applied = feed->applied;
+  stats->malformed = feed->malformed;
+  stats->batches = feed->batches;
+  stats->largest_batch = feed->largest_batch;
+  {
+    std::lock_guard<std::mutex> guard(feed->lock);
+    stats->queued = (int)(feed->pending.size() + feed->batch.size() - feed->next);
+  }
+  stats->reading = feed->reading;
+}
@@ -0,0 +1,673 @@
+/**
+ * @file ipc.cpp
+ * @brief Unix-domain-socket query server.
+ *
+ * The server thread owns the sockets: it accepts clients, parses request
+ * frames into fixed-size records and writes queued replies with one
+ * gathered send per wakeup. Replies are built once, in their final wire
+ * format, by whichever thread computes them; a path is written from the
+ * Dijkstra parent chain straight into its reply buffer, which is then moved,
+ * not copied, onto the connection's queue. Threads that queue a reply wake
+ * the server through a pipe.
+ *
+ * MST queries for the same graph version share one computation, and its
+ * result is kept until the graph changes.
+ */
+
+#include "ipc.h"
+#include "analytics.h"
+#include "graph.h"
+#include "history.h"
+#include "parallel.h"
+#include "paths.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <errno.h>
+#include <fcntl.h>
+#include <float.h>
+#include <memory>
+#include <mutex>
+#include <poll.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+#include <sys/un.h>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+
+#define IPC_BACKLOG 64
+#define IPC_READ_BYTES 65536 // receive buffer growth per read
+#define IPC_WRITE_BATCH 64   // replies gathered into one send
+
+// One client; shared by the server thread and the tasks answering it
+typedef struct
+{
+  int fd;
+  std::vector<char> in; // received bytes not parsed yet; server thread only
+  std::mutex lock;      // guards out and out_offset
+  std::deque<std::vector<char>> out; // replies waiting to be sent
+  size_t out_offset;                 // bytes of out.front() already sent
+  std::atomic<bool> closed;
+} Connection;
+
+typedef std::shared_ptr<Connection> ConnectionRef;
+
+// A parsed request
+typedef struct
+{
+  ConnectionRef client;
+  uint32_t tag;
+  uint8_t op;
+  uint32_t length;
+  char payload[IPC_MAX_REQUEST];
+} Request;
+
+// Allocated once and never destroyed, so that exit does not tear the mutex
+// down under the server thread
+typedef struct
+{
+  int listen_fd;
+  int wake[2]; // pipe written when a reply is queued
+  std::mutex lock; // guards pending
+  std::condition_variable arrived;
+  std::vector<Request> pending; // parsed, not yet handled
+  std::vector<Request> batch;   // being handled; GLUT thread only
+
+  std::mutex mst_lock; // guards the MST fields
+  std::shared_ptr<const MstResult> mst;
+  unsigned int mst_version;    // graph version of mst
+  bool mst_running;            // a computation is under way
+  unsigned int mst_running_version;
+  std::vector<Request> mst_waiting; // requests the computation answers
+
+  std::atomic<int> connections;
+  std::atomic<unsigned long long> requests;
+  unsigned long long mutations, batches; // GLUT thread only
+  int largest_batch;
+} Server;
+
+static Server *server = NULL;
+
+// Payload size of every request op
+static const int request_length[] = {-1, 0, 8, 12, 4, 8, 0};
+#define IPC_OP_COUNT (int)(sizeof(request_length) / sizeof(request_length[0]))
+
+/**
+ * @brief Allocates a reply with its header filled in.
+ *
+ * @param tag Tag of the request
+ * @param status IPC_STATUS_* code
+ * @param length Payload bytes, left for the caller to fill
+ * @return Reply in wire format
+ */
+static std::vector<char> reply_buffer(uint32_t tag, uint8_t status, size_t length)
+{
+  std::vector<char> reply(sizeof(IpcHeader) + length);
+  IpcHeader header = {(uint32_t)length, tag, status, {0, 0, 0}};
+  memcpy(reply.data(), &header, sizeof(header));
+  return reply;
+}
+
+/**
+ * @brief Queues a reply and wakes the server thread to send it.
+ *
+ * @param client Connection of the request
+ * @param reply Reply in wire format; moved onto the queue
+ */
+static void send_reply(const ConnectionRef &client, std::vector<char> &&reply)
+{
+  if (client->closed)
+    return;
+  {
+    std::lock_guard<std::mutex> guard(client->lock);
+    client->out.push_back(std::move(reply));
+  }
+  char byte = 0;
+  // A full pipe already holds a wakeup
+  if (write(server->wake[1], &byte, 1) < 0 && errno != EAGAIN)
+    perror("ipc wake");
+}
+
+/**
+ * @brief Queues a reply without payload.
+ *
+ * @param request Request to answer
+ * @param status IPC_STATUS_* code
+ */
+static void send_status(const Request &request, uint8_t status)
+{
+  send_reply(request.client, reply_buffer(request.tag, status, 0));
+}
+
+/**
+ * @brief Reads what a client sent and parses the complete frames.
+ *
+ * @param client Connection to read
+ * @param parsed Receives the requests
+ * @return false once the connection is closed or sent a frame too large for
+ *         any request
+ */
+static bool read_requests(const ConnectionRef &client, std::vector<Request> &parsed)
+{
+  std::vector<char> &in = client->in;
+  for (;;)
+  {
+    size_t used = in.size();
+    in.resize(used + IPC_READ_BYTES);
+    ssize_t got = recv(client->fd, in.data() + used, IPC_READ_BYTES, 0);
+    in.resize(used + std::max(got, (ssize_t)0));
+    if (got == 0)
+      return false;
+    if (got < 0)
+    {
+      if (errno == EINTR)
+        continue;
+      if (errno == EAGAIN || errno == EWOULDBLOCK)
+        break;
+      return false;
+    }
+    if (got < IPC_READ_BYTES)
+      break;
+  }
+
+  size_t at = 0;
+  while (in.size() - at >= sizeof(IpcHeader))
+  {
+    IpcHeader header;
+    memcpy(&header, &in[at], sizeof(header));
+    if (header.length > IPC_MAX_REQUEST)
+      return false;
+    if (in.size() - at < sizeof(header) + header.length)
+      break;
+    Request request;
+    request.client = client;
+    request.tag = header.tag;
+    request.op = header.code;
+    request.length = header.length;
+    memcpy(request.payload, &in[at + sizeof(header)], header.length);
+    parsed.push_back(std::move(request));
+    at += sizeof(header) + header.length;
+  }
+  in.erase(in.begin(), in.begin() + at);
+  return true;
+}
+
+/**
+ * @brief Sends queued replies until the socket would block.
+ *
+ * @param client Connection to write
+ * @return false if the connection failed
+ */
+static bool write_replies(const ConnectionRef &client)
+{
+  std::lock_guard<std::mutex> guard(client->lock);
+  while (!client->out.empty())
+  {
+    struct iovec iov[IPC_WRITE_BATCH];
+    int count = 0;
+    for (auto it = client->out.begin(); it != client->out.end() && count < IPC_WRITE_BATCH;
+         ++it, count++)
+    {
+      size_t skip = count == 0 ? client->out_offset : 0;
+      iov[count].iov_base = it->data() + skip;
+      iov[count].iov_len = it->size() - skip;
+    }
+    struct msghdr message = {};
+    message.msg_iov = iov;
+    message.msg_iovlen = count;
+    ssize_t sent = sendmsg(client->fd, &message, MSG_NOSIGNAL);
+    if (sent < 0)
+    {
+      if (errno == EINTR)
+        continue;
+      return errno == EAGAIN || errno == EWOULDBLOCK;
+    }
+    while (sent > 0)
+    {
+      size_t left = client->out.front().size() - client->out_offset;
+      if ((size_t)sent < left)
+      {
+        client->out_offset += sent;
+        break;
+      }
+      sent -= left;
+      client->out.pop_front();
+      client->out_offset = 0;
+    }
+  }
+  return true;
+}
+
+/**
+ * @brief Body of the server thread: accepts clients, reads requests and
+ *        sends replies.
+ */
+static void serve()
+{
+  std::vector<ConnectionRef> clients;
+  std::vector<struct pollfd> fds;
+  std::vector<Request> parsed;
+  for (;;)
+  {
+    fds.clear();
+    fds.push_back({server->listen_fd, POLLIN, 0});
+    fds.push_back({server->wake[0], POLLIN, 0});
+    for (const ConnectionRef &client : clients)
+    {
+      short events = POLLIN;
+      std::lock_guard<std::mutex> guard(client->lock);
+      if (!client->out.empty())
+        events |= POLLOUT;
+      fds.push_back({client->fd, events, 0});
+    }
+    if (poll(fds.data(), fds.size(), -1) < 0)
+    {
+      if (errno == EINTR)
+        continue;
+      perror("ipc poll");
+      return;
+    }
+    if (fds[1].revents & POLLIN)
+    {
+      char drain[256];
+      while (read(server->wake[0], drain, sizeof(drain)) > 0)
+        ;
+    }
+
+    size_t polled = clients.size();
+    for (size_t c = 0; c < polled; c++)
+    {
+      const ConnectionRef &client = clients[c];
+      short revents = fds[c + 2].revents;
+      bool open = true;
+      if (revents & (POLLIN | POLLHUP | POLLERR))
+        open = read_requests(client, parsed);
+      if (open && (revents & POLLOUT))
+        open = write_replies(client);
+      if (!open)
+      {
+        client->closed = true;
+        close(client->fd);
+      }
+    }
+    clients.erase(std::remove_if(clients.begin(), clients.end(),
+                                 [](const ConnectionRef &client)
+                                 { return client->closed.load(); }),
+                  clients.end());
+    server->connections = (int)clients.size();
+
+    if (fds[0].revents & POLLIN)
+    {
+      int fd;
+      while ((fd = accept4(server->listen_fd, NULL, NULL, SOCK_NONBLOCK | SOCK_CLOEXEC)) >= 0)
+      {
+        ConnectionRef client = std::make_shared<Connection>();
+        client->fd = fd;
+        clients.push_back(client);
+      }
+      server->connections = (int)clients.size();
+    }
+
+    if (!parsed.empty())
+    {
+      server->requests += parsed.size();
+      {
+        std::lock_guard<std::mutex> guard(server->lock);
+        for (Request &request : parsed)
+          server->pending.push_back(std::move(request));
+      }
+      parsed.clear();
+      server->arrived.notify_one();
+    }
+  }
+}
+
+/**
+ * @brief Listens on a Unix-domain socket and starts the server thread.
+ *
+ * @param path Socket path; a file already there is replaced
+ * @return false if the socket cannot be set up
+ */
+bool ipc_start(const char *path)
+{
+  if (server)
+    return true;
+  struct sockaddr_un address = {};
+  address.sun_family = AF_UNIX;
+  if (strlen(path) >= sizeof(address.sun_path))
+  {
+    fprintf(stderr, "%s: socket path too long\n", path);
+    return false;
+  }
+  strcpy(address.sun_path, path);
+  int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+  if (fd < 0)
+  {
+    perror("socket");
+    return false;
+  }
+  unlink(path);
+  int wake[2];
+  if (bind(fd, (struct sockaddr *)&address, sizeof(address)) < 0 ||
+      listen(fd, IPC_BACKLOG) < 0 || pipe2(wake, O_NONBLOCK | O_CLOEXEC) < 0)
+  {
+    perror(path);
+    close(fd);
+    return false;
+  }
+  server = new Server();
+  server->listen_fd = fd;
+  server->wake[0] = wake[0];
+  server->wake[1] = wake[1];
+  std::thread(serve).detach();
+  return true;
+}
+
+/**
+ * @brief Reads a little-endian value from a request payload.
+ *
+ * @param request Request
+ * @param offset Byte offset into the payload
+ * @return The value
+ */
+template <typename T>
+static T payload_at(const Request &request, int offset)
+{
+  T value;
+  memcpy(&value, request.payload + offset, sizeof(T));
+  return value;
+}
+
+/**
+ * @brief Answers a path query on a worker.
+ *
+ * @param adj Adjacency snapshot
+ * @param ids External id of every node of the snapshot
+ * @param request Request to answer
+ * @param src Start node index
+ * @param dest End node index
+ */
+static void answer_path(const Adjacency &adj, const std::vector<int> &ids,
+                        const Request &request, int src, int dest)
+{
+  // One scratch per worker slot, kept for the lifetime of the process
+  static std::vector<DijkstraScratch> *scratch =
+      new std::vector<DijkstraScratch>(parallel_threads());
+  DijkstraScratch &sc = (*scratch)[parallel_worker_id()];
+  dijkstra_search(adj, &src, 1, dest, &sc);
+  if (sc.dist[dest] == FLT_MAX)
+  {
+    send_status(request, IPC_STATUS_NO_PATH);
+    return;
+  }
+  uint32_t count = 0;
+  for (int at = dest; at != -1; at = sc.parent[at])
+    count++;
+  std::vector<char> reply = reply_buffer(request.tag, IPC_STATUS_OK, 8 + 4 * (size_t)count);
+  char *payload = reply.data() + sizeof(IpcHeader);
+  memcpy(payload, &sc.dist[dest], 4);
+  memcpy(payload + 4, &count, 4);
+  uint32_t slot = count;
+  for (int at = dest; at != -1; at = sc.parent[at])
+  {
+    int32_t id = ids[at];
+    memcpy(payload + 8 + 4 * (size_t)--slot, &id, 4);
+  }
+  send_reply(request.client, std::move(reply));
+}
+
+/**
+ * @brief Answers MST queries from a computed tree.
+ *
+ * @param mst The tree
+ * @param requests Requests to answer
+ */
+static void answer_mst(const MstResult &mst, const std::vector<Request> &requests)
+{
+  uint32_t edges = (uint32_t)(mst.ends.size() / 2);
+  for (const Request &request : requests)
+  {
+    std::vector<char> reply = reply_buffer(request.tag, IPC_STATUS_OK, 8 + 8 * (size_t)edges);
+    char *payload = reply.data() + sizeof(IpcHeader);
+    memcpy(payload, &mst.sum, 4);
+    memcpy(payload + 4, &edges, 4);
+    memcpy(payload + 8, mst.ends.data(), 8 * (size_t)edges);
+    send_reply(request.client, std::move(reply));
+  }
+}
+
+/**
+ * @brief Answers MST queries, sharing one computation per graph version.
+ *
+ * @param adj Adjacency snapshot of the current graph
+ * @param ids External id of every node of the snapshot
+ * @param requests Requests to answer
+ */
+static void start_mst(const std::shared_ptr<const Adjacency> &adj,
+                      const std::shared_ptr<const std::vector<int>> &ids,
+                      std::vector<Request> &requests)
+{
+  unsigned int version = graph_version;
+  std::lock_guard<std::mutex> guard(server->mst_lock);
+  if (server->mst && server->mst_version == version)
+  {
+    std::shared_ptr<const MstResult> mst = server->mst;
+    std::shared_ptr<std::vector<Request>> waiting =
+        std::make_shared<std::vector<Request>>(std::move(requests));
+    task_submit(TASK_INTERACTIVE, [mst, waiting]()
+                { answer_mst(*mst, *waiting); });
+    return;
+  }
+  for (Request &request : requests)
+    server->mst_waiting.push_back(std::move(request));
+  if (server->mst_running && server->mst_running_version == version)
+    return;
+  server->mst_running = true;
+  server->mst_running_version = version;
+  task_submit(TASK_INTERACTIVE, [adj, ids, version]()
+              {
+                std::shared_ptr<MstResult> mst = std::make_shared<MstResult>();
+                minimum_spanning_tree(*adj, *ids, mst.get());
+                std::vector<Request> waiting;
+                {
+                  std::lock_guard<std::mutex> guard(server->mst_lock);
+                  if (server->mst_running_version != version)
+                    return; // a newer computation answers everyone
+                  server->mst = mst;
+                  server->mst_version = version;
+                  server->mst_running = false;
+                  waiting.swap(server->mst_waiting);
+                }
+                answer_mst(*mst, waiting);
+              });
+}
+
+/**
+ * @brief Applies one mutation.
+ *
+ * @param request Mutation request with a valid payload size
+ * @param touched Receives the ids of the nodes it changed
+ */
+static void apply_mutation(const Request &request, std::vector<int> &touched)
+{
+  if (request.op == IPC_OP_ADD_NODE)
+  {
+    int node = history_add_node(payload_at<float>(request, 0), payload_at<float>(request, 4));
+    int32_t id = nodes[node].id;
+    touched.push_back(id);
+    std::vector<char> reply = reply_buffer(request.tag, IPC_STATUS_OK, 4);
+    memcpy(reply.data() + sizeof(IpcHeader), &id, 4);
+    send_reply(request.client, std::move(reply));
+    return;
+  }
+  if (request.op == IPC_OP_ADD_EDGE)
+  {
+    int src = graph_node_index(payload_at<int32_t>(request, 0));
+    int dest = graph_node_index(payload_at<int32_t>(request, 4));
+    float weight = payload_at<float>(request, 8);
+    if (src == -1 || dest == -1)
+      send_status(request, IPC_STATUS_NOT_FOUND);
+    else if (src == dest || !(weight > 0))
+      send_status(request, IPC_STATUS_BAD_REQUEST);
+    else
+    {
+      if (has_edge(src, dest))
+        history_set_weight(graph_find_edge(src, dest), weight);
+      else
+        history_add_edge(src, dest, weight);
+      touched.push_back(nodes[src].id);
+      touched.push_back(nodes[dest].id);
+      send_status(request, IPC_STATUS_OK);
+    }
+    return;
+  }
+  int node = graph_node_index(payload_at<int32_t>(request, 0));
+  if (node == -1)
+  {
+    send_status(request, IPC_STATUS_NOT_FOUND);
+    return;
+  }
+  std::shared_ptr<const Adjacency> adj = graph_adjacency();
+  for (int e = adj->offsets[node]; e < adj->offsets[node + 1]; e++)
+    touched.push_back(nodes[adj->targets[e]].id);
+  history_delete_node(node);
+  send_status(request, IPC_STATUS_OK);
+}
+
+/**
+ * @brief Handles the requests that arrived since the last frame.
+ *
+ * Mutations go through the undo history like edits made with the mouse.
+ * Node lookups for the queries happen here, on the GLUT thread; the
+ * searches themselves run as interactive tasks.
+ *
+ * @param touch Called with the index of every node a mutation changed, or
+ *        NULL
+ */
+void ipc_poll(void (*touch)(int node))
+{
+  if (!server)
+    return;
+  {
+    std::lock_guard<std::mutex> guard(server->lock);
+    server->batch.swap(server->pending);
+  }
+  std::vector<Request> &batch = server->batch;
+  if (batch.empty())
+    return;
+
+  std::vector<int> touched;
+  for (Request &request : batch)
+  {
+    if (request.op == 0 || request.op >= IPC_OP_COUNT ||
+        (int)request.length != request_length[request.op])
+    {
+      send_status(request, IPC_STATUS_BAD_REQUEST);
+      request.op = 0;
+    }
+    else if (request.op == IPC_OP_ADD_NODE || request.op == IPC_OP_ADD_EDGE ||
+             request.op == IPC_OP_DELETE_NODE)
+    {
+      apply_mutation(request, touched);
+      server->mutations++;
+    }
+  }
+  if (touch)
+  {
+    for (int id : touched)
+    {
+      int node = graph_node_index(id);
+      if (node != -1)
+        touch(node);
+    }
+  }
+
+  std::shared_ptr<const Adjacency> adj;
+  std::shared_ptr<std::vector<int>> ids;
+  std::vector<Request> msts;
+  for (Request &request : batch)
+  {
+    if (request.op == IPC_OP_STATS)
+    {
+      int32_t next_id = 0;
+      for (int i = 0; i < node_count; i++)
+        next_id = std::max(next_id, nodes[i].id + 1);
+      uint32_t stats[3] = {(uint32_t)node_count, (uint32_t)edge_count, graph_version};
+      std::vector<char> reply = reply_buffer(request.tag, IPC_STATUS_OK, 16);
+      memcpy(reply.data() + sizeof(IpcHeader), stats, 12);
+      memcpy(reply.data() + sizeof(IpcHeader) + 12, &next_id, 4);
+      send_reply(request.client, std::move(reply));
+      continue;
+    }
+    if (request.op != IPC_OP_PATH && request.op != IPC_OP_MST)
+      continue;
+    if (!adj)
+    {
+      adj = graph_adjacency();
+      ids = std::make_shared<std::vector<int>>(node_count);
+      for (int i = 0; i < node_count; i++)
+        (*ids)[i] = nodes[i].id;
+    }
+    if (request.op == IPC_OP_MST)
+    {
+      msts.push_back(std::move(request));
+      continue;
+    }
+    int src = graph_node_index(payload_at<int32_t>(request, 0));
+    int dest = graph_node_index(payload_at<int32_t>(request, 4));
+    if (src == -1 || dest == -1)
+    {
+      send_status(request, IPC_STATUS_NOT_FOUND);
+      continue;
+    }
+    std::shared_ptr<const std::vector<int>> snapshot_ids = ids;
+    Request query = std::move(request);
+    task_submit(TASK_INTERACTIVE, [adj, snapshot_ids, query, src, dest]()
+                { answer_path(*adj, *snapshot_ids, query, src, dest); });
+  }
+  if (!msts.empty())
+    start_mst(adj, ids, msts);
+
+  server->batches++;
+  server->largest_batch = std::max(server->largest_batch, (int)batch.size());
+  batch.clear();
+}
+
+/**
+ * @brief Waits until requests arrive.
+ *
+ * @param timeout_ms Longest wait in milliseconds
+ * @return true if requests are queued
+ */
+bool ipc_wait(int timeout_ms)
+{
+  if (!server)
+    return false;
+  std::unique_lock<std::mutex> guard(server->lock);
+  return server->arrived.wait_for(guard, std::chrono::milliseconds(timeout_ms),
+                                  []
+                                  { return !server->pending.empty(); });
+}
+
+/**
+ * @brief Fills in the server counters.
+ *
+ * @param stats Receives the counters; all zero if no server runs
+ */
+void ipc_stats(IpcStats *stats)
+{
+  *stats = IpcStats();
+  if (!server)
+    return;
+  stats->connections = server->connections;
+  stats->requests = server->requests;
+  stats->mutations = server->mutations;
+  stats->batches = server->batches;
+  stats->largest_batch = server->largest_batch;
+}
@@ -0,0 +1,337 @@
+/**
+ * @file loadgen.cpp
+ * @brief Load generator for the IPC server.
+ *
+ * Every connection runs on its own thread and keeps a fixed number of
+ * requests in flight, writing each top-up as one send. Latency is measured
+ * from the send of a request to the arrival of its reply, so it includes
+ * the wait for the server's next frame. Path queries pick random node ids
+ * below the highest id the server reported.
+ */
+
+#include "ipc.h"
+
+#include <algorithm>
+#include <chrono>
+#include <errno.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+
+#define LOAD_CONNECTIONS 4
+#define LOAD_DEPTH 32
+#define LOAD_REQUESTS 100000
+#define LOAD_READ_BYTES 65536
+
+typedef struct
+{
+  const char *path;
+  int connections;
+  int depth;         // requests in flight per connection
+  long requests;     // over all connections
+  int mutations;     // percentage of edge insertions
+  int msts;          // percentage of MST queries
+  unsigned int seed;
+  int32_t next_id;   // node ids are drawn below this
+} LoadOptions;
+
+typedef struct
+{
+  std::vector<float> latency_us;
+  long replies[4]; // by IPC_STATUS_*
+  bool failed;
+} LoadResult;
+
+typedef std::chrono::steady_clock Clock;
+
+/**
+ * @brief Connects to the server.
+ *
+ * @param path Socket path
+ * @return Socket, or -1 after printing the error
+ */
+static int connect_server(const char *path)
+{
+  struct sockaddr_un address = {};
+  address.sun_family = AF_UNIX;
+  strncpy(address.sun_path, path, sizeof(address.sun_path) - 1);
+  int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+  if (fd < 0 || connect(fd, (struct sockaddr *)&address, sizeof(address)) < 0)
+  {
+    perror(path);
+    if (fd >= 0)
+      close(fd);
+    return -1;
+  }
+  return fd;
+}
+
+/**
+ * @brief Writes a whole buffer.
+ *
+ * @param fd Socket
+ * @param data Bytes to write
+ * @param size Number of bytes
+ * @return false if the connection failed
+ */
+static bool send_all(int fd, const char *data, size_t size)
+{
+  while (size > 0)
+  {
+    ssize_t sent = send(fd, data, size, MSG_NOSIGNAL);
+    if (sent < 0 && errno == EINTR)
+      continue;
+    if (sent <= 0)
+      return false;
+    data += sent;
+    size -= sent;
+  }
+  return true;
+}
+
+/**
+ * @brief Appends a request frame.
+ *
+ * @param out Buffer to append to
+ * @param tag Request tag
+ * @param op IPC_OP_* code
+ * @param payload Payload bytes
+ * @param length Payload size
+ */
+static void append_request(std::vector<char> &out, uint32_t tag, uint8_t op,
+                           const void *payload, uint32_t length)
+{
+  IpcHeader header = {length, tag, op, {0, 0, 0}};
+  const char *bytes = (const char *)&header;
+  out.insert(out.end(), bytes, bytes + sizeof(header));
+  out.insert(out.end(), (const char *)payload, (const char *)payload + length);
+}
+
+/**
+ * @brief Next value of a SplitMix64 stream.
+ *
+ * @param state Stream state
+ * @return Pseudo-random value
+ */
+static uint64_t next_random(uint64_t *state)
+{
+  uint64_t z = (*state += 0x9E3779B97F4A7C15ull);
+  z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+  z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+  return z ^ (z >> 31);
+}
+
+/**
+ * @brief Asks the server for its graph size.
+ *
+ * @param options Receives the highest node id + 1
+ * @return false if the server cannot be reached
+ */
+static bool fetch_stats(LoadOptions *options)
+{
+  int fd = connect_server(options->path);
+  if (fd < 0)
+    return false;
+  std::vector<char> request;
+  append_request(request, 0, IPC_OP_STATS, NULL, 0);
+  char reply[sizeof(IpcHeader) + 16];
+  size_t got = 0;
+  bool ok = send_all(fd, request.data(), request.size());
+  while (ok && got < sizeof(reply))
+  {
+    ssize_t n = recv(fd, reply + got, sizeof(reply) - got, 0);
+    ok = n > 0;
+    got += std::max(n, (ssize_t)0);
+  }
+  close(fd);
+  if (!ok)
+  {
+    fprintf(stderr, "%s: no reply to the stats request\n", options->path);
+    return false;
+  }
+  uint32_t counts[3];
+  memcpy(counts, reply + sizeof(IpcHeader), sizeof(counts));
+  memcpy(&options->next_id, reply + sizeof(IpcHeader) + 12, 4);
+  printf("Server graph: %u nodes, %u edges, version %u\n", counts[0], counts[1], counts[2]);
+  return true;
+}
+
+/**
+ * @brief Runs the requests of one connection.
+ *
+ * @param options Load parameters
+ * @param count Requests to send
+ * @param seed Seed of this connection's request stream
+ * @param result Receives the latencies and reply counts
+ */
+static void run_connection(const LoadOptions *options, long count, uint64_t seed,
+                           LoadResult *result)
+{
+  int fd = connect_server(options->path);
+  if (fd < 0)
+  {
+    result->failed = true;
+    return;
+  }
+  std::vector<Clock::time_point> sent_at(count);
+  result->latency_us.reserve(count);
+  std::vector<char> out, in;
+  long sent = 0, received = 0;
+  int32_t ids = std::max(options->next_id, 1);
+  while (received < count)
+  {
+    out.clear();
+    Clock::time_point now = Clock::now();
+    while (sent < count && sent - received < options->depth)
+    {
+      int pick = (int)(next_random(&seed) % 100);
+      int32_t ends[3];
+      ends[0] = (int32_t)(next_random(&seed) % ids);
+      ends[1] = (int32_t)(next_random(&seed) % ids);
+      if (pick < options->mutations)
+      {
+        float weight = 1 + next_random(&seed) % 10;
+        memcpy(&ends[2], &weight, 4);
+        append_request(out, (uint32_t)sent, IPC_OP_ADD_EDGE, ends, 12);
+      }
+      else if (pick < options->mutations + options->msts)
+        append_request(out, (uint32_t)sent, IPC_OP_MST, NULL, 0);
+      else
+        append_request(out, (uint32_t)sent, IPC_OP_PATH, ends, 8);
+      sent_at[sent++] = now;
+    }
+    if (!out.empty() && !send_all(fd, out.data(), out.size()))
+    {
+      result->failed = true;
+      break;
+    }
+
+    size_t used = in.size();
+    in.resize(used + LOAD_READ_BYTES);
+    ssize_t got = recv(fd, in.data() + used, LOAD_READ_BYTES, 0);
+    if (got <= 0)
+    {
+      if (got < 0 && errno == EINTR)
+      {
+        in.resize(used);
+        continue;
+      }
+      result->failed = true;
+      break;
+    }
+    in.resize(used + got);
+    now = Clock::now();
+    size_t at = 0;
+    while (in.size() - at >= sizeof(IpcHeader))
+    {
+      IpcHeader header;
+      memcpy(&header, &in[at], sizeof(header));
+      if (in.size() - at < sizeof(header) + header.length)
+        break;
+      if (header.tag < (uint32_t)count && header.code < 4)
+      {
+        result->latency_us.push_back(
+            std::chrono::duration<float, std::micro>(now - sent_at[header.tag]).count());
+        result->replies[header.code]++;
+      }
+      received++;
+      at += sizeof(header) + header.length;
+    }
+    in.erase(in.begin(), in.begin() + at);
+  }
+  close(fd);
+}
+
+/**
+ * @brief Latency at a percentile.
+ *
+ * @param sorted Latencies in ascending order
+ * @param percent Percentile in [0, 100]
+ * @return Latency in milliseconds
+ */
+static double percentile(const std::vector<float> &sorted, double percent)
+{
+  if (sorted.empty())
+    return 0;
+  size_t at = (size_t)(percent / 100 * (sorted.size() - 1) + 0.5);
+  return sorted[at] / 1000.0;
+}
+
+/**
+ * @brief Parses the options, runs the connections and prints the results.
+ *
+ * @param argc Argument count
+ * @param argv Arguments
+ * @return Exit status
+ */
+int main(int argc, char **argv)
+{
+  LoadOptions options = {NULL, LOAD_CONNECTIONS, LOAD_DEPTH, LOAD_REQUESTS, 0, 0, 1, 0};
+  for (int i = 1; i < argc; i++)
+  {
+    if (strcmp(argv[i], "--connections") == 0 && i + 1 < argc)
+      options.connections = std::max(atoi(argv[++i]), 1);
+    else if (strcmp(argv[i], "--depth") == 0 && i + 1 < argc)
+      options.depth = std::max(atoi(argv[++i]), 1);
+    else if (strcmp(argv[i], "--requests") == 0 && i + 1 < argc)
+      options.requests = std::max(atol(argv[++i]), 1L);
+    else if (strcmp(argv[i], "--mutations") == 0 && i + 1 < argc)
+      options.mutations = atoi(argv[++i]);
+    else if (strcmp(argv[i], "--mst") == 0 && i + 1 < argc)
+      options.msts = atoi(argv[++i]);
+    else if (strcmp(argv[i], "--seed") == 0 && i + 1 < argc)
+      options.seed = (unsigned int)strtoul(argv[++i], NULL, 10);
+    else if (!options.path && argv[i][0] != '-')
+      options.path = argv[i];
+  }
+  if (!options.path || options.mutations + options.msts > 100)
+  {
+    fprintf(stderr, "usage: grapher-load SOCKET [--connections N] [--depth N] "
+                    "[--requests N] [--mutations PERCENT] [--mst PERCENT] [--seed N]\n");
+    return 1;
+  }
+  if (!fetch_stats(&options))
+    return 1;
+
+  std::vector<LoadResult> results(options.connections);
+  std::vector<std::thread> threads;
+  Clock::time_point start = Clock::now();
+  for (int c = 0; c < options.connections; c++)
+  {
+    long count = options.requests / options.connections +
+                 (c < options.requests % options.connections ? 1 : 0);
+    uint64_t seed = ((uint64_t)options.seed << 32) | (uint64_t)c;
+    threads.emplace_back(run_connection, &options, count, seed, &results[c]);
+  }
+  for (std::thread &thread : threads)
+    thread.join();
+  double seconds = std::chrono::duration<double>(Clock::now() - start).count();
+
+  std::vector<float> latency;
+  long replies[4] = {0, 0, 0, 0};
+  bool failed = false;
+  for (const LoadResult &result : results)
+  {
+    latency.insert(latency.end(), result.latency_us.begin(), result.latency_us.end());
+    for (int s = 0; s < 4; s++)
+      replies[s] += result.replies[s];
+    failed |= result.failed;
+  }
+  std::sort(latency.begin(), latency.end());
+  printf("%d connections x %d in flight: %zu replies in %.2f s, %.0f req/s\n",
+         options.connections, options.depth, latency.size(), seconds,
+         latency.size() / seconds);
+  printf("Latency: p50 %.3f ms, p90 %.3f ms, p99 %.3f ms, p99.9 %.3f ms, max %.3f ms\n",
+         percentile(latency, 50), percentile(latency, 90), percentile(latency, 99),
+         percentile(latency, 99.9), percentile(latency, 100));
+  printf("Replies: %ld ok, %ld bad request, %ld not found, %ld no path\n",
+         replies[IPC_STATUS_OK], replies[IPC_STATUS_BAD_REQUEST],
+         replies[IPC_STATUS_NOT_FOUND], replies[IPC_STATUS_NO_PATH]);
+  return failed ? 1 : 0;
+}
@@ -4,12 +4,37 @@
  *
  * This program visualizes a graph with nodes and edges, allowing the user to
  * add nodes, add edges, find the shortest path, edit edge weights, delete nodes,
- * and find the Minimum Spanning Tree (MST) using Kruskal's algorithm.
+ * and find the Minimum Spanning Tree (MST) using Prim's algorithm.
  *
  * The visualization uses the Dracula theme for colors.
  */
 
+#include "analytics.h"
+#include "arena.h"
+#include "backend.h"
+#include "bundling.h"
+#include "checkpoint.h"
+#include "community.h"
+#include "edgefile.h"
+#include "forces.h"
+#include "graph.h"
+#include "generators.h"
+#include "history.h"
+#include "ingest.h"
+#include "ipc.h"
+#include "parallel.h"
+#include "paths.h"
+#include "perfcount.h"
+#include "query.h"
+#include "reorder.h"
+#include "replay.h"
+#include "stream.h"
+#include "stress.h"
+
+#define GL_GLEXT_PROTOTYPES // glMultiDrawArrays
 #include <GL/glut.h>
+#include <algorithm>
+#include <chrono>
 #include <ctype.h>
 #include <float.h>
 #include <iostream>
@@ -18,6 +43,9 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <strings.h>
+#include <unordered_map>
+#include <vector>
 
 // Mode constants
 #define MODE_ADD_NODE 1
@@ -26,8 +54,28 @@
 #define MODE_EDIT_WEIGHT 4
 #define MODE_DELETE_NODE 5
 #define MODE_MST 6
+#define MODE_GENERATE 7
+#define MODE_SP_TREE 8
+#define MODE_ANALYTICS 9
+
+// Clear Screen is an action rather than a mode
+#define MENU_CLEAR 0
+
+// Edge rendering styles, cycled with 'e'. Auto bundles the edges of graphs
+// with at least BUNDLE_AUTO_EDGES edges.
+#define EDGES_AUTO 0
+#define EDGES_STRAIGHT 1
+#define EDGES_BUNDLED 2
+#define EDGE_STYLES 3
+#define BUNDLE_AUTO_EDGES 2000
+#define BUNDLE_REFRESH_DISTANCE 0.01f // node movement that triggers a refinement
+#define BUNDLE_ALPHA 0.35f
+
+// Layout engines, switched with 'l'
+#define LAYOUT_FORCE 0
+#define LAYOUT_STRESS 1
+#define LAYOUT_ENGINES 2
 
-#define MAX_NODES 1000
 #define INF FLT_MAX
 
 // Menu pixel region constants
@@ -35,6 +83,7 @@
 #define BUTTON_WIDTH 130
 #define BUTTON_HEIGHT 40
 #define BUTTON_PADDING 10
+#define MENU_TOP 20
 
 // Dracula theme color definitions
 #define COLOR_BG_R 0.157f // #282a36 background
@@ -61,6 +110,14 @@
 #define COLOR_SP_G 0.914f
 #define COLOR_SP_B 0.992f
 
+#define COLOR_FAR_R 1.0f // #ff5555 farthest node in a distance coloring
+#define COLOR_FAR_G 0.333f
+#define COLOR_FAR_B 0.333f
+
+#define COLOR_MID_R 0.945f // #f1fa8c halfway color of a distance coloring
+#define COLOR_MID_G 0.980f
+#define COLOR_MID_B 0.549f
+
 #define COLOR_MENU_BG_R 0.2667f // #44475a menu background
 #define COLOR_MENU_BG_G 0.278f
 #define COLOR_MENU_BG_B 0.3529f
@@ -77,17 +134,126 @@
 #define COLOR_TEXT_G 0.972f
 #define COLOR_TEXT_B 0.949f
 
+// Categorical colors for components and facilities
+static const float node_palette[][3] = {
+    {COLOR_SP_R, COLOR_SP_G, COLOR_SP_B},
+    {COLOR_MST_R, COLOR_MST_G, COLOR_MST_B},
+    {1.0f, 0.722f, 0.424f}, // #ffb86c
+    {COLOR_EDGE_R, COLOR_EDGE_G, COLOR_EDGE_B},
+    {COLOR_BUTTON_ACTIVE_R, COLOR_BUTTON_ACTIVE_G, COLOR_BUTTON_ACTIVE_B},
+    {COLOR_MID_R, COLOR_MID_G, COLOR_MID_B},
+};
+#define NODE_PALETTE_SIZE (int)(sizeof(node_palette) / sizeof(node_palette[0]))
+
 // Global state variables
 int current_mode = MODE_ADD_NODE;
 int selected_node = -1; // For add edge mode
 int sp_selected = -1;   // For shortest path mode
 
-// For Dijkstra results (shortest path)
-int shortest_path_nodes[MAX_NODES];
-int shortest_path_length = 0;
+// Per-node color and size override set by analysis modes
+typedef struct
+{
+  float r, g, b;
+  float scale; // radius multiplier
+} NodeStyle;
+
+// Shortest path mode: the route_count shortest routes in front, shown while
+// routes_shown > 0. A new click cancels the query in flight.
+Query<std::vector<Route>> path_query;
+int routes_shown = 0;
+int route_count = 1; // K of the next query, cycled by 'k'
+int path_ends[2] = {-1, -1}; // ids of the endpoints of the last query
+static const int route_counts[] = {1, 3, 5, 10};
+#define ROUTE_COUNT_CHOICES (int)(sizeof(route_counts) / sizeof(route_counts[0]))
+
+// Bundled edges, refined in the background as the layout moves
+int edge_style = EDGES_AUTO;
+static const char *edge_style_names[] = {"auto", "straight", "bundled"};
+Query<BundleResult> bundle_query;
+
+int layout_engine = LAYOUT_FORCE;
+static const char *layout_engine_names[] = {"force", "stress"};
+int force_law = FORCE_FR; // FORCE_* law of the force-directed engine
+static const char *force_law_names[] = {"FR", "LinLog", "ForceAtlas2"};
+Query<StressModel> stress_query;
+int stress_placed = -1;  // node count the pivot-MDS placement was applied at
+double stress_value = -1; // stress before the last step, -1 before the first
+double layout_ms = 0;     // duration of the last layout step
+
+// For the shortest path tree mode
+typedef struct
+{
+  std::vector<NodeStyle> styles; // distance or facility coloring
+  std::vector<int> parent;       // predecessor of each node in the tree
+  double ms;
+} TreeResult;
+int tree_root = -1;             // hovered node the tree grows from
+std::vector<int> tree_sources;  // facilities toggled by clicking
+Query<TreeResult> tree_query;
+bool tree_dirty = true;         // root or sources changed
+unsigned int tree_version = 0;  // graph_version the tree was requested for
+
+// For the analytics mode
+#define METRIC_COMPONENTS 1
+#define METRIC_BFS 2
+#define METRIC_PAGERANK 3
+#define METRIC_BETWEENNESS 4
+#define METRIC_COMMUNITIES 5
+#define METRIC_COUNT 5
+#define BETWEENNESS_PIVOTS 64 // exact below this many nodes, sampled above
+typedef struct
+{
+  std::vector<NodeStyle> styles;
+  char summary[64];
+  double ms;
+} MetricResult;
+int metric_selected = METRIC_COMPONENTS;
+int metric_source = 0;           // BFS root, picked by clicking a node
+Query<MetricResult> metric_query;
+bool metric_dirty = true;        // metric or root changed
+unsigned int metric_version = 0; // graph_version the metric was requested for
+
+// Collapsed view, toggled with 'c': every community is drawn and laid out
+// as one supernode, with one link per pair of connected communities.
+// Clicking a supernode opens it in place; communities of one node are
+// always open, as plain nodes.
+#define COMMUNITY_MAX_RADIUS 0.2f      // supernode radius cap
+#define COMMUNITY_OPEN_SPACING 2.5f    // open disk radius per sqrt(member), in node radii
+#define COMMUNITY_OPEN_MAX_RADIUS 0.6f // open disk radius cap
+typedef struct
+{
+  std::vector<int> ids;       // ids of the nodes labeled
+  std::vector<int> community; // label of each of them
+  CommunityStats stats;
+  double ms;
+} CommunityResult;
+typedef struct
+{
+  bool built;                     // the view below is usable
+  unsigned int version;           // graph_version it was built for
+  int result;                     // community_results it was built from
+  std::shared_ptr<const Adjacency> adj;
+  std::vector<int> community;     // community of every node
+  CommunityGraph graph;
+  std::vector<float> xy;          // center of every community
+  std::vector<unsigned char> open;
+} CollapsedView;
+bool collapsed_view = false;
+Query<CommunityResult> community_query; // labels by id, so stale ones still apply
+int community_results = 0;              // results collected so far
+CollapsedView collapsed;
+std::vector<int> open_ids; // one member of every opened community
 
-// For MST
-float mst_sum = 0;
+// For MST. Feed batches applied since the version of the tree in front or
+// in flight are recorded, so that the tree catches up with them instead of
+// being recomputed, for as long as nothing else changes the graph.
+Query<MstResult> mst_query;
+bool mst_dirty = true;        // never computed
+unsigned int mst_version = 0; // graph_version the MST was requested for
+bool mst_tracking = false;    // every change since mst_version is recorded
+unsigned int mst_tracked = 0; // graph_version after the last recorded batch
+std::vector<Edge> mst_changed; // edges the feed changed since, by id
+std::vector<int> mst_deleted;  // nodes the feed deleted since
 
 // For weight input
 bool inputting_weight = false;
@@ -97,387 +263,2447 @@ int temp_src, temp_dest;
 bool editing_existing_edge = false;
 int editing_edge = -1;
 
-// Use a constant radius for nodes
-const float NODE_RADIUS = 0.05f;
+// Node indices the interface holds, parked as external ids by
+// hold_indices() while the graph is renumbered, followed by the endpoints
+// of the edge being edited
+static int *const held_nodes[] = {&selected_node, &sp_selected, &tree_root,
+                                  &metric_source, &temp_src, &temp_dest};
+#define HELD_NODES (int)(sizeof(held_nodes) / sizeof(held_nodes[0]))
+int held_ids[HELD_NODES + 2];
+
+typedef struct
+{
+  const char *label;
+  int mode; // MODE_* selected by the button, or MENU_CLEAR
+} MenuButton;
 
+static const MenuButton menu_buttons[] = {
+    {"Add Node", MODE_ADD_NODE},
+    {"Add Edge", MODE_ADD_EDGE},
+    {"Shortest Path", MODE_SHORTEST_PATH},
+    {"Edit Weight", MODE_EDIT_WEIGHT},
+    {"Delete Node", MODE_DELETE_NODE},
+    {"MST", MODE_MST},
+    {"Generate", MODE_GENERATE},
+    {"SP Tree", MODE_SP_TREE},
+    {"Analytics", MODE_ANALYTICS},
+    {"Clear Screen", MENU_CLEAR},
+};
+#define MENU_BUTTON_COUNT (int)(sizeof(menu_buttons) / sizeof(menu_buttons[0]))
+
+// For the generator mode
+int generator_selected = GEN_ERDOS_RENYI;
+unsigned int generator_runs = 0; // varies the seed between generations
+
+// Logical window size used for input mapping and layout. It follows the real
+// window, except during a replay where it follows the recorded size.
+int window_w = 800, window_h = 600;
+bool headless = false;         // replaying without a window
+bool replay_max_speed = false; // replay ignoring recorded timestamps
+
+// Progressive startup: --load reads a graph on the feed's reader thread once
+// the window is up, and every frame applies and draws the next
+// STARTUP_FRAME_EVENTS of it. New nodes start next to a neighbor; once the
+// input is read, the pivot-MDS placement of the whole graph replaces those
+// positions.
+#define STARTUP_FRAME_EVENTS 32768
+typedef struct
+{
+  bool loading;          // the input is not fully applied yet
+  bool placing;          // waiting for the pivot-MDS placement
+  double first_frame_ms; // from process start to the end of the first frame
+  double loaded_ms;      // to the last chunk applied, -1 without --load
+  double interactive_ms; // to the first frame of the complete, placed graph
+} StartupState;
+StartupState startup = {false, false, -1, -1, -1};
+// Startup placement built on a background task
 typedef struct
 {
-  float x, y;
-  char label;
-} Node;
+  std::vector<float> x, y;
+} Placement;
+Query<Placement> placement_query;
+static const std::chrono::steady_clock::time_point process_start = std::chrono::steady_clock::now();
+
+// Heap allocation counts for checking that the frame loop stays off the heap
+unsigned long long tick_allocations = 0;  // during all layout ticks so far
+unsigned long long frame_allocations = 0; // between the last two redraws
+
+// Node ranges the layout kernels are split into, independent of the backend
+#define LAYOUT_CHUNKS 64
+// Interleaved partial sums of the repulsion loop, one per vector lane
+#define LAYOUT_LANES 8
+
+// Work done per backend by --bench-backends
+#define BENCH_LAYOUT_ITERATIONS 10
+#define BENCH_SOURCES 16
+
+// Local relayout after an edit or while dragging a node
+#define LOCAL_HOPS 2              // neighborhood of the touched nodes that is simulated
+#define LOCAL_MAX_NODES 512       // cap on the simulated nodes
+#define LOCAL_STEPS 120           // ticks simulated after the last touch
+#define LOCAL_GLOBAL_NODES 20000  // larger graphs only take global steps after 'g'
+
+// Overlap removal after every layout tick
+#define OVERLAP_PASSES 32       // most separation passes per tick
+#define OVERLAP_MARGIN 1.001f   // separation aimed for, in node diameters
+#define OVERLAP_SHARE 0.9f      // share of an overlap each node of the pair moves
+#define OVERLAP_MAX_FILL 0.6f   // canvas share covered by circles above which overlaps stay
+#define BENCH_OVERLAP_TICKS 300 // layout ticks run by --bench-overlap
+
+// Majorization steps timed by --bench-stress
+#define BENCH_STRESS_ITERATIONS 50
+
+// Routes per query timed by --bench-routes
+#define BENCH_ROUTES 10
 
+// Attraction passes timed before and after a node reordering
+#define LOCALITY_ROUNDS 10
+
+// Use a constant radius for nodes
+const float NODE_RADIUS = 0.05f;
+
+// Repulsion on every node at the last global force step, which local
+// relayouts keep as the far field
 typedef struct
 {
-  int src, dest;
-  float weight;
-} Edge;
+  std::vector<float> repulsion; // (x, y) per node
+  std::vector<float> xy;        // positions it was computed at
+  std::vector<int> ids;         // node of each entry
+  float k;                      // optimal edge length of that step
+  std::unordered_map<int, int> index; // id to entry, built once indices moved
+} FrozenField;
+FrozenField frozen;
 
-Node nodes[MAX_NODES];
-Edge edges[MAX_NODES * MAX_NODES];
-int node_count = 0, edge_count = 0;
+// Pinned nodes keep their position in every layout engine
+std::vector<int> pinned_ids;
+int drag_id = -1; // node being dragged, or -1
+
+// Nodes edited or dragged since the last layout tick, and the graph version
+// after the edit; an edit made without touching nodes lays out globally
+std::vector<int> touched_ids;
+unsigned int touched_version = 0;
+
+// Local relayout: the simulated nodes and their frozen far field
+bool local_running = false;
+bool global_resumed = false; // 'g' pressed since the last local relayout
+unsigned int local_version = 0; // graph version local_nodes was built for
+int local_steps_left = 0;
+std::vector<int> local_seed_ids;
+std::vector<int> local_nodes;
+std::vector<int> local_slot;   // entry of every node in local_nodes, or -1
+std::vector<float> local_far;  // (x, y) far-field repulsion per simulated node
+std::shared_ptr<const Adjacency> local_adj;
 
 // Forward declarations
 void dijkstra(int start, int end);
+void ingest_frame();
+void ipc_frame(void (*touch)(int node));
+void update_startup();
 void draw_weight_input();
 int find_edge_near(float x, float y);
 float pointToSegmentDistance(float px, float py, float ax, float ay, float bx,
                              float by);
-void delete_node(int node_index);
 void draw_mst();
 void update_layout();
+template <typename Law>
+void force_step();
 void idle();
 void draw_mode_dialog();
+void mouse(int button, int state, int x, int y);
+void motion(int x, int y);
+void keyboard(unsigned char key, int x, int y);
+void resize(int w, int h);
+LayoutBox layout_box();
 
 /**
- * @brief Updates the layout of the nodes using a force-directed algorithm.
+ * @brief Adds the attractive forces between nodes connected by an edge.
+ *
+ * @tparam Law Force law, see forces.h
+ * @param disp Displacement of every node
+ * @param k Optimal edge length
  */
-void update_layout()
+template <typename Law>
+void apply_attraction(float (*disp)[2], float k)
 {
-  if (node_count == 0)
-    return;
-
-  // Compute the wall's x-coordinate in GL space so that nodes don't enter the
-  // side panel.
-  int winWidth = glutGet(GLUT_WINDOW_WIDTH);
-  float wall_x = (MENU_WIDTH_PIXELS / (float)winWidth) * 2.0f -
-                 1.0f; // e.g. ~ -0.625 for 800px width
-
-  float area = 4.0f; // (2x2 coordinate system from -1 to 1)
-  float k = sqrt(area / (float)node_count);
-  float disp[MAX_NODES][2];
-  for (int i = 0; i < node_count; i++)
+  for (int i = 0; i < edge_count; i++)
   {
-    disp[i][0] = 0;
-    disp[i][1] = 0;
+    int src = edges[i].src;
+    int dest = edges[i].dest;
+    float dx = nodes[src].x - nodes[dest].x;
+    float dy = nodes[src].y - nodes[dest].y;
+    float f = Law::attraction(force_dist2(dx, dy), k);
+    disp[src][0] -= dx * f;
+    disp[src][1] -= dy * f;
+    disp[dest][0] += dx * f;
+    disp[dest][1] += dy * f;
   }
+}
 
-  // Repulsive forces between all pairs of nodes
-  for (int i = 0; i < node_count; i++)
+/**
+ * @brief Returns the first row of a chunk of the upper pair triangle.
+ *
+ * Row i holds the pairs (i, j > i), so rows shrink towards the end; the
+ * boundaries are spaced so that every chunk holds about the same number of
+ * pairs.
+ *
+ * @param n Number of rows
+ * @param c Chunk index in [0, chunks]
+ * @param chunks Number of chunks
+ * @return First row of chunk c, or n for c == chunks
+ */
+static int triangle_row(int n, int c, int chunks)
+{
+  if (c >= chunks)
+    return n;
+  return (int)(n - n * sqrt(1.0 - (double)c / chunks));
+}
+
+/**
+ * @brief Adds the repulsion of one node on another.
+ *
+ * @tparam Law Force law, see forces.h
+ * @param dx x offset from the other node
+ * @param dy y offset from the other node
+ * @param k2 Squared optimal edge length
+ * @param mass Mass of the other node, 1 for unweighted laws
+ * @param sum Force to add to
+ */
+template <typename Law>
+static inline void add_repulsion(float dx, float dy, float k2, float mass, float sum[2])
+{
+  float f = mass * Law::repulsion(force_dist2(dx, dy), k2);
+  sum[0] += dx * f;
+  sum[1] += dy * f;
+}
+
+/**
+ * @brief Repulsion between node i and every later node, applied to both.
+ *
+ * The row sum goes to LAYOUT_LANES interleaved partial sums like the
+ * deterministic loop; with the arrays known not to overlap, the compiler
+ * turns both the sums and the stores to the later nodes into vector lanes.
+ *
+ * @tparam Law Force law, see forces.h
+ * @param i Node
+ * @param n Number of nodes
+ * @param k2 Squared optimal edge length
+ * @param px x-coordinates of all nodes
+ * @param py y-coordinates of all nodes
+ * @param mass Mass of every node for weighted laws, else NULL
+ * @param sx Force sums in x, updated at i and every later node
+ * @param sy Force sums in y, updated at i and every later node
+ */
+template <typename Law>
+static void repulse_row(int i, int n, float k2, const float *__restrict px,
+                        const float *__restrict py, const float *__restrict mass,
+                        float *__restrict sx, float *__restrict sy)
+{
+  float xi = px[i], yi = py[i];
+  float mi = Law::weighted ? mass[i] : 1.0f;
+  float lx[LAYOUT_LANES] = {}, ly[LAYOUT_LANES] = {};
+  int j = i + 1;
+  for (; j + LAYOUT_LANES <= n; j += LAYOUT_LANES)
   {
-    for (int j = 0; j < node_count; j++)
+    for (int l = 0; l < LAYOUT_LANES; l++)
     {
-      if (i == j)
-        continue;
-      float dx = nodes[i].x - nodes[j].x;
-      float dy = nodes[i].y - nodes[j].y;
-      float dist = sqrt(dx * dx + dy * dy);
-      if (dist < 0.001f)
-        dist = 0.001f;
-      float force = (k * k) / dist;
-      disp[i][0] += (dx / dist) * force;
-      disp[i][1] += (dy / dist) * force;
+      float dx = xi - px[j + l], dy = yi - py[j + l];
+      float f = Law::repulsion(force_dist2(dx, dy), k2);
+      if (Law::weighted)
+        f *= mi * mass[j + l];
+      float fx = dx * f, fy = dy * f;
+      lx[l] += fx;
+      ly[l] += fy;
+      sx[j + l] -= fx;
+      sy[j + l] -= fy;
     }
   }
-
-  // Attractive forces for nodes connected by an edge
-  for (int i = 0; i < edge_count; i++)
+  for (; j < n; j++)
   {
-    int src = edges[i].src;
-    int dest = edges[i].dest;
-    float dx = nodes[src].x - nodes[dest].x;
-    float dy = nodes[src].y - nodes[dest].y;
-    float dist = sqrt(dx * dx + dy * dy);
-    if (dist < 0.001f)
-      dist = 0.001f;
-    float force = (dist * dist) / k;
-    float fx = (dx / dist) * force;
-    float fy = (dy / dist) * force;
-    disp[src][0] -= fx;
-    disp[src][1] -= fy;
-    disp[dest][0] += fx;
-    disp[dest][1] += fy;
-  }
-
-  // Centering force: pull nodes toward the center (0,0)
-  float centering_strength = 4.0f;
-  for (int i = 0; i < node_count; i++)
+    float dx = xi - px[j], dy = yi - py[j];
+    float f = Law::repulsion(force_dist2(dx, dy), k2);
+    if (Law::weighted)
+      f *= mi * mass[j];
+    float fx = dx * f, fy = dy * f;
+    lx[0] += fx;
+    ly[0] += fy;
+    sx[j] -= fx;
+    sy[j] -= fy;
+  }
+  float tx = 0, ty = 0;
+  for (int l = 0; l < LAYOUT_LANES; l++)
   {
-    disp[i][0] -= nodes[i].x * centering_strength;
-    disp[i][1] -= nodes[i].y * centering_strength;
+    tx += lx[l];
+    ty += ly[l];
   }
+  sx[i] += tx;
+  sy[i] += ty;
+}
 
-  // Update node positions with maximum displacement and damping factor
-  float temp = 0.05f;   // maximum allowed move per iteration
-  float damping = 0.1f; // damping factor to reduce oscillations
-  for (int i = 0; i < node_count; i++)
+/**
+ * @brief Adds the repulsive forces between all pairs of nodes.
+ *
+ * In deterministic mode every node sums the forces of all other nodes in
+ * index order, into LAYOUT_LANES interleaved partial sums that the compiler
+ * turns into vector lanes; the lanes are added in a fixed order, which gives
+ * the same bits on every backend. A node's own term has a zero offset and
+ * adds nothing, so the loop needs no branch. Otherwise each pair is
+ * computed once and applied to both nodes by repulse_row. That halves the
+ * force evaluations but adds a store per pair, so it saves less than half.
+ * The contributions to the second node go to a buffer of the worker that
+ * ran the chunk, so the final sums depend on scheduling in the last bits.
+ *
+ * @tparam Law Force law, see forces.h
+ * @param disp Displacement of every node, zero on entry
+ * @param k Optimal edge length
+ * @param mass Degree + 1 of every node for weighted laws, else NULL
+ */
+template <typename Law>
+void apply_repulsion(float (*disp)[2], float k, const float *mass)
+{
+  int n = node_count;
+  float k2 = k * k;
+  // Positions in separate arrays, so the inner loops load contiguous floats
+  float *px = arena_array<float>(&frame_arena, n);
+  float *py = arena_array<float>(&frame_arena, n);
+  for (int i = 0; i < n; i++)
+  {
+    px[i] = nodes[i].x;
+    py[i] = nodes[i].y;
+  }
+  if (backend_deterministic)
   {
-    float disp_length = sqrt(disp[i][0] * disp[i][0] + disp[i][1] * disp[i][1]);
-    if (disp_length < 0.001f)
-      disp_length = 0.001f;
-    float dx = (disp[i][0] / disp_length) * fmin(disp_length, temp);
-    float dy = (disp[i][1] / disp_length) * fmin(disp_length, temp);
-    nodes[i].x += dx * damping;
-    nodes[i].y += dy * damping;
-    // Clamp x so that nodes do not cross the wall, and clamp y to [-1,1]
-    if (nodes[i].x < wall_x)
-      nodes[i].x = wall_x;
-    if (nodes[i].x > 1)
-      nodes[i].x = 1;
-    if (nodes[i].y < -1)
-      nodes[i].y = -1;
-    if (nodes[i].y > 1)
-      nodes[i].y = 1;
+    backend_for(LAYOUT_CHUNKS, [&](int c)
+                {
+                  int lo = (int)((long long)n * c / LAYOUT_CHUNKS);
+                  int hi = (int)((long long)n * (c + 1) / LAYOUT_CHUNKS);
+                  for (int i = lo; i < hi; i++)
+                  {
+                    float xi = px[i], yi = py[i];
+                    float lx[LAYOUT_LANES] = {}, ly[LAYOUT_LANES] = {};
+                    int j = 0;
+                    for (; j + LAYOUT_LANES <= n; j += LAYOUT_LANES)
+                    {
+                      for (int l = 0; l < LAYOUT_LANES; l++)
+                      {
+                        float dx = xi - px[j + l], dy = yi - py[j + l];
+                        float f = Law::repulsion(force_dist2(dx, dy), k2);
+                        if (Law::weighted)
+                          f *= mass[j + l];
+                        lx[l] += dx * f;
+                        ly[l] += dy * f;
+                      }
+                    }
+                    for (; j < n; j++)
+                    {
+                      float dx = xi - px[j], dy = yi - py[j];
+                      float f = Law::repulsion(force_dist2(dx, dy), k2);
+                      if (Law::weighted)
+                        f *= mass[j];
+                      lx[j % LAYOUT_LANES] += dx * f;
+                      ly[j % LAYOUT_LANES] += dy * f;
+                    }
+                    float sx = 0, sy = 0;
+                    for (int l = 0; l < LAYOUT_LANES; l++)
+                    {
+                      sx += lx[l];
+                      sy += ly[l];
+                    }
+                    float mi = Law::weighted ? mass[i] : 1.0f;
+                    disp[i][0] = sx * mi;
+                    disp[i][1] = sy * mi;
+                  }
+                });
+    return;
   }
+
+  // Per-worker sums of the forces on the second node of each pair, x and y
+  // in separate arrays so the inner loop stores contiguous floats
+  int slots = backend_slots();
+  float *partial = arena_array<float>(&frame_arena, (size_t)slots * 2 * n);
+  memset(partial, 0, sizeof(float) * (size_t)slots * 2 * n);
+  backend_for(LAYOUT_CHUNKS, [&](int c)
+              {
+                float *mx = partial + (size_t)backend_slot() * 2 * n;
+                int lo = triangle_row(n, c, LAYOUT_CHUNKS);
+                int hi = triangle_row(n, c + 1, LAYOUT_CHUNKS);
+                for (int i = lo; i < hi; i++)
+                  repulse_row<Law>(i, n, k2, px, py, mass, mx, mx + n);
+              });
+  backend_for(LAYOUT_CHUNKS, [&](int c)
+              {
+                int lo = (int)((long long)n * c / LAYOUT_CHUNKS);
+                int hi = (int)((long long)n * (c + 1) / LAYOUT_CHUNKS);
+                for (int s = 0; s < slots; s++)
+                {
+                  const float *sx = partial + (size_t)s * 2 * n;
+                  const float *sy = sx + n;
+                  for (int i = lo; i < hi; i++)
+                  {
+                    disp[i][0] += sx[i];
+                    disp[i][1] += sy[i];
+                  }
+                }
+              });
 }
 
 /**
- * @brief Idle function for continuous layout updates.
+ * @brief Degree + 1 of a node, its mass under weighted force laws.
+ *
+ * @param adj Adjacency snapshot
+ * @param i Node
+ * @return Mass
  */
-void idle()
+static inline float node_mass(const Adjacency &adj, int i)
 {
-  update_layout();
-  glutPostRedisplay();
+  return (float)(adj.offsets[i + 1] - adj.offsets[i] + 1);
 }
 
 /**
- * @brief Draws a string at the specified coordinates.
+ * @brief Degree + 1 of every node, the mass of weighted force laws.
  *
- * @param x X-coordinate
- * @param y Y-coordinate
- * @param str String to draw
+ * @param adj Adjacency snapshot
+ * @return Mass per node from the frame arena
  */
-void draw_string(float x, float y, char *str)
+float *layout_masses(const Adjacency &adj)
 {
-  glRasterPos2f(x, y);
-  for (char *c = str; *c != '\0'; c++)
-  {
-    glutBitmapCharacter(GLUT_BITMAP_HELVETICA_18, *c);
-  }
+  float *mass = arena_array<float>(&frame_arena, adj.node_count);
+  for (int i = 0; i < adj.node_count; i++)
+    mass[i] = node_mass(adj, i);
+  return mass;
 }
 
 /**
- * @brief Draws a string at the specified pixel coordinates.
+ * @brief Marks the pinned nodes.
  *
- * @param x X-coordinate in pixels
- * @param y Y-coordinate in pixels
- * @param str String to draw
+ * @return Flag per node from the frame arena, or NULL if nothing is pinned
  */
-void draw_string_pixel(int x, int y, const char *str)
+unsigned char *pinned_mask()
 {
-  glRasterPos2i(x, y);
-  for (const char *c = str; *c != '\0'; c++)
+  if (pinned_ids.empty())
+    return NULL;
+  unsigned char *mask = arena_array<unsigned char>(&frame_arena, node_count);
+  memset(mask, 0, node_count);
+  for (int id : pinned_ids)
   {
-    glutBitmapCharacter(GLUT_BITMAP_HELVETICA_18, *c);
+    int i = graph_node_index(id);
+    if (i != -1)
+      mask[i] = 1;
   }
+  return mask;
 }
 
 /**
- * @brief Draws the nodes as circles with centered labels.
+ * @brief Turns a displacement into the move of one step, limited and
+ *        damped.
+ *
+ * @param disp Displacement
+ * @param move Receives the move
  */
-void draw_nodes()
+static inline void damped_move(const float disp[2], float move[2])
 {
-  int num_segments = 50;
-  for (int i = 0; i < node_count; i++)
-  {
-    float cx = nodes[i].x;
-    float cy = nodes[i].y;
-
-    // Filled circle (node fill color)
-    glColor3f(COLOR_NODE_FILL_R, COLOR_NODE_FILL_G, COLOR_NODE_FILL_B);
-    glBegin(GL_TRIANGLE_FAN);
-    glVertex2f(cx, cy);
-    for (int j = 0; j <= num_segments; j++)
-    {
-      float angle = 2.0f * 3.1415926f * j / num_segments;
-      float x = cx + cos(angle) * NODE_RADIUS;
-      float y = cy + sin(angle) * NODE_RADIUS;
-      glVertex2f(x, y);
-    }
-    glEnd();
-
-    // Circle border (node border color)
-    glColor3f(COLOR_NODE_BORDER_R, COLOR_NODE_BORDER_G, COLOR_NODE_BORDER_B);
-    glLineWidth(1.0f);
-    glBegin(GL_LINE_LOOP);
-    for (int j = 0; j <= num_segments; j++)
-    {
-      float angle = 2.0f * 3.1415926f * j / num_segments;
-      float x = cx + cos(angle) * NODE_RADIUS;
-      float y = cy + sin(angle) * NODE_RADIUS;
-      glVertex2f(x, y);
-    }
-    glEnd();
+  float temp = 0.05f;   // maximum allowed move per iteration
+  float damping = 0.1f; // damping factor to reduce oscillations
+  float disp_length = sqrt(disp[0] * disp[0] + disp[1] * disp[1]);
+  if (disp_length < 0.001f)
+    disp_length = 0.001f;
+  float dx = (disp[0] / disp_length) * fmin(disp_length, temp);
+  float dy = (disp[1] / disp_length) * fmin(disp_length, temp);
+  move[0] = dx * damping;
+  move[1] = dy * damping;
+}
 
-    // Label centered in the circle
-    char label[2] = {nodes[i].label, '\0'};
-    glColor3f(COLOR_TEXT_R, COLOR_TEXT_G, COLOR_TEXT_B);
-    draw_string(cx - 0.008f, cy - 0.02f, label);
-  }
+/**
+ * @brief Moves a node by its displacement, limited and damped, and keeps it
+ *        right of the menu panel.
+ *
+ * @param i Node
+ * @param disp Displacement
+ * @param wall_x Left edge of the canvas in GL coordinates
+ */
+static inline void move_node(int i, const float disp[2], float wall_x)
+{
+  float move[2];
+  damped_move(disp, move);
+  nodes[i].x += move[0];
+  nodes[i].y += move[1];
+  // Clamp x so that nodes do not cross the wall, and clamp y to [-1,1]
+  if (nodes[i].x < wall_x)
+    nodes[i].x = wall_x;
+  if (nodes[i].x > 1)
+    nodes[i].x = 1;
+  if (nodes[i].y < -1)
+    nodes[i].y = -1;
+  if (nodes[i].y > 1)
+    nodes[i].y = 1;
 }
 
 /**
- * @brief Draws the edges between nodes.
+ * @brief Keeps the repulsion of a global step as the far field of later
+ *        local relayouts.
+ *
+ * @param disp Repulsion on every node
+ * @param k Optimal edge length
  */
-void draw_edges()
+void freeze_repulsion(const float (*disp)[2], float k)
 {
-  glColor3f(COLOR_EDGE_R, COLOR_EDGE_G, COLOR_EDGE_B);
-  glLineWidth(4.0f);
-  glBegin(GL_LINES);
-  for (int i = 0; i < edge_count; i++)
+  int n = node_count;
+  frozen.repulsion.resize(2 * (size_t)n);
+  frozen.xy.resize(2 * (size_t)n);
+  frozen.ids.resize(n);
+  memcpy(frozen.repulsion.data(), disp, sizeof(float[2]) * n);
+  for (int i = 0; i < n; i++)
   {
-    Node src = nodes[edges[i].src];
-    Node dest = nodes[edges[i].dest];
-    float dx = dest.x - src.x;
-    float dy = dest.y - src.y;
-    float d = sqrt(dx * dx + dy * dy);
-    if (d == 0)
-      d = 0.0001f;
-    float offsetX = (dx / d) * NODE_RADIUS;
-    float offsetY = (dy / d) * NODE_RADIUS;
-    float startX = src.x + offsetX;
-    float startY = src.y + offsetY;
-    float endX = dest.x - offsetX;
-    float endY = dest.y - offsetY;
-    glVertex2f(startX, startY);
-    glVertex2f(endX, endY);
+    frozen.xy[2 * i] = nodes[i].x;
+    frozen.xy[2 * i + 1] = nodes[i].y;
+    frozen.ids[i] = nodes[i].id;
   }
-  glEnd();
+  frozen.k = k;
+  frozen.index.clear();
+}
 
-  // Draw edge weight labels
-  for (int i = 0; i < edge_count; i++)
+/**
+ * @brief Finds the frozen entry of a node.
+ *
+ * Entries are by index, which only shifts once nodes are deleted or
+ * renumbered; then the lookup goes through an id map built on first use.
+ *
+ * @param i Node
+ * @return Entry in frozen, or -1 if the node is newer than the last global
+ *         step
+ */
+int frozen_entry(int i)
+{
+  int n = (int)frozen.ids.size();
+  if (i < n && frozen.ids[i] == nodes[i].id)
+    return i;
+  if (frozen.index.empty())
   {
-    Node src = nodes[edges[i].src];
-    Node dest = nodes[edges[i].dest];
-    float dx = dest.x - src.x;
-    float dy = dest.y - src.y;
-    float d = sqrt(dx * dx + dy * dy);
-    if (d == 0)
-      d = 0.0001f;
-    float offsetX = (dx / d) * NODE_RADIUS;
-    float offsetY = (dy / d) * NODE_RADIUS;
-    float startX = src.x + offsetX;
-    float startY = src.y + offsetY;
-    float endX = dest.x - offsetX;
-    float endY = dest.y - offsetY;
-    float midX = (startX + endX) / 2;
-    float midY = (startY + endY) / 2;
-
-    float label_offset = 0.03f;
-    float perpX = -dy / d;
-    float perpY = dx / d;
-    float labelX = midX + label_offset * perpX;
-    float labelY = midY + label_offset * perpY;
-
-    char weight_str[10];
-    sprintf(weight_str, "%.1f", edges[i].weight);
-    glColor3f(COLOR_TEXT_R, COLOR_TEXT_G, COLOR_TEXT_B);
-    draw_string(labelX - 0.015f, labelY - 0.015f, weight_str);
+    for (int e = 0; e < n; e++)
+      frozen.index.emplace(frozen.ids[e], e);
   }
+  auto it = frozen.index.find(nodes[i].id);
+  return it == frozen.index.end() ? -1 : it->second;
 }
 
 /**
- * @brief Draws the shortest path between two nodes.
+ * @brief Marks a node as edited or dragged, so that the next layout ticks
+ *        only simulate its neighborhood.
+ *
+ * Touching a node of the running local relayout just keeps it going.
+ *
+ * @param i Node
  */
-void draw_shortest_path()
+void layout_touch(int i)
 {
-  if (shortest_path_length < 2)
+  if (i < 0 || i >= node_count)
     return;
-  glColor3f(COLOR_SP_R, COLOR_SP_G, COLOR_SP_B);
-  glLineWidth(4.0f);
-  glBegin(GL_LINES);
-  for (int i = 0; i < shortest_path_length - 1; i++)
+  touched_version = graph_version;
+  if (local_running && local_version == graph_version && local_slot[i] != -1)
   {
-    Node src = nodes[shortest_path_nodes[i]];
-    Node dest = nodes[shortest_path_nodes[i + 1]];
-    float dx = dest.x - src.x;
-    float dy = dest.y - src.y;
-    float d = sqrt(dx * dx + dy * dy);
-    if (d == 0)
-      d = 0.0001f;
-    float offsetX = (dx / d) * NODE_RADIUS;
-    float offsetY = (dy / d) * NODE_RADIUS;
-    float startX = src.x + offsetX;
-    float startY = src.y + offsetY;
-    float endX = dest.x - offsetX;
-    float endY = dest.y - offsetY;
-    glVertex2f(startX, startY);
-    glVertex2f(endX, endY);
+    local_steps_left = LOCAL_STEPS;
+    return;
   }
-  glEnd();
+  touched_ids.push_back(nodes[i].id);
 }
 
 /**
- * @brief Draws the Minimum Spanning Tree (MST) using Kruskal's algorithm.
+ * @brief Starts a local relayout around the touched nodes.
+ *
+ * The nodes within LOCAL_HOPS hops of the touched ones, and of those of a
+ * relayout still running, are simulated; all others hold still. Their
+ * repulsion on a simulated node is the frozen repulsion of the last global
+ * step minus that of the simulated nodes at the time, rescaled to the
+ * current optimal edge length. A node added since then gets the exact
+ * repulsion of the nodes that hold still instead.
+ *
+ * @tparam Law Force law, see forces.h
  */
-void draw_mst()
+template <typename Law>
+void local_begin()
 {
-  typedef struct
-  {
-    int src, dest;
-    float weight;
-  } MstEdge;
-
-  MstEdge mst_edges[MAX_NODES];
-  int mst_count = 0;
+  if (local_running && local_steps_left > 0)
+    touched_ids.insert(touched_ids.end(), local_seed_ids.begin(), local_seed_ids.end());
+  std::sort(touched_ids.begin(), touched_ids.end());
+  touched_ids.erase(std::unique(touched_ids.begin(), touched_ids.end()), touched_ids.end());
+  local_seed_ids = touched_ids;
 
-  int parent[MAX_NODES];
-  for (int i = 0; i < node_count; i++)
-  {
-    parent[i] = i;
-  }
-  auto find = [&](int x) -> int
+  local_adj = graph_adjacency();
+  const Adjacency &adj = *local_adj;
+  local_slot.assign(node_count, -1);
+  local_nodes.clear();
+  for (int id : local_seed_ids)
   {
-    while (parent[x] != x)
+    int i = graph_node_index(id);
+    if (i != -1 && local_slot[i] == -1 && (int)local_nodes.size() < LOCAL_MAX_NODES)
     {
-      parent[x] = parent[parent[x]];
-      x = parent[x];
+      local_slot[i] = (int)local_nodes.size();
+      local_nodes.push_back(i);
     }
-    return x;
-  };
-  auto union_set = [&](int x, int y)
-  {
-    int rootx = find(x);
-    int rooty = find(y);
-    parent[rootx] = rooty;
-  };
-
-  int indices[MAX_NODES * MAX_NODES];
-  for (int i = 0; i < edge_count; i++)
-  {
-    indices[i] = i;
   }
-  for (int i = 0; i < edge_count - 1; i++)
+  size_t begin = 0;
+  for (int hop = 0; hop < LOCAL_HOPS; hop++)
   {
-    for (int j = i + 1; j < edge_count; j++)
+    size_t end = local_nodes.size();
+    for (size_t a = begin; a < end; a++)
     {
-      if (edges[indices[j]].weight < edges[indices[i]].weight)
+      int i = local_nodes[a];
+      for (int e = adj.offsets[i]; e < adj.offsets[i + 1]; e++)
       {
-        int temp = indices[i];
-        indices[i] = indices[j];
-        indices[j] = temp;
+        int j = adj.targets[e];
+        if (local_slot[j] == -1 && (int)local_nodes.size() < LOCAL_MAX_NODES)
+        {
+          local_slot[j] = (int)local_nodes.size();
+          local_nodes.push_back(j);
+        }
       }
     }
+    begin = end;
   }
 
-  for (int i = 0; i < edge_count; i++)
+  int m = (int)local_nodes.size(), n = node_count;
+  std::vector<int> entry(m);
+  for (int a = 0; a < m; a++)
+    entry[a] = frozen_entry(local_nodes[a]);
+  float k = sqrt(4.0f / (float)n);
+  float k2 = k * k;
+  float rescale = entry.empty() || frozen.k == 0 ? 0 : k2 / (frozen.k * frozen.k);
+  local_far.assign(2 * (size_t)m, 0);
+  backend_for(LAYOUT_CHUNKS, [&](int c)
+              {
+                int lo = (int)((long long)m * c / LAYOUT_CHUNKS);
+                int hi = (int)((long long)m * (c + 1) / LAYOUT_CHUNKS);
+                for (int a = lo; a < hi; a++)
+                {
+                  float *far = &local_far[2 * (size_t)a];
+                  int i = local_nodes[a];
+                  int s = entry[a];
+                  float mi = Law::weighted ? node_mass(adj, i) : 1.0f;
+                  if (s == -1)
+                  {
+                    for (int j = 0; j < n; j++)
+                    {
+                      if (local_slot[j] == -1)
+                        add_repulsion<Law>(nodes[i].x - nodes[j].x, nodes[i].y - nodes[j].y, k2,
+                                           mi * (Law::weighted ? node_mass(adj, j) : 1.0f), far);
+                    }
+                    continue;
+                  }
+                  float near[2] = {0, 0};
+                  for (int b = 0; b < m; b++)
+                  {
+                    int t = entry[b];
+                    if (b != a && t != -1)
+                      add_repulsion<Law>(frozen.xy[2 * s] - frozen.xy[2 * t],
+                                         frozen.xy[2 * s + 1] - frozen.xy[2 * t + 1], k2,
+                                         mi * (Law::weighted ? node_mass(adj, local_nodes[b]) : 1.0f),
+                                         near);
+                  }
+                  far[0] = frozen.repulsion[2 * s] * rescale - near[0];
+                  far[1] = frozen.repulsion[2 * s + 1] * rescale - near[1];
+                }
+              });
+  local_running = true;
+  global_resumed = false;
+  local_version = graph_version;
+  local_steps_left = LOCAL_STEPS;
+}
+
+/**
+ * @brief Runs one force step of the local relayout.
+ *
+ * Simulated nodes feel the frozen far field, each other's repulsion, the
+ * attraction of all their edges and the centering force; everything else
+ * holds still.
+ *
+ * @tparam Law Force law, see forces.h
+ */
+template <typename Law>
+void local_step()
+{
+  int m = (int)local_nodes.size();
+  if (m == 0)
+    return;
+  const Adjacency &adj = *local_adj;
+  float wall_x = layout_box().x0;
+  float k = sqrt(4.0f / (float)node_count);
+  float k2 = k * k;
+  float(*disp)[2] = arena_array<float[2]>(&frame_arena, m);
+  for (int a = 0; a < m; a++)
   {
-    int idx = indices[i];
-    int u = edges[idx].src;
-    int v = edges[idx].dest;
-    if (find(u) != find(v))
+    int i = local_nodes[a];
+    float xi = nodes[i].x, yi = nodes[i].y;
+    float mi = Law::weighted ? node_mass(adj, i) : 1.0f;
+    float sum[2] = {local_far[2 * a], local_far[2 * a + 1]};
+    for (int b = 0; b < m; b++)
     {
-      union_set(u, v);
-      mst_edges[mst_count].src = u;
-      mst_edges[mst_count].dest = v;
-      mst_edges[mst_count].weight = edges[idx].weight;
-      mst_count++;
-      if (mst_count == node_count - 1)
-        break;
+      int j = local_nodes[b];
+      add_repulsion<Law>(xi - nodes[j].x, yi - nodes[j].y, k2,
+                         mi * (Law::weighted ? node_mass(adj, j) : 1.0f), sum);
     }
+    for (int e = adj.offsets[i]; e < adj.offsets[i + 1]; e++)
+    {
+      int j = adj.targets[e];
+      float dx = xi - nodes[j].x;
+      float dy = yi - nodes[j].y;
+      float f = Law::attraction(force_dist2(dx, dy), k);
+      sum[0] -= dx * f;
+      sum[1] -= dy * f;
+    }
+    disp[a][0] = sum[0] - xi * Law::gravity(mi);
+    disp[a][1] = sum[1] - yi * Law::gravity(mi);
   }
-
-  for (int i = 0; i < mst_count; i++)
+  unsigned char *pinned = pinned_mask();
+  for (int a = 0; a < m; a++)
   {
-    mst_sum += mst_edges[i].weight;
+    if (!pinned || !pinned[local_nodes[a]])
+      move_node(local_nodes[a], disp[a], wall_x);
   }
+}
 
+/**
+ * @brief Runs one tick of the force-directed engine.
+ *
+ * Edits that touched nodes start a local relayout; any other change of the
+ * graph goes back to global steps. After LOCAL_STEPS ticks without a touch
+ * the global steps resume, except on graphs above LOCAL_GLOBAL_NODES, whose
+ * O(N^2) global step would stall the window: those hold still until 'g',
+ * from the start and after every local relayout.
+ *
+ * @tparam Law Force law, see forces.h
+ */
+template <typename Law>
+void force_tick()
+{
+  if (!touched_ids.empty() && touched_version == graph_version)
+    local_begin<Law>();
+  touched_ids.clear();
+  if (local_running && local_version == graph_version)
+  {
+    if (local_steps_left > 0)
+    {
+      local_step<Law>();
+      local_steps_left--;
+      return;
+    }
+    if (node_count > LOCAL_GLOBAL_NODES)
+      return;
+  }
+  local_running = false;
+  if (node_count > LOCAL_GLOBAL_NODES && !global_resumed)
+    return;
+  force_step<Law>();
+}
+
+/**
+ * @brief Runs one tick of the force-directed engine with the selected force
+ *        law.
+ */
+void update_force_layout()
+{
+  if (force_law == FORCE_LINLOG)
+    force_tick<ForceLinLog>();
+  else if (force_law == FORCE_ATLAS)
+    force_tick<ForceAtlas>();
+  else
+    force_tick<ForceFR>();
+}
+
+/**
+ * @brief Runs one global step of the force-directed layout with the
+ *        selected force law.
+ */
+void update_layout()
+{
+  if (force_law == FORCE_LINLOG)
+    force_step<ForceLinLog>();
+  else if (force_law == FORCE_ATLAS)
+    force_step<ForceAtlas>();
+  else
+    force_step<ForceFR>();
+}
+
+/**
+ * @brief Moves all nodes by one step of a force-directed layout.
+ *
+ * Repulsion and the position update run on the selected execution backend;
+ * attraction scatters into both ends of every edge and stays serial.
+ *
+ * @tparam Law Force law, see forces.h
+ */
+template <typename Law>
+void force_step()
+{
+  if (node_count == 0)
+    return;
+
+  // Compute the wall's x-coordinate in GL space so that nodes don't enter the
+  // side panel.
+  float wall_x = (MENU_WIDTH_PIXELS / (float)window_w) * 2.0f -
+                 1.0f; // e.g. ~ -0.625 for 800px width
+
+  float area = 4.0f; // (2x2 coordinate system from -1 to 1)
+  float k = sqrt(area / (float)node_count);
+  float(*disp)[2] = arena_array<float[2]>(&frame_arena, node_count);
+  memset(disp, 0, sizeof(float[2]) * node_count);
+
+  float *mass = NULL;
+  std::shared_ptr<const Adjacency> adj;
+  if (Law::weighted)
+  {
+    adj = graph_adjacency();
+    mass = layout_masses(*adj);
+  }
+  apply_repulsion<Law>(disp, k, mass);
+  freeze_repulsion(disp, k);
+  apply_attraction<Law>(disp, k);
+
+  int n = node_count;
+  unsigned char *pinned = pinned_mask();
+  backend_for(LAYOUT_CHUNKS, [&](int c)
+              {
+                int lo = (int)((long long)n * c / LAYOUT_CHUNKS);
+                int hi = (int)((long long)n * (c + 1) / LAYOUT_CHUNKS);
+                for (int i = lo; i < hi; i++)
+                {
+                  // Centering force: pull nodes toward the center (0,0)
+                  float gravity = Law::gravity(Law::weighted ? mass[i] : 1.0f);
+                  disp[i][0] -= nodes[i].x * gravity;
+                  disp[i][1] -= nodes[i].y * gravity;
+
+                  if (!pinned || !pinned[i])
+                    move_node(i, disp[i], wall_x);
+                }
+              });
+}
+
+/**
+ * @brief Area the layout keeps the nodes in: the canvas right of the menu.
+ *
+ * @return Layout box in GL coordinates
+ */
+LayoutBox layout_box()
+{
+  LayoutBox box = {(MENU_WIDTH_PIXELS / (float)window_w) * 2.0f - 1.0f, -1, 1, 1};
+  return box;
+}
+
+/**
+ * @brief Runs one stress majorization step.
+ *
+ * The stress model of a new graph version is built on a background task;
+ * the nodes hold still until it is ready. When recording or replaying, the
+ * build is waited for instead, so the step a model is first used at is the
+ * same in both runs. The pivot-MDS placement replaces the positions when the
+ * engine is switched on and when the graph was replaced by one of a very
+ * different size.
+ */
+void update_stress_layout()
+{
+  query_collect(&stress_query);
+  if (stress_query.shown != graph_version)
+  {
+    if (!stress_query.task || stress_query.version != graph_version)
+    {
+      std::shared_ptr<const Adjacency> adj = graph_adjacency();
+      LayoutBox box = layout_box();
+      unsigned int seed = session_seed;
+      query_start(&stress_query, [adj, box, seed](StressModel *out)
+                  { stress_build(*adj, box, seed, out); },
+                  TASK_BACKGROUND);
+    }
+    if (record_active() || replay_active())
+    {
+      task_wait(stress_query.task);
+      query_collect(&stress_query);
+    }
+    if (stress_query.shown != graph_version)
+      return;
+  }
+
+  const StressModel &model = stress_query.front;
+  if (stress_placed < 0 || abs(node_count - stress_placed) * 2 > stress_placed)
+  {
+    for (int i = 0; i < node_count; i++)
+    {
+      nodes[i].x = model.x[i];
+      nodes[i].y = model.y[i];
+    }
+    stress_placed = node_count;
+  }
+  float(*next)[2] = arena_array<float[2]>(&frame_arena, node_count);
+  unsigned char *pinned = pinned_mask();
+  Node *held = NULL;
+  if (pinned)
+  {
+    held = arena_array<Node>(&frame_arena, node_count);
+    memcpy(held, nodes, sizeof(Node) * node_count);
+  }
+  stress_value = stress_step(model, nodes, layout_box(), next);
+  for (int i = 0; pinned && i < node_count; i++)
+  {
+    if (pinned[i])
+      nodes[i] = held[i];
+  }
+}
+
+/**
+ * @brief Pushes overlapping nodes apart after a layout tick.
+ *
+ * The broad phase buckets nodes into a grid of cells one node diameter
+ * wide, so only nodes in neighboring cells can overlap. Each pass then
+ * computes, in parallel over node ranges, how far every node must move to
+ * clear the nodes it overlaps, and applies the moves together. Each node of
+ * a pair moves by OVERLAP_SHARE of the overlap, or all of it against a
+ * pinned node; the pair overshoots contact, which clears packed clusters
+ * in far fewer passes than splitting the overlap evenly. Passes repeat
+ * until nothing overlaps or OVERLAP_PASSES ran; as the layout converges
+ * the moves per tick shrink, and the last pass leaves the circles apart.
+ * A pass costs O(N) plus the pairs in neighboring cells. Canvases more
+ * than OVERLAP_MAX_FILL covered by circles cannot be cleared and are left
+ * as they are. Pairs of pinned nodes are not counted, since no pass can
+ * move them apart.
+ *
+ * @return Overlapping pairs found by the last pass, or -1 if skipped
+ */
+int remove_overlaps()
+{
+  int n = node_count;
+  LayoutBox box = layout_box();
+  float width = box.x1 - box.x0, height = box.y1 - box.y0;
+  float diameter = 2 * NODE_RADIUS;
+  if (n < 2 || n * 3.1415926f * NODE_RADIUS * NODE_RADIUS > OVERLAP_MAX_FILL * width * height)
+    return -1;
+  int cols = (int)ceilf(width / diameter), rows = (int)ceilf(height / diameter);
+  int cells = cols * rows;
+  int *cell_of = arena_array<int>(&frame_arena, n);
+  int *start = arena_array<int>(&frame_arena, cells + 1);
+  int *order = arena_array<int>(&frame_arena, n);
+  float(*push)[2] = arena_array<float[2]>(&frame_arena, n);
+  int *overlaps = arena_array<int>(&frame_arena, LAYOUT_CHUNKS);
+  unsigned char *pinned = pinned_mask();
+  // Aim slightly past contact, so rounding cannot leave a sliver of overlap
+  float target = diameter * OVERLAP_MARGIN;
+
+  int found = 0;
+  for (int pass = 0; pass < OVERLAP_PASSES; pass++)
+  {
+    memset(start, 0, sizeof(int) * (cells + 1));
+    for (int i = 0; i < n; i++)
+    {
+      int cx = std::min(std::max((int)((nodes[i].x - box.x0) / diameter), 0), cols - 1);
+      int cy = std::min(std::max((int)((nodes[i].y - box.y0) / diameter), 0), rows - 1);
+      cell_of[i] = cy * cols + cx;
+      start[cell_of[i] + 1]++;
+    }
+    for (int c = 0; c < cells; c++)
+      start[c + 1] += start[c];
+    for (int i = 0; i < n; i++)
+      order[start[cell_of[i]]++] = i;
+    for (int c = cells; c > 0; c--)
+      start[c] = start[c - 1];
+    start[0] = 0;
+
+    backend_for(LAYOUT_CHUNKS, [&](int ch)
+                {
+                  int lo = (int)((long long)n * ch / LAYOUT_CHUNKS);
+                  int hi = (int)((long long)n * (ch + 1) / LAYOUT_CHUNKS);
+                  int count = 0;
+                  for (int i = lo; i < hi; i++)
+                  {
+                    push[i][0] = push[i][1] = 0;
+                    int cx = cell_of[i] % cols, cy = cell_of[i] / cols;
+                    for (int y = std::max(cy - 1, 0); y <= std::min(cy + 1, rows - 1); y++)
+                    {
+                      for (int x = std::max(cx - 1, 0); x <= std::min(cx + 1, cols - 1); x++)
+                      {
+                        for (int s = start[y * cols + x]; s < start[y * cols + x + 1]; s++)
+                        {
+                          int j = order[s];
+                          float dx = nodes[i].x - nodes[j].x;
+                          float dy = nodes[i].y - nodes[j].y;
+                          float d2 = dx * dx + dy * dy;
+                          if (j == i || d2 >= diameter * diameter)
+                            continue;
+                          // Two pinned nodes stay put, so passes cannot clear them
+                          if (pinned && pinned[i] && pinned[j])
+                            continue;
+                          count++;
+                          if (pinned && pinned[i])
+                            continue;
+                          float d = sqrtf(d2);
+                          float gap = (target - d) * (pinned && pinned[j] ? 1.0f : OVERLAP_SHARE);
+                          if (d < 1e-6f)
+                          {
+                            // Nodes on one spot part along a direction
+                            // fixed by their indices
+                            float angle = 0.618034f * 6.2831853f * (i < j ? j : i);
+                            dx = (i < j ? 1 : -1) * cosf(angle);
+                            dy = (i < j ? 1 : -1) * sinf(angle);
+                            d = 1;
+                          }
+                          push[i][0] += dx / d * gap;
+                          push[i][1] += dy / d * gap;
+                        }
+                      }
+                    }
+                  }
+                  overlaps[ch] = count;
+                });
+    found = 0;
+    for (int ch = 0; ch < LAYOUT_CHUNKS; ch++)
+      found += overlaps[ch];
+    found /= 2; // every pair is seen from both ends
+    if (found == 0)
+      break;
+    backend_for(LAYOUT_CHUNKS, [&](int ch)
+                {
+                  int lo = (int)((long long)n * ch / LAYOUT_CHUNKS);
+                  int hi = (int)((long long)n * (ch + 1) / LAYOUT_CHUNKS);
+                  for (int i = lo; i < hi; i++)
+                  {
+                    nodes[i].x = std::min(std::max(nodes[i].x + push[i][0], box.x0), box.x1);
+                    nodes[i].y = std::min(std::max(nodes[i].y + push[i][1], box.y0), box.y1);
+                  }
+                });
+  }
+  return found;
+}
+
+/**
+ * @brief Radius of a community's disk in the collapsed view.
+ *
+ * @param size Members of the community
+ * @param open Whether the community is open
+ * @return Radius in GL units; a community of one node is that node
+ */
+float community_radius(int size, bool open)
+{
+  if (size <= 1)
+    return NODE_RADIUS;
+  if (open)
+    return std::min(COMMUNITY_OPEN_SPACING * NODE_RADIUS * sqrtf((float)size),
+                    COMMUNITY_OPEN_MAX_RADIUS);
+  return std::min(NODE_RADIUS * sqrtf((float)size), COMMUNITY_MAX_RADIUS);
+}
+
+/**
+ * @brief Keeps the communities of the collapsed view up to date.
+ *
+ * Labels are kept by node id, so a result for an older graph version still
+ * applies to the nodes that remain. A new detection starts once the
+ * previous one is done and the graph has changed since, which keeps a live
+ * feed from restarting it every frame. When recording or replaying,
+ * detection is waited for, as the stress model build is.
+ */
+void update_communities()
+{
+  if (query_collect(&community_query, true))
+    community_results++;
+  if (community_query.task || (community_results > 0 && community_query.shown == graph_version))
+    return;
+  std::shared_ptr<const Adjacency> adj = graph_adjacency();
+  std::vector<int> ids(node_count);
+  for (int i = 0; i < node_count; i++)
+    ids[i] = nodes[i].id;
+  query_start(&community_query, [adj, ids](CommunityResult *out)
+              {
+                auto start = std::chrono::steady_clock::now();
+                out->ids = ids;
+                detect_communities(*adj, &out->community, &out->stats);
+                out->ms = std::chrono::duration<double, std::milli>(
+                              std::chrono::steady_clock::now() - start)
+                              .count();
+              });
+  if (record_active() || replay_active())
+  {
+    task_wait(community_query.task);
+    if (query_collect(&community_query, true))
+      community_results++;
+  }
+}
+
+/**
+ * @brief Scales the offsets of a community's members from its center.
+ *
+ * @param c Community
+ * @param radius Largest offset wanted
+ * @param grow Also spread members that fit already; members on one spot
+ *        are spread along a sunflower spiral
+ */
+void fit_members(int c, float radius, bool grow)
+{
+  const CommunityGraph &g = collapsed.graph;
+  int m0 = g.member_offsets[c], m1 = g.member_offsets[c + 1];
+  float cx = collapsed.xy[2 * c], cy = collapsed.xy[2 * c + 1];
+  float far = 0;
+  for (int m = m0; m < m1; m++)
+  {
+    int u = g.members[m];
+    far = std::max(far, (nodes[u].x - cx) * (nodes[u].x - cx) + (nodes[u].y - cy) * (nodes[u].y - cy));
+  }
+  far = sqrtf(far);
+  if (far < 1e-4f)
+  {
+    if (!grow)
+      return;
+    for (int m = m0; m < m1; m++)
+    {
+      float r = radius * sqrtf((m - m0 + 0.5f) / (m1 - m0));
+      float angle = 2.39996f * (m - m0); // golden angle
+      nodes[g.members[m]].x = cx + r * cosf(angle);
+      nodes[g.members[m]].y = cy + r * sinf(angle);
+    }
+    return;
+  }
+  if (far <= radius && !grow)
+    return;
+  float scale = radius / far;
+  for (int m = m0; m < m1; m++)
+  {
+    int u = g.members[m];
+    nodes[u].x = cx + (nodes[u].x - cx) * scale;
+    nodes[u].y = cy + (nodes[u].y - cy) * scale;
+  }
+}
+
+/**
+ * @brief Rebuilds the collapsed view after the graph or its communities
+ *        changed.
+ *
+ * Nodes added since the last detection join the community of their first
+ * labeled neighbor, or form their own. Communities are renumbered by their
+ * lowest node and centered on the centroid of their members. When new
+ * labels arrive, and when the view is entered, the members are packed into
+ * their community's disk. O(N + E).
+ */
+void build_collapsed()
+{
+  if (community_results == 0)
+    return;
+  bool relabeled = !collapsed.built || collapsed.result != community_results;
+  if (!relabeled && collapsed.version == graph_version)
+    return;
+  const CommunityResult &result = community_query.front;
+  std::shared_ptr<const Adjacency> adj = graph_adjacency();
+  int n = node_count;
+  std::vector<int> label(n, -1);
+  for (size_t a = 0; a < result.ids.size(); a++)
+  {
+    int i = graph_node_index(result.ids[a]);
+    if (i != -1)
+      label[i] = result.community[a];
+  }
+  int labels = result.stats.count;
+  for (int i = 0; i < n; i++)
+  {
+    for (int e = adj->offsets[i]; e < adj->offsets[i + 1] && label[i] == -1; e++)
+      label[i] = label[adj->targets[e]];
+    if (label[i] == -1)
+      label[i] = labels++;
+  }
+  std::vector<int> renumber(labels, -1);
+  int count = 0;
+  collapsed.community.resize(n);
+  for (int i = 0; i < n; i++)
+  {
+    int &c = renumber[label[i]];
+    if (c == -1)
+      c = count++;
+    collapsed.community[i] = c;
+  }
+  community_graph(*adj, collapsed.community, count, &collapsed.graph);
+  collapsed.adj = adj;
+
+  const CommunityGraph &g = collapsed.graph;
+  collapsed.open.assign(count, 0);
+  std::vector<int> kept;
+  for (int id : open_ids)
+  {
+    int i = graph_node_index(id);
+    if (i != -1 && !collapsed.open[collapsed.community[i]])
+    {
+      collapsed.open[collapsed.community[i]] = 1;
+      kept.push_back(id);
+    }
+  }
+  open_ids.swap(kept);
+  collapsed.xy.assign(2 * (size_t)count, 0);
+  for (int c = 0; c < count; c++)
+  {
+    int size = g.member_offsets[c + 1] - g.member_offsets[c];
+    for (int m = g.member_offsets[c]; m < g.member_offsets[c + 1]; m++)
+    {
+      collapsed.xy[2 * c] += nodes[g.members[m]].x / size;
+      collapsed.xy[2 * c + 1] += nodes[g.members[m]].y / size;
+    }
+    if (size == 1)
+      collapsed.open[c] = 1;
+    else if (relabeled)
+      fit_members(c, community_radius(size, collapsed.open[c]) - NODE_RADIUS, false);
+  }
+  collapsed.built = true;
+  collapsed.version = graph_version;
+  collapsed.result = community_results;
+}
+
+/**
+ * @brief Lays out the members of an open community inside its disk.
+ *
+ * Runs the force law on the members and the edges between them in the
+ * frame of the disk, scaled to the unit disk, so the members spread as a
+ * graph of that size would over the canvas.
+ *
+ * @tparam Law Force law, see forces.h
+ * @param c Community
+ * @param pinned Pinned flag per node, or NULL
+ */
+template <typename Law>
+void open_step(int c, const unsigned char *pinned)
+{
+  const CommunityGraph &g = collapsed.graph;
+  const Adjacency &adj = *collapsed.adj;
+  int m0 = g.member_offsets[c], s = g.member_offsets[c + 1] - m0;
+  float cx = collapsed.xy[2 * c], cy = collapsed.xy[2 * c + 1];
+  float radius = community_radius(s, true) - NODE_RADIUS;
+  float k = sqrtf(3.1415926f / (float)s);
+  float k2 = k * k;
+  float *px = arena_array<float>(&frame_arena, 2 * (size_t)s);
+  for (int a = 0; a < s; a++)
+  {
+    int u = g.members[m0 + a];
+    px[2 * a] = (nodes[u].x - cx) / radius;
+    px[2 * a + 1] = (nodes[u].y - cy) / radius;
+  }
+  for (int a = 0; a < s; a++)
+  {
+    int u = g.members[m0 + a];
+    if (pinned && pinned[u])
+      continue;
+    float xi = px[2 * a], yi = px[2 * a + 1];
+    float mi = Law::weighted ? node_mass(adj, u) : 1.0f;
+    float sum[2] = {0, 0};
+    for (int b = 0; b < s; b++)
+      add_repulsion<Law>(xi - px[2 * b], yi - px[2 * b + 1], k2,
+                         mi * (Law::weighted ? node_mass(adj, g.members[m0 + b]) : 1.0f), sum);
+    for (int e = adj.offsets[u]; e < adj.offsets[u + 1]; e++)
+    {
+      int v = adj.targets[e];
+      if (collapsed.community[v] != c)
+        continue;
+      // Members are listed in node order
+      int b = (int)(std::lower_bound(&g.members[m0], &g.members[m0] + s, v) - &g.members[m0]);
+      float dx = xi - px[2 * b];
+      float dy = yi - px[2 * b + 1];
+      float f = Law::attraction(force_dist2(dx, dy), k);
+      sum[0] -= dx * f;
+      sum[1] -= dy * f;
+    }
+    sum[0] -= xi * Law::gravity(mi);
+    sum[1] -= yi * Law::gravity(mi);
+    float move[2];
+    damped_move(sum, move);
+    float x = xi + move[0], y = yi + move[1];
+    float d = sqrtf(x * x + y * y);
+    if (d > 1)
+    {
+      x /= d;
+      y /= d;
+    }
+    nodes[u].x = cx + x * radius;
+    nodes[u].y = cy + y * radius;
+  }
+}
+
+/**
+ * @brief Runs one force step of the collapsed view.
+ *
+ * Supernodes repel each other and attract along their links, each link
+ * counting once, with the optimal edge length of a graph with one node per
+ * community; weighted laws weigh a supernode by its links. Members move
+ * with their community, and a community holding a pinned node stays put.
+ * Open communities of up to LOCAL_MAX_NODES members also lay out their
+ * members inside their disk. A step costs O(C^2 + N) for C communities,
+ * plus O(s^2) per open community of s members.
+ *
+ * @tparam Law Force law, see forces.h
+ */
+template <typename Law>
+void collapsed_step()
+{
+  const CommunityGraph &g = collapsed.graph;
+  int count = g.count;
+  if (count == 0)
+    return;
+  LayoutBox box = layout_box();
+  float k = sqrtf(4.0f / (float)count);
+  float k2 = k * k;
+  int links = (int)g.link_edges.size();
+  float *mass = arena_array<float>(&frame_arena, count);
+  for (int c = 0; c < count; c++)
+    mass[c] = 1;
+  for (int l = 0; Law::weighted && l < links; l++)
+  {
+    mass[g.link_ends[2 * l]]++;
+    mass[g.link_ends[2 * l + 1]]++;
+  }
+  unsigned char *pinned = pinned_mask();
+  unsigned char *held = arena_array<unsigned char>(&frame_arena, count);
+  memset(held, 0, count);
+  for (int i = 0; pinned && i < node_count; i++)
+  {
+    if (pinned[i])
+      held[collapsed.community[i]] = 1;
+  }
+
+  float *xy = collapsed.xy.data();
+  float(*disp)[2] = arena_array<float[2]>(&frame_arena, count);
+  backend_for(LAYOUT_CHUNKS, [&](int ch)
+              {
+                int lo = (int)((long long)count * ch / LAYOUT_CHUNKS);
+                int hi = (int)((long long)count * (ch + 1) / LAYOUT_CHUNKS);
+                for (int c = lo; c < hi; c++)
+                {
+                  float sum[2] = {0, 0};
+                  for (int d = 0; d < count; d++)
+                    add_repulsion<Law>(xy[2 * c] - xy[2 * d], xy[2 * c + 1] - xy[2 * d + 1], k2,
+                                       mass[c] * mass[d], sum);
+                  disp[c][0] = sum[0] - xy[2 * c] * Law::gravity(mass[c]);
+                  disp[c][1] = sum[1] - xy[2 * c + 1] * Law::gravity(mass[c]);
+                }
+              });
+  for (int l = 0; l < links; l++)
+  {
+    int a = g.link_ends[2 * l], b = g.link_ends[2 * l + 1];
+    float dx = xy[2 * a] - xy[2 * b];
+    float dy = xy[2 * a + 1] - xy[2 * b + 1];
+    float f = Law::attraction(force_dist2(dx, dy), k);
+    disp[a][0] -= dx * f;
+    disp[a][1] -= dy * f;
+    disp[b][0] += dx * f;
+    disp[b][1] += dy * f;
+  }
+  backend_for(LAYOUT_CHUNKS, [&](int ch)
+              {
+                int lo = (int)((long long)count * ch / LAYOUT_CHUNKS);
+                int hi = (int)((long long)count * (ch + 1) / LAYOUT_CHUNKS);
+                for (int c = lo; c < hi; c++)
+                {
+                  if (held[c])
+                    continue;
+                  int m0 = g.member_offsets[c], m1 = g.member_offsets[c + 1];
+                  float r = community_radius(m1 - m0, collapsed.open[c]);
+                  float move[2];
+                  damped_move(disp[c], move);
+                  float mid_x = (box.x0 + box.x1) / 2, mid_y = (box.y0 + box.y1) / 2;
+                  float x = std::min(std::max(xy[2 * c] + move[0], std::min(box.x0 + r, mid_x)),
+                                     std::max(box.x1 - r, mid_x));
+                  float y = std::min(std::max(xy[2 * c + 1] + move[1], std::min(box.y0 + r, mid_y)),
+                                     std::max(box.y1 - r, mid_y));
+                  float dx = x - xy[2 * c], dy = y - xy[2 * c + 1];
+                  xy[2 * c] = x;
+                  xy[2 * c + 1] = y;
+                  for (int m = m0; m < m1; m++)
+                  {
+                    nodes[g.members[m]].x += dx;
+                    nodes[g.members[m]].y += dy;
+                  }
+                }
+              });
+  for (int c = 0; c < count; c++)
+  {
+    int size = g.member_offsets[c + 1] - g.member_offsets[c];
+    if (collapsed.open[c] && size > 1 && size <= LOCAL_MAX_NODES)
+      open_step<Law>(c, pinned);
+  }
+}
+
+/**
+ * @brief Runs one layout tick of the collapsed view with the selected force
+ *        law, whatever the layout engine; the nodes hold still until the
+ *        first communities are found.
+ */
+void collapsed_layout()
+{
+  update_communities();
+  build_collapsed();
+  if (!collapsed.built)
+    return;
+  if (force_law == FORCE_LINLOG)
+    collapsed_step<ForceLinLog>();
+  else if (force_law == FORCE_ATLAS)
+    collapsed_step<ForceAtlas>();
+  else
+    collapsed_step<ForceFR>();
+}
+
+/**
+ * @brief Tells whether a node is hidden inside a closed community of the
+ *        collapsed view.
+ *
+ * @param i Node
+ * @return true if the node is not drawn and cannot be picked
+ */
+bool node_hidden(int i)
+{
+  return collapsed_view && collapsed.built && collapsed.version == graph_version &&
+         !collapsed.open[collapsed.community[i]];
+}
+
+/**
+ * @brief Finds the community of the collapsed view whose disk holds a point.
+ *
+ * @param x X-coordinate
+ * @param y Y-coordinate
+ * @param open Look for open communities of several nodes instead of closed
+ *        ones
+ * @return Community, or -1 if there is none or the view is not shown
+ */
+int community_at(float x, float y, bool open)
+{
+  if (!collapsed_view || !collapsed.built || collapsed.version != graph_version)
+    return -1;
+  const CommunityGraph &g = collapsed.graph;
+  for (int c = 0; c < g.count; c++)
+  {
+    int size = g.member_offsets[c + 1] - g.member_offsets[c];
+    if (size <= 1 || (bool)collapsed.open[c] != open)
+      continue;
+    float r = community_radius(size, open);
+    float dx = collapsed.xy[2 * c] - x, dy = collapsed.xy[2 * c + 1] - y;
+    if (dx * dx + dy * dy < r * r)
+      return c;
+  }
+  return -1;
+}
+
+/**
+ * @brief Opens or closes a community of the collapsed view in place,
+ *        spreading its members over the new disk.
+ *
+ * @param c Community of several nodes
+ * @param open Whether to open it
+ */
+void set_community_open(int c, bool open)
+{
+  const CommunityGraph &g = collapsed.graph;
+  int size = g.member_offsets[c + 1] - g.member_offsets[c];
+  collapsed.open[c] = open;
+  if (open)
+    open_ids.push_back(nodes[g.members[g.member_offsets[c]]].id);
+  else
+  {
+    open_ids.erase(std::remove_if(open_ids.begin(), open_ids.end(), [c](int id)
+                                  {
+                                    int i = graph_node_index(id);
+                                    return i == -1 || collapsed.community[i] == c;
+                                  }),
+                   open_ids.end());
+  }
+  fit_members(c, community_radius(size, open) - NODE_RADIUS, open);
+}
+
+/**
+ * @brief Requests a redraw unless running without a window.
+ */
+void request_redisplay()
+{
+  if (!headless)
+    glutPostRedisplay();
+}
+
+/**
+ * @brief Shows the result of the shortest path query once it is done.
+ *
+ * A result computed for an older version of the graph is dropped; its node
+ * indices may no longer be valid.
+ */
+void collect_path_query()
+{
+  if (query_collect(&path_query))
+    routes_shown = (int)path_query.front.size();
+}
+
+/**
+ * @brief Runs one layout tick and counts it for the event log.
+ *
+ * Outside the collapsed view, overlapping nodes are pushed apart after the
+ * engine has moved them. Layout runs at background priority, so a query submitted meanwhile gets
+ * the workers first.
+ */
+void layout_step()
+{
+  collect_path_query();
+  unsigned long long before = heap_allocations();
+  int priority = task_set_priority(TASK_BACKGROUND);
+  auto start = std::chrono::steady_clock::now();
+  if (collapsed_view)
+    collapsed_layout();
+  else if (layout_engine == LAYOUT_STRESS)
+    update_stress_layout();
+  else
+    update_force_layout();
+  if (!collapsed_view)
+    remove_overlaps();
+  touched_ids.clear();
+  layout_ms = std::chrono::duration<double, std::milli>(
+                  std::chrono::steady_clock::now() - start)
+                  .count();
+  task_set_priority(priority);
+  arena_reset(&frame_arena);
+  tick_allocations += heap_allocations() - before;
+  layout_tick++;
+}
+
+/**
+ * @brief Idle function for continuous layout updates.
+ */
+void idle()
+{
+  if (replay_active())
+  {
+    static const ReplayHandlers handlers = {mouse, motion, keyboard, resize, layout_step};
+    replay_poll(&handlers, replay_max_speed);
+  }
+  else
+  {
+    ipc_frame(layout_touch);
+    ingest_frame();
+    update_startup();
+    layout_step();
+    checkpoint_poll(current_mode);
+  }
+  glutPostRedisplay();
+}
+
+/**
+ * @brief Draws a string at the specified coordinates.
+ *
+ * @param x X-coordinate
+ * @param y Y-coordinate
+ * @param str String to draw
+ */
+void draw_string(float x, float y, char *str)
+{
+  glRasterPos2f(x, y);
+  for (char *c = str; *c != '\0'; c++)
+  {
+    glutBitmapCharacter(GLUT_BITMAP_HELVETICA_18, *c);
+  }
+}
+
+/**
+ * @brief Draws a string at the specified pixel coordinates.
+ *
+ * @param x X-coordinate in pixels
+ * @param y Y-coordinate in pixels
+ * @param str String to draw
+ */
+void draw_string_pixel(int x, int y, const char *str)
+{
+  glRasterPos2i(x, y);
+  for (const char *c = str; *c != '\0'; c++)
+  {
+    glutBitmapCharacter(GLUT_BITMAP_HELVETICA_18, *c);
+  }
+}
+
+/**
+ * @brief Draws a filled circle with a border in the node border color.
+ *
+ * @param cx Center x-coordinate
+ * @param cy Center y-coordinate
+ * @param radius Radius
+ * @param fill Fill color
+ * @param alpha Fill opacity, used when blending is enabled
+ * @param border Border line width
+ */
+void draw_disk(float cx, float cy, float radius, const float fill[3], float alpha, float border)
+{
+  int num_segments = 50;
+  glColor4f(fill[0], fill[1], fill[2], alpha);
+  glBegin(GL_TRIANGLE_FAN);
+  glVertex2f(cx, cy);
+  for (int j = 0; j <= num_segments; j++)
+  {
+    float angle = 2.0f * 3.1415926f * j / num_segments;
+    float x = cx + cos(angle) * radius;
+    float y = cy + sin(angle) * radius;
+    glVertex2f(x, y);
+  }
+  glEnd();
+
+  glColor3f(COLOR_NODE_BORDER_R, COLOR_NODE_BORDER_G, COLOR_NODE_BORDER_B);
+  glLineWidth(border);
+  glBegin(GL_LINE_LOOP);
+  for (int j = 0; j <= num_segments; j++)
+  {
+    float angle = 2.0f * 3.1415926f * j / num_segments;
+    float x = cx + cos(angle) * radius;
+    float y = cy + sin(angle) * radius;
+    glVertex2f(x, y);
+  }
+  glEnd();
+}
+
+/**
+ * @brief Draws one node as a circle with its centered label.
+ *
+ * @param i Node
+ * @param style Color and size set by the current mode, or NULL for the node
+ *        fill color
+ * @param pinned Pinned flag per node, or NULL; pinned nodes get a thicker
+ *        border
+ */
+void draw_node(int i, const NodeStyle *style, const unsigned char *pinned)
+{
+  float cx = nodes[i].x;
+  float cy = nodes[i].y;
+  float fill[3] = {COLOR_NODE_FILL_R, COLOR_NODE_FILL_G, COLOR_NODE_FILL_B};
+  float radius = NODE_RADIUS;
+  if (style)
+  {
+    fill[0] = style->r;
+    fill[1] = style->g;
+    fill[2] = style->b;
+    radius *= style->scale;
+  }
+  draw_disk(cx, cy, radius, fill, 1.0f, pinned && pinned[i] ? 3.0f : 1.0f);
+
+  // Label centered in the circle
+  char label[2] = {nodes[i].label, '\0'};
+  glColor3f(COLOR_TEXT_R, COLOR_TEXT_G, COLOR_TEXT_B);
+  draw_string(cx - 0.008f, cy - 0.02f, label);
+}
+
+/**
+ * @brief Draws the nodes as circles with centered labels.
+ *
+ * @param styles Per-node colors and sizes of the current mode, or NULL; used
+ * only when it holds exactly node_count entries
+ */
+void draw_nodes(const std::vector<NodeStyle> *styles)
+{
+  bool styled = styles && (int)styles->size() == node_count;
+  unsigned char *pinned = pinned_mask();
+  for (int i = 0; i < node_count; i++)
+    draw_node(i, styled ? &(*styles)[i] : NULL, pinned);
+}
+
+/**
+ * @brief Tells whether edges are drawn bundled.
+ *
+ * @return true for the bundled style, or for the auto style on dense graphs
+ */
+bool bundles_enabled()
+{
+  return edge_style == EDGES_BUNDLED ||
+         (edge_style == EDGES_AUTO && edge_count >= BUNDLE_AUTO_EDGES);
+}
+
+/**
+ * @brief Picks up finished bundles and starts the next bundling task.
+ *
+ * One task runs at a time, at background priority. A structural edit
+ * restarts it from scratch; once the nodes have moved by more than
+ * BUNDLE_REFRESH_DISTANCE, the shown bundles are refined for the new
+ * positions, so they follow the layout as it settles.
+ */
+void update_bundles()
+{
+  query_collect(&bundle_query);
+  if (!bundles_enabled())
+  {
+    query_cancel(&bundle_query);
+    return;
+  }
+  if (bundle_query.task && bundle_query.version == graph_version)
+    return;
+  bool current = bundle_query.shown == graph_version && bundle_query.front.points;
+  if (current)
+  {
+    const std::vector<float> &xy = bundle_query.front.node_xy;
+    float moved = 0;
+    for (int i = 0; i < node_count && moved < BUNDLE_REFRESH_DISTANCE; i++)
+      moved = fmaxf(fabsf(nodes[i].x - xy[2 * i]), fabsf(nodes[i].y - xy[2 * i + 1]));
+    if (moved < BUNDLE_REFRESH_DISTANCE)
+      return;
+  }
+
+  std::vector<float> xy(2 * (size_t)node_count);
+  for (int i = 0; i < node_count; i++)
+  {
+    xy[2 * i] = nodes[i].x;
+    xy[2 * i + 1] = nodes[i].y;
+  }
+  std::vector<int> ends(2 * (size_t)edge_count);
+  for (int i = 0; i < edge_count; i++)
+  {
+    ends[2 * i] = edges[i].src;
+    ends[2 * i + 1] = edges[i].dest;
+  }
+  std::shared_ptr<BundleResult> previous;
+  if (current)
+    previous = std::make_shared<BundleResult>(bundle_query.front);
+  float cell_w = 2.0f * BUNDLE_MERGE_PIXELS / window_w;
+  float cell_h = 2.0f * BUNDLE_MERGE_PIXELS / window_h;
+  query_start(&bundle_query, [xy, ends, previous, cell_w, cell_h](BundleResult *out)
+              {
+                bundle_edges(xy, ends, previous.get(), out);
+                if (!task_cancelled())
+                  bundle_merge(ends, cell_w, cell_h, out);
+              },
+              TASK_BACKGROUND);
+}
+
+/**
+ * @brief Fills in the polylines of the shown bundles for the current node
+ *        positions.
+ *
+ * Bundles lag behind the layout, so every bend is moved by the blend of its
+ * end points' movements since the bundles were computed. The polylines start
+ * and end on the node circles.
+ *
+ * @param xy Receives BUNDLE_POINTS + 2 (x, y) points per edge
+ */
+void bundle_strips(float *xy)
+{
+  const std::vector<float> &points = *bundle_query.front.points;
+  const std::vector<float> &base = bundle_query.front.node_xy;
+  const int stride = BUNDLE_POINTS + 2;
+  for (int i = 0; i < edge_count; i++)
+  {
+    int a = edges[i].src, b = edges[i].dest;
+    float move_ax = nodes[a].x - base[2 * a], move_ay = nodes[a].y - base[2 * a + 1];
+    float move_bx = nodes[b].x - base[2 * b], move_by = nodes[b].y - base[2 * b + 1];
+    const float *p = &points[(size_t)i * BUNDLE_POINTS * 2];
+    float *v = xy + (size_t)i * stride * 2;
+    for (int j = 0; j < BUNDLE_POINTS; j++)
+    {
+      float t = (j + 1) / (float)(BUNDLE_POINTS + 1);
+      v[2 * j + 2] = p[2 * j] + (1 - t) * move_ax + t * move_bx;
+      v[2 * j + 3] = p[2 * j + 1] + (1 - t) * move_ay + t * move_by;
+    }
+    const Node *ends[2] = {&nodes[a], &nodes[b]};
+    const float *bend[2] = {v + 2, v + 2 * BUNDLE_POINTS};
+    float *tip[2] = {v, v + 2 * (stride - 1)};
+    for (int e = 0; e < 2; e++)
+    {
+      float dx = bend[e][0] - ends[e]->x, dy = bend[e][1] - ends[e]->y;
+      float d = sqrt(dx * dx + dy * dy);
+      float r = d > NODE_RADIUS ? NODE_RADIUS / d : 0;
+      tip[e][0] = ends[e]->x + dx * r;
+      tip[e][1] = ends[e]->y + dy * r;
+    }
+  }
+}
+
+/**
+ * @brief Fills in the shared segments of the shown bundles for the current
+ *        node positions.
+ *
+ * Every vertex moves like the point of its anchor edge, as in
+ * bundle_strips().
+ *
+ * @param xy Receives two (x, y) points per segment
+ */
+void merged_lines(float *xy)
+{
+  const MergedBundles &merged = *bundle_query.front.merged;
+  const std::vector<float> &base = bundle_query.front.node_xy;
+  int vertices = (int)merged.anchor_edge.size();
+  float *at = arena_array<float>(&frame_arena, 2 * (size_t)vertices);
+  for (int v = 0; v < vertices; v++)
+  {
+    int e = merged.anchor_edge[v];
+    int a = edges[e].src, b = edges[e].dest;
+    float t = merged.anchor_t[v];
+    at[2 * v] = merged.xy[2 * v] + (1 - t) * (nodes[a].x - base[2 * a]) +
+                t * (nodes[b].x - base[2 * b]);
+    at[2 * v + 1] = merged.xy[2 * v + 1] + (1 - t) * (nodes[a].y - base[2 * a + 1]) +
+                    t * (nodes[b].y - base[2 * b + 1]);
+  }
+  int segments = (int)merged.counts.size();
+  for (int s = 0; s < segments; s++)
+  {
+    int u = merged.segments[2 * s], v = merged.segments[2 * s + 1];
+    xy[4 * s] = at[2 * u];
+    xy[4 * s + 1] = at[2 * u + 1];
+    xy[4 * s + 2] = at[2 * v];
+    xy[4 * s + 3] = at[2 * v + 1];
+  }
+}
+
+/**
+ * @brief Draws the shown bundles as thin translucent lines, each shared
+ *        segment once.
+ *
+ * A segment that k edges run along gets the alpha of k overlapping strokes
+ * of BUNDLE_ALPHA, 1 - (1 - BUNDLE_ALPHA)^k, so bundles look as they would
+ * drawn edge by edge while writing every pixel of a bundle once. All lines
+ * go to GL in one glDrawArrays call from vertex and color arrays in the
+ * frame arena.
+ */
+void draw_bundles()
+{
+  static unsigned char alpha[256];
+  if (!alpha[1])
+  {
+    for (int k = 1; k < 256; k++)
+      alpha[k] = (unsigned char)lroundf(255 * (1 - powf(1 - BUNDLE_ALPHA, (float)k)));
+  }
+  const MergedBundles &merged = *bundle_query.front.merged;
+  int segments = (int)merged.counts.size();
+  float *xy = arena_array<float>(&frame_arena, 4 * (size_t)segments);
+  merged_lines(xy);
+  unsigned char *rgba = arena_array<unsigned char>(&frame_arena, 8 * (size_t)segments);
+  unsigned char r = (unsigned char)(255 * COLOR_EDGE_R), g = (unsigned char)(255 * COLOR_EDGE_G),
+                b = (unsigned char)(255 * COLOR_EDGE_B);
+  for (int s = 0; s < segments; s++)
+  {
+    unsigned char a = alpha[std::min(merged.counts[s], 255)];
+    unsigned char *c = rgba + 8 * (size_t)s;
+    c[0] = c[4] = r;
+    c[1] = c[5] = g;
+    c[2] = c[6] = b;
+    c[3] = c[7] = a;
+  }
+
+  glLineWidth(1.0f);
+  glEnableClientState(GL_VERTEX_ARRAY);
+  glEnableClientState(GL_COLOR_ARRAY);
+  glVertexPointer(2, GL_FLOAT, 0, xy);
+  glColorPointer(4, GL_UNSIGNED_BYTE, 0, rgba);
+  glDrawArrays(GL_LINES, 0, 2 * segments);
+  glDisableClientState(GL_COLOR_ARRAY);
+  glDisableClientState(GL_VERTEX_ARRAY);
+}
+
+/**
+ * @brief Draws the edges, bundled once bundles for the graph are ready.
+ *
+ * Weight labels are left out while bundling is enabled; on graphs that dense
+ * they cannot be read and cost more than the lines.
+ */
+void draw_edges()
+{
+  if (bundles_enabled() && bundle_query.shown == graph_version && bundle_query.front.merged)
+  {
+    draw_bundles();
+    return;
+  }
+  glColor3f(COLOR_EDGE_R, COLOR_EDGE_G, COLOR_EDGE_B);
+  glLineWidth(4.0f);
+  glBegin(GL_LINES);
+  for (int i = 0; i < edge_count; i++)
+  {
+    Node src = nodes[edges[i].src];
+    Node dest = nodes[edges[i].dest];
+    float dx = dest.x - src.x;
+    float dy = dest.y - src.y;
+    float d = sqrt(dx * dx + dy * dy);
+    if (d == 0)
+      d = 0.0001f;
+    float offsetX = (dx / d) * NODE_RADIUS;
+    float offsetY = (dy / d) * NODE_RADIUS;
+    float startX = src.x + offsetX;
+    float startY = src.y + offsetY;
+    float endX = dest.x - offsetX;
+    float endY = dest.y - offsetY;
+    glVertex2f(startX, startY);
+    glVertex2f(endX, endY);
+  }
+  glEnd();
+  if (bundles_enabled())
+    return;
+
+  // Draw edge weight labels
+  for (int i = 0; i < edge_count; i++)
+  {
+    Node src = nodes[edges[i].src];
+    Node dest = nodes[edges[i].dest];
+    float dx = dest.x - src.x;
+    float dy = dest.y - src.y;
+    float d = sqrt(dx * dx + dy * dy);
+    if (d == 0)
+      d = 0.0001f;
+    float offsetX = (dx / d) * NODE_RADIUS;
+    float offsetY = (dy / d) * NODE_RADIUS;
+    float startX = src.x + offsetX;
+    float startY = src.y + offsetY;
+    float endX = dest.x - offsetX;
+    float endY = dest.y - offsetY;
+    float midX = (startX + endX) / 2;
+    float midY = (startY + endY) / 2;
+
+    float label_offset = 0.03f;
+    float perpX = -dy / d;
+    float perpY = dx / d;
+    float labelX = midX + label_offset * perpX;
+    float labelY = midY + label_offset * perpY;
+
+    char weight_str[10];
+    sprintf(weight_str, "%.1f", edges[i].weight);
+    glColor3f(COLOR_TEXT_R, COLOR_TEXT_G, COLOR_TEXT_B);
+    draw_string(labelX - 0.015f, labelY - 0.015f, weight_str);
+  }
+}
+
+/**
+ * @brief Draws the collapsed view.
+ *
+ * A closed community is one disk in its palette color, sized by its members
+ * and labeled with their count; one translucent line joins every linked
+ * pair of closed communities. Open communities show their members inside a
+ * translucent disk, and their edges to a closed community end at its
+ * center. Draw work grows with the communities and links, plus the members
+ * and edges of the open communities.
+ *
+ * @param styles Per-node colors and sizes of the current mode, or NULL; used
+ * only when it holds exactly node_count entries
+ */
+void draw_collapsed(const std::vector<NodeStyle> *styles)
+{
+  const CommunityGraph &g = collapsed.graph;
+  const Adjacency &adj = *collapsed.adj;
+  const std::vector<int> &comm = collapsed.community;
+  const std::vector<unsigned char> &open = collapsed.open;
+  const float *xy = collapsed.xy.data();
+  bool styled = styles && (int)styles->size() == node_count;
+  for (int c = 0; c < g.count; c++)
+  {
+    int size = g.member_offsets[c + 1] - g.member_offsets[c];
+    if (open[c] && size > 1)
+      draw_disk(xy[2 * c], xy[2 * c + 1], community_radius(size, true),
+                node_palette[c % NODE_PALETTE_SIZE], 0.15f, 1.0f);
+  }
+
+  glColor4f(COLOR_EDGE_R, COLOR_EDGE_G, COLOR_EDGE_B, 0.6f);
+  glLineWidth(2.0f);
+  glBegin(GL_LINES);
+  for (int l = 0; l < (int)g.link_edges.size(); l++)
+  {
+    int a = g.link_ends[2 * l], b = g.link_ends[2 * l + 1];
+    if (open[a] || open[b])
+      continue;
+    glVertex2f(xy[2 * a], xy[2 * a + 1]);
+    glVertex2f(xy[2 * b], xy[2 * b + 1]);
+  }
+  for (int c = 0; c < g.count; c++)
+  {
+    for (int m = g.member_offsets[c]; open[c] && m < g.member_offsets[c + 1]; m++)
+    {
+      int u = g.members[m];
+      for (int e = adj.offsets[u]; e < adj.offsets[u + 1]; e++)
+      {
+        int v = adj.targets[e];
+        int d = comm[v];
+        if (open[d] && v < u)
+          continue; // drawn from v
+        glVertex2f(nodes[u].x, nodes[u].y);
+        if (open[d])
+          glVertex2f(nodes[v].x, nodes[v].y);
+        else
+          glVertex2f(xy[2 * d], xy[2 * d + 1]);
+      }
+    }
+  }
+  glEnd();
+
+  unsigned char *pinned = pinned_mask();
+  char count[16];
+  for (int c = 0; c < g.count; c++)
+  {
+    int m0 = g.member_offsets[c], m1 = g.member_offsets[c + 1];
+    if (!open[c])
+    {
+      draw_disk(xy[2 * c], xy[2 * c + 1], community_radius(m1 - m0, false),
+                node_palette[c % NODE_PALETTE_SIZE], 1.0f, 1.0f);
+      snprintf(count, sizeof(count), "%d", m1 - m0);
+      glColor3f(COLOR_BG_R, COLOR_BG_G, COLOR_BG_B);
+      draw_string(xy[2 * c] - 0.008f * strlen(count), xy[2 * c + 1] - 0.02f, count);
+      continue;
+    }
+    const float *rgb = node_palette[c % NODE_PALETTE_SIZE];
+    NodeStyle member = {rgb[0], rgb[1], rgb[2], 1.0f};
+    for (int m = m0; m < m1; m++)
+    {
+      int u = g.members[m];
+      draw_node(u, styled ? &(*styles)[u] : m1 - m0 > 1 ? &member : NULL, pinned);
+    }
+  }
+}
+
+/**
+ * @brief Picks the color of one of several routes, evenly spaced around the
+ *        hue circle and starting at the shortest path color.
+ *
+ * @param r Route index
+ * @param count Number of routes
+ * @param rgb Receives the color
+ */
+void route_color(int r, int count, float rgb[3])
+{
+  if (r == 0)
+  {
+    rgb[0] = COLOR_SP_R;
+    rgb[1] = COLOR_SP_G;
+    rgb[2] = COLOR_SP_B;
+    return;
+  }
+  // Full saturation at the brightness of the palette; hue 190 is the cyan
+  // of the first route
+  float hue = fmodf(190.0f + 360.0f * r / count, 360.0f) / 60.0f;
+  float x = 1.0f - fabsf(fmodf(hue, 2.0f) - 1.0f);
+  float low = 0.33f, span = 0.67f;
+  int sector = (int)hue;
+  float c[6][3] = {{1, x, 0}, {x, 1, 0}, {0, 1, x}, {0, x, 1}, {x, 0, 1}, {1, 0, x}};
+  for (int i = 0; i < 3; i++)
+    rgb[i] = low + span * c[sector % 6][i];
+}
+
+/**
+ * @brief Draws the routes found between two nodes.
+ *
+ * Longer routes are drawn first and wider, so where routes share edges the
+ * shorter ones run inside the longer ones and all colors stay visible.
+ */
+void draw_shortest_path()
+{
+  for (int r = routes_shown - 1; r >= 0; r--)
+  {
+    const std::vector<int> &path = path_query.front[r].nodes;
+    float rgb[3];
+    route_color(r, routes_shown, rgb);
+    glColor3f(rgb[0], rgb[1], rgb[2]);
+    glLineWidth(4.0f + 3.0f * r);
+    glBegin(GL_LINES);
+    for (size_t i = 0; i + 1 < path.size(); i++)
+    {
+      Node src = nodes[path[i]];
+      Node dest = nodes[path[i + 1]];
+      float dx = dest.x - src.x;
+      float dy = dest.y - src.y;
+      float d = sqrt(dx * dx + dy * dy);
+      if (d == 0)
+        d = 0.0001f;
+      float offsetX = (dx / d) * NODE_RADIUS;
+      float offsetY = (dy / d) * NODE_RADIUS;
+      glVertex2f(src.x + offsetX, src.y + offsetY);
+      glVertex2f(dest.x - offsetX, dest.y - offsetY);
+    }
+    glEnd();
+  }
+  glLineWidth(1.0f);
+}
+
+/**
+ * @brief Maps a normalized distance to a green-yellow-red color.
+ *
+ * @param t Distance divided by the largest finite distance, in [0, 1]
+ * @return Node style with that color and the default size
+ */
+NodeStyle distance_style(float t)
+{
+  NodeStyle style;
+  if (t < 0.5f)
+  {
+    float u = t * 2;
+    style.r = COLOR_MST_R + (COLOR_MID_R - COLOR_MST_R) * u;
+    style.g = COLOR_MST_G + (COLOR_MID_G - COLOR_MST_G) * u;
+    style.b = COLOR_MST_B + (COLOR_MID_B - COLOR_MST_B) * u;
+  }
+  else
+  {
+    float u = (t - 0.5f) * 2;
+    style.r = COLOR_MID_R + (COLOR_FAR_R - COLOR_MID_R) * u;
+    style.g = COLOR_MID_G + (COLOR_FAR_G - COLOR_MID_G) * u;
+    style.b = COLOR_MID_B + (COLOR_FAR_B - COLOR_MID_B) * u;
+  }
+  style.scale = 1.0f;
+  return style;
+}
+
+/**
+ * @brief Computes a shortest path tree and its node coloring.
+ *
+ * With a root, nodes are colored by their distance from it. Otherwise every
+ * node takes the color of its nearest facility, fading with the distance to
+ * it. Runs on a worker.
+ *
+ * @param adj Adjacency snapshot
+ * @param root Root node, or -1 to use the facilities
+ * @param sources Facility nodes
+ * @param out Receives the tree and the styles; left empty when cancelled
+ */
+void compute_sp_tree(const Adjacency &adj, int root, const std::vector<int> &sources,
+                     TreeResult *out)
+{
+  int n = adj.node_count;
+  const float *dist;
+  const int *nearest = NULL;
+  auto start = std::chrono::steady_clock::now();
+  // One scratch per worker; a cancelled tree may still be unwinding elsewhere
+  static std::vector<DijkstraScratch> scratch(parallel_threads());
+  FacilityResult result;
+  if (root != -1)
+  {
+    DijkstraScratch &sc = scratch[parallel_worker_id()];
+    if (!dijkstra_search(adj, &root, 1, -1, &sc))
+      return;
+    dist = sc.dist.data();
+    out->parent.assign(sc.parent.begin(), sc.parent.end());
+  }
+  else
+  {
+    nearest_facilities(adj, sources, &result);
+    if (task_cancelled())
+      return;
+    dist = result.dist.data();
+    nearest = result.nearest.data();
+    out->parent.assign(result.parent.begin(), result.parent.end());
+  }
+  out->ms = std::chrono::duration<double, std::milli>(
+                std::chrono::steady_clock::now() - start)
+                .count();
+
+  float max_dist = 0;
+  for (int i = 0; i < n; i++)
+  {
+    if (dist[i] != INF && dist[i] > max_dist)
+      max_dist = dist[i];
+  }
+  out->styles.resize(n);
+  for (int i = 0; i < n; i++)
+  {
+    NodeStyle style = {COLOR_NODE_FILL_R, COLOR_NODE_FILL_G, COLOR_NODE_FILL_B, 1.0f};
+    float t = max_dist > 0 ? dist[i] / max_dist : 0;
+    if (dist[i] == INF)
+      ; // unreachable nodes keep the default fill
+    else if (!nearest)
+      style = distance_style(t);
+    else
+    {
+      // Facility color, blended toward the background with distance
+      const float *c = node_palette[nearest[i] % NODE_PALETTE_SIZE];
+      float fade = 0.6f * t;
+      style.r = c[0] + (COLOR_BG_R - c[0]) * fade;
+      style.g = c[1] + (COLOR_BG_G - c[1]) * fade;
+      style.b = c[2] + (COLOR_BG_B - c[2]) * fade;
+      style.scale = dist[i] == 0 ? 1.4f : 1.0f;
+    }
+    out->styles[i] = style;
+  }
+}
+
+/**
+ * @brief Keeps the shortest path tree shown in MODE_SP_TREE up to date.
+ *
+ * Picks up a finished tree, and starts a new query when the root, the
+ * facilities or the graph changed. The previous tree stays on screen until
+ * the new one is ready.
+ */
+void update_sp_tree()
+{
+  query_collect(&tree_query);
+  if (!tree_dirty && tree_version == graph_version)
+    return;
+  tree_dirty = false;
+  tree_version = graph_version;
+  if (tree_root >= node_count)
+    tree_root = -1;
+  for (size_t i = 0; i < tree_sources.size();)
+  {
+    if (tree_sources[i] >= node_count)
+      tree_sources.erase(tree_sources.begin() + i);
+    else
+      i++;
+  }
+
+  if (tree_root == -1 && tree_sources.empty())
+  {
+    query_cancel(&tree_query);
+    tree_query.front.parent.clear();
+    tree_query.front.styles.clear();
+    return;
+  }
+  std::shared_ptr<const Adjacency> adj = graph_adjacency();
+  int root = tree_root;
+  std::vector<int> sources = tree_sources;
+  query_start(&tree_query, [adj, root, sources](TreeResult *out)
+              { compute_sp_tree(*adj, root, sources, out); });
+}
+
+/**
+ * @brief Draws the edges of the current shortest path tree.
+ */
+void draw_sp_tree()
+{
+  const std::vector<int> &parent = tree_query.front.parent;
+  if (tree_query.shown != graph_version || (int)parent.size() != node_count)
+    return;
+  glColor3f(COLOR_SP_R, COLOR_SP_G, COLOR_SP_B);
+  glLineWidth(2.0f);
+  glBegin(GL_LINES);
+  for (int v = 0; v < node_count; v++)
+  {
+    int u = parent[v];
+    if (u == -1)
+      continue;
+    glVertex2f(nodes[u].x, nodes[u].y);
+    glVertex2f(nodes[v].x, nodes[v].y);
+  }
+  glEnd();
+}
+
+/**
+ * @brief Returns the display name of an analytics metric.
+ *
+ * @param metric METRIC_* constant
+ * @return Name shown in the mode dialog
+ */
+const char *metric_name(int metric)
+{
+  switch (metric)
+  {
+  case METRIC_COMPONENTS:
+    return "Components";
+  case METRIC_BFS:
+    return "BFS Layers";
+  case METRIC_PAGERANK:
+    return "PageRank";
+  case METRIC_BETWEENNESS:
+    return "Betweenness";
+  case METRIC_COMMUNITIES:
+    return "Communities";
+  }
+  return "Unknown";
+}
+
+/**
+ * @brief Computes an analytics metric and its node coloring.
+ *
+ * Components and communities get one palette color each. BFS layers use the distance
+ * coloring from the clicked root. PageRank and betweenness scale both color
+ * and radius with the value relative to the largest one. Runs on a worker.
+ *
+ * @param adj Adjacency snapshot
+ * @param metric METRIC_* constant
+ * @param source BFS root
+ * @param label Label of the BFS root, for the summary
+ * @param out Receives the styles, the summary and the time
+ */
+void compute_metric(const Adjacency &adj, int metric, int source, char label,
+                    MetricResult *out)
+{
+  int n = adj.node_count;
+  char *summary = out->summary;
+  size_t size = sizeof(out->summary);
+  std::vector<int> labels;
+  std::vector<float> values;
+  auto start = std::chrono::steady_clock::now();
+  switch (metric)
+  {
+  case METRIC_COMPONENTS:
+  {
+    int count = connected_components(adj, &labels);
+    snprintf(summary, size, "%d components", count);
+    break;
+  }
+  case METRIC_BFS:
+  {
+    int bottom_up = 0;
+    int layers = bfs_layers(adj, source, &labels, &bottom_up);
+    snprintf(summary, size, "%d layers from %c, %d bottom-up", layers,
+             label, bottom_up);
+    break;
+  }
+  case METRIC_PAGERANK:
+  {
+    int iterations = pagerank(adj, 0.85f, 100, 1e-6f, &values);
+    snprintf(summary, size, "%d iterations", iterations);
+    break;
+  }
+  case METRIC_BETWEENNESS:
+  {
+    int sources = betweenness(adj, BETWEENNESS_PIVOTS, &values);
+    snprintf(summary, size, "%d of %d sources", sources, n);
+    break;
+  }
+  case METRIC_COMMUNITIES:
+  {
+    CommunityStats stats;
+    int count = detect_communities(adj, &labels, &stats);
+    snprintf(summary, size, "%d communities, Q = %.3f", count, stats.modularity);
+    break;
+  }
+  }
+  out->ms = std::chrono::duration<double, std::milli>(
+                std::chrono::steady_clock::now() - start)
+                .count();
+  if (task_cancelled())
+    return;
+
+  out->styles.resize(n);
+  float max_value = 0;
+  for (int i = 0; i < n; i++)
+  {
+    float v = values.empty() ? (float)labels[i] : values[i];
+    if (v > max_value)
+      max_value = v;
+  }
+  for (int i = 0; i < n; i++)
+  {
+    NodeStyle style = {COLOR_NODE_FILL_R, COLOR_NODE_FILL_G, COLOR_NODE_FILL_B, 1.0f};
+    if (metric == METRIC_COMPONENTS || metric == METRIC_COMMUNITIES)
+    {
+      const float *c = node_palette[labels[i] % NODE_PALETTE_SIZE];
+      style.r = c[0];
+      style.g = c[1];
+      style.b = c[2];
+    }
+    else if (metric == METRIC_BFS)
+    {
+      if (labels[i] != -1)
+        style = distance_style(max_value > 0 ? labels[i] / max_value : 0);
+      if (i == source)
+        style.scale = 1.4f;
+    }
+    else
+    {
+      float t = max_value > 0 ? values[i] / max_value : 0;
+      style = distance_style(t);
+      style.scale = 0.7f + 0.9f * sqrtf(t);
+    }
+    out->styles[i] = style;
+  }
+}
+
+/**
+ * @brief Keeps the metric shown in MODE_ANALYTICS up to date.
+ *
+ * Picks up a finished metric, and starts a new query when the metric, the
+ * root or the graph changed. The previous coloring stays on screen until the
+ * new one is ready.
+ */
+void update_analytics()
+{
+  query_collect(&metric_query);
+  if (!metric_dirty && metric_version == graph_version)
+    return;
+  metric_dirty = false;
+  metric_version = graph_version;
+  if (metric_source >= node_count)
+    metric_source = 0;
+
+  std::shared_ptr<const Adjacency> adj = graph_adjacency();
+  int metric = metric_selected;
+  int source = metric_source;
+  char label = node_count ? nodes[source].label : '-';
+  query_start(&metric_query, [adj, metric, source, label](MetricResult *out)
+              { compute_metric(*adj, metric, source, label, out); });
+}
+
+/**
+ * @brief Brings the MST in front up to date with the feed batches applied
+ *        since it was computed.
+ *
+ * @return false if a tree edge got heavier or went away, which needs a
+ *         full recomputation
+ */
+bool mst_catch_up()
+{
+  auto weight_of = [](int a, int b) -> float
+  {
+    int u = graph_node_index(a), v = graph_node_index(b);
+    int k = u == -1 || v == -1 ? -1 : graph_find_edge(u, v);
+    return k == -1 ? -1.0f : edges[k].weight;
+  };
+  MstResult updated;
+  if (!update_spanning_tree(mst_query.front, mst_changed, mst_deleted, weight_of, &updated))
+    return false;
+  std::swap(mst_query.front, updated);
+  mst_query.shown = mst_version = graph_version;
+  mst_changed.clear();
+  mst_deleted.clear();
+  return true;
+}
+
+/**
+ * @brief Records a feed batch for the MST to catch up with.
+ *
+ * A batch that follows a change the MST did not see, or a backlog larger
+ * than the graph, ends tracking, and the next update recomputes the tree.
+ *
+ * @param batch Changes of the batch
+ * @param before graph_version before the batch
+ */
+void mst_record(const IngestBatch &batch, unsigned int before)
+{
+  if (!mst_tracking || before != mst_tracked ||
+      mst_changed.size() + batch.changed.size() > (size_t)edge_count + node_count)
+  {
+    mst_tracking = false;
+    mst_changed.clear();
+    mst_deleted.clear();
+    return;
+  }
+  mst_changed.insert(mst_changed.end(), batch.changed.begin(), batch.changed.end());
+  mst_deleted.insert(mst_deleted.end(), batch.deleted.begin(), batch.deleted.end());
+  mst_tracked = graph_version;
+}
+
+/**
+ * @brief Starts a new MST query when the graph changed.
+ *
+ * While only the feed changes the graph, the tree is updated from the
+ * recorded batches instead: a full computation still running is left to
+ * finish and catches up afterwards, so a steady feed cannot starve it.
+ */
+void update_mst()
+{
+  if (mst_tracked != graph_version)
+    mst_tracking = false; // changed by an edit, not by the feed
+  query_collect(&mst_query, mst_tracking);
+  if (mst_tracking && mst_query.task)
+    return; // catches up with the feed once it is done
+  if (!mst_dirty && mst_query.shown == graph_version)
+    return;
+  if (!mst_dirty && mst_tracking && mst_query.shown == mst_version && mst_catch_up())
+    return;
+  mst_dirty = false;
+  mst_version = graph_version;
+  mst_tracking = true;
+  mst_tracked = graph_version;
+  mst_changed.clear();
+  mst_deleted.clear();
+  std::shared_ptr<const Adjacency> adj = graph_adjacency();
+  std::vector<int> ids(node_count);
+  for (int i = 0; i < node_count; i++)
+    ids[i] = nodes[i].id;
+  query_start(&mst_query, [adj, ids](MstResult *out)
+              { minimum_spanning_tree(*adj, ids, out); });
+}
+
+/**
+ * @brief Draws the last computed Minimum Spanning Tree (MST).
+ *
+ * The tree refers to nodes by external id, so after an edit the previous
+ * tree stays visible, minus deleted nodes, until the new one is ready.
+ */
+void draw_mst()
+{
+  const std::vector<int> &ends = mst_query.front.ends;
   glColor3f(COLOR_MST_R, COLOR_MST_G, COLOR_MST_B);
   glLineWidth(4.0f);
   glBegin(GL_LINES);
-  for (int i = 0; i < mst_count; i++)
+  for (size_t i = 0; i + 1 < ends.size(); i += 2)
   {
-    Node src = nodes[mst_edges[i].src];
-    Node dest = nodes[mst_edges[i].dest];
+    int a = graph_node_index(ends[i]);
+    int b = graph_node_index(ends[i + 1]);
+    if (a == -1 || b == -1)
+      continue;
+    Node src = nodes[a];
+    Node dest = nodes[b];
     float dx = dest.x - src.x;
     float dy = dest.y - src.y;
     float d = sqrt(dx * dx + dy * dy);
@@ -520,119 +2746,123 @@ void draw_menu_pixel()
   glVertex2i(0, h);
   glEnd();
 
-  int y = 20;
-  // Add Node button
-  glColor3f(current_mode == MODE_ADD_NODE ? COLOR_BUTTON_ACTIVE_R
-                                          : COLOR_BUTTON_INACTIVE_R,
-            current_mode == MODE_ADD_NODE ? COLOR_BUTTON_ACTIVE_G
-                                          : COLOR_BUTTON_INACTIVE_G,
-            current_mode == MODE_ADD_NODE ? COLOR_BUTTON_ACTIVE_B
-                                          : COLOR_BUTTON_INACTIVE_B);
-  glBegin(GL_QUADS);
-  glVertex2i(10, y);
-  glVertex2i(BUTTON_WIDTH + 10, y);
-  glVertex2i(BUTTON_WIDTH + 10, y + BUTTON_HEIGHT);
-  glVertex2i(10, y + BUTTON_HEIGHT);
-  glEnd();
-  glColor3f(COLOR_TEXT_R, COLOR_TEXT_G, COLOR_TEXT_B);
-  draw_string_pixel(15, y + 25, "Add Node");
-
-  y += BUTTON_HEIGHT + BUTTON_PADDING;
-  // Add Edge button
-  glColor3f(current_mode == MODE_ADD_EDGE ? COLOR_BUTTON_ACTIVE_R
-                                          : COLOR_BUTTON_INACTIVE_R,
-            current_mode == MODE_ADD_EDGE ? COLOR_BUTTON_ACTIVE_G
-                                          : COLOR_BUTTON_INACTIVE_G,
-            current_mode == MODE_ADD_EDGE ? COLOR_BUTTON_ACTIVE_B
-                                          : COLOR_BUTTON_INACTIVE_B);
-  glBegin(GL_QUADS);
-  glVertex2i(10, y);
-  glVertex2i(BUTTON_WIDTH + 10, y);
-  glVertex2i(BUTTON_WIDTH + 10, y + BUTTON_HEIGHT);
-  glVertex2i(10, y + BUTTON_HEIGHT);
-  glEnd();
-  glColor3f(COLOR_TEXT_R, COLOR_TEXT_G, COLOR_TEXT_B);
-  draw_string_pixel(15, y + 25, "Add Edge");
-
-  y += BUTTON_HEIGHT + BUTTON_PADDING;
-  // Shortest Path button
-  glColor3f(current_mode == MODE_SHORTEST_PATH ? COLOR_BUTTON_ACTIVE_R
-                                               : COLOR_BUTTON_INACTIVE_R,
-            current_mode == MODE_SHORTEST_PATH ? COLOR_BUTTON_ACTIVE_G
-                                               : COLOR_BUTTON_INACTIVE_G,
-            current_mode == MODE_SHORTEST_PATH ? COLOR_BUTTON_ACTIVE_B
-                                               : COLOR_BUTTON_INACTIVE_B);
-  glBegin(GL_QUADS);
-  glVertex2i(10, y);
-  glVertex2i(BUTTON_WIDTH + 10, y);
-  glVertex2i(BUTTON_WIDTH + 10, y + BUTTON_HEIGHT);
-  glVertex2i(10, y + BUTTON_HEIGHT);
-  glEnd();
-  glColor3f(COLOR_TEXT_R, COLOR_TEXT_G, COLOR_TEXT_B);
-  draw_string_pixel(15, y + 25, "Shortest Path");
-
-  y += BUTTON_HEIGHT + BUTTON_PADDING;
-  // Edit Weight button
-  glColor3f(current_mode == MODE_EDIT_WEIGHT ? COLOR_BUTTON_ACTIVE_R
-                                             : COLOR_BUTTON_INACTIVE_R,
-            current_mode == MODE_EDIT_WEIGHT ? COLOR_BUTTON_ACTIVE_G
-                                             : COLOR_BUTTON_INACTIVE_G,
-            current_mode == MODE_EDIT_WEIGHT ? COLOR_BUTTON_ACTIVE_B
-                                             : COLOR_BUTTON_INACTIVE_B);
-  glBegin(GL_QUADS);
-  glVertex2i(10, y);
-  glVertex2i(BUTTON_WIDTH + 10, y);
-  glVertex2i(BUTTON_WIDTH + 10, y + BUTTON_HEIGHT);
-  glVertex2i(10, y + BUTTON_HEIGHT);
-  glEnd();
-  glColor3f(COLOR_TEXT_R, COLOR_TEXT_G, COLOR_TEXT_B);
-  draw_string_pixel(15, y + 25, "Edit Weight");
-
-  y += BUTTON_HEIGHT + BUTTON_PADDING;
-  // Delete Node button
-  glColor3f(current_mode == MODE_DELETE_NODE ? COLOR_BUTTON_ACTIVE_R
-                                             : COLOR_BUTTON_INACTIVE_R,
-            current_mode == MODE_DELETE_NODE ? COLOR_BUTTON_ACTIVE_G
-                                             : COLOR_BUTTON_INACTIVE_G,
-            current_mode == MODE_DELETE_NODE ? COLOR_BUTTON_ACTIVE_B
-                                             : COLOR_BUTTON_INACTIVE_B);
-  glBegin(GL_QUADS);
-  glVertex2i(10, y);
-  glVertex2i(BUTTON_WIDTH + 10, y);
-  glVertex2i(BUTTON_WIDTH + 10, y + BUTTON_HEIGHT);
-  glVertex2i(10, y + BUTTON_HEIGHT);
-  glEnd();
-  glColor3f(COLOR_TEXT_R, COLOR_TEXT_G, COLOR_TEXT_B);
-  draw_string_pixel(15, y + 25, "Delete Node");
-
-  y += BUTTON_HEIGHT + BUTTON_PADDING;
-  // MST button
-  glColor3f(current_mode == MODE_MST ? COLOR_BUTTON_ACTIVE_R
-                                     : COLOR_BUTTON_INACTIVE_R,
-            current_mode == MODE_MST ? COLOR_BUTTON_ACTIVE_G
-                                     : COLOR_BUTTON_INACTIVE_G,
-            current_mode == MODE_MST ? COLOR_BUTTON_ACTIVE_B
-                                     : COLOR_BUTTON_INACTIVE_B);
-  glBegin(GL_QUADS);
-  glVertex2i(10, y);
-  glVertex2i(BUTTON_WIDTH + 10, y);
-  glVertex2i(BUTTON_WIDTH + 10, y + BUTTON_HEIGHT);
-  glVertex2i(10, y + BUTTON_HEIGHT);
-  glEnd();
-  glColor3f(COLOR_TEXT_R, COLOR_TEXT_G, COLOR_TEXT_B);
-  draw_string_pixel(15, y + 25, "MST");
+  for (int i = 0; i < MENU_BUTTON_COUNT; i++)
+  {
+    int y = MENU_TOP + i * (BUTTON_HEIGHT + BUTTON_PADDING);
+    bool active = menu_buttons[i].mode == current_mode;
+    glColor3f(active ? COLOR_BUTTON_ACTIVE_R : COLOR_BUTTON_INACTIVE_R,
+              active ? COLOR_BUTTON_ACTIVE_G : COLOR_BUTTON_INACTIVE_G,
+              active ? COLOR_BUTTON_ACTIVE_B : COLOR_BUTTON_INACTIVE_B);
+    glBegin(GL_QUADS);
+    glVertex2i(10, y);
+    glVertex2i(BUTTON_WIDTH + 10, y);
+    glVertex2i(BUTTON_WIDTH + 10, y + BUTTON_HEIGHT);
+    glVertex2i(10, y + BUTTON_HEIGHT);
+    glEnd();
+    glColor3f(COLOR_TEXT_R, COLOR_TEXT_G, COLOR_TEXT_B);
+    draw_string_pixel(15, y + 25, menu_buttons[i].label);
+  }
 
-  y += BUTTON_HEIGHT + BUTTON_PADDING;
-  // Clear Screen button
-  glColor3f(COLOR_BUTTON_INACTIVE_R, COLOR_BUTTON_INACTIVE_G, COLOR_BUTTON_INACTIVE_B);
-  glBegin(GL_QUADS);
-  glVertex2i(10, y);
-  glVertex2i(BUTTON_WIDTH + 10, y);
-  glVertex2i(BUTTON_WIDTH + 10, y + BUTTON_HEIGHT);
-  glVertex2i(10, y + BUTTON_HEIGHT);
-  glEnd();
+  // Heap allocations since the previous frame; 0 while idle
+  char allocs[32];
+  snprintf(allocs, sizeof(allocs), "Allocs: %llu", frame_allocations);
   glColor3f(COLOR_TEXT_R, COLOR_TEXT_G, COLOR_TEXT_B);
-  draw_string_pixel(15, y + 25, "Clear Screen");
+  draw_string_pixel(15, h - 15, allocs);
+  char backend[32];
+  snprintf(backend, sizeof(backend), "Backend: %s", backend_name(backend_current()));
+  draw_string_pixel(15, h - 35, backend);
+  // Scheduler load: queued interactive/background tasks and steals so far
+  SchedulerStats sched;
+  scheduler_stats(&sched);
+  char tasks[48];
+  snprintf(tasks, sizeof(tasks), "Tasks: %d/%d q, %llu st",
+           sched.queued[TASK_INTERACTIVE], sched.queued[TASK_BACKGROUND], sched.steals);
+  draw_string_pixel(15, h - 55, tasks);
+  char style[32];
+  snprintf(style, sizeof(style), "Edges: %s", edge_style_names[edge_style]);
+  draw_string_pixel(15, h - 75, style);
+
+  // Layout engine, step time and, for stress layouts, the stress reached
+  char layout[64];
+  if (collapsed_view && collapsed.built)
+    snprintf(layout, sizeof(layout), "Layout: %d communities, %.1f ms/it",
+             collapsed.graph.count, layout_ms);
+  else if (collapsed_view)
+    snprintf(layout, sizeof(layout), "Layout: finding communities %d%%",
+             (int)(std::max(query_progress(community_query), 0.0f) * 100));
+  else if (layout_engine == LAYOUT_FORCE && local_running && local_version == graph_version)
+    snprintf(layout, sizeof(layout), "Layout: %s, local %d, %.1f ms/it",
+             force_law_names[force_law], local_steps_left > 0 ? (int)local_nodes.size() : 0,
+             layout_ms);
+  else if (layout_engine == LAYOUT_FORCE && node_count > LOCAL_GLOBAL_NODES && !global_resumed)
+    snprintf(layout, sizeof(layout), "Layout: %s, holding, 'g' resumes",
+             force_law_names[force_law]);
+  else if (layout_engine == LAYOUT_FORCE)
+    snprintf(layout, sizeof(layout), "Layout: %s, %.1f ms/it", force_law_names[force_law],
+             layout_ms);
+  else if (stress_query.shown != graph_version)
+    snprintf(layout, sizeof(layout), "Layout: stress, building %d%%",
+             (int)(std::max(query_progress(stress_query), 0.0f) * 100));
+  else
+    snprintf(layout, sizeof(layout), "Layout: stress %.4f, %.1f ms/it", stress_value,
+             layout_ms);
+  draw_string_pixel(w - 260, h - 15, layout);
+
+  // Requests per second over the last full second, once a server runs
+  int row = h - 35;
+  IpcStats ipc;
+  ipc_stats(&ipc);
+  if (ipc.requests || ipc.connections)
+  {
+    static unsigned long long counted = 0;
+    static double rate = 0;
+    static auto since = std::chrono::steady_clock::now();
+    double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - since).count();
+    if (elapsed >= 1)
+    {
+      rate = (ipc.requests - counted) / elapsed;
+      counted = ipc.requests;
+      since = std::chrono::steady_clock::now();
+    }
+    char served[64];
+    snprintf(served, sizeof(served), "IPC: %d clients, %.0f req/s", ipc.connections, rate);
+    draw_string_pixel(w - 260, row, served);
+    row -= 20;
+  }
+
+  // Feed events applied per second over the last full second
+  IngestStats feed;
+  ingest_stats(&feed);
+  if (feed.parsed || feed.reading)
+  {
+    static unsigned long long counted = 0;
+    static double rate = 0;
+    static auto since = std::chrono::steady_clock::now();
+    double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - since).count();
+    if (elapsed >= 1)
+    {
+      rate = (feed.applied - counted) / elapsed;
+      counted = feed.applied;
+      since = std::chrono::steady_clock::now();
+    }
+    char ingested[64];
+    snprintf(ingested, sizeof(ingested), "Feed: %.0f ev/s, %d queued", rate, feed.queued);
+    draw_string_pixel(w - 260, row, ingested);
+    row -= 20;
+  }
+
+  // Progress of a --load, then how long the startup took
+  char started[64];
+  if (startup.loading)
+    snprintf(started, sizeof(started), "Loading: %d nodes, %d edges", node_count, edge_count);
+  else if (startup.placing)
+    snprintf(started, sizeof(started), "Placing: pivot-MDS %d%%",
+             (int)(std::max(query_progress(placement_query), 0.0f) * 100));
+  else
+    snprintf(started, sizeof(started), "Startup: %.0f ms, ready %.0f ms",
+             startup.first_frame_ms, startup.interactive_ms);
+  if (startup.loaded_ms >= 0 || startup.loading)
+    draw_string_pixel(w - 260, row, started);
 
   glPopMatrix();
   glMatrixMode(GL_PROJECTION);
@@ -670,226 +2900,1066 @@ void draw_weight_input()
   glVertex2i(x, y + box_height);
   glEnd();
 
-  // Border (text color)
-  glColor3f(COLOR_TEXT_R, COLOR_TEXT_G, COLOR_TEXT_B);
-  glLineWidth(2.0f);
-  glBegin(GL_LINE_LOOP);
-  glVertex2i(x, y);
-  glVertex2i(x + box_width, y);
-  glVertex2i(x + box_width, y + box_height);
-  glVertex2i(x, y + box_height);
-  glEnd();
+  // Border (text color)
+  glColor3f(COLOR_TEXT_R, COLOR_TEXT_G, COLOR_TEXT_B);
+  glLineWidth(2.0f);
+  glBegin(GL_LINE_LOOP);
+  glVertex2i(x, y);
+  glVertex2i(x + box_width, y);
+  glVertex2i(x + box_width, y + box_height);
+  glVertex2i(x, y + box_height);
+  glEnd();
+
+  // Prompt text
+  char prompt[64];
+  char fromChar, toChar;
+  if (editing_existing_edge)
+  {
+    fromChar = 'A' + edges[editing_edge].src;
+    toChar = 'A' + edges[editing_edge].dest;
+  }
+  else
+  {
+    fromChar = 'A' + temp_src;
+    toChar = 'A' + temp_dest;
+  }
+  sprintf(prompt, "Weight for %c-%c:", fromChar, toChar);
+  draw_string_pixel(x + 10, y + 20, prompt);
+  sprintf(prompt, "%s_", weight_input_buffer);
+  draw_string_pixel(x + 10, y + 40, prompt);
+
+  glPopMatrix();
+  glMatrixMode(GL_PROJECTION);
+  glPopMatrix();
+  glMatrixMode(GL_MODELVIEW);
+}
+
+/**
+ * @brief Finds the node at the specified coordinates.
+ *
+ * @param x X-coordinate
+ * @param y Y-coordinate
+ * @return Index of the node nearest to the point among those it lies in,
+ *         or -1 if no node is found; nodes hidden in a closed community are
+ *         skipped
+ */
+int find_node(float x, float y)
+{
+  int found = -1;
+  float nearest = NODE_RADIUS * NODE_RADIUS;
+  for (int i = 0; i < node_count; i++)
+  {
+    if (node_hidden(i))
+      continue;
+    float dx = nodes[i].x - x;
+    float dy = nodes[i].y - y;
+    if (dx * dx + dy * dy < nearest)
+    {
+      found = i;
+      nearest = dx * dx + dy * dy;
+    }
+  }
+  return found;
+}
+
+/**
+ * @brief Calculates the distance from a point to a line segment.
+ *
+ * @param px X-coordinate of the point
+ * @param py Y-coordinate of the point
+ * @param ax X-coordinate of the segment start
+ * @param ay Y-coordinate of the segment start
+ * @param bx X-coordinate of the segment end
+ * @param by Y-coordinate of the segment end
+ * @return Distance from the point to the segment
+ */
+float pointToSegmentDistance(float px, float py, float ax, float ay, float bx,
+                             float by)
+{
+  float vx = bx - ax, vy = by - ay;
+  float wx = px - ax, wy = py - ay;
+  float c1 = vx * wx + vy * wy;
+  if (c1 <= 0)
+    return sqrt((px - ax) * (px - ax) + (py - ay) * (py - ay));
+  float c2 = vx * vx + vy * vy;
+  if (c2 <= c1)
+    return sqrt((px - bx) * (px - bx) + (py - by) * (py - by));
+  float bVal = c1 / c2;
+  float projx = ax + bVal * vx;
+  float projy = ay + bVal * vy;
+  return sqrt((px - projx) * (px - projx) + (py - projy) * (py - projy));
+}
+
+/**
+ * @brief Finds the edge near the specified coordinates.
+ *
+ * @param x X-coordinate
+ * @param y Y-coordinate
+ * @return Index of the edge, or -1 if no edge is found
+ */
+int find_edge_near(float x, float y)
+{
+  const float threshold = 0.05f;
+  for (int i = 0; i < edge_count; i++)
+  {
+    Node a = nodes[edges[i].src];
+    Node b = nodes[edges[i].dest];
+    float dist = pointToSegmentDistance(x, y, a.x, a.y, b.x, b.y);
+    if (dist < threshold)
+      return i;
+  }
+  return -1;
+}
+
+/**
+ * @brief Finds the shortest path between two nodes using Dijkstra's algorithm,
+ *        or the route_count shortest loopless routes.
+ *
+ * The search runs as an interactive task over the adjacency snapshot. A
+ * single path stops as soon as the end node is settled; more routes go
+ * through Yen's algorithm. collect_path_query() shows the routes once they
+ * are done, and the previous ones stay on screen until then. A query still
+ * running is cancelled, so only the latest click is answered.
+ *
+ * @param start Index of the start node
+ * @param end Index of the end node
+ */
+void dijkstra(int start, int end)
+{
+  if (start < 0 || start >= node_count || end < 0 || end >= node_count)
+  {
+    std::cerr << "Invalid start or end node for Dijkstra's algorithm.\n";
+    return;
+  }
+
+  path_ends[0] = nodes[start].id;
+  path_ends[1] = nodes[end].id;
+  std::shared_ptr<const Adjacency> adj = graph_adjacency();
+  int k = route_count;
+  query_start(&path_query, [adj, start, end, k](std::vector<Route> *routes)
+              {
+                if (k > 1)
+                {
+                  k_shortest_paths(*adj, start, end, k, routes);
+                  return;
+                }
+                // One scratch per worker; cancelled searches may still be
+                // unwinding on other workers
+                static std::vector<DijkstraScratch> scratch(parallel_threads());
+                DijkstraScratch &sc = scratch[parallel_worker_id()];
+                if (!dijkstra_search(*adj, &start, 1, end, &sc) ||
+                    sc.dist[end] == INF)
+                  return;
+                Route route;
+                for (int at = end; at != -1; at = sc.parent[at])
+                  route.nodes.push_back(at);
+                std::reverse(route.nodes.begin(), route.nodes.end());
+                route.length = sc.dist[end];
+                route.deviation = 0;
+                routes->push_back(route);
+              });
+}
+
+/**
+ * @brief Finds the menu button under a pixel row.
+ *
+ * @param y Y-coordinate in pixels
+ * @return Index into menu_buttons, or -1 if the row is not on a button
+ */
+int menu_button_at(int y)
+{
+  if (y < MENU_TOP)
+    return -1;
+  int index = (y - MENU_TOP) / (BUTTON_HEIGHT + BUTTON_PADDING);
+  int offset = (y - MENU_TOP) % (BUTTON_HEIGHT + BUTTON_PADDING);
+  if (index >= MENU_BUTTON_COUNT || offset > BUTTON_HEIGHT)
+    return -1;
+  return index;
+}
+
+/**
+ * @brief Generates a graph with the selected generator, filling the canvas.
+ *
+ * Runs through the journal so that the previous graph can be restored with
+ * undo. The seed derives from the session seed, so a replay regenerates the
+ * same graphs.
+ */
+void generate_in_canvas()
+{
+  GeneratorParams params;
+  generator_defaults(generator_selected, &params);
+  params.seed = session_seed + generator_runs++;
+  float wall_x = (MENU_WIDTH_PIXELS / (float)window_w) * 2.0f - 1.0f;
+  params.x0 = wall_x + 0.1f;
+  params.x1 = 0.9f;
+  params.y0 = -0.9f;
+  params.y1 = 0.9f;
+  history_replace([&]()
+                  { generate_graph(&params); });
+  routes_shown = 0;
+}
+
+/**
+ * @brief Node index as an external id.
+ *
+ * @param index Node index, or -1
+ * @return External id, or -1
+ */
+static int to_id(int index)
+{
+  return index >= 0 && index < node_count ? nodes[index].id : -1;
+}
+
+/**
+ * @brief External id as a node index.
+ *
+ * @param id External id, or -1
+ * @return Node index, or -1 if the node is gone
+ */
+static int to_index(int id)
+{
+  return id == -1 ? -1 : graph_node_index(id);
+}
+
+/**
+ * @brief Parks the node and edge indices the interface holds as external
+ *        ids, before something renumbers the graph.
+ *
+ * Selections, the routes on screen and a weight being typed in refer to
+ * nodes by index; restore_indices() maps them back afterwards.
+ */
+void hold_indices()
+{
+  for (int i = 0; i < HELD_NODES; i++)
+    held_ids[i] = to_id(*held_nodes[i]);
+  bool editing = editing_existing_edge && editing_edge >= 0 && editing_edge < edge_count;
+  held_ids[HELD_NODES] = editing ? to_id(edges[editing_edge].src) : -1;
+  held_ids[HELD_NODES + 1] = editing ? to_id(edges[editing_edge].dest) : -1;
+  for (int &v : tree_sources)
+    v = to_id(v);
+  for (Route &route : path_query.front)
+  {
+    for (int &v : route.nodes)
+      v = to_id(v);
+  }
+}
+
+/**
+ * @brief Maps the indices parked by hold_indices() back to the renumbered
+ *        graph.
+ *
+ * Nodes that are gone become -1, except the BFS root, which falls back to
+ * node 0; routes through them keep a -1 for the caller to check. A weight
+ * input for an edge that is gone is cancelled.
+ */
+void restore_indices()
+{
+  for (int i = 0; i < HELD_NODES; i++)
+    *held_nodes[i] = to_index(held_ids[i]);
+  metric_source = std::max(0, metric_source);
+  if (editing_existing_edge && editing_edge != -1)
+  {
+    int u = to_index(held_ids[HELD_NODES]), v = to_index(held_ids[HELD_NODES + 1]);
+    editing_edge = u == -1 || v == -1 ? -1 : graph_find_edge(u, v);
+    if (editing_edge == -1)
+      inputting_weight = editing_existing_edge = false;
+  }
+  else if (inputting_weight && (temp_src == -1 || temp_dest == -1))
+    inputting_weight = false;
+  for (int &v : tree_sources)
+    v = to_index(v);
+  tree_sources.erase(std::remove(tree_sources.begin(), tree_sources.end(), -1),
+                     tree_sources.end());
+  for (Route &route : path_query.front)
+  {
+    for (int &v : route.nodes)
+      v = to_index(v);
+  }
+}
+
+/**
+ * @brief Times the passes that depend on the node order, under the cache
+ * counters.
+ *
+ * Runs LOCALITY_ROUNDS attraction passes and one full Dijkstra search. The
+ * adjacency is built before counting starts so only the traversals count.
+ *
+ * @param counters Open counters
+ * @param root Start node of the search
+ * @param sample Receives the time and counts
+ */
+void measure_locality(PerfCounters *counters, int root, PerfSample *sample)
+{
+  float(*disp)[2] = arena_array<float[2]>(&query_arena, node_count);
+  for (int i = 0; i < node_count; i++)
+    disp[i][0] = disp[i][1] = 0;
+  float k = sqrt(4.0f / node_count);
+  std::shared_ptr<const Adjacency> adj = graph_adjacency();
+  static DijkstraScratch scratch;
+  scratch.heap.reserve(node_count);
+  perf_start(counters);
+  for (int r = 0; r < LOCALITY_ROUNDS; r++)
+    apply_attraction<ForceFR>(disp, k);
+  dijkstra_search(*adj, &root, 1, -1, &scratch);
+  perf_stop(counters, sample);
+}
+
+/**
+ * @brief Renumbers the nodes for memory locality and reports the effect.
+ *
+ * The permutation goes through the journal, so it can be undone. Selections
+ * and query state hold node indices; they are carried over through the
+ * external ids.
+ *
+ * @param method REORDER_RCM or REORDER_HILBERT
+ */
+void reorder_graph(int method)
+{
+  if (node_count == 0)
+    return;
+  PerfCounters counters;
+  perf_open(&counters);
+  PerfSample before, after;
+  int root_id = nodes[0].id;
+  measure_locality(&counters, 0, &before);
+
+  hold_indices();
+  auto start = std::chrono::steady_clock::now();
+  std::vector<int> order;
+  if (method == REORDER_RCM)
+    order_rcm(*graph_adjacency(), &order);
+  else
+    order_hilbert(nodes, node_count, &order);
+  history_permute(order.data());
+  double ms = std::chrono::duration<double, std::milli>(
+                  std::chrono::steady_clock::now() - start)
+                  .count();
+
+  restore_indices();
+  tree_dirty = true;
+  metric_dirty = true;
 
-  // Prompt text
-  char prompt[64];
-  char fromChar, toChar;
-  if (editing_existing_edge)
+  measure_locality(&counters, graph_node_index(root_id), &after);
+  perf_close(&counters);
+  printf("Reordered %d nodes by %s in %.1f ms (%d attraction passes + "
+         "Dijkstra)\n",
+         node_count, reorder_name(method), ms, LOCALITY_ROUNDS);
+  perf_print("  before", &before);
+  perf_print("  after ", &after);
+  arena_reset(&query_arena);
+}
+
+/**
+ * @brief Keeps the routes on screen across a change of the graph made
+ *        between hold_indices() and restore_indices().
+ *
+ * Routes stay as long as their nodes and edges do, with lengths following
+ * the new weights, and are searched again in case the change opened a
+ * shorter one. If an end of the search is gone, the routes are dropped.
+ */
+void recheck_routes()
+{
+  bool searching = routes_shown > 0 || path_query.task;
+  for (int r = 0; r < routes_shown; r++)
   {
-    fromChar = 'A' + edges[editing_edge].src;
-    toChar = 'A' + edges[editing_edge].dest;
+    Route &route = path_query.front[r];
+    route.length = 0;
+    for (size_t i = 0; i + 1 < route.nodes.size() && routes_shown; i++)
+    {
+      int u = route.nodes[i], v = route.nodes[i + 1];
+      int k = u == -1 || v == -1 ? -1 : graph_find_edge(u, v);
+      if (k == -1)
+        routes_shown = 0; // a later query finds the next best
+      else
+        route.length += edges[k].weight;
+    }
   }
-  else
+  if (searching)
   {
-    fromChar = 'A' + temp_src;
-    toChar = 'A' + temp_dest;
+    int start = to_index(path_ends[0]), end = to_index(path_ends[1]);
+    if (start != -1 && end != -1)
+      dijkstra(start, end);
+    else
+    {
+      query_cancel(&path_query);
+      routes_shown = 0;
+    }
   }
-  sprintf(prompt, "Weight for %c-%c:", fromChar, toChar);
-  draw_string_pixel(x + 10, y + 20, prompt);
-  sprintf(prompt, "%s_", weight_input_buffer);
-  draw_string_pixel(x + 10, y + 40, prompt);
-
-  glPopMatrix();
-  glMatrixMode(GL_PROJECTION);
-  glPopMatrix();
-  glMatrixMode(GL_MODELVIEW);
 }
 
 /**
- * @brief Finds the node at the specified coordinates.
+ * @brief Applies the edge events that arrived since the last frame.
  *
- * @param x X-coordinate
- * @param y Y-coordinate
- * @return Index of the node, or -1 if no node is found
+ * Indices held by the interface are carried across the batch through the
+ * external ids. The touched nodes get a local relayout, the MST records
+ * the batch to catch up with it and the routes on screen are checked
+ * again.
  */
-int find_node(float x, float y)
+void ingest_frame()
 {
-  for (int i = 0; i < node_count; i++)
+  static IngestBatch batch;
+  float wall_x = (MENU_WIDTH_PIXELS / (float)window_w) * 2.0f - 1.0f;
+  unsigned int before = graph_version;
+  hold_indices();
+  bool applied = ingest_poll(wall_x + 0.1f, -0.9f, 0.9f, 0.9f,
+                             startup.loading ? STARTUP_FRAME_EVENTS : INGEST_FRAME_EVENTS, &batch);
+  restore_indices();
+  if (!applied || graph_version == before)
+    return;
+
+  for (int id : batch.touched)
   {
-    float dx = nodes[i].x - x;
-    float dy = nodes[i].y - y;
-    if (dx * dx + dy * dy < NODE_RADIUS * NODE_RADIUS)
-      return i;
+    int i = graph_node_index(id);
+    if (i != -1)
+      layout_touch(i);
   }
-  return -1;
+  mst_record(batch, before);
+  recheck_routes();
 }
 
 /**
- * @brief Adds an edge between two nodes with the specified weight.
+ * @brief Handles the query server's requests that arrived since the last
+ *        frame.
  *
- * @param src Source node index
- * @param dest Destination node index
- * @param weight Weight of the edge
+ * A remote node deletion renumbers the nodes above it, so indices held by
+ * the interface are carried across the mutations through the external ids,
+ * as for a feed batch, and the routes on screen are checked again.
+ *
+ * @param touch Called with every node a mutation changed, or NULL
  */
-void add_edge(int src, int dest, float weight)
+void ipc_frame(void (*touch)(int node))
 {
-  edges[edge_count++] = (Edge){src, dest, weight};
+  unsigned int before = graph_version;
+  hold_indices();
+  ipc_poll(touch);
+  restore_indices();
+  if (graph_version != before)
+    recheck_routes();
 }
 
 /**
- * @brief Calculates the distance from a point to a line segment.
+ * @brief Milliseconds since the process started.
  *
- * @param px X-coordinate of the point
- * @param py Y-coordinate of the point
- * @param ax X-coordinate of the segment start
- * @param ay Y-coordinate of the segment start
- * @param bx X-coordinate of the segment end
- * @param by Y-coordinate of the segment end
- * @return Distance from the point to the segment
+ * @return Elapsed time
  */
-float pointToSegmentDistance(float px, float py, float ax, float ay, float bx,
-                             float by)
+double startup_elapsed_ms()
 {
-  float vx = bx - ax, vy = by - ay;
-  float wx = px - ax, wy = py - ay;
-  float c1 = vx * wx + vy * wy;
-  if (c1 <= 0)
-    return sqrt((px - ax) * (px - ax) + (py - ay) * (py - ay));
-  float c2 = vx * vx + vy * vy;
-  if (c2 <= c1)
-    return sqrt((px - bx) * (px - bx) + (py - by) * (py - by));
-  float bVal = c1 / c2;
-  float projx = ax + bVal * vx;
-  float projy = ay + bVal * vy;
-  return sqrt((px - projx) * (px - projx) + (py - projy) * (py - projy));
+  return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() -
+                                                   process_start)
+      .count();
 }
 
 /**
- * @brief Finds the edge near the specified coordinates.
+ * @brief Moves the nodes to a pivot-MDS placement, except pinned ones.
  *
- * @param x X-coordinate
- * @param y Y-coordinate
- * @return Index of the edge, or -1 if no edge is found
+ * @param place Placement of the current graph
  */
-int find_edge_near(float x, float y)
+void apply_placement(const Placement &place)
 {
-  const float threshold = 0.05f;
-  for (int i = 0; i < edge_count; i++)
+  unsigned char *pinned = pinned_mask();
+  for (int i = 0; i < node_count; i++)
   {
-    Node a = nodes[edges[i].src];
-    Node b = nodes[edges[i].dest];
-    float dist = pointToSegmentDistance(x, y, a.x, a.y, b.x, b.y);
-    if (dist < threshold)
-      return i;
+    if (!pinned || !pinned[i])
+    {
+      nodes[i].x = place.x[i];
+      nodes[i].y = place.y[i];
+    }
   }
-  return -1;
+  arena_reset(&frame_arena);
+  local_running = false;
 }
 
 /**
- * @brief Finds the shortest path between two nodes using Dijkstra's algorithm.
+ * @brief Advances the progressive startup after each frame's feed batch.
  *
- * @param start Index of the start node
- * @param end Index of the end node
+ * Once the input is read and applied, the pivot-MDS placement of the
+ * graph is built on a background task and applied when it is ready; an
+ * edit made meanwhile restarts the build. The stress engine places the
+ * graph itself, so it skips this step.
  */
-void dijkstra(int start, int end)
+void update_startup()
 {
-  if (start < 0 || start >= node_count || end < 0 || end >= node_count)
+  if (startup.loading)
   {
-    std::cerr << "Invalid start or end node for Dijkstra's algorithm.\n";
+    IngestStats feed;
+    ingest_stats(&feed);
+    if (feed.reading || feed.queued > 0)
+      return;
+    startup.loading = false;
+    startup.loaded_ms = startup_elapsed_ms();
+    startup.placing = node_count > 1 && layout_engine == LAYOUT_FORCE;
+  }
+  if (!startup.placing)
     return;
+  query_collect(&placement_query);
+  if (placement_query.shown == graph_version && (int)placement_query.front.x.size() == node_count)
+  {
+    apply_placement(placement_query.front);
+    startup.placing = false;
+    return;
+  }
+  if (!placement_query.task || placement_query.version != graph_version)
+  {
+    std::shared_ptr<const Adjacency> adj = graph_adjacency();
+    LayoutBox box = layout_box();
+    unsigned int seed = session_seed;
+    query_start(&placement_query, [adj, box, seed](Placement *out)
+                { stress_place(*adj, box, seed, &out->x, &out->y); },
+                TASK_BACKGROUND);
   }
+}
+
+/**
+ * @brief Prints the startup times once the graph is complete and placed.
+ */
+void print_startup()
+{
+  if (startup.loaded_ms >= 0)
+    printf("Startup: first frame after %.1f ms; %d nodes, %d edges loaded after %.1f ms; "
+           "interactive after %.1f ms\n",
+           startup.first_frame_ms, node_count, edge_count, startup.loaded_ms,
+           startup.interactive_ms);
+  else
+    printf("Startup: first frame after %.1f ms; interactive after %.1f ms\n",
+           startup.first_frame_ms, startup.interactive_ms);
+  fflush(stdout);
+}
+
+/**
+ * @brief Prints the scheduler's queue depths and counters.
+ */
+void print_scheduler_stats()
+{
+  SchedulerStats sched;
+  scheduler_stats(&sched);
+  printf("Scheduler: %d workers, %llu tasks run, %llu stolen, %llu cancelled, "
+         "queued",
+         sched.workers, sched.executed, sched.steals, sched.cancelled);
+  for (int w = 0; w <= sched.workers; w++)
+    printf(" %d", sched.depth[w]);
+  printf("\n");
+}
 
-  float dist[MAX_NODES];
-  bool visited[MAX_NODES];
-  int prev[MAX_NODES];
+/**
+ * @brief Prints what the checkpoint writer has written.
+ */
+void print_checkpoint_stats()
+{
+  CheckpointStats written;
+  checkpoint_stats(&written);
+  printf("Checkpoint: %d bases, %d deltas; last base %.1f MB -> %.1f MB "
+         "(%.2f bytes/edge), last record in %.1f ms\n",
+         written.bases, written.deltas, written.raw_bytes / 1048576.0,
+         written.base_bytes / 1048576.0,
+         edge_count ? written.base_bytes / (double)edge_count : 0.0, written.ms);
+}
+
+/**
+ * @brief Times edge bundling and compares the fill cost of straight and
+ *        bundled edges.
+ *
+ * Bundles the current layout from scratch, then refines the result once, as
+ * the renderer does after the nodes moved. The fill cost is measured on the
+ * CPU model of GL wide lines at the window size: straight edges as drawn by
+ * draw_edges(), 4 pixels wide, and bundles, 1 pixel wide, both edge by edge
+ * and as the merged shared segments draw_bundles() draws. Straight edges are
+ * also measured 1 pixel wide, so bundling can be compared with them apart
+ * from the line width.
+ */
+void bench_bundling()
+{
+  if (edge_count == 0)
+    return;
+  std::vector<float> xy(2 * (size_t)node_count);
   for (int i = 0; i < node_count; i++)
   {
-    dist[i] = INF;
-    visited[i] = false;
-    prev[i] = -1;
+    xy[2 * i] = nodes[i].x;
+    xy[2 * i + 1] = nodes[i].y;
+  }
+  std::vector<int> ends(2 * (size_t)edge_count);
+  for (int i = 0; i < edge_count; i++)
+  {
+    ends[2 * i] = edges[i].src;
+    ends[2 * i + 1] = edges[i].dest;
+  }
+  auto start = std::chrono::steady_clock::now();
+  BundleResult cold;
+  bundle_edges(xy, ends, NULL, &cold);
+  auto middle = std::chrono::steady_clock::now();
+  bundle_edges(xy, ends, &cold, &bundle_query.front);
+  auto end = std::chrono::steady_clock::now();
+  bundle_merge(ends, 2.0f * BUNDLE_MERGE_PIXELS / window_w, 2.0f * BUNDLE_MERGE_PIXELS / window_h,
+               &bundle_query.front);
+  auto merged = std::chrono::steady_clock::now();
+  bundle_query.shown = graph_version;
+  printf("Bundling %d edges: %.1f ms from scratch, %.1f ms refinement, %.1f ms merging "
+         "(%s, %d threads)\n",
+         edge_count, std::chrono::duration<double, std::milli>(middle - start).count(),
+         std::chrono::duration<double, std::milli>(end - middle).count(),
+         std::chrono::duration<double, std::milli>(merged - end).count(),
+         backend_name(backend_current()), backend_slots());
+
+  float *straight = arena_array<float>(&frame_arena, (size_t)edge_count * 4);
+  for (int i = 0; i < edge_count; i++)
+  {
+    Node src = nodes[edges[i].src];
+    Node dest = nodes[edges[i].dest];
+    float dx = dest.x - src.x;
+    float dy = dest.y - src.y;
+    float d = sqrt(dx * dx + dy * dy);
+    if (d == 0)
+      d = 0.0001f;
+    straight[4 * i] = src.x + (dx / d) * NODE_RADIUS;
+    straight[4 * i + 1] = src.y + (dy / d) * NODE_RADIUS;
+    straight[4 * i + 2] = dest.x - (dx / d) * NODE_RADIUS;
+    straight[4 * i + 3] = dest.y - (dy / d) * NODE_RADIUS;
   }
-  dist[start] = 0;
+  const int stride = BUNDLE_POINTS + 2;
+  float *bundled = arena_array<float>(&frame_arena, (size_t)edge_count * stride * 2);
+  bundle_strips(bundled);
+  int segments = (int)bundle_query.front.merged->counts.size();
+  float *shared = arena_array<float>(&frame_arena, 4 * (size_t)segments);
+  merged_lines(shared);
+  FillCost lines, thin, bundles, once;
+  polyline_fill(straight, edge_count, 2, 4, window_w, window_h, &lines);
+  polyline_fill(straight, edge_count, 2, 1, window_w, window_h, &thin);
+  polyline_fill(bundled, edge_count, stride, 1, window_w, window_h, &bundles);
+  polyline_fill(shared, segments, 2, 1, window_w, window_h, &once);
+  printf("Straight edges, 4 px: %lld fragments over %lld pixels (overdraw %.1fx)\n",
+         lines.fragments, lines.covered, lines.fragments / (double)std::max(lines.covered, 1LL));
+  printf("Straight edges, 1 px: %lld fragments over %lld pixels (overdraw %.1fx)\n",
+         thin.fragments, thin.covered, thin.fragments / (double)std::max(thin.covered, 1LL));
+  printf("Bundled edges,  1 px: %lld fragments over %lld pixels (overdraw %.1fx), "
+         "%.2fx the fragments of 1 px straight edges\n",
+         bundles.fragments, bundles.covered,
+         bundles.fragments / (double)std::max(bundles.covered, 1LL),
+         bundles.fragments / (double)std::max(thin.fragments, 1LL));
+  printf("Shared segments, 1 px: %lld fragments over %lld pixels (overdraw %.1fx), "
+         "%.2fx the fragments of 1 px straight edges; %d segments for %d edge pieces\n",
+         once.fragments, once.covered, once.fragments / (double)std::max(once.covered, 1LL),
+         once.fragments / (double)std::max(thin.fragments, 1LL), segments,
+         edge_count * (stride - 1));
+  arena_reset(&frame_arena);
+}
 
+/**
+ * @brief Times the stress model build and the majorization steps.
+ *
+ * Reports the stress of the current drawing, of the pivot-MDS placement and
+ * after BENCH_STRESS_ITERATIONS steps from it, and leaves the nodes there.
+ */
+void bench_stress()
+{
+  if (node_count == 0)
+    return;
+  std::shared_ptr<const Adjacency> adj = graph_adjacency();
+  StressModel &model = stress_query.front;
+  stress_build(*adj, layout_box(), session_seed, &model);
+  stress_query.shown = graph_version;
+  double initial = stress_measure(model, nodes);
   for (int i = 0; i < node_count; i++)
   {
-    int u = -1;
-    float min_dist = INF;
-    for (int j = 0; j < node_count; j++)
+    nodes[i].x = model.x[i];
+    nodes[i].y = model.y[i];
+  }
+  stress_placed = node_count;
+  double placed = stress_measure(model, nodes);
+
+  float(*next)[2] = arena_array<float[2]>(&frame_arena, node_count);
+  unsigned long long allocations = heap_allocations();
+  auto start = std::chrono::steady_clock::now();
+  for (int it = 0; it < BENCH_STRESS_ITERATIONS; it++)
+    stress_step(model, nodes, layout_box(), next);
+  auto end = std::chrono::steady_clock::now();
+  allocations = heap_allocations() - allocations;
+  stress_value = stress_measure(model, nodes);
+  arena_reset(&frame_arena);
+  printf("Stress model: %d pivots, %zu edge terms, built in %.1f ms (%s, %d threads)\n",
+         model.pivot_count, model.targets.size(), model.build_ms,
+         backend_name(backend_current()), backend_slots());
+  printf("Stress: %.4f current, %.4f pivot MDS, %.4f after %d steps at %.2f ms/step, "
+         "%llu allocs\n",
+         initial, placed, stress_value, BENCH_STRESS_ITERATIONS,
+         std::chrono::duration<double, std::milli>(end - start).count() /
+             BENCH_STRESS_ITERATIONS,
+         allocations);
+}
+
+/**
+ * @brief Times one global force step, as run unasked on small graphs or
+ *        after 'g'.
+ */
+void bench_global_step()
+{
+  auto t0 = std::chrono::steady_clock::now();
+  update_layout();
+  arena_reset(&frame_arena);
+  auto t1 = std::chrono::steady_clock::now();
+  printf("Global force step: %d nodes in %.1f ms%s\n", node_count,
+         std::chrono::duration<double, std::milli>(t1 - t0).count(),
+         node_count > LOCAL_GLOBAL_NODES ? " (only after 'g')" : "");
+}
+
+/**
+ * @brief Times a global force step against local relayouts after an edit
+ *        and during a drag.
+ *
+ * The edit adds a node joined to three others; the drag pins the node of
+ * highest degree and moves it. Each relayout runs for LOCAL_STEPS ticks. The
+ * graph keeps the added node, which is undoable.
+ */
+void bench_local()
+{
+  if (node_count < 3)
+    return;
+  // Above LOCAL_GLOBAL_NODES no global step runs before the edit, so the
+  // first local tick has no frozen far field; it is timed after the edits
+  bool held = node_count > LOCAL_GLOBAL_NODES;
+  if (!held)
+    bench_global_step();
+
+  for (int round = 0; round < 2; round++)
+  {
+    if (round == 0)
     {
-      if (!visited[j] && dist[j] < min_dist)
+      int ends[3] = {0, node_count / 2, node_count - 1};
+      int v = history_add_node(0.5f, 0.5f);
+      for (int e = 0; e < 3; e++)
       {
-        u = j;
-        min_dist = dist[j];
+        history_add_edge(v, ends[e], 1);
+        layout_touch(ends[e]);
       }
+      layout_touch(v);
     }
-    if (u == -1)
-      break;
-    visited[u] = true;
+    else
+    {
+      std::shared_ptr<const Adjacency> adj = graph_adjacency();
+      int dragged = 0;
+      for (int i = 1; i < node_count; i++)
+      {
+        if (adj->offsets[i + 1] - adj->offsets[i] > adj->offsets[dragged + 1] - adj->offsets[dragged])
+          dragged = i;
+      }
+      pinned_ids.push_back(nodes[dragged].id);
+      nodes[dragged].x = 0.2f;
+      nodes[dragged].y = -0.3f;
+      layout_touch(dragged);
+    }
+    auto start = std::chrono::steady_clock::now();
+    update_force_layout();
+    arena_reset(&frame_arena);
+    auto first = std::chrono::steady_clock::now();
+    while (local_steps_left > 0)
+    {
+      update_force_layout();
+      arena_reset(&frame_arena);
+    }
+    auto end = std::chrono::steady_clock::now();
+    printf("Local relayout after %s: %zu nodes, first tick %.2f ms, then %.3f ms/tick\n",
+           round == 0 ? "adding a node" : "dragging a node", local_nodes.size(),
+           std::chrono::duration<double, std::milli>(first - start).count(),
+           std::chrono::duration<double, std::milli>(end - first).count() /
+               (LOCAL_STEPS - 1));
+  }
+  if (held)
+    bench_global_step();
+}
+
+/**
+ * @brief Times K shortest paths queries against K independent full Dijkstra
+ *        searches, the cost of Yen's algorithm without the shared tree.
+ *
+ * Queries run between evenly spaced node pairs. Every route is checked to
+ * be loopless, to follow edges of the graph and to be no shorter than the
+ * one before it.
+ */
+void bench_routes()
+{
+  if (node_count < 2)
+    return;
+  std::shared_ptr<const Adjacency> adj = graph_adjacency();
+  const Adjacency &a = *adj;
+  int pairs = std::min(BENCH_SOURCES, node_count / 2);
+  DijkstraScratch scratch;
+  std::vector<Route> routes;
+  double yen_ms = 0, full_ms = 0;
+  int found = 0, bad = 0;
+  for (int p = 0; p < pairs; p++)
+  {
+    int source = (int)((long long)node_count * p / pairs);
+    auto t0 = std::chrono::steady_clock::now();
+    for (int r = 0; r < BENCH_ROUTES; r++)
+      dijkstra_search(a, &source, 1, -1, &scratch);
+    auto t1 = std::chrono::steady_clock::now();
+    // The target is the reachable node farthest from the source in index
+    int target = node_count - 1;
+    while (target > 0 && (target == source || scratch.dist[target] == INF))
+      target--;
+    if (target == source)
+      continue;
+    k_shortest_paths(a, source, target, BENCH_ROUTES, &routes);
+    auto t2 = std::chrono::steady_clock::now();
+    full_ms += std::chrono::duration<double, std::milli>(t1 - t0).count();
+    yen_ms += std::chrono::duration<double, std::milli>(t2 - t1).count();
+    found += (int)routes.size();
 
-    for (int k = 0; k < edge_count; k++)
+    for (size_t r = 0; r < routes.size(); r++)
     {
-      int v = -1;
-      if (edges[k].src == u)
-        v = edges[k].dest;
-      if (edges[k].dest == u)
-        v = edges[k].src;
-      if (v != -1 && !visited[v] && dist[u] + edges[k].weight < dist[v])
+      const std::vector<int> &path = routes[r].nodes;
+      std::vector<int> sorted(path);
+      std::sort(sorted.begin(), sorted.end());
+      double length = 0;
+      bool ok = path.front() == source && path.back() == target &&
+                std::adjacent_find(sorted.begin(), sorted.end()) == sorted.end() &&
+                (r == 0 || routes[r].length >= routes[r - 1].length * (1 - 1e-6f));
+      for (size_t i = 0; ok && i + 1 < path.size(); i++)
       {
-        dist[v] = dist[u] + edges[k].weight;
-        prev[v] = u;
+        int e = a.offsets[path[i]];
+        while (e < a.offsets[path[i] + 1] && a.targets[e] != path[i + 1])
+          e++;
+        ok = e < a.offsets[path[i] + 1];
+        if (ok)
+          length += a.weights[e];
       }
+      ok = ok && fabs(length - routes[r].length) <= 1e-3 * std::max(length, 1.0);
+      bad += !ok;
+    }
+  }
+  printf("%d nodes, %d edges, %d queries for %d routes on %s (%d slots)\n", node_count,
+         edge_count, pairs, BENCH_ROUTES, backend_name(backend_current()), backend_slots());
+  printf("  yen          %8.2f ms/query, %.1f routes/query, %d invalid\n", yen_ms / pairs,
+         (double)found / pairs, bad);
+  printf("  %2d dijkstra  %8.2f ms/query (%.1fx)\n", BENCH_ROUTES, full_ms / pairs,
+         full_ms / std::max(yen_ms, 1e-9));
+}
+
+/**
+ * @brief Times BENCH_LAYOUT_ITERATIONS global force steps with every force
+ *        law, each from the same start, and leaves the nodes there.
+ */
+void bench_forces()
+{
+  if (node_count == 0)
+    return;
+  std::vector<Node> start(nodes, nodes + node_count);
+  int previous = force_law;
+  printf("%d nodes, %d edges, %d iterations, %s (%d slots), %s mode\n", node_count,
+         edge_count, BENCH_LAYOUT_ITERATIONS, backend_name(backend_current()),
+         backend_slots(), backend_deterministic ? "deterministic" : "nondeterministic");
+  for (force_law = 0; force_law < FORCE_LAWS; force_law++)
+  {
+    std::copy(start.begin(), start.end(), nodes);
+    update_layout(); // warm up threads and the frame arena
+    arena_reset(&frame_arena);
+    std::copy(start.begin(), start.end(), nodes);
+    auto t0 = std::chrono::steady_clock::now();
+    for (int it = 0; it < BENCH_LAYOUT_ITERATIONS; it++)
+    {
+      update_layout();
+      arena_reset(&frame_arena);
     }
+    auto t1 = std::chrono::steady_clock::now();
+    printf("  %-12s %8.2f ms/iter\n", force_law_names[force_law],
+           std::chrono::duration<double, std::milli>(t1 - t0).count() /
+               BENCH_LAYOUT_ITERATIONS);
   }
+  std::copy(start.begin(), start.end(), nodes);
+  force_law = previous;
+}
 
-  shortest_path_length = 0;
-  if (dist[end] == INF)
+/**
+ * @brief Times community detection and compares a step and the draw work of
+ *        the collapsed view with those of the full graph.
+ *
+ * Draw work counts the circles and lines drawn: nodes and edges for the
+ * full graph, supernodes and links with every community closed.
+ */
+void bench_communities()
+{
+  if (node_count == 0)
     return;
+  std::vector<Node> start(nodes, nodes + node_count);
+  std::shared_ptr<const Adjacency> adj = graph_adjacency();
+  std::vector<int> labels;
+  CommunityStats stats;
+  auto t0 = std::chrono::steady_clock::now();
+  detect_communities(*adj, &labels, &stats);
+  auto t1 = std::chrono::steady_clock::now();
+  printf("%d nodes, %d edges: %d communities, Q = %.4f, %d levels in %.1f ms (%d slots)\n",
+         node_count, edge_count, stats.count, stats.modularity, stats.levels,
+         std::chrono::duration<double, std::milli>(t1 - t0).count(), parallel_threads());
 
-  int path[MAX_NODES];
-  int at = end;
-  while (at != -1)
+  collapsed_view = true;
+  collapsed.built = false;
+  update_communities();
+  task_wait(community_query.task);
+  collapsed_layout(); // builds the view and warms up the frame arena
+  arena_reset(&frame_arena);
+  auto t2 = std::chrono::steady_clock::now();
+  for (int it = 0; it < BENCH_LAYOUT_ITERATIONS; it++)
   {
-    path[shortest_path_length++] = at;
-    at = prev[at];
+    collapsed_layout();
+    arena_reset(&frame_arena);
   }
+  auto t3 = std::chrono::steady_clock::now();
+  int links = (int)collapsed.graph.link_edges.size();
+  collapsed_view = false;
+  collapsed.built = false;
 
-  for (int i = 0; i < shortest_path_length; i++)
+  std::copy(start.begin(), start.end(), nodes);
+  auto t4 = std::chrono::steady_clock::now();
+  for (int it = 0; it < BENCH_LAYOUT_ITERATIONS; it++)
   {
-    shortest_path_nodes[i] = path[shortest_path_length - 1 - i];
+    update_layout();
+    arena_reset(&frame_arena);
   }
+  auto t5 = std::chrono::steady_clock::now();
+  std::copy(start.begin(), start.end(), nodes);
+  printf("  full graph  %8.2f ms/step, %d circles + %d lines\n",
+         std::chrono::duration<double, std::milli>(t5 - t4).count() / BENCH_LAYOUT_ITERATIONS,
+         node_count, edge_count);
+  printf("  collapsed   %8.2f ms/step, %d circles + %d lines\n",
+         std::chrono::duration<double, std::milli>(t3 - t2).count() / BENCH_LAYOUT_ITERATIONS,
+         collapsed.graph.count, links);
 }
 
 /**
- * @brief Deletes a node and updates the graph.
+ * @brief Counts overlapping pairs of nodes by brute force.
  *
- * @param node_index Index of the node to delete
+ * @return Pairs of nodes closer than one node diameter
  */
-void delete_node(int node_index)
+long long count_overlaps()
 {
-  for (int i = 0; i < edge_count;)
+  long long pairs = 0;
+  float diameter = 2 * NODE_RADIUS;
+  for (int i = 0; i < node_count; i++)
   {
-    if (edges[i].src == node_index || edges[i].dest == node_index)
+    for (int j = i + 1; j < node_count; j++)
     {
-      for (int j = i; j < edge_count - 1; j++)
-      {
-        edges[j] = edges[j + 1];
-      }
-      edge_count--;
+      float dx = nodes[i].x - nodes[j].x, dy = nodes[i].y - nodes[j].y;
+      pairs += dx * dx + dy * dy < diameter * diameter;
     }
-    else
+  }
+  return pairs;
+}
+
+/**
+ * @brief Runs BENCH_OVERLAP_TICKS force ticks from the same start without
+ *        and with overlap removal, and reports the overlapping pairs left
+ *        and the time the removal took per tick.
+ */
+void bench_overlap()
+{
+  if (node_count < 2)
+    return;
+  std::vector<Node> start(nodes, nodes + node_count);
+  LayoutBox box = layout_box();
+  printf("%d nodes, %d edges, circles cover %.0f%% of the canvas\n", node_count, edge_count,
+         100 * node_count * 3.1415926f * NODE_RADIUS * NODE_RADIUS /
+             ((box.x1 - box.x0) * (box.y1 - box.y0)));
+  for (int round = 0; round < 2; round++)
+  {
+    std::copy(start.begin(), start.end(), nodes);
+    double removal_ms = 0;
+    int left = 0;
+    for (int tick = 0; tick < BENCH_OVERLAP_TICKS; tick++)
     {
-      if (edges[i].src > node_index)
-        edges[i].src--;
-      if (edges[i].dest > node_index)
-        edges[i].dest--;
-      i++;
+      update_force_layout();
+      arena_reset(&frame_arena);
+      if (round == 0)
+        continue;
+      auto t0 = std::chrono::steady_clock::now();
+      left = remove_overlaps();
+      removal_ms += std::chrono::duration<double, std::milli>(
+                        std::chrono::steady_clock::now() - t0)
+                        .count();
+      arena_reset(&frame_arena);
     }
+    if (round == 0)
+      printf("  without removal: %lld overlapping pairs after %d ticks\n", count_overlaps(),
+             BENCH_OVERLAP_TICKS);
+    else if (left < 0)
+      printf("  with removal: skipped, the circles cannot all fit\n");
+    else
+      printf("  with removal:    %lld overlapping pairs after %d ticks, %.3f ms/tick\n",
+             count_overlaps(), BENCH_OVERLAP_TICKS, removal_ms / BENCH_OVERLAP_TICKS);
   }
-  for (int i = node_index; i < node_count - 1; i++)
+  std::copy(start.begin(), start.end(), nodes);
+}
+
+/**
+ * @brief Times the layout and facility kernels on every compiled-in backend.
+ *
+ * Each backend starts from the same positions and runs the same number of
+ * layout iterations and one nearest-facility query. The positions are then
+ * compared with those of the first backend, which in deterministic mode must
+ * match bit for bit. The graph and the selected backend are restored
+ * afterwards.
+ */
+void bench_backends()
+{
+  if (node_count == 0)
+    return;
+  std::vector<Node> start(nodes, nodes + node_count);
+  std::vector<Node> reference;
+  std::vector<int> sources(std::min(BENCH_SOURCES, node_count));
+  for (size_t s = 0; s < sources.size(); s++)
+    sources[s] = (int)((long long)node_count * s / sources.size());
+  std::shared_ptr<const Adjacency> adj = graph_adjacency();
+  FacilityResult facilities;
+  int previous = backend_current();
+
+  printf("%d nodes, %d edges, %d layout iterations, %zu facilities, %s mode\n",
+         node_count, edge_count, BENCH_LAYOUT_ITERATIONS, sources.size(),
+         backend_deterministic ? "deterministic" : "nondeterministic");
+  for (int b = BACKEND_SERIAL; b <= BACKEND_COUNT; b++)
   {
-    nodes[i] = nodes[i + 1];
-    nodes[i].label = 'A' + i;
+    if (!backend_select(b))
+    {
+      printf("  %-9s not compiled in\n", backend_name(b));
+      continue;
+    }
+    std::copy(start.begin(), start.end(), nodes);
+    update_layout(); // warm up threads and the frame arena
+    arena_reset(&frame_arena);
+    std::copy(start.begin(), start.end(), nodes);
+
+    unsigned long long allocations = heap_allocations();
+    auto t0 = std::chrono::steady_clock::now();
+    for (int it = 0; it < BENCH_LAYOUT_ITERATIONS; it++)
+    {
+      update_layout();
+      arena_reset(&frame_arena);
+    }
+    auto t1 = std::chrono::steady_clock::now();
+    allocations = heap_allocations() - allocations;
+    nearest_facilities(*adj, sources, &facilities);
+    auto t2 = std::chrono::steady_clock::now();
+
+    const char *match = "reference";
+    if (reference.empty())
+      reference.assign(nodes, nodes + node_count);
+    else
+    {
+      float diff = 0;
+      for (int i = 0; i < node_count; i++)
+        diff = std::max(diff, std::max(fabsf(nodes[i].x - reference[i].x),
+                                       fabsf(nodes[i].y - reference[i].y)));
+      static char buf[48];
+      snprintf(buf, sizeof(buf), diff == 0 ? "identical" : "max diff %g", diff);
+      match = buf;
+    }
+    printf("  %-9s %3d slots  layout %8.2f ms/iter  facilities %8.2f ms  "
+           "%llu allocs  %s\n",
+           backend_name(b), backend_slots(),
+           std::chrono::duration<double, std::milli>(t1 - t0).count() /
+               BENCH_LAYOUT_ITERATIONS,
+           std::chrono::duration<double, std::milli>(t2 - t1).count(),
+           allocations, match);
   }
-  node_count--;
+  std::copy(start.begin(), start.end(), nodes);
+  backend_select(previous);
+  print_scheduler_stats();
 }
 
 /**
@@ -902,8 +3972,8 @@ void delete_node(int node_index)
  */
 void mouse(int button, int state, int x, int y)
 {
-  int w = glutGet(GLUT_WINDOW_WIDTH);
-  int h = glutGet(GLUT_WINDOW_HEIGHT);
+  int w = window_w;
+  int h = window_h;
 
   std::cout << "X: " << x << " Y: " << y << "\n";
 
@@ -913,38 +3983,46 @@ void mouse(int button, int state, int x, int y)
     {
       selected_node = -1;
       sp_selected = -1;
-      int y_pos = y;
-      if (y_pos >= 20 && y_pos <= 60)
-        current_mode = MODE_ADD_NODE;
-      else if (y_pos >= 70 && y_pos <= 110)
-        current_mode = MODE_ADD_EDGE;
-      else if (y_pos >= 120 && y_pos <= 160)
-        current_mode = MODE_SHORTEST_PATH;
-      else if (y_pos >= 170 && y_pos <= 210)
-        current_mode = MODE_EDIT_WEIGHT;
-      else if (y_pos >= 220 && y_pos <= 260)
-        current_mode = MODE_DELETE_NODE;
-      else if (y_pos >= 270 && y_pos <= 310)
-        current_mode = MODE_MST;
-      else if (y_pos >= 320 && y_pos <= 360)
+      tree_root = -1;
+      tree_sources.clear();
+      tree_dirty = true;
+      int button = menu_button_at(y);
+      if (button != -1 && menu_buttons[button].mode != MENU_CLEAR)
+        current_mode = menu_buttons[button].mode;
+      else if (button != -1)
       {
         // Clear Screen button clicked
-        node_count = 0;
-        edge_count = 0;
+        history_clear();
+        routes_shown = 0;
       }
-      glutPostRedisplay();
+      request_redisplay();
       return;
     }
 
     float gl_x = (x / (float)w) * 2.0f - 1.0f;
     float gl_y = 1.0f - (y / (float)h) * 2.0f;
 
+    // In the collapsed view, clicking a closed community opens it
+    int community = community_at(gl_x, gl_y, false);
+    if (community != -1)
+    {
+      set_community_open(community, true);
+      request_redisplay();
+      return;
+    }
+
     if (current_mode == MODE_ADD_NODE)
     {
-      if (find_node(gl_x, gl_y) == -1 && node_count < MAX_NODES)
+      // Pressing on a node drags it instead; dragged nodes stay pinned
+      int node = find_node(gl_x, gl_y);
+      if (node == -1)
+        layout_touch(history_add_node(gl_x, gl_y));
+      else
       {
-        nodes[node_count] = (Node){gl_x, gl_y, 'A' + node_count};
-        node_count++;
+        drag_id = nodes[node].id;
+        if (std::find(pinned_ids.begin(), pinned_ids.end(), drag_id) == pinned_ids.end())
+          pinned_ids.push_back(drag_id);
+        layout_touch(node);
       }
     }
     else if (current_mode == MODE_ADD_EDGE)
@@ -988,11 +4066,40 @@ void mouse(int button, int state, int x, int y)
       int edge_index = find_edge_near(gl_x, gl_y);
       if (edge_index != -1)
       {
-        editing_edge = edge_index;
-        editing_existing_edge = true;
-        inputting_weight = true;
-        snprintf(weight_input_buffer, sizeof(weight_input_buffer), "%.1f",
-                 edges[edge_index].weight);
+        editing_edge = edge_index;
+        editing_existing_edge = true;
+        inputting_weight = true;
+        snprintf(weight_input_buffer, sizeof(weight_input_buffer), "%.1f",
+                 edges[edge_index].weight);
+      }
+    }
+    else if (current_mode == MODE_GENERATE)
+    {
+      generate_in_canvas();
+    }
+    else if (current_mode == MODE_SP_TREE)
+    {
+      int node = find_node(gl_x, gl_y);
+      if (node != -1)
+      {
+        auto it = std::find(tree_sources.begin(), tree_sources.end(), node);
+        if (it != tree_sources.end())
+          tree_sources.erase(it);
+        else
+          tree_sources.push_back(node);
+        // Show the facility view right away rather than the hovered tree
+        tree_root = -1;
+        tree_dirty = true;
+      }
+    }
+    else if (current_mode == MODE_ANALYTICS)
+    {
+      int node = find_node(gl_x, gl_y);
+      if (node != -1)
+      {
+        metric_source = node;
+        metric_selected = METRIC_BFS;
+        metric_dirty = true;
       }
     }
     else if (current_mode == MODE_DELETE_NODE)
@@ -1000,10 +4107,85 @@ void mouse(int button, int state, int x, int y)
       int node = find_node(gl_x, gl_y);
       if (node != -1)
       {
-        delete_node(node);
+        std::shared_ptr<const Adjacency> adj = graph_adjacency();
+        for (int e = adj->offsets[node]; e < adj->offsets[node + 1]; e++)
+          touched_ids.push_back(nodes[adj->targets[e]].id);
+        // Deleting renumbers the nodes above it
+        hold_indices();
+        history_delete_node(node);
+        restore_indices();
+        touched_version = graph_version;
+        recheck_routes();
       }
     }
-    glutPostRedisplay();
+    request_redisplay();
+  }
+  else if (button == GLUT_LEFT_BUTTON && state == GLUT_UP)
+    drag_id = -1;
+  else if (button == GLUT_RIGHT_BUTTON && state == GLUT_DOWN && x >= MENU_WIDTH_PIXELS)
+  {
+    // Right click pins or unpins a node, or closes the open community
+    // around the pointer in the collapsed view
+    float gl_x = (x / (float)w) * 2.0f - 1.0f;
+    float gl_y = 1.0f - (y / (float)h) * 2.0f;
+    int node = find_node(gl_x, gl_y);
+    int community = community_at(gl_x, gl_y, true);
+    if (node == -1 && community != -1)
+    {
+      set_community_open(community, false);
+      request_redisplay();
+    }
+    else if (node != -1)
+    {
+      auto it = std::find(pinned_ids.begin(), pinned_ids.end(), nodes[node].id);
+      if (it != pinned_ids.end())
+      {
+        pinned_ids.erase(it);
+        layout_touch(node);
+      }
+      else
+        pinned_ids.push_back(nodes[node].id);
+      request_redisplay();
+    }
+  }
+}
+
+/**
+ * @brief Motion callback; moves the dragged node, or roots the shortest path
+ * tree at the hovered node.
+ *
+ * Leaving a node keeps its tree on screen unless facilities were picked, in
+ * which case the facility view comes back.
+ *
+ * @param x X-coordinate of the mouse
+ * @param y Y-coordinate of the mouse
+ */
+void motion(int x, int y)
+{
+  int dragged = drag_id == -1 ? -1 : graph_node_index(drag_id);
+  if (dragged != -1)
+  {
+    LayoutBox box = layout_box();
+    float gl_x = (x / (float)window_w) * 2.0f - 1.0f;
+    float gl_y = 1.0f - (y / (float)window_h) * 2.0f;
+    nodes[dragged].x = std::min(std::max(gl_x, box.x0), box.x1);
+    nodes[dragged].y = std::min(std::max(gl_y, box.y0), box.y1);
+    layout_touch(dragged);
+    request_redisplay();
+    return;
+  }
+  if (current_mode != MODE_SP_TREE || x < MENU_WIDTH_PIXELS)
+    return;
+  float gl_x = (x / (float)window_w) * 2.0f - 1.0f;
+  float gl_y = 1.0f - (y / (float)window_h) * 2.0f;
+  int node = find_node(gl_x, gl_y);
+  if (node == -1 && tree_sources.empty())
+    return;
+  if (node != tree_root)
+  {
+    tree_root = node;
+    tree_dirty = true;
+    request_redisplay();
   }
 }
 
@@ -1023,16 +4205,26 @@ void keyboard(unsigned char key, int x, int y)
       float weight = atof(weight_input_buffer);
       if (weight > 0)
       {
+        int src = editing_existing_edge ? edges[editing_edge].src : temp_src;
+        int dest = editing_existing_edge ? edges[editing_edge].dest : temp_dest;
         if (editing_existing_edge)
         {
-          edges[editing_edge].weight = weight;
+          history_set_weight(editing_edge, weight);
           editing_edge = -1;
           editing_existing_edge = false;
         }
+        else if (has_edge(temp_src, temp_dest))
+        {
+          // Re-adding an existing edge updates its weight instead of
+          // creating a parallel edge
+          history_set_weight(graph_find_edge(temp_src, temp_dest), weight);
+        }
         else
         {
-          add_edge(temp_src, temp_dest, weight);
+          history_add_edge(temp_src, temp_dest, weight);
         }
+        layout_touch(src);
+        layout_touch(dest);
       }
       inputting_weight = false;
       weight_input_buffer[0] = '\0';
@@ -1055,8 +4247,178 @@ void keyboard(unsigned char key, int x, int y)
         strncat(weight_input_buffer, keyStr, 1);
       }
     }
-    glutPostRedisplay();
+    request_redisplay();
+  }
+  else if (current_mode == MODE_GENERATE && key >= '1' &&
+           key < '1' + GEN_COUNT)
+  {
+    generator_selected = key - '0';
+    request_redisplay();
+  }
+  else if (current_mode == MODE_ANALYTICS && key >= '1' &&
+           key < '1' + METRIC_COUNT)
+  {
+    metric_selected = key - '0';
+    metric_dirty = true;
+    request_redisplay();
+  }
+  else if (key == 'o' || key == 'h')
+  {
+    // 'o' renumbers nodes by Reverse Cuthill-McKee, 'h' along a Hilbert curve
+    reorder_graph(key == 'o' ? REORDER_RCM : REORDER_HILBERT);
+    request_redisplay();
+  }
+  else if (key == 'b')
+  {
+    // 'b' switches the layout and path kernels to the next compiled-in backend
+    int b = backend_current();
+    do
+      b = b % BACKEND_COUNT + 1;
+    while (!backend_select(b));
+    printf("Execution backend: %s (%d slots)\n", backend_name(b), backend_slots());
+    request_redisplay();
+  }
+  else if (key == 'e')
+  {
+    // 'e' cycles the edge style: auto, straight, bundled
+    edge_style = (edge_style + 1) % EDGE_STYLES;
+    request_redisplay();
+  }
+  else if (key == 'l')
+  {
+    // 'l' switches between the force-directed and the stress layout
+    layout_engine = (layout_engine + 1) % LAYOUT_ENGINES;
+    stress_placed = -1;
+    if (layout_engine != LAYOUT_STRESS)
+      query_cancel(&stress_query);
+    printf("Layout engine: %s\n", layout_engine_names[layout_engine]);
+    request_redisplay();
   }
+  else if (key == 'f')
+  {
+    // 'f' cycles the force law of the force-directed layout
+    force_law = (force_law + 1) % FORCE_LAWS;
+    local_running = false; // its frozen far field belongs to the old law
+    printf("Force law: %s\n", force_law_names[force_law]);
+    request_redisplay();
+  }
+  else if (key == 'k')
+  {
+    // 'k' cycles the number of routes the shortest path mode finds
+    int c = 0;
+    while (c < ROUTE_COUNT_CHOICES && route_counts[c] != route_count)
+      c++;
+    route_count = route_counts[(c + 1) % ROUTE_COUNT_CHOICES];
+    printf("Routes per query: %d\n", route_count);
+    request_redisplay();
+  }
+  else if (key == 'c')
+  {
+    // 'c' toggles the collapsed view of the communities; leaving it resumes
+    // the full layout from the collapsed arrangement
+    collapsed_view = !collapsed_view;
+    collapsed.built = false;
+    local_running = false;
+    if (!collapsed_view)
+      query_cancel(&community_query);
+    printf("Collapsed view: %s\n", collapsed_view ? "on" : "off");
+    request_redisplay();
+  }
+  else if (key == 'g')
+  {
+    // 'g' goes back to global force steps after a local relayout, and
+    // starts them on graphs too large to run them unasked
+    local_running = false;
+    global_resumed = true;
+    request_redisplay();
+  }
+  else if (key == 26 || key == 'u' || key == 25 || key == 'r')
+  {
+    // Ctrl+Z / 'u' undoes the last edit, Ctrl+Y / 'r' redoes it
+    bool changed = (key == 26 || key == 'u') ? history_undo() : history_redo();
+    if (changed)
+    {
+      selected_node = -1;
+      sp_selected = -1;
+      routes_shown = 0;
+      request_redisplay();
+    }
+  }
+}
+
+/**
+ * @brief Applies a new logical window size.
+ *
+ * @param w Width in pixels
+ * @param h Height in pixels
+ */
+void resize(int w, int h)
+{
+  window_w = w;
+  window_h = h;
+}
+
+/**
+ * @brief GLUT reshape callback; records the new size and updates the viewport.
+ *
+ * @param w Width in pixels
+ * @param h Height in pixels
+ */
+void reshape(int w, int h)
+{
+  glViewport(0, 0, w, h);
+  if (replay_active())
+    return;
+  record_event(EVENT_RESIZE, 0, 0, w, h);
+  resize(w, h);
+}
+
+/**
+ * @brief GLUT mouse callback; records the event and ignores live input while
+ * a replay is running.
+ *
+ * @param button Mouse button
+ * @param state Button state (GLUT_DOWN or GLUT_UP)
+ * @param x X-coordinate of the mouse
+ * @param y Y-coordinate of the mouse
+ */
+void on_mouse(int button, int state, int x, int y)
+{
+  if (replay_active())
+    return;
+  record_event(EVENT_MOUSE, button, state, x, y);
+  mouse(button, state, x, y);
+}
+
+/**
+ * @brief GLUT motion callback, with or without a button held; records the
+ * event and ignores live input while a replay is running.
+ *
+ * @param x X-coordinate of the mouse
+ * @param y Y-coordinate of the mouse
+ */
+void on_motion(int x, int y)
+{
+  if (replay_active())
+    return;
+  record_event(EVENT_MOTION, 0, 0, x, y);
+  motion(x, y);
+}
+
+/**
+ * @brief GLUT keyboard callback; records the event and ignores live input
+ * while a replay is running.
+ *
+ * @param key Key pressed
+ * @param x X-coordinate of the mouse
+ * @param y Y-coordinate of the mouse
+ */
+void on_keyboard(unsigned char key, int x, int y)
+{
+  if (replay_active())
+    return;
+  record_event(EVENT_KEY, key, 0, x, y);
+  keyboard(key, x, y);
 }
 
 /**
@@ -1064,6 +4426,11 @@ void keyboard(unsigned char key, int x, int y)
  */
 void display()
 {
+  static unsigned long long allocations_seen = 0;
+  unsigned long long allocations = heap_allocations();
+  frame_allocations = allocations - allocations_seen;
+  allocations_seen = allocations;
+
   glClear(GL_COLOR_BUFFER_BIT);
 
   glMatrixMode(GL_PROJECTION);
@@ -1072,11 +4439,41 @@ void display()
   glMatrixMode(GL_MODELVIEW);
   glLoadIdentity();
 
-  draw_nodes();
-  draw_edges();
+  // Queries run on the scheduler; these only pick up finished results and
+  // start new queries, so a frame never waits for an algorithm
+  const std::vector<NodeStyle> *styles = NULL;
+  if (current_mode == MODE_SP_TREE)
+  {
+    update_sp_tree();
+    if (tree_query.shown == graph_version)
+      styles = &tree_query.front.styles;
+  }
+  else if (current_mode == MODE_ANALYTICS)
+  {
+    update_analytics();
+    if (metric_query.shown == graph_version)
+      styles = &metric_query.front.styles;
+  }
+  else if (current_mode == MODE_MST)
+    update_mst();
+
+  // The view is built by the layout tick, except in a live session where
+  // an edit should not flash the full graph for a frame
+  if (collapsed_view && !record_active() && !replay_active())
+    build_collapsed();
+  if (collapsed_view && collapsed.built && collapsed.version == graph_version)
+    draw_collapsed(styles);
+  else
+  {
+    update_bundles();
+    draw_nodes(styles);
+    draw_edges();
+  }
 
   if (current_mode == MODE_SHORTEST_PATH)
     draw_shortest_path();
+  else if (current_mode == MODE_SP_TREE)
+    draw_sp_tree();
   else if (current_mode == MODE_MST)
   {
     draw_mst();
@@ -1090,14 +4487,13 @@ void display()
     glPushMatrix();
     glLoadIdentity();
     char sum_str[50];
-    sprintf(sum_str, "MST Sum: %.1f", mst_sum);
+    sprintf(sum_str, "MST Sum: %.1f", mst_query.front.sum);
     glColor3f(COLOR_TEXT_R, COLOR_TEXT_G, COLOR_TEXT_B);
     draw_string_pixel(w - 200, 30, sum_str);
     glPopMatrix();
     glMatrixMode(GL_PROJECTION);
     glPopMatrix();
     glMatrixMode(GL_MODELVIEW);
-    mst_sum = 0;
   }
 
   draw_menu_pixel();
@@ -1107,6 +4503,15 @@ void display()
   draw_mode_dialog(); // Add this line to draw the mode dialog
 
   glFlush();
+  arena_reset(&frame_arena);
+
+  if (startup.first_frame_ms < 0)
+    startup.first_frame_ms = startup_elapsed_ms();
+  if (startup.interactive_ms < 0 && !startup.loading && !startup.placing)
+  {
+    startup.interactive_ms = startup_elapsed_ms();
+    print_startup();
+  }
 }
 
 /**
@@ -1117,8 +4522,93 @@ void draw_mode_dialog()
   int w = glutGet(GLUT_WINDOW_WIDTH);
   int h = glutGet(GLUT_WINDOW_HEIGHT);
 
+  // Mode instructions
+  const char *mode_str;
+  char mode_buf[256];
+  switch (current_mode)
+  {
+  case MODE_ADD_NODE:
+    mode_str = "Mode: Add Node\nClick empty area to add a node.";
+    break;
+  case MODE_ADD_EDGE:
+    mode_str = "Mode: Add Edge\nClick two nodes to add an edge.";
+    break;
+  case MODE_SHORTEST_PATH:
+  {
+    int at = snprintf(mode_buf, sizeof(mode_buf),
+                      "Mode: Shortest Path (k = %d)\nClick two nodes to find the\n"
+                      "shortest routes; 'k' sets k.",
+                      route_count);
+    for (int r = 0; r < routes_shown && r < 5 && at < (int)sizeof(mode_buf); r++)
+      at += snprintf(mode_buf + at, sizeof(mode_buf) - at, "%s%.1f", r ? " " : "\nLengths: ",
+                     path_query.front[r].length);
+    if (routes_shown > 5 && at < (int)sizeof(mode_buf))
+      snprintf(mode_buf + at, sizeof(mode_buf) - at, " ... %.1f",
+               path_query.front[routes_shown - 1].length);
+    mode_str = mode_buf;
+    break;
+  }
+  case MODE_EDIT_WEIGHT:
+    mode_str = "Mode: Edit Weight\nClick an edge to edit its weight.";
+    break;
+  case MODE_DELETE_NODE:
+    mode_str = "Mode: Delete Node\nClick a node to delete it.";
+    break;
+  case MODE_MST:
+    mode_str = "Mode: MST\nMinimum Spanning Tree will be\ndisplayed.";
+    break;
+  case MODE_SP_TREE:
+    snprintf(mode_buf, sizeof(mode_buf),
+             "Mode: SP Tree (%d facilities)\nHover a node to see its tree,\n"
+             "click nodes to toggle facilities.\nQuery: %.2f ms",
+             (int)tree_sources.size(), tree_query.front.ms);
+    mode_str = mode_buf;
+    break;
+  case MODE_ANALYTICS:
+    snprintf(mode_buf, sizeof(mode_buf),
+             "Mode: Analytics (%s)\nKeys 1-5: components bfs pagerank\n"
+             "betweenness communities.\nClick a BFS root. 'c' collapses.\n"
+             "%s in %.2f ms",
+             metric_name(metric_selected), metric_query.front.summary,
+             metric_query.front.ms);
+    mode_str = mode_buf;
+    break;
+  case MODE_GENERATE:
+    snprintf(mode_buf, sizeof(mode_buf),
+             "Mode: Generate (%s)\nKeys 1-5: er ba grid geometric rmat\n"
+             "Click the canvas to generate.",
+             generator_name(generator_selected));
+    mode_str = mode_buf;
+    break;
+  default:
+    mode_str = "Mode: Unknown";
+    break;
+  }
+
+  // Progress of the query behind the current mode, -1 while none is running
+  float progress = -1;
+  if (current_mode == MODE_SHORTEST_PATH)
+    progress = query_progress(path_query);
+  else if (current_mode == MODE_MST)
+    progress = query_progress(mst_query);
+  else if (current_mode == MODE_SP_TREE)
+    progress = query_progress(tree_query);
+  else if (current_mode == MODE_ANALYTICS)
+    progress = query_progress(metric_query);
+  char status_buf[320];
+  if (progress >= 0)
+  {
+    snprintf(status_buf, sizeof(status_buf), "%s\nComputing... %d%%", mode_str,
+             (int)(progress * 100));
+    mode_str = status_buf;
+  }
+
+  // The box grows with the number of instruction lines
+  int lines = 1;
+  for (const char *c = mode_str; *c != '\0'; c++)
+    lines += *c == '\n';
   int box_width = 300;
-  int box_height = 75;
+  int box_height = lines > 3 ? 15 + 20 * lines : 75;
   int x = w - box_width - 20;
   int y = 20;
 
@@ -1153,42 +4643,34 @@ void draw_mode_dialog()
   glVertex2i(x, y + box_height);
   glEnd();
 
-  // Mode instructions
-  const char *mode_str;
-  switch (current_mode)
-  {
-  case MODE_ADD_NODE:
-    mode_str = "Mode: Add Node\nClick empty area to add a node.";
-    break;
-  case MODE_ADD_EDGE:
-    mode_str = "Mode: Add Edge\nClick two nodes to add an edge.";
-    break;
-  case MODE_SHORTEST_PATH:
-    mode_str = "Mode: Shortest Path\nClick two nodes to find the\nshortest path.";
-    break;
-  case MODE_EDIT_WEIGHT:
-    mode_str = "Mode: Edit Weight\nClick an edge to edit its weight.";
-    break;
-  case MODE_DELETE_NODE:
-    mode_str = "Mode: Delete Node\nClick a node to delete it.";
-    break;
-  case MODE_MST:
-    mode_str = "Mode: MST\nMinimum Spanning Tree will be\ndisplayed.";
-    break;
-  default:
-    mode_str = "Mode: Unknown";
-    break;
-  }
-
   // Draw mode instructions
   int line_height = 20;
   int line_y = y + 20;
-  char *line = strtok(strdup(mode_str), "\n");
-  while (line != NULL)
+  for (const char *line = mode_str; *line != '\0';)
   {
-    draw_string_pixel(x + 10, line_y, line);
+    const char *end = strchr(line, '\n');
+    size_t length = end ? (size_t)(end - line) : strlen(line);
+    char text[128];
+    if (length >= sizeof(text))
+      length = sizeof(text) - 1;
+    memcpy(text, line, length);
+    text[length] = '\0';
+    if (length > 0)
+      draw_string_pixel(x + 10, line_y, text);
     line_y += line_height;
-    line = strtok(NULL, "\n");
+    line = end ? end + 1 : line + length;
+  }
+
+  if (progress >= 0)
+  {
+    // Progress bar along the bottom edge of the box
+    glColor3f(COLOR_BUTTON_ACTIVE_R, COLOR_BUTTON_ACTIVE_G, COLOR_BUTTON_ACTIVE_B);
+    glBegin(GL_QUADS);
+    glVertex2i(x + 2, y + box_height - 6);
+    glVertex2i(x + 2 + (int)((box_width - 4) * progress), y + box_height - 6);
+    glVertex2i(x + 2 + (int)((box_width - 4) * progress), y + box_height - 2);
+    glVertex2i(x + 2, y + box_height - 2);
+    glEnd();
   }
 
   glPopMatrix();
@@ -1206,9 +4688,374 @@ void draw_mode_dialog()
  */
 int main(int argc, char **argv)
 {
+  const char *record_path = NULL;
+  const char *replay_path = NULL;
+  GeneratorParams gen = {};
+  const char *save_edges_path = NULL;
+  const char *import_edges_path = NULL;
+  const char *session_path = NULL;
+  const char *serve_path = NULL;
+  const char *ingest_path = NULL;
+  double ingest_rate = 0;
+  const char *load_path = NULL;
+  int reorder = 0;
+  bool bench = false;
+  bool bench_bundles = false;
+  bool bench_stresses = false;
+  bool bench_locals = false;
+  bool bench_force_laws = false;
+  bool bench_route_queries = false;
+  bool bench_community_view = false;
+  bool bench_overlaps = false;
+  StreamOptions stream = {NULL, (size_t)512 << 20, 10, -1, -1, 0};
+  for (int i = 1; i < argc; i++)
+  {
+    if (strcmp(argv[i], "--record") == 0 && i + 1 < argc)
+      record_path = argv[++i];
+    else if (strcmp(argv[i], "--replay") == 0 && i + 1 < argc)
+      replay_path = argv[++i];
+    else if (strcmp(argv[i], "--max-speed") == 0)
+      replay_max_speed = true;
+    else if (strcmp(argv[i], "--headless") == 0)
+      headless = true;
+    else if (strcmp(argv[i], "--seed") == 0 && i + 1 < argc)
+      session_seed = (unsigned int)strtoul(argv[++i], NULL, 10);
+    else if (strcmp(argv[i], "--generate") == 0 && i + 1 < argc)
+    {
+      gen.type = generator_type(argv[++i]);
+      if (gen.type == 0)
+      {
+        std::cerr << "Unknown generator " << argv[i]
+                  << " (use er, ba, grid, geometric or rmat)\n";
+        return 1;
+      }
+      generator_defaults(gen.type, &gen);
+    }
+    else if (strcmp(argv[i], "--nodes") == 0 && i + 1 < argc)
+      gen.nodes = atoi(argv[++i]);
+    else if (strcmp(argv[i], "--edges") == 0 && i + 1 < argc)
+      gen.edges = atoi(argv[++i]);
+    else if (strcmp(argv[i], "--prob") == 0 && i + 1 < argc)
+      gen.probability = atof(argv[++i]);
+    else if (strcmp(argv[i], "--degree") == 0 && i + 1 < argc)
+      gen.degree = atoi(argv[++i]);
+    else if (strcmp(argv[i], "--radius") == 0 && i + 1 < argc)
+      gen.radius = atof(argv[++i]);
+    else if (strcmp(argv[i], "--reorder") == 0 && i + 1 < argc)
+    {
+      reorder = reorder_method(argv[++i]);
+      if (reorder == 0)
+      {
+        std::cerr << "Unknown ordering " << argv[i] << " (use rcm or hilbert)\n";
+        return 1;
+      }
+    }
+    else if (strcmp(argv[i], "--backend") == 0 && i + 1 < argc)
+    {
+      int b = backend_lookup(argv[++i]);
+      if (!backend_select(b))
+      {
+        std::cerr << "Unknown or unavailable backend " << argv[i]
+                  << " (use serial, par_unseq, openmp or pool)\n";
+        return 1;
+      }
+    }
+    else if (strcmp(argv[i], "--nondeterministic") == 0)
+      backend_deterministic = false;
+    else if (strcmp(argv[i], "--bench-backends") == 0)
+      bench = true;
+    else if (strcmp(argv[i], "--bench-bundling") == 0)
+      bench_bundles = true;
+    else if (strcmp(argv[i], "--bench-stress") == 0)
+      bench_stresses = true;
+    else if (strcmp(argv[i], "--bench-local") == 0)
+      bench_locals = true;
+    else if (strcmp(argv[i], "--bench-forces") == 0)
+      bench_force_laws = true;
+    else if (strcmp(argv[i], "--bench-routes") == 0)
+      bench_route_queries = true;
+    else if (strcmp(argv[i], "--bench-communities") == 0)
+      bench_community_view = true;
+    else if (strcmp(argv[i], "--bench-overlap") == 0)
+      bench_overlaps = true;
+    else if (strcmp(argv[i], "--layout") == 0 && i + 1 < argc)
+    {
+      ++i;
+      if (strcmp(argv[i], "force") == 0)
+        layout_engine = LAYOUT_FORCE;
+      else if (strcmp(argv[i], "stress") == 0)
+        layout_engine = LAYOUT_STRESS;
+      else
+      {
+        std::cerr << "Unknown layout " << argv[i] << " (use force or stress)\n";
+        return 1;
+      }
+    }
+    else if (strcmp(argv[i], "--force") == 0 && i + 1 < argc)
+    {
+      ++i;
+      force_law = -1;
+      for (int f = 0; f < FORCE_LAWS; f++)
+      {
+        if (strcasecmp(argv[i], force_law_names[f]) == 0)
+          force_law = f;
+      }
+      if (force_law == -1)
+      {
+        std::cerr << "Unknown force law " << argv[i] << " (use fr, linlog or forceatlas2)\n";
+        return 1;
+      }
+    }
+    else if (strcmp(argv[i], "--save-edges") == 0 && i + 1 < argc)
+      save_edges_path = argv[++i];
+    else if (strcmp(argv[i], "--import-edges") == 0 && i + 1 < argc)
+      import_edges_path = argv[++i];
+    else if (strcmp(argv[i], "--stream") == 0 && i + 1 < argc)
+      stream.path = argv[++i];
+    else if (strcmp(argv[i], "--memory") == 0 && i + 1 < argc)
+      stream.budget = (size_t)atol(argv[++i]) << 20;
+    else if (strcmp(argv[i], "--iterations") == 0 && i + 1 < argc)
+      stream.iterations = atoi(argv[++i]);
+    else if (strcmp(argv[i], "--from") == 0 && i + 1 < argc)
+      stream.from = atoi(argv[++i]);
+    else if (strcmp(argv[i], "--to") == 0 && i + 1 < argc)
+      stream.to = atoi(argv[++i]);
+    else if (strcmp(argv[i], "--session") == 0 && i + 1 < argc)
+      session_path = argv[++i];
+    else if (strcmp(argv[i], "--serve") == 0 && i + 1 < argc)
+      serve_path = argv[++i];
+    else if (strcmp(argv[i], "--ingest") == 0 && i + 1 < argc)
+      ingest_path = argv[++i];
+    else if (strcmp(argv[i], "--ingest-rate") == 0 && i + 1 < argc)
+      ingest_rate = atof(argv[++i]);
+    else if (strcmp(argv[i], "--load") == 0 && i + 1 < argc)
+      load_path = argv[++i];
+  }
+  if (session_path && (record_path || replay_path))
+  {
+    // A log replays from the graph the command line builds, not a restored one
+    std::cerr << "--session cannot be combined with --record or --replay\n";
+    return 1;
+  }
+  if (serve_path && (record_path || replay_path))
+  {
+    // Requests from other processes are not part of the log
+    std::cerr << "--serve cannot be combined with --record or --replay\n";
+    return 1;
+  }
+  if ((ingest_path || load_path) && (record_path || replay_path))
+  {
+    // Nor are feed events
+    std::cerr << "--ingest and --load cannot be combined with --record or --replay\n";
+    return 1;
+  }
+  if (ingest_path && load_path)
+  {
+    // Both read through the one feed
+    std::cerr << "--load cannot be combined with --ingest\n";
+    return 1;
+  }
+
+  if (session_path)
+  {
+    CheckpointStats restored;
+    int mode;
+    if (checkpoint_restore(session_path, &mode, &restored))
+    {
+      for (int b = 0; b < MENU_BUTTON_COUNT; b++)
+      {
+        if (menu_buttons[b].mode == mode && mode != MENU_CLEAR)
+          current_mode = mode;
+      }
+      printf("Restored %s: %d nodes, %d edges, %d deltas, %.1f MB in %.1f ms\n",
+             session_path, node_count, edge_count, restored.deltas,
+             (restored.base_bytes + restored.delta_bytes) / 1048576.0, restored.ms);
+      gen.type = 0;
+      reorder = 0;
+    }
+  }
+
+  if (gen.type != 0)
+  {
+    gen.seed = session_seed;
+    gen.x0 = (MENU_WIDTH_PIXELS / (float)window_w) * 2.0f - 1.0f + 0.1f;
+    gen.x1 = 0.9f;
+    gen.y0 = -0.9f;
+    gen.y1 = 0.9f;
+    auto start = std::chrono::steady_clock::now();
+    generate_graph(&gen);
+    double ms = std::chrono::duration<double, std::milli>(
+                    std::chrono::steady_clock::now() - start)
+                    .count();
+    printf("Generated %s: %d nodes, %d edges in %.1f ms (%d threads)\n",
+           generator_name(gen.type), node_count, edge_count, ms,
+           parallel_threads());
+  }
+  if (load_path && headless)
+  {
+    // Without a window, the input is applied in the same chunks as it
+    // arrives, then placed, and the timings are printed
+    if (!ingest_start(load_path, false, 0))
+      return 1;
+    auto start = std::chrono::steady_clock::now();
+    IngestStats feed;
+    startup.loading = true;
+    do
+    {
+      ingest_wait(100);
+      ingest_frame();
+      touched_ids.clear();
+      ingest_stats(&feed);
+    } while (feed.reading || feed.queued > 0);
+    startup.loading = false;
+    auto loaded = std::chrono::steady_clock::now();
+    Placement place;
+    if (node_count > 1)
+    {
+      stress_place(*graph_adjacency(), layout_box(), session_seed, &place.x, &place.y);
+      apply_placement(place);
+    }
+    auto placed = std::chrono::steady_clock::now();
+    printf("Loaded %s: %d nodes, %d edges in %.1f ms (%llu malformed lines), "
+           "pivot-MDS placement in %.1f ms\n",
+           load_path, node_count, edge_count,
+           std::chrono::duration<double, std::milli>(loaded - start).count(), feed.malformed,
+           std::chrono::duration<double, std::milli>(placed - loaded).count());
+  }
+  if (reorder != 0)
+    reorder_graph(reorder);
+  if (bench)
+    bench_backends();
+  if (bench_bundles)
+    bench_bundling();
+  if (bench_stresses)
+    bench_stress();
+  if (bench_locals)
+    bench_local();
+  if (bench_force_laws)
+    bench_forces();
+  if (bench_route_queries)
+    bench_routes();
+  if (bench_community_view)
+    bench_communities();
+  if (bench_overlaps)
+    bench_overlap();
+
+  if (save_edges_path)
+  {
+    // Out-of-core edge files are built from a text edge list or from the
+    // generated graph
+    auto start = std::chrono::steady_clock::now();
+    bool ok = import_edges_path
+                  ? edgefile_import_text(import_edges_path, save_edges_path, stream.budget)
+                  : edgefile_save_graph(save_edges_path, stream.budget);
+    if (!ok)
+      return 1;
+    printf("Wrote %s in %.1f ms (peak RSS %.1f MB)\n", save_edges_path,
+           std::chrono::duration<double, std::milli>(
+               std::chrono::steady_clock::now() - start)
+               .count(),
+           peak_rss_kb() / 1024.0);
+  }
+  if (stream.path)
+  {
+    stream.seed = session_seed;
+    return stream_run(&stream);
+  }
+  if (save_edges_path && (import_edges_path || headless))
+    return 0;
+
+  if (replay_path && !replay_open(replay_path, &window_w, &window_h))
+    return 1;
+  if (session_path)
+    checkpoint_start(session_path);
+  if (serve_path)
+  {
+    if (!ipc_start(serve_path))
+      return 1;
+    printf("Serving %s: %d nodes, %d edges\n", serve_path, node_count, edge_count);
+    fflush(stdout);
+  }
+  if (ingest_path && !ingest_start(ingest_path, !headless, ingest_rate))
+    return 1;
+  if (load_path && !headless)
+  {
+    if (!ingest_start(load_path, false, 0))
+      return 1;
+    startup.loading = true;
+  }
+  if (headless && ingest_path && !serve_path)
+  {
+    // Applies the feed as fast as it arrives and reports the sustained rate
+    IngestStats feed;
+    auto start = std::chrono::steady_clock::now();
+    double apply_ms = 0;
+    do
+    {
+      ingest_wait(100);
+      auto before = std::chrono::steady_clock::now();
+      ingest_frame();
+      apply_ms += std::chrono::duration<double, std::milli>(
+                      std::chrono::steady_clock::now() - before)
+                      .count();
+      touched_ids.clear();
+      ingest_stats(&feed);
+    } while (feed.reading || feed.queued > 0);
+    double s = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    printf("Ingested %llu events (%llu malformed) in %.2f s: %.0f events/s, applying at "
+           "%.0f events/s\n",
+           feed.applied, feed.malformed, s, feed.applied / s,
+           apply_ms > 0 ? feed.applied / (apply_ms / 1000) : 0);
+    printf("  %llu batches, largest %d events; %d nodes, %d edges\n", feed.batches,
+           feed.largest_batch, node_count, edge_count);
+    if (session_path)
+      checkpoint_flush(current_mode);
+    return 0;
+  }
+  if (headless && serve_path)
+  {
+    // Without a window, a frame is whatever arrived while waiting
+    for (;;)
+    {
+      ipc_wait(100);
+      ipc_frame(NULL);
+      ingest_frame();
+      if (session_path)
+        checkpoint_poll(current_mode);
+    }
+  }
+  if (headless)
+  {
+    if (!replay_path)
+    {
+      if (session_path)
+      {
+        checkpoint_flush(current_mode);
+        print_checkpoint_stats();
+        return 0;
+      }
+      if (gen.type != 0 || load_path)
+        return 0;
+      std::cerr << "--headless requires --replay <log>, --generate <type>, --load <file>, "
+                   "--session <file> or --serve <socket>\n";
+      return 1;
+    }
+    static const ReplayHandlers handlers = {mouse, motion, keyboard, resize, layout_step};
+    replay_run(&handlers);
+    if (path_query.task)
+      task_wait(path_query.task);
+    collect_path_query();
+    printf("Layout ticks: %llu heap allocations (%u ticks)\n", tick_allocations,
+           layout_tick);
+    print_scheduler_stats();
+    return 0;
+  }
+  if (record_path && !record_open(record_path, window_w, window_h))
+    return 1;
+
   glutInit(&argc, argv);
   glutInitDisplayMode(GLUT_SINGLE | GLUT_RGB);
-  glutInitWindowSize(800, 600);
+  glutInitWindowSize(window_w, window_h);
   glutCreateWindow("Graph Visualizer - Dracula Theme");
 
   // Set the background to Dracula theme color
@@ -1219,8 +5066,11 @@ int main(int argc, char **argv)
   glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
 
   glutDisplayFunc(display);
-  glutMouseFunc(mouse);
-  glutKeyboardFunc(keyboard);
+  glutReshapeFunc(reshape);
+  glutMouseFunc(on_mouse);
+  glutPassiveMotionFunc(on_motion);
+  glutMotionFunc(on_motion);
+  glutKeyboardFunc(on_keyboard);
   glutIdleFunc(idle);
   glutMainLoop();
   return 0;
@@ -0,0 +1,537 @@
+/**
+ * @file parallel.cpp
+ * @brief Work-stealing scheduler on a persistent thread pool.
+ *
+ * The pool is started on first use with one thread per core minus the
+ * caller, and at least one so that background tasks make progress on a
+ * single core. Threads outside the pool share deque 0.
+ *
+ * parallel_for pushes helper tasks onto the caller's deque and then runs
+ * chunks itself; idle workers steal the helpers, which claim chunks from a
+ * shared counter. Once all chunks are claimed, helpers nobody started are
+ * taken back, so a parallel_for issued from inside a chunk or a task never
+ * waits for work that is queued behind it.
+ *
+ * Task objects are recycled through a free list, so once the pool has warmed
+ * up neither parallel_for nor a deque push touches the heap.
+ */
+
+#include "parallel.h"
+
+#include <algorithm>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+typedef struct Job Job;
+
+typedef struct Task
+{
+  void (*run)(struct Task *task);
+  std::function<void()> fn; // body of a submitted task
+  TaskHandle state;         // state of a submitted task
+  Job *job;                 // job of a parallel_for helper
+  TaskState *owner;         // cancellation seen by task_cancelled()
+  int priority;
+  struct Task *next_free;
+} Task;
+
+struct Job
+{
+  const std::function<void(int)> *fn;
+  int chunks;
+  std::atomic<int> next;     // next unclaimed chunk
+  std::atomic<int> finished; // helpers done with the job
+};
+
+// Ring buffer of tasks; grows, never shrinks
+typedef struct
+{
+  std::vector<Task *> ring;
+  size_t head;
+  size_t count;
+} TaskQueue;
+
+typedef struct
+{
+  std::mutex mutex;
+  TaskQueue queue[TASK_PRIORITIES];
+  std::atomic<unsigned long long> executed;
+  std::atomic<unsigned long long> steals;
+} Worker;
+
+// The deques and the wake-up signal are never destroyed: the detached pool
+// threads still use them while the process exits
+static Worker *workers = new Worker[SCHED_MAX_WORKERS + 1];
+static int worker_count = 0;
+static std::once_flag pool_started;
+
+static std::atomic<int> pending(0); // queued tasks over all deques
+static std::atomic<unsigned long long> cancelled_count(0);
+static std::mutex &sleep_mutex = *new std::mutex();
+static std::condition_variable &wake = *new std::condition_variable(); // new work or a finished task
+
+static std::mutex free_mutex;
+static Task *free_tasks = NULL;
+
+static thread_local int worker_id = 0;
+static thread_local int current_priority = TASK_INTERACTIVE;
+static thread_local TaskState *current_owner = NULL;
+
+/**
+ * @brief Appends a task to the back of a queue.
+ *
+ * @param q Queue, locked by the caller
+ * @param task Task to append
+ */
+static void queue_push(TaskQueue *q, Task *task)
+{
+  if (q->count == q->ring.size())
+  {
+    std::vector<Task *> grown(q->ring.empty() ? 16 : q->ring.size() * 2);
+    for (size_t i = 0; i < q->count; i++)
+      grown[i] = q->ring[(q->head + i) % q->ring.size()];
+    q->ring.swap(grown);
+    q->head = 0;
+  }
+  q->ring[(q->head + q->count) % q->ring.size()] = task;
+  q->count++;
+}
+
+/**
+ * @brief Removes the newest task of a queue.
+ *
+ * @param q Queue, locked by the caller
+ * @return Task, or NULL if the queue is empty
+ */
+static Task *queue_pop_back(TaskQueue *q)
+{
+  if (q->count == 0)
+    return NULL;
+  q->count--;
+  return q->ring[(q->head + q->count) % q->ring.size()];
+}
+
+/**
+ * @brief Removes the oldest task of a queue.
+ *
+ * @param q Queue, locked by the caller
+ * @return Task, or NULL if the queue is empty
+ */
+static Task *queue_pop_front(TaskQueue *q)
+{
+  if (q->count == 0)
+    return NULL;
+  Task *task = q->ring[q->head];
+  q->head = (q->head + 1) % q->ring.size();
+  q->count--;
+  return task;
+}
+
+/**
+ * @brief Removes every queued helper of a job.
+ *
+ * @param q Queue, locked by the caller
+ * @param job Job whose helpers are removed
+ * @param removed Receives the removed tasks
+ * @return Number of tasks removed
+ */
+static int queue_remove_job(TaskQueue *q, Job *job, Task **removed)
+{
+  int taken = 0;
+  size_t kept = 0;
+  for (size_t i = 0; i < q->count; i++)
+  {
+    Task *task = q->ring[(q->head + i) % q->ring.size()];
+    if (task->job == job)
+      removed[taken++] = task;
+    else
+      q->ring[(q->head + kept++) % q->ring.size()] = task;
+  }
+  q->count = kept;
+  return taken;
+}
+
+/**
+ * @brief Takes a task object from the free list.
+ *
+ * @return Cleared task
+ */
+static Task *alloc_task()
+{
+  std::lock_guard<std::mutex> lock(free_mutex);
+  Task *task = free_tasks;
+  if (task)
+    free_tasks = task->next_free;
+  else
+    task = new Task();
+  task->job = NULL;
+  task->owner = NULL;
+  return task;
+}
+
+/**
+ * @brief Returns a task object to the free list.
+ *
+ * @param task Task that is no longer queued or running
+ */
+static void release_task(Task *task)
+{
+  task->fn = nullptr;
+  task->state.reset();
+  std::lock_guard<std::mutex> lock(free_mutex);
+  task->next_free = free_tasks;
+  free_tasks = task;
+}
+
+/**
+ * @brief Wakes sleeping workers and waiters.
+ */
+static void notify_all()
+{
+  {
+    std::lock_guard<std::mutex> lock(sleep_mutex);
+  }
+  wake.notify_all();
+}
+
+/**
+ * @brief Queues a task on the calling thread's deque.
+ *
+ * @param task Task to queue
+ */
+static void push_task(Task *task)
+{
+  Worker &w = workers[worker_id];
+  {
+    std::lock_guard<std::mutex> lock(w.mutex);
+    queue_push(&w.queue[task->priority], task);
+  }
+  pending++;
+}
+
+/**
+ * @brief Finds the next task for a worker.
+ *
+ * Priorities are searched in order. Within one priority the worker first pops
+ * the newest task of its own deque, then steals the oldest task of the
+ * others, starting with its right neighbor so thieves spread out.
+ *
+ * @param self Deque of the calling thread
+ * @return Task, or NULL if every deque is empty
+ */
+static Task *find_task(int self)
+{
+  if (pending.load() == 0)
+    return NULL;
+  for (int p = 0; p < TASK_PRIORITIES; p++)
+  {
+    {
+      std::lock_guard<std::mutex> lock(workers[self].mutex);
+      Task *task = queue_pop_back(&workers[self].queue[p]);
+      if (task)
+      {
+        pending--;
+        return task;
+      }
+    }
+    for (int k = 1; k <= worker_count; k++)
+    {
+      Worker &victim = workers[(self + k) % (worker_count + 1)];
+      std::lock_guard<std::mutex> lock(victim.mutex);
+      Task *task = queue_pop_front(&victim.queue[p]);
+      if (task)
+      {
+        pending--;
+        workers[self].steals++;
+        return task;
+      }
+    }
+  }
+  return NULL;
+}
+
+/**
+ * @brief Runs a task under its priority and cancellation state.
+ *
+ * @param task Task taken from a deque
+ */
+static void run_task(Task *task)
+{
+  int priority = current_priority;
+  TaskState *owner = current_owner;
+  current_priority = task->priority;
+  current_owner = task->owner;
+  workers[worker_id].executed++;
+  task->run(task);
+  current_priority = priority;
+  current_owner = owner;
+}
+
+/**
+ * @brief Body of a submitted task.
+ *
+ * @param task Task whose fn is called unless it was cancelled while queued
+ */
+static void run_submitted(Task *task)
+{
+  if (task->state->cancelled.load())
+    cancelled_count++;
+  else
+    task->fn();
+  task->state->done = true;
+  release_task(task);
+  notify_all();
+}
+
+/**
+ * @brief Body of a parallel_for helper: claims chunks until none are left.
+ *
+ * @param task Helper task
+ */
+static void run_helper(Task *task)
+{
+  Job *job = task->job;
+  for (int i = job->next++; i < job->chunks; i = job->next++)
+    (*job->fn)(i);
+  release_task(task);
+  job->finished++; // last access to the job; the caller may return now
+}
+
+/**
+ * @brief Main loop of a pool thread.
+ *
+ * @param id Worker index
+ */
+static void worker_main(int id)
+{
+  worker_id = id;
+  current_priority = TASK_BACKGROUND;
+  while (true)
+  {
+    Task *task = find_task(id);
+    if (task)
+    {
+      run_task(task);
+      continue;
+    }
+    std::unique_lock<std::mutex> lock(sleep_mutex);
+    wake.wait(lock, []()
+              { return pending.load() > 0; });
+  }
+}
+
+/**
+ * @brief Starts the pool threads. They are detached and live until exit.
+ */
+static void start_pool()
+{
+  unsigned int cores = std::thread::hardware_concurrency();
+  worker_count = cores > 1 ? (int)cores - 1 : 1;
+  if (worker_count > SCHED_MAX_WORKERS)
+    worker_count = SCHED_MAX_WORKERS;
+  for (int t = 1; t <= worker_count; t++)
+    std::thread(worker_main, t).detach();
+}
+
+/**
+ * @brief Returns the number of worker slots.
+ *
+ * @return Pool threads plus one for the threads outside the pool
+ */
+int parallel_threads()
+{
+  std::call_once(pool_started, start_pool);
+  return worker_count + 1;
+}
+
+/**
+ * @brief Returns the slot of the calling thread.
+ *
+ * @return 0 outside the pool, 1.. for pool threads
+ */
+int parallel_worker_id() { return worker_id; }
+
+/**
+ * @brief Runs a function over a range of chunks on all cores.
+ *
+ * Chunks are claimed dynamically from a shared counter so uneven chunks still
+ * balance. Callers that need reproducible output derive everything from the
+ * chunk index, never from the worker that ran it.
+ *
+ * @param chunks Number of chunks
+ * @param fn Function called once per chunk index
+ */
+void parallel_for(int chunks, const std::function<void(int)> &fn)
+{
+  if (chunks <= 1)
+  {
+    for (int i = 0; i < chunks; i++)
+      fn(i);
+    return;
+  }
+  std::call_once(pool_started, start_pool);
+
+  int priority = current_priority;
+  Job job;
+  job.fn = &fn;
+  job.chunks = chunks;
+  job.next = 0;
+  job.finished = 0;
+  int helpers = std::min(chunks - 1, worker_count);
+  for (int h = 0; h < helpers; h++)
+  {
+    Task *task = alloc_task();
+    task->run = run_helper;
+    task->job = &job;
+    task->owner = current_owner;
+    task->priority = priority;
+    push_task(task);
+  }
+  notify_all();
+
+  for (int i = job.next++; i < chunks; i = job.next++)
+    fn(i);
+
+  // Every chunk is claimed; take back the helpers that never started
+  Task *unstarted[SCHED_MAX_WORKERS];
+  int removed;
+  {
+    Worker &w = workers[worker_id];
+    std::lock_guard<std::mutex> lock(w.mutex);
+    removed = queue_remove_job(&w.queue[priority], &job, unstarted);
+  }
+  pending -= removed;
+  for (int h = 0; h < removed; h++)
+    release_task(unstarted[h]);
+  while (job.finished.load() < helpers - removed)
+    std::this_thread::yield();
+}
+
+/**
+ * @brief Queues a function to run on the pool.
+ *
+ * @param priority TASK_INTERACTIVE or TASK_BACKGROUND
+ * @param fn Function to run
+ * @return Handle for cancelling and waiting
+ */
+TaskHandle task_submit(int priority, std::function<void()> fn)
+{
+  std::call_once(pool_started, start_pool);
+  TaskHandle state = std::make_shared<TaskState>();
+  state->cancelled = false;
+  state->done = false;
+  state->progress = 0;
+  Task *task = alloc_task();
+  task->run = run_submitted;
+  task->fn = std::move(fn);
+  task->state = state;
+  task->owner = state.get();
+  task->priority = priority;
+  push_task(task);
+  notify_all();
+  return state;
+}
+
+/**
+ * @brief Asks a task to stop.
+ *
+ * A queued task is dropped when a worker reaches it; a running one sees
+ * task_cancelled() return true and is expected to return early.
+ *
+ * @param task Handle from task_submit
+ */
+void task_cancel(const TaskHandle &task)
+{
+  if (task)
+    task->cancelled = true;
+}
+
+/**
+ * @brief Waits for a task to finish.
+ *
+ * The caller runs queued tasks while it waits, so waiting from inside a task
+ * cannot starve the pool.
+ *
+ * @param task Handle from task_submit
+ */
+void task_wait(const TaskHandle &task)
+{
+  while (!task->done.load())
+  {
+    Task *other = find_task(worker_id);
+    if (other)
+    {
+      run_task(other);
+      continue;
+    }
+    std::unique_lock<std::mutex> lock(sleep_mutex);
+    wake.wait(lock, [&]()
+              { return task->done.load() || pending.load() > 0; });
+  }
+}
+
+/**
+ * @brief Tells whether the work the calling thread does was cancelled.
+ *
+ * Inside a submitted task this is that task's flag; inside a parallel_for
+ * chunk it is the flag of the task that issued the loop.
+ *
+ * @return true if the current task has been cancelled
+ */
+bool task_cancelled() { return current_owner && current_owner->cancelled.load(); }
+
+/**
+ * @brief Reports the progress of the work the calling thread does.
+ *
+ * Outside a task this does nothing, so kernels can report unconditionally.
+ *
+ * @param fraction Share of the work done, in [0, 1]
+ */
+void task_progress(float fraction)
+{
+  if (current_owner)
+    current_owner->progress.store((int)(fraction * 1000), std::memory_order_relaxed);
+}
+
+/**
+ * @brief Sets the priority of the parallel_for helpers the calling thread
+ * queues.
+ *
+ * @param priority TASK_INTERACTIVE or TASK_BACKGROUND
+ * @return Previous priority
+ */
+int task_set_priority(int priority)
+{
+  int previous = current_priority;
+  current_priority = priority;
+  return previous;
+}
+
+/**
+ * @brief Takes a snapshot of the scheduler counters.
+ *
+ * @param stats Receives queue depths, executed, stolen and cancelled counts
+ */
+void scheduler_stats(SchedulerStats *stats)
+{
+  stats->workers = worker_count;
+  stats->executed = 0;
+  stats->steals = 0;
+  stats->cancelled = cancelled_count.load();
+  for (int p = 0; p < TASK_PRIORITIES; p++)
+    stats->queued[p] = 0;
+  for (int w = 0; w <= worker_count; w++)
+  {
+    std::lock_guard<std::mutex> lock(workers[w].mutex);
+    stats->depth[w] = 0;
+    for (int p = 0; p < TASK_PRIORITIES; p++)
+    {
+      stats->depth[w] += (int)workers[w].queue[p].count;
+      stats->queued[p] += (int)workers[w].queue[p].count;
+    }
+    stats->executed += workers[w].executed.load();
+    stats->steals += workers[w].steals.load();
+  }
+}
@@ -0,0 +1,516 @@
+/**
+ * @file paths.cpp
+ * @brief Binary-heap Dijkstra, concurrent multi-source queries and K
+ *        shortest paths.
+ */
+
+#include "paths.h"
+#include "backend.h"
+#include "parallel.h"
+
+#include <algorithm>
+#include <atomic>
+#include <float.h>
+#include <functional>
+#include <mutex>
+
+#define INF FLT_MAX
+
+#define CANCEL_CHECK_INTERVAL 256 // settled nodes between cancellation checks
+
+/**
+ * @brief Runs Dijkstra's algorithm over the adjacency snapshot.
+ *
+ * Uses a lazy-deletion binary heap, so a search costs O((V + E) log V)
+ * instead of the O(V * E) of scanning the edge list for every settled node.
+ * The scratch buffers are resized and reused, which keeps repeated queries
+ * free of allocations once they have grown to the graph size. When run as a
+ * task, the search reports the share of settled nodes as its progress and
+ * gives up once task_cancelled() is set.
+ *
+ * @param adj Adjacency snapshot
+ * @param sources Start nodes, all at distance 0
+ * @param source_count Number of start nodes
+ * @param stop_at Node whose settlement ends the search, or -1
+ * @param scratch Search state; holds dist and parent afterwards
+ * @return false if the search was cancelled before it finished
+ */
+bool dijkstra_search(const Adjacency &adj, const int *sources, int source_count,
+                     int stop_at, DijkstraScratch *scratch)
+{
+  int n = adj.node_count;
+  scratch->dist.assign(n, INF);
+  scratch->parent.assign(n, -1);
+  std::vector<std::pair<float, int>> &heap = scratch->heap;
+  heap.clear();
+  auto greater = std::greater<std::pair<float, int>>();
+
+  for (int i = 0; i < source_count; i++)
+  {
+    scratch->dist[sources[i]] = 0;
+    heap.push_back(std::make_pair(0.0f, sources[i]));
+  }
+  std::make_heap(heap.begin(), heap.end(), greater);
+
+  int until_check = CANCEL_CHECK_INTERVAL;
+  int settled = 0;
+  while (!heap.empty())
+  {
+    if (--until_check == 0)
+    {
+      if (task_cancelled())
+        return false;
+      task_progress((float)settled / n);
+      until_check = CANCEL_CHECK_INTERVAL;
+    }
+    std::pop_heap(heap.begin(), heap.end(), greater);
+    float d = heap.back().first;
+    int u = heap.back().second;
+    heap.pop_back();
+    if (d > scratch->dist[u])
+      continue; // stale entry
+    settled++;
+    if (u == stop_at)
+      break;
+    for (int k = adj.offsets[u]; k < adj.offsets[u + 1]; k++)
+    {
+      int v = adj.targets[k];
+      float nd = d + adj.weights[k];
+      if (nd < scratch->dist[v])
+      {
+        scratch->dist[v] = nd;
+        scratch->parent[v] = u;
+        heap.push_back(std::make_pair(nd, v));
+        std::push_heap(heap.begin(), heap.end(), greater);
+      }
+    }
+  }
+  return true;
+}
+
+/**
+ * @brief Finds the nearest source of every node.
+ *
+ * Each source gets its own full search. Searches run concurrently on the
+ * selected execution backend; every worker owns a scratch and a running
+ * best-so-far, so nothing is shared while searching. The per-worker results
+ * are then reduced in parallel over node ranges. Ties go to the lower source
+ * index, which keeps the result independent of the backend and of
+ * scheduling.
+ *
+ * @param adj Adjacency snapshot
+ * @param sources Source nodes
+ * @param result Nearest source, distance and predecessor of every node
+ */
+void nearest_facilities(const Adjacency &adj, const std::vector<int> &sources,
+                        FacilityResult *result)
+{
+  // The buffers are shared by all calls; a cancelled query still unwinding
+  // finishes before the next one starts
+  static std::mutex busy;
+  std::lock_guard<std::mutex> lock(busy);
+  int n = adj.node_count;
+  int workers = backend_slots();
+  static std::vector<DijkstraScratch> scratch;
+  static std::vector<FacilityResult> best;
+  scratch.resize(workers);
+  best.resize(workers);
+  for (int w = 0; w < workers; w++)
+  {
+    best[w].dist.assign(n, INF);
+    best[w].parent.assign(n, -1);
+    best[w].nearest.assign(n, -1);
+  }
+
+  backend_for((int)sources.size(), [&](int s)
+              {
+                int w = backend_slot();
+                DijkstraScratch &sc = scratch[w];
+                FacilityResult &b = best[w];
+                if (!dijkstra_search(adj, &sources[s], 1, -1, &sc))
+                  return;
+                for (int v = 0; v < n; v++)
+                {
+                  float d = sc.dist[v];
+                  if (d < b.dist[v] || (d == b.dist[v] && d < INF && s < b.nearest[v]))
+                  {
+                    b.dist[v] = d;
+                    b.parent[v] = sc.parent[v];
+                    b.nearest[v] = s;
+                  }
+                }
+              });
+
+  result->dist.assign(n, INF);
+  result->parent.assign(n, -1);
+  result->nearest.assign(n, -1);
+  const int chunks = 64;
+  backend_for(chunks, [&](int c)
+              {
+                int lo = (int)((long long)n * c / chunks);
+                int hi = (int)((long long)n * (c + 1) / chunks);
+                for (int w = 0; w < workers; w++)
+                {
+                  for (int v = lo; v < hi; v++)
+                  {
+                    float d = best[w].dist[v];
+                    int s = best[w].nearest[v];
+                    if (s == -1)
+                      continue;
+                    if (d < result->dist[v] || (d == result->dist[v] && s < result->nearest[v]))
+                    {
+                      result->dist[v] = d;
+                      result->parent[v] = best[w].parent[v];
+                      result->nearest[v] = s;
+                    }
+                  }
+                }
+              });
+}
+
+/**
+ * @brief Returns the weight of the edge between two nodes.
+ *
+ * @param adj Adjacency snapshot
+ * @param u One end
+ * @param v Other end
+ * @return Weight, or INF if they are not adjacent
+ */
+static float edge_weight(const Adjacency &adj, int u, int v)
+{
+  for (int e = adj.offsets[u]; e < adj.offsets[u + 1]; e++)
+  {
+    if (adj.targets[e] == v)
+      return adj.weights[e];
+  }
+  return INF;
+}
+
+// State of one spur search of k_shortest_paths; one per worker. Entries of
+// dist and parent are valid where seen == generation, so a search only
+// touches the nodes it reaches.
+typedef struct
+{
+  std::vector<float> dist;
+  std::vector<int> parent;
+  std::vector<unsigned> seen;
+  std::vector<unsigned> settled; // settled where == generation
+  std::vector<unsigned> blocked; // on the root path where == generation
+  std::vector<unsigned> clean;   // tree path to the target is usable where == generation
+  std::vector<unsigned> dirty;   // ... is not usable where == generation
+  std::vector<std::pair<float, int>> heap;
+  unsigned generation;
+} SpurScratch;
+
+// Shortest path tree towards the target, shared by all spur searches
+typedef struct
+{
+  const std::vector<float> *dist; // distance to the target
+  const std::vector<int> *next;   // next node towards the target, -1 there
+  int target;
+} TargetTree;
+
+/**
+ * @brief Tells whether the tree path from a node to the target avoids the
+ *        root path and the spur node.
+ *
+ * Results are cached for the current search, so the tree is walked at most
+ * once per node.
+ *
+ * @param tree Shortest path tree towards the target
+ * @param sc Scratch of the search
+ * @param spur Spur node, whose tree edge may be removed
+ * @param v Node
+ * @return true if the path can be appended to a spur path ending at v
+ */
+static bool tree_path_clean(const TargetTree &tree, SpurScratch *sc, int spur, int v)
+{
+  unsigned gen = sc->generation;
+  int at = v;
+  bool ok = true;
+  while (true)
+  {
+    if (sc->clean[at] == gen)
+      break;
+    if (sc->dirty[at] == gen || sc->blocked[at] == gen || at == spur ||
+        (*tree.dist)[at] == INF)
+    {
+      ok = false;
+      break;
+    }
+    if (at == tree.target)
+      break;
+    at = (*tree.next)[at];
+  }
+  // Everything walked before the stop shares its verdict
+  for (int w = v; w != at; w = (*tree.next)[w])
+    (ok ? sc->clean : sc->dirty)[w] = gen;
+  (ok ? sc->clean : sc->dirty)[at] = gen;
+  return ok;
+}
+
+/**
+ * @brief Finds the shortest spur path from a spur node to the target that
+ *        avoids the root path and the removed edges out of the spur node.
+ *
+ * An A* search whose heuristic is the distance to the target in the full
+ * graph. Removing nodes and edges only lengthens paths, so the heuristic
+ * stays consistent. Once the popped node's tree path is still intact, the
+ * tree path completes the spur path and the search stops. In most cases the
+ * spur node's own tree path is intact, so few nodes are settled.
+ *
+ * @param adj Adjacency snapshot
+ * @param tree Shortest path tree towards the target
+ * @param spur Spur node
+ * @param removed Neighbors of the spur node whose edge is removed
+ * @param limit Spur paths of this length or more are not wanted
+ * @param sc Search state; blocked must be set for this generation
+ * @param path Receives the spur path from spur to the target
+ * @return false if no path shorter than limit exists or the calling task
+ *         was cancelled
+ */
+static bool spur_search(const Adjacency &adj, const TargetTree &tree, int spur,
+                        const std::vector<int> &removed, float limit, SpurScratch *sc,
+                        std::vector<int> *path)
+{
+  const std::vector<float> &h = *tree.dist;
+  unsigned gen = sc->generation;
+  auto greater = std::greater<std::pair<float, int>>();
+  std::vector<std::pair<float, int>> &heap = sc->heap;
+  heap.clear();
+  sc->seen[spur] = gen;
+  sc->dist[spur] = 0;
+  sc->parent[spur] = -1;
+  heap.push_back(std::make_pair(h[spur], spur));
+
+  int last = -1;
+  int until_check = CANCEL_CHECK_INTERVAL;
+  while (!heap.empty())
+  {
+    if (--until_check == 0)
+    {
+      if (task_cancelled())
+        return false;
+      until_check = CANCEL_CHECK_INTERVAL;
+    }
+    std::pop_heap(heap.begin(), heap.end(), greater);
+    float key = heap.back().first;
+    int u = heap.back().second;
+    heap.pop_back();
+    if (sc->settled[u] == gen)
+      continue; // stale entry
+    if (key >= limit)
+      break; // every path left is at least this long
+    sc->settled[u] = gen;
+    if (u == tree.target)
+    {
+      last = u;
+      break;
+    }
+    if (u == spur)
+    {
+      int next = (*tree.next)[u];
+      if (h[u] < INF && std::find(removed.begin(), removed.end(), next) == removed.end() &&
+          tree_path_clean(tree, sc, spur, next))
+      {
+        last = u;
+        break;
+      }
+    }
+    else if (tree_path_clean(tree, sc, spur, u))
+    {
+      last = u;
+      break;
+    }
+    float du = sc->dist[u];
+    for (int k = adj.offsets[u]; k < adj.offsets[u + 1]; k++)
+    {
+      int v = adj.targets[k];
+      if (sc->blocked[v] == gen || sc->settled[v] == gen || h[v] == INF)
+        continue;
+      if (u == spur && std::find(removed.begin(), removed.end(), v) != removed.end())
+        continue;
+      float nd = du + adj.weights[k];
+      if (sc->seen[v] != gen || nd < sc->dist[v])
+      {
+        sc->seen[v] = gen;
+        sc->dist[v] = nd;
+        sc->parent[v] = u;
+        heap.push_back(std::make_pair(nd + h[v], v));
+        std::push_heap(heap.begin(), heap.end(), greater);
+      }
+    }
+  }
+  if (last == -1)
+    return false;
+
+  path->clear();
+  for (int at = last; at != -1; at = sc->parent[at])
+    path->push_back(at);
+  std::reverse(path->begin(), path->end());
+  for (int at = (*tree.next)[last]; last != tree.target && at != -1; at = (*tree.next)[at])
+    path->push_back(at);
+  return true;
+}
+
+/**
+ * @brief Finds the K shortest loopless paths between two nodes with Yen's
+ *        algorithm.
+ *
+ * One full Dijkstra search from the target gives the shortest path and the
+ * tree that all spur searches share as their heuristic and shortcut. Each
+ * round deviates from the last path found at every node from the point
+ * where that path itself deviated (Lawler's refinement). Once enough
+ * candidates are known to fill the remaining paths, spur searches give up at
+ * the length of the last of those. The spur searches of a round run
+ * concurrently on the selected backend, each on its own worker's scratch.
+ * Lengths are summed along each path from the source, candidates are merged
+ * in spur order and ties go to the earlier candidate, so the result does not
+ * depend on the backend.
+ *
+ * @param adj Adjacency snapshot
+ * @param source Start node
+ * @param target End node
+ * @param k Number of paths wanted
+ * @param routes Receives up to k paths, shortest first
+ * @return false if the calling task was cancelled
+ */
+bool k_shortest_paths(const Adjacency &adj, int source, int target, int k,
+                      std::vector<Route> *routes)
+{
+  // The buffers are shared by all calls; a cancelled query still unwinding
+  // finishes before the next one starts
+  static std::mutex busy;
+  std::lock_guard<std::mutex> lock(busy);
+  static DijkstraScratch target_scratch;
+  static std::vector<SpurScratch> scratch;
+  routes->clear();
+  int n = adj.node_count;
+  if (k < 1 || source == target)
+    return true;
+  if (!dijkstra_search(adj, &target, 1, -1, &target_scratch))
+    return false;
+  TargetTree tree = {&target_scratch.dist, &target_scratch.parent, target};
+  if (target_scratch.dist[source] == INF)
+    return true;
+
+  int workers = backend_slots();
+  scratch.resize(workers);
+  for (SpurScratch &sc : scratch)
+  {
+    if ((int)sc.dist.size() != n)
+    {
+      sc.dist.assign(n, 0);
+      sc.parent.assign(n, -1);
+      sc.seen.assign(n, 0);
+      sc.settled.assign(n, 0);
+      sc.blocked.assign(n, 0);
+      sc.clean.assign(n, 0);
+      sc.dirty.assign(n, 0);
+      sc.generation = 0;
+    }
+  }
+
+  Route first;
+  for (int at = source; at != -1; at = target_scratch.parent[at])
+    first.nodes.push_back(at);
+  first.length = 0;
+  for (size_t i = 0; i + 1 < first.nodes.size(); i++)
+    first.length += edge_weight(adj, first.nodes[i], first.nodes[i + 1]);
+  first.deviation = 0;
+  routes->push_back(first);
+
+  std::vector<Route> candidates;
+  std::vector<Route> found;
+  std::vector<char> ok;
+  std::atomic<bool> cancelled(false);
+  std::vector<float> root;
+  std::vector<float> lengths;
+  while ((int)routes->size() < k)
+  {
+    const Route &last = routes->back();
+    int spurs = (int)last.nodes.size() - 1 - last.deviation;
+    found.assign(std::max(spurs, 0), Route());
+    ok.assign(found.size(), 0);
+    root.assign(last.nodes.size(), 0);
+    for (size_t i = 1; i < last.nodes.size(); i++)
+      root[i] = root[i - 1] + edge_weight(adj, last.nodes[i - 1], last.nodes[i]);
+    // Candidates enough for all remaining paths bound the useful length
+    float limit = INF;
+    size_t wanted = k - routes->size();
+    if (candidates.size() >= wanted)
+    {
+      lengths.clear();
+      for (const Route &c : candidates)
+        lengths.push_back(c.length);
+      std::nth_element(lengths.begin(), lengths.begin() + (wanted - 1), lengths.end());
+      limit = lengths[wanted - 1];
+    }
+    backend_for(spurs, [&](int s)
+                {
+                  SpurScratch &sc = scratch[backend_slot()];
+                  int i = last.deviation + s;
+                  int spur = last.nodes[i];
+                  if (++sc.generation == 0)
+                  {
+                    // Stamps wrapped around: start over with clean arrays
+                    std::fill(sc.seen.begin(), sc.seen.end(), 0);
+                    std::fill(sc.settled.begin(), sc.settled.end(), 0);
+                    std::fill(sc.blocked.begin(), sc.blocked.end(), 0);
+                    std::fill(sc.clean.begin(), sc.clean.end(), 0);
+                    std::fill(sc.dirty.begin(), sc.dirty.end(), 0);
+                    sc.generation = 1;
+                  }
+                  for (int r = 0; r < i; r++)
+                    sc.blocked[last.nodes[r]] = sc.generation;
+                  // Remove the next edge of every path found that shares the root
+                  std::vector<int> removed;
+                  for (const Route &p : *routes)
+                  {
+                    if ((int)p.nodes.size() > i + 1 &&
+                        std::equal(p.nodes.begin(), p.nodes.begin() + i + 1, last.nodes.begin()))
+                      removed.push_back(p.nodes[i + 1]);
+                  }
+                  Route &route = found[s];
+                  if (!spur_search(adj, tree, spur, removed, limit - root[i], &sc, &route.nodes))
+                  {
+                    if (task_cancelled())
+                      cancelled = true;
+                    return;
+                  }
+                  route.nodes.insert(route.nodes.begin(), last.nodes.begin(),
+                                     last.nodes.begin() + i);
+                  route.length = root[i];
+                  for (size_t r = i; r + 1 < route.nodes.size(); r++)
+                    route.length += edge_weight(adj, route.nodes[r], route.nodes[r + 1]);
+                  route.deviation = i;
+                  ok[s] = route.length < limit;
+                });
+    if (cancelled || task_cancelled())
+      return false;
+    for (size_t s = 0; s < found.size(); s++)
+    {
+      if (!ok[s])
+        continue;
+      bool known = false;
+      for (const Route &c : candidates)
+        known = known || c.nodes == found[s].nodes;
+      for (const Route &p : *routes)
+        known = known || p.nodes == found[s].nodes;
+      if (!known)
+        candidates.push_back(std::move(found[s]));
+    }
+    if (candidates.empty())
+      break;
+    size_t best = 0;
+    for (size_t c = 1; c < candidates.size(); c++)
+    {
+      if (candidates[c].length < candidates[best].length)
+        best = c;
+    }
+    routes->push_back(std::move(candidates[best]));
+    candidates.erase(candidates.begin() + best);
+    task_progress((float)routes->size() / k);
+  }
+  return true;
+}
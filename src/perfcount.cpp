@@ -0,0 +1,148 @@
+/**
+ * @file perfcount.cpp
+ * @brief perf_event_open wrappers for cache miss counting.
+ */
+
+#include "perfcount.h"
+
+#include <chrono>
+#include <linux/perf_event.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+/**
+ * @brief Opens one user-space counter on the calling thread.
+ *
+ * @param type PERF_TYPE_HARDWARE or PERF_TYPE_HW_CACHE
+ * @param config Event of that type
+ * @return File descriptor, or -1 if the event is not available
+ */
+static int open_counter(uint32_t type, uint64_t config)
+{
+  struct perf_event_attr attr;
+  memset(&attr, 0, sizeof(attr));
+  attr.size = sizeof(attr);
+  attr.type = type;
+  attr.config = config;
+  attr.disabled = 1;
+  attr.exclude_kernel = 1;
+  attr.exclude_hv = 1;
+  return (int)syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0);
+}
+
+/**
+ * @brief Returns a monotonic timestamp.
+ *
+ * @return Nanoseconds since an arbitrary epoch
+ */
+static long long now_ns()
+{
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(
+             std::chrono::steady_clock::now().time_since_epoch())
+      .count();
+}
+
+/**
+ * @brief Opens the cache counters for the calling thread.
+ *
+ * @param counters Receives the counter descriptors
+ * @return true if at least one counter is available
+ */
+bool perf_open(PerfCounters *counters)
+{
+  counters->fd[PERF_CACHE_REFERENCES] =
+      open_counter(PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_REFERENCES);
+  counters->fd[PERF_CACHE_MISSES] =
+      open_counter(PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES);
+  counters->fd[PERF_L1D_MISSES] = open_counter(
+      PERF_TYPE_HW_CACHE, PERF_COUNT_HW_CACHE_L1D |
+                              (PERF_COUNT_HW_CACHE_OP_READ << 8) |
+                              (PERF_COUNT_HW_CACHE_RESULT_MISS << 16));
+  counters->start_ns = 0;
+  bool any = false;
+  for (int i = 0; i < PERF_COUNTER_COUNT; i++)
+    any |= counters->fd[i] >= 0;
+  return any;
+}
+
+/**
+ * @brief Closes the counters.
+ *
+ * @param counters Open counters
+ */
+void perf_close(PerfCounters *counters)
+{
+  for (int i = 0; i < PERF_COUNTER_COUNT; i++)
+  {
+    if (counters->fd[i] >= 0)
+      close(counters->fd[i]);
+    counters->fd[i] = -1;
+  }
+}
+
+/**
+ * @brief Resets and enables the counters.
+ *
+ * @param counters Open counters
+ */
+void perf_start(PerfCounters *counters)
+{
+  for (int i = 0; i < PERF_COUNTER_COUNT; i++)
+  {
+    if (counters->fd[i] < 0)
+      continue;
+    ioctl(counters->fd[i], PERF_EVENT_IOC_RESET, 0);
+    ioctl(counters->fd[i], PERF_EVENT_IOC_ENABLE, 0);
+  }
+  counters->start_ns = now_ns();
+}
+
+/**
+ * @brief Disables the counters and reads them.
+ *
+ * @param counters Open counters
+ * @param sample Receives the counts and the elapsed time
+ */
+void perf_stop(PerfCounters *counters, PerfSample *sample)
+{
+  sample->ms = (now_ns() - counters->start_ns) / 1e6;
+  for (int i = 0; i < PERF_COUNTER_COUNT; i++)
+  {
+    long long value = -1;
+    if (counters->fd[i] >= 0)
+    {
+      ioctl(counters->fd[i], PERF_EVENT_IOC_DISABLE, 0);
+      if (read(counters->fd[i], &value, sizeof(value)) != sizeof(value))
+        value = -1;
+    }
+    sample->value[i] = value;
+  }
+}
+
+/**
+ * @brief Prints a sample on one line.
+ *
+ * @param name Label printed first
+ * @param sample Sample to print
+ */
+void perf_print(const char *name, const PerfSample *sample)
+{
+  static const char *names[PERF_COUNTER_COUNT] = {"cache refs", "cache misses",
+                                                  "L1d misses"};
+  printf("%s: %.1f ms", name, sample->ms);
+  bool any = false;
+  for (int i = 0; i < PERF_COUNTER_COUNT; i++)
+  {
+    if (sample->value[i] < 0)
+      continue;
+    printf(", %.2fM %s", sample->value[i] / 1e6, names[i]);
+    any = true;
+  }
+  if (!any)
+    printf(" (cache counters unavailable)");
+  printf("\n");
+}
@@ -0,0 +1,346 @@
+/**
+ * @file replay.cpp
+ * @brief Binary input event log and the driver that replays it.
+ *
+ * Log layout: the magic "GRPL", a version byte, then varints for the seed and
+ * the window size. Each event is one byte holding the type and state, one
+ * byte holding the button or key, and varints for the time delta, the tick
+ * delta and the zigzag-encoded coordinates, which keeps a typical event at
+ * five to eight bytes.
+ */
+
+#include "replay.h"
+
+#include <chrono>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <vector>
+
+#define LOG_MAGIC "GRPL"
+#define LOG_VERSION 1
+
+unsigned int session_seed = 1;
+uint32_t layout_tick = 0;
+
+static FILE *record_file = NULL;
+static std::chrono::steady_clock::time_point record_start;
+static uint64_t record_last_time = 0;
+static uint32_t record_last_tick = 0;
+
+static std::vector<InputEvent> replay_events;
+static size_t replay_next = 0;
+static bool replaying = false;
+static std::chrono::steady_clock::time_point replay_start;
+static uint32_t replay_first_tick = 0;
+
+/**
+ * @brief Returns the microseconds elapsed since a starting point.
+ *
+ * @param start Starting point
+ * @return Elapsed time in microseconds
+ */
+static uint64_t elapsed_us(std::chrono::steady_clock::time_point start)
+{
+  return std::chrono::duration_cast<std::chrono::microseconds>(
+             std::chrono::steady_clock::now() - start)
+      .count();
+}
+
+/**
+ * @brief Writes an unsigned LEB128 varint.
+ *
+ * @param f Output file
+ * @param value Value to write
+ */
+static void put_varint(FILE *f, uint64_t value)
+{
+  while (value >= 0x80)
+  {
+    fputc((int)(value & 0x7f) | 0x80, f);
+    value >>= 7;
+  }
+  fputc((int)value, f);
+}
+
+/**
+ * @brief Reads an unsigned LEB128 varint.
+ *
+ * @param p Read cursor, advanced past the varint
+ * @param end End of the buffer
+ * @param value Decoded value
+ * @return false if the buffer ends inside the varint
+ */
+static bool get_varint(const unsigned char **p, const unsigned char *end,
+                       uint64_t *value)
+{
+  uint64_t result = 0;
+  for (int shift = 0; *p < end && shift < 64; shift += 7)
+  {
+    unsigned char byte = *(*p)++;
+    result |= (uint64_t)(byte & 0x7f) << shift;
+    if (!(byte & 0x80))
+    {
+      *value = result;
+      return true;
+    }
+  }
+  return false;
+}
+
+static uint64_t zigzag(int v) { return ((uint64_t)(int64_t)v << 1) ^ (uint64_t)((int64_t)v >> 63); }
+static int unzigzag(uint64_t v) { return (int)((v >> 1) ^ (~(v & 1) + 1)); }
+
+/**
+ * @brief Closes the event log so buffered data reaches the disk.
+ *
+ * An end marker carries the layout ticks that ran after the last input, so a
+ * replay also covers the layout settling at the end of the session.
+ */
+static void record_close()
+{
+  if (record_file)
+  {
+    record_event(EVENT_END, 0, 0, 0, 0);
+    fclose(record_file);
+    record_file = NULL;
+  }
+}
+
+/**
+ * @brief Starts recording input events.
+ *
+ * @param path Output file
+ * @param width Current window width
+ * @param height Current window height
+ * @return false if the file cannot be created
+ */
+bool record_open(const char *path, int width, int height)
+{
+  record_file = fopen(path, "wb");
+  if (!record_file)
+  {
+    perror(path);
+    return false;
+  }
+  fwrite(LOG_MAGIC, 1, 4, record_file);
+  fputc(LOG_VERSION, record_file);
+  put_varint(record_file, session_seed);
+  put_varint(record_file, width);
+  put_varint(record_file, height);
+  fflush(record_file);
+  record_start = std::chrono::steady_clock::now();
+  record_last_time = 0;
+  record_last_tick = layout_tick;
+  atexit(record_close);
+  return true;
+}
+
+/**
+ * @brief Checks whether events are being recorded.
+ *
+ * @return true while a recording is open
+ */
+bool record_active() { return record_file != NULL; }
+
+/**
+ * @brief Appends an event to the log.
+ *
+ * Events injected by the replay driver are not recorded again. The log is
+ * flushed after every event so that it survives a crash of the program
+ * being investigated.
+ *
+ * @param type Event type (EVENT_*)
+ * @param code Mouse button or key
+ * @param state Button state for mouse events
+ * @param x X-coordinate, or the new width for resize events
+ * @param y Y-coordinate, or the new height for resize events
+ */
+void record_event(int type, int code, int state, int x, int y)
+{
+  if (!record_file || replaying)
+    return;
+  uint64_t now = elapsed_us(record_start);
+  fputc(type | (state << 4), record_file);
+  fputc(code, record_file);
+  put_varint(record_file, now - record_last_time);
+  put_varint(record_file, layout_tick - record_last_tick);
+  put_varint(record_file, zigzag(x));
+  put_varint(record_file, zigzag(y));
+  fflush(record_file);
+  record_last_time = now;
+  record_last_tick = layout_tick;
+}
+
+/**
+ * @brief Loads an event log for replay.
+ *
+ * The whole log is decoded up front so that replay timing does not include
+ * any file I/O. The recorded seed becomes the session seed.
+ *
+ * @param path Log file
+ * @param width Receives the recorded window width
+ * @param height Receives the recorded window height
+ * @return false if the file is missing or malformed
+ */
+bool replay_open(const char *path, int *width, int *height)
+{
+  FILE *f = fopen(path, "rb");
+  if (!f)
+  {
+    perror(path);
+    return false;
+  }
+  std::vector<unsigned char> data;
+  unsigned char buf[4096];
+  size_t n;
+  while ((n = fread(buf, 1, sizeof(buf), f)) > 0)
+    data.insert(data.end(), buf, buf + n);
+  fclose(f);
+
+  const unsigned char *p = data.data();
+  const unsigned char *end = p + data.size();
+  uint64_t seed, w, h;
+  if (data.size() < 5 || memcmp(p, LOG_MAGIC, 4) != 0 || p[4] != LOG_VERSION)
+  {
+    fprintf(stderr, "%s: not an event log\n", path);
+    return false;
+  }
+  p += 5;
+  if (!get_varint(&p, end, &seed) || !get_varint(&p, end, &w) ||
+      !get_varint(&p, end, &h))
+  {
+    fprintf(stderr, "%s: truncated header\n", path);
+    return false;
+  }
+
+  replay_events.clear();
+  uint64_t time = 0;
+  uint32_t tick = 0;
+  while (end - p >= 2)
+  {
+    InputEvent ev;
+    ev.type = p[0] & 0x0f;
+    ev.state = p[0] >> 4;
+    ev.code = p[1];
+    p += 2;
+    uint64_t dt, dtick, x, y;
+    if (!get_varint(&p, end, &dt) || !get_varint(&p, end, &dtick) ||
+        !get_varint(&p, end, &x) || !get_varint(&p, end, &y))
+      break; // a crash may leave a partial last event
+    time += dt;
+    tick += (uint32_t)dtick;
+    ev.time_us = time;
+    ev.tick = tick;
+    ev.x = unzigzag(x);
+    ev.y = unzigzag(y);
+    replay_events.push_back(ev);
+  }
+
+  session_seed = (unsigned int)seed;
+  *width = (int)w;
+  *height = (int)h;
+  replay_next = 0;
+  replaying = true;
+  replay_start = std::chrono::steady_clock::now();
+  replay_first_tick = layout_tick;
+  return true;
+}
+
+/**
+ * @brief Checks whether a replay is in progress.
+ *
+ * @return true until the last event has been dispatched
+ */
+bool replay_active() { return replaying; }
+
+/**
+ * @brief Sends one event to its handler.
+ *
+ * @param handlers Input handlers
+ * @param ev Event to dispatch
+ */
+static void dispatch(const ReplayHandlers *handlers, const InputEvent &ev)
+{
+  switch (ev.type)
+  {
+  case EVENT_MOUSE:
+    handlers->mouse(ev.code, ev.state, ev.x, ev.y);
+    break;
+  case EVENT_KEY:
+    handlers->keyboard((unsigned char)ev.code, ev.x, ev.y);
+    break;
+  case EVENT_RESIZE:
+    handlers->resize(ev.x, ev.y);
+    break;
+  case EVENT_MOTION:
+    handlers->motion(ev.x, ev.y);
+    break;
+  case EVENT_END:
+    break;
+  }
+}
+
+/**
+ * @brief Prints replay statistics and leaves replay mode.
+ */
+static void replay_finish()
+{
+  uint64_t us = elapsed_us(replay_start);
+  uint32_t ticks = layout_tick - replay_first_tick;
+  printf("Replay: %zu events, %u layout ticks in %.3f ms (%.1f ticks/s)\n",
+         replay_events.size(), ticks, us / 1000.0,
+         us ? ticks * 1e6 / (double)us : 0.0);
+  replaying = false;
+}
+
+/**
+ * @brief Advances the replay from the idle callback.
+ *
+ * At the recorded pace the layout runs one tick per call until the next
+ * event's tick is reached, then pauses until its timestamp is due. At
+ * maximum speed the ticks up to the next event run back to back and one
+ * event is dispatched per call, so each step still gets drawn.
+ *
+ * @param handlers Input handlers
+ * @param max_speed Ignore the recorded timestamps
+ */
+void replay_poll(const ReplayHandlers *handlers, bool max_speed)
+{
+  if (!replaying)
+    return;
+  if (replay_next == replay_events.size())
+  {
+    replay_finish();
+    return;
+  }
+  const InputEvent &ev = replay_events[replay_next];
+  uint32_t target = replay_first_tick + ev.tick;
+  if (max_speed)
+  {
+    while (layout_tick < target)
+      handlers->tick();
+  }
+  else if (layout_tick < target)
+  {
+    handlers->tick();
+    return;
+  }
+  else if (elapsed_us(replay_start) < ev.time_us)
+  {
+    return;
+  }
+  replay_next++;
+  dispatch(handlers, ev);
+}
+
+/**
+ * @brief Replays the whole log at maximum speed.
+ *
+ * @param handlers Input handlers
+ */
+void replay_run(const ReplayHandlers *handlers)
+{
+  while (replaying)
+    replay_poll(handlers, true);
+}
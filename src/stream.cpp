@@ -0,0 +1,456 @@
+/**
+ * @file stream.cpp
+ * @brief Streamed layout, Boruvka MST and Dijkstra over an edge file.
+ *
+ * Node ranges are split into STREAM_CHUNKS slices. Because every edge is
+ * stored in both directions, each node can sum its own forces or pick its
+ * own lightest edge from its arc range, so workers never write to the same
+ * entry.
+ */
+
+#include "stream.h"
+#include "parallel.h"
+
+#include <algorithm>
+#include <chrono>
+#include <float.h>
+#include <functional>
+#include <math.h>
+#include <stdio.h>
+#include <utility>
+
+#define STREAM_CHUNKS 64
+#define STREAM_MAX_GRID 4096 // cells per side of the repulsion grid
+
+#define INF FLT_MAX
+
+/**
+ * @brief Runs fn(lo, hi) over STREAM_CHUNKS equal slices of [lo, hi).
+ *
+ * @param lo First index
+ * @param hi One past the last index
+ * @param fn Function called with each non-empty slice
+ */
+static void for_each_slice(int lo, int hi, const std::function<void(int, int)> &fn)
+{
+  long long total = hi - lo;
+  parallel_for(STREAM_CHUNKS, [&](int c)
+               {
+                 int a = lo + (int)(total * c / STREAM_CHUNKS);
+                 int b = lo + (int)(total * (c + 1) / STREAM_CHUNKS);
+                 if (a < b)
+                   fn(a, b);
+               });
+}
+
+/**
+ * @brief splitmix64 finalizer.
+ *
+ * @param z Input
+ * @return Mixed value
+ */
+static inline uint64_t mix64(uint64_t z)
+{
+  z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+  z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+  return z ^ (z >> 31);
+}
+
+/**
+ * @brief Places the nodes at hashed random positions.
+ *
+ * @param file Open edge file
+ * @param seed Seed of the placement
+ * @param layout Receives the positions
+ */
+void stream_layout_init(const EdgeFile *file, unsigned int seed, StreamLayout *layout)
+{
+  int n = file->node_count;
+  layout->x.resize(n);
+  layout->y.resize(n);
+  layout->dx.resize(n);
+  layout->dy.resize(n);
+  for_each_slice(0, n, [&](int lo, int hi)
+                 {
+                   for (int i = lo; i < hi; i++)
+                   {
+                     uint64_t r = mix64(mix64(seed) ^ (uint64_t)i);
+                     layout->x[i] = (r >> 40) / 8388608.0f - 1.0f;
+                     layout->y[i] = (r & 0xffffff) / 8388608.0f - 1.0f;
+                   }
+                 });
+}
+
+/**
+ * @brief Runs one force-directed iteration.
+ *
+ * Uses the forces, centering and step limits of update_layout(). Repulsion
+ * uses the grid variant of Fruchterman-Reingold: nodes only repel others
+ * closer than 2k, found through a grid of 2k cells, which replaces the
+ * all-pairs loop. Attraction streams the edge file one window at a time.
+ *
+ * @param file Open edge file
+ * @param layout Positions to update
+ */
+void stream_layout_step(EdgeFile *file, StreamLayout *layout)
+{
+  int n = file->node_count;
+  if (n == 0)
+    return;
+  std::vector<float> &x = layout->x, &y = layout->y;
+  std::vector<float> &dx = layout->dx, &dy = layout->dy;
+  float k = sqrt(4.0f / n);
+
+  // Bucket nodes into grid cells by counting sort
+  float reach = 2 * k;
+  float reach2 = reach * reach;
+  int side = std::max(1, std::min(STREAM_MAX_GRID, (int)(2.0f / reach)));
+  float cell_size = 2.0f / side;
+  auto cell_of = [&](float v)
+  {
+    int c = (int)((v + 1.0f) / cell_size);
+    return std::min(std::max(c, 0), side - 1);
+  };
+  std::vector<int> &start = layout->cell_start, &members = layout->cell_nodes;
+  start.assign((size_t)side * side + 1, 0);
+  members.resize(n);
+  for (int i = 0; i < n; i++)
+    start[cell_of(y[i]) * side + cell_of(x[i]) + 1]++;
+  for (size_t c = 0; c + 1 < start.size(); c++)
+    start[c + 1] += start[c];
+  std::vector<float> &cx_of = layout->cell_x, &cy_of = layout->cell_y;
+  cx_of.resize(n);
+  cy_of.resize(n);
+  {
+    std::vector<int> fill(start.begin(), start.end() - 1);
+    for (int i = 0; i < n; i++)
+    {
+      int m = fill[cell_of(y[i]) * side + cell_of(x[i])]++;
+      members[m] = i;
+      cx_of[m] = x[i]; // cell-ordered copies keep the inner loop sequential
+      cy_of[m] = y[i];
+    }
+  }
+
+  // Repulsion within the 3x3 neighborhood of each node's cell, visiting
+  // nodes in cell order so that neighboring cells stay in cache
+  for_each_slice(0, n, [&](int lo, int hi)
+                 {
+                   for (int mi = lo; mi < hi; mi++)
+                   {
+                     int i = members[mi];
+                     float px = cx_of[mi], py = cy_of[mi];
+                     float fx = 0, fy = 0;
+                     int cx = cell_of(px), cy = cell_of(py);
+                     for (int gy = std::max(cy - 1, 0); gy <= std::min(cy + 1, side - 1); gy++)
+                     {
+                       for (int gx = std::max(cx - 1, 0); gx <= std::min(cx + 1, side - 1); gx++)
+                       {
+                         int c = gy * side + gx;
+                         for (int m = start[c]; m < start[c + 1]; m++)
+                         {
+                           if (m == mi)
+                             continue;
+                           float ddx = px - cx_of[m];
+                           float ddy = py - cy_of[m];
+                           // (d / |d|) * k^2 / |d| without the square root
+                           float dist2 = ddx * ddx + ddy * ddy;
+                           if (dist2 >= reach2)
+                             continue;
+                           if (dist2 < 0.000001f)
+                             dist2 = 0.000001f;
+                           float scale = (k * k) / dist2;
+                           fx += ddx * scale;
+                           fy += ddy * scale;
+                         }
+                       }
+                     }
+                     dx[i] = fx;
+                     dy[i] = fy;
+                   }
+                 });
+
+  // Attraction, each node pulled along its own arcs
+  edgefile_for_each_window(file, [&](int lo, int hi)
+                           {
+                             for_each_slice(lo, hi, [&](int a, int b)
+                                            {
+                                              for (int u = a; u < b; u++)
+                                              {
+                                                for (uint64_t e = file->offsets[u]; e < file->offsets[u + 1]; e++)
+                                                {
+                                                  int v = file->arcs[e].dest;
+                                                  float ddx = x[u] - x[v];
+                                                  float ddy = y[u] - y[v];
+                                                  float dist = sqrt(ddx * ddx + ddy * ddy);
+                                                  if (dist < 0.001f)
+                                                    dist = 0.001f;
+                                                  float force = (dist * dist) / k;
+                                                  dx[u] -= (ddx / dist) * force;
+                                                  dy[u] -= (ddy / dist) * force;
+                                                }
+                                              }
+                                            });
+                           });
+
+  // Centering, limited and damped step, clamp to the canvas
+  float centering_strength = 4.0f;
+  float temp = 0.05f;
+  float damping = 0.1f;
+  for_each_slice(0, n, [&](int lo, int hi)
+                 {
+                   for (int i = lo; i < hi; i++)
+                   {
+                     float fx = dx[i] - x[i] * centering_strength;
+                     float fy = dy[i] - y[i] * centering_strength;
+                     float length = sqrt(fx * fx + fy * fy);
+                     if (length < 0.001f)
+                       length = 0.001f;
+                     x[i] += (fx / length) * fmin(length, temp) * damping;
+                     y[i] += (fy / length) * fmin(length, temp) * damping;
+                     x[i] = std::min(std::max(x[i], -1.0f), 1.0f);
+                     y[i] = std::min(std::max(y[i], -1.0f), 1.0f);
+                   }
+                 });
+}
+
+// Candidate edge of a Boruvka round, ordered by weight then endpoints
+typedef struct
+{
+  float weight;
+  int u, v; // u < v
+} Candidate;
+
+/**
+ * @brief Strict total order on candidate edges.
+ *
+ * Breaking weight ties by endpoints makes every component pick edges that
+ * cannot close a cycle.
+ *
+ * @param a First candidate
+ * @param b Second candidate
+ * @return true if a is lighter than b
+ */
+static inline bool lighter(const Candidate &a, const Candidate &b)
+{
+  if (a.weight != b.weight)
+    return a.weight < b.weight;
+  if (a.u != b.u)
+    return a.u < b.u;
+  return a.v < b.v;
+}
+
+/**
+ * @brief Finds the root of x, halving the path on the way.
+ *
+ * @param parent Union-find forest
+ * @param x Node
+ * @return Root of the tree holding x
+ */
+static int find_root(std::vector<int> &parent, int x)
+{
+  while (parent[x] != x)
+  {
+    parent[x] = parent[parent[x]];
+    x = parent[x];
+  }
+  return x;
+}
+
+/**
+ * @brief Computes a minimum spanning forest with Boruvka's algorithm.
+ *
+ * Kruskal needs all edges sorted, which does not stream. Each Boruvka round
+ * instead makes one sequential pass in which every node finds its lightest
+ * arc leaving its component; those are reduced per component and merged.
+ * The number of components at least halves per round, so a graph takes
+ * O(log V) passes.
+ *
+ * @param file Open edge file
+ * @param tree_edges Receives the number of forest edges
+ * @param rounds Receives the number of passes over the file
+ * @return Total forest weight
+ */
+double stream_mst(EdgeFile *file, long long *tree_edges, int *rounds)
+{
+  int n = file->node_count;
+  std::vector<int> parent(n), label(n);
+  for (int i = 0; i < n; i++)
+    parent[i] = i;
+  std::vector<Candidate> node_best(n), comp_best(n);
+  const Candidate none = {INF, -1, -1};
+  double total = 0;
+  *tree_edges = 0;
+  *rounds = 0;
+
+  bool merged = true;
+  while (merged)
+  {
+    merged = false;
+    (*rounds)++;
+    for (int i = 0; i < n; i++)
+      label[i] = find_root(parent, i);
+
+    edgefile_for_each_window(file, [&](int lo, int hi)
+                             {
+                               for_each_slice(lo, hi, [&](int a, int b)
+                                              {
+                                                for (int u = a; u < b; u++)
+                                                {
+                                                  Candidate best = none;
+                                                  for (uint64_t e = file->offsets[u]; e < file->offsets[u + 1]; e++)
+                                                  {
+                                                    int v = file->arcs[e].dest;
+                                                    if (label[v] == label[u])
+                                                      continue;
+                                                    Candidate c = {file->arcs[e].weight, std::min(u, v), std::max(u, v)};
+                                                    if (lighter(c, best))
+                                                      best = c;
+                                                  }
+                                                  node_best[u] = best;
+                                                }
+                                              });
+                             });
+
+    std::fill(comp_best.begin(), comp_best.end(), none);
+    for (int u = 0; u < n; u++)
+    {
+      if (node_best[u].u != -1 && lighter(node_best[u], comp_best[label[u]]))
+        comp_best[label[u]] = node_best[u];
+    }
+    for (int c = 0; c < n; c++)
+    {
+      const Candidate &best = comp_best[c];
+      if (best.u == -1)
+        continue;
+      int ru = find_root(parent, best.u), rv = find_root(parent, best.v);
+      if (ru == rv)
+        continue; // both components picked the same edge
+      parent[std::max(ru, rv)] = std::min(ru, rv);
+      total += best.weight;
+      (*tree_edges)++;
+      merged = true;
+    }
+  }
+  return total;
+}
+
+/**
+ * @brief Finds a shortest path with a binary-heap Dijkstra.
+ *
+ * Arcs are read straight from the mapping; every settled node is reported
+ * to edgefile_touch() so that mapped pages are released once the budget is
+ * reached.
+ *
+ * @param file Open edge file
+ * @param from Start node
+ * @param to End node
+ * @param path Receives the nodes of the path, from first to last
+ * @return Path length, or -1 if to is unreachable
+ */
+float stream_shortest_path(EdgeFile *file, int from, int to, std::vector<int> *path)
+{
+  int n = file->node_count;
+  path->clear();
+  if (from < 0 || from >= n || to < 0 || to >= n)
+    return -1;
+  std::vector<float> dist(n, INF);
+  std::vector<int> parent(n, -1);
+  std::vector<std::pair<float, int>> heap;
+  auto greater = std::greater<std::pair<float, int>>();
+  dist[from] = 0;
+  heap.push_back(std::make_pair(0.0f, from));
+  while (!heap.empty())
+  {
+    std::pop_heap(heap.begin(), heap.end(), greater);
+    float d = heap.back().first;
+    int u = heap.back().second;
+    heap.pop_back();
+    if (d > dist[u])
+      continue; // stale entry
+    if (u == to)
+      break;
+    edgefile_touch(file, u);
+    for (uint64_t e = file->offsets[u]; e < file->offsets[u + 1]; e++)
+    {
+      int v = file->arcs[e].dest;
+      float nd = d + file->arcs[e].weight;
+      if (nd < dist[v])
+      {
+        dist[v] = nd;
+        parent[v] = u;
+        heap.push_back(std::make_pair(nd, v));
+        std::push_heap(heap.begin(), heap.end(), greater);
+      }
+    }
+  }
+  if (dist[to] == INF)
+    return -1;
+  for (int at = to; at != -1; at = parent[at])
+    path->push_back(at);
+  std::reverse(path->begin(), path->end());
+  return dist[to];
+}
+
+/**
+ * @brief Returns the milliseconds elapsed since a starting point.
+ *
+ * @param start Starting point
+ * @return Elapsed time in milliseconds
+ */
+static double elapsed_ms(std::chrono::steady_clock::time_point start)
+{
+  return std::chrono::duration<double, std::milli>(
+             std::chrono::steady_clock::now() - start)
+      .count();
+}
+
+/**
+ * @brief Runs layout iterations, an MST and a shortest path on an edge file
+ * and prints the timings and the peak resident size.
+ *
+ * @param options Streamed mode options
+ * @return 0 on success, 1 if the file cannot be opened
+ */
+int stream_run(const StreamOptions *options)
+{
+  EdgeFile file;
+  if (!edgefile_open(options->path, options->budget, &file))
+    return 1;
+  printf("Streaming %s: %d nodes, %lld edges, %.0f MB budget, %d threads\n",
+         options->path, file.node_count, file.edge_count,
+         options->budget / 1048576.0, parallel_threads());
+
+  StreamLayout layout;
+  stream_layout_init(&file, options->seed, &layout);
+  auto start = std::chrono::steady_clock::now();
+  for (int i = 0; i < options->iterations; i++)
+    stream_layout_step(&file, &layout);
+  double ms = elapsed_ms(start);
+  printf("Layout: %d iterations in %.1f ms (%.1f ms/iteration)\n",
+         options->iterations, ms,
+         options->iterations ? ms / options->iterations : 0);
+
+  long long tree_edges;
+  int rounds;
+  start = std::chrono::steady_clock::now();
+  double weight = stream_mst(&file, &tree_edges, &rounds);
+  printf("MST: weight %.1f, %lld edges, %d passes in %.1f ms\n", weight,
+         tree_edges, rounds, elapsed_ms(start));
+
+  int from = options->from >= 0 ? options->from : 0;
+  int to = options->to >= 0 ? options->to : file.node_count - 1;
+  std::vector<int> path;
+  start = std::chrono::steady_clock::now();
+  float length = stream_shortest_path(&file, from, to, &path);
+  ms = elapsed_ms(start);
+  if (length < 0)
+    printf("Shortest path %d -> %d: unreachable (%.1f ms)\n", from, to, ms);
+  else
+    printf("Shortest path %d -> %d: length %.1f, %d hops in %.1f ms\n", from,
+           to, length, (int)path.size() - 1, ms);
+
+  printf("Peak RSS: %.1f MB\n", peak_rss_kb() / 1024.0);
+  edgefile_close(&file);
+  return 0;
+}
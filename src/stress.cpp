@@ -0,0 +1,564 @@
+/**
+ * @file stress.cpp
+ * @brief Sparse stress model, pivot MDS and the majorization step.
+ *
+ * The step is the localized majorization update of Gansner, Koren and
+ * North: every node moves to the weighted mean of the positions its terms
+ * want it at. All nodes read the previous positions, so the step runs in
+ * chunks on the execution backend and gives the same result on all of them.
+ *
+ * Stress is reported scale-free: the drawing is first scaled by the factor
+ * that minimizes its stress, so layouts of any size can be compared. The
+ * value is the weighted squared error over the weighted squared distances;
+ * 0 means every term is met exactly.
+ */
+
+#include "stress.h"
+#include "backend.h"
+#include "parallel.h"
+#include "paths.h"
+
+#include <algorithm>
+#include <chrono>
+#include <float.h>
+#include <math.h>
+#include <stdint.h>
+
+#define STRESS_CHUNKS 64
+
+// Sums over the terms of a chunk of nodes, for the scale-free stress
+typedef struct
+{
+  double wdd; // sum of w * d^2
+  double wdl; // sum of w * d * |xi - xj|
+  double wll; // sum of w * |xi - xj|^2
+} StressSums;
+
+/**
+ * @brief Picks distinct pivots uniformly at random.
+ *
+ * @param n Number of nodes
+ * @param k Number of pivots, at most n
+ * @param seed Seed of the SplitMix64 stream
+ * @param pivots Receives the pivots
+ */
+static void choose_pivots(int n, int k, unsigned int seed, std::vector<int> &pivots)
+{
+  std::vector<int> all(n);
+  for (int i = 0; i < n; i++)
+    all[i] = i;
+  uint64_t state = seed;
+  pivots.resize(k);
+  for (int i = 0; i < k; i++)
+  {
+    uint64_t z = (state += 0x9E3779B97F4A7C15ull);
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+    z ^= z >> 31;
+    std::swap(all[i], all[i + (int)(z % (uint64_t)(n - i))]);
+    pivots[i] = all[i];
+  }
+}
+
+/**
+ * @brief Finds the dominant eigenvector of a symmetric matrix orthogonal to
+ *        another vector.
+ *
+ * @param b k x k matrix
+ * @param k Dimension
+ * @param against Unit vector to stay orthogonal to, or NULL
+ * @param v Receives the unit eigenvector
+ * @return Its eigenvalue
+ */
+static double power_iteration(const std::vector<double> &b, int k, const double *against,
+                              std::vector<double> &v)
+{
+  std::vector<double> w(k);
+  v.resize(k);
+  for (int p = 0; p < k; p++)
+    v[p] = 1.0 + p % 3; // not orthogonal to the eigenvectors of a typical matrix
+  double lambda = 0;
+  for (int step = 0; step < STRESS_POWER_STEPS; step++)
+  {
+    if (against)
+    {
+      double dot = 0;
+      for (int p = 0; p < k; p++)
+        dot += v[p] * against[p];
+      for (int p = 0; p < k; p++)
+        v[p] -= dot * against[p];
+    }
+    double norm = 0;
+    for (int p = 0; p < k; p++)
+      norm += v[p] * v[p];
+    norm = sqrt(norm);
+    if (norm == 0)
+      break;
+    for (int p = 0; p < k; p++)
+      v[p] /= norm;
+    lambda = 0;
+    for (int p = 0; p < k; p++)
+    {
+      w[p] = 0;
+      for (int q = 0; q < k; q++)
+        w[p] += b[(size_t)p * k + q] * v[q];
+      lambda += v[p] * w[p];
+    }
+    v.swap(w);
+  }
+  double norm = 0;
+  for (int p = 0; p < k; p++)
+    norm += v[p] * v[p];
+  norm = sqrt(norm);
+  for (int p = 0; p < k; p++)
+    v[p] = norm > 0 ? v[p] / norm : 0;
+  return lambda;
+}
+
+/**
+ * @brief Places the nodes by pivot MDS.
+ *
+ * The squared pivot distances are double-centered into C (n x k), and the
+ * two leading eigenvectors v of C^T C give the coordinates C v, each divided
+ * by the square root of its singular value as in classical MDS.
+ *
+ * @param d Pivot distances, node_count x pivot_count
+ * @param n Number of nodes
+ * @param k Number of pivots
+ * @param x Receives the x-coordinates
+ * @param y Receives the y-coordinates
+ */
+static void pivot_mds(const std::vector<float> &d, int n, int k, std::vector<float> &x,
+                      std::vector<float> &y)
+{
+  std::vector<double> c((size_t)n * k), row(n, 0), col(k, 0);
+  double grand = 0;
+  for (int i = 0; i < n; i++)
+  {
+    for (int p = 0; p < k; p++)
+    {
+      double dd = (double)d[(size_t)i * k + p] * d[(size_t)i * k + p];
+      c[(size_t)i * k + p] = dd;
+      row[i] += dd / k;
+      col[p] += dd / n;
+      grand += dd / ((double)n * k);
+    }
+  }
+  for (int i = 0; i < n; i++)
+  {
+    for (int p = 0; p < k; p++)
+      c[(size_t)i * k + p] = -0.5 * (c[(size_t)i * k + p] - row[i] - col[p] + grand);
+  }
+
+  std::vector<double> b((size_t)k * k, 0);
+  backend_for(k, [&](int p)
+              {
+                double *out = &b[(size_t)p * k];
+                for (int i = 0; i < n; i++)
+                {
+                  double cp = c[(size_t)i * k + p];
+                  const double *ci = &c[(size_t)i * k];
+                  for (int q = 0; q < k; q++)
+                    out[q] += cp * ci[q];
+                }
+              });
+
+  std::vector<double> v1, v2;
+  double l1 = power_iteration(b, k, NULL, v1);
+  double l2 = power_iteration(b, k, v1.data(), v2);
+  double s1 = l1 > 0 ? 1 / sqrt(sqrt(l1)) : 0;
+  double s2 = l2 > 0 ? 1 / sqrt(sqrt(l2)) : 0;
+  x.resize(n);
+  y.resize(n);
+  for (int i = 0; i < n; i++)
+  {
+    double px = 0, py = 0;
+    for (int p = 0; p < k; p++)
+    {
+      px += c[(size_t)i * k + p] * v1[p];
+      py += c[(size_t)i * k + p] * v2[p];
+    }
+    x[i] = (float)(px * s1);
+    y[i] = (float)(py * s2);
+  }
+}
+
+/**
+ * @brief Calls fn(j, d, w) for every stress term of node i.
+ *
+ * @param model Stress model
+ * @param i Node
+ * @param fn Receives the other node, the target distance and the weight
+ */
+template <typename F>
+static inline void for_each_term(const StressModel &model, int i, F fn)
+{
+  for (int e = model.offsets[i]; e < model.offsets[i + 1]; e++)
+  {
+    float d = model.edge_dist[e];
+    fn(model.targets[e], d, 1 / (d * d));
+  }
+  int k = model.pivot_count;
+  for (int p = 0; p < k; p++)
+  {
+    if (model.pivots[p] != i)
+      fn(model.pivots[p], model.pivot_dist[(size_t)i * k + p],
+         model.pivot_weight[(size_t)i * k + p]);
+  }
+}
+
+/**
+ * @brief Weights the pivot terms by the nodes each pivot stands in for.
+ *
+ * Every node belongs to the region of its nearest pivot. The term between
+ * node i and pivot p counts the nodes of p's region that are at most half
+ * as far from p as i is, over the squared distance.
+ *
+ * @param model Model with pivot distances; receives the pivot weights
+ */
+static void weigh_pivots(StressModel *model)
+{
+  int n = model->node_count, k = model->pivot_count;
+  const std::vector<float> &d = model->pivot_dist;
+  std::vector<int> nearest(n), start(k + 1, 0);
+  for (int i = 0; i < n; i++)
+  {
+    const float *row = &d[(size_t)i * k];
+    nearest[i] = (int)(std::min_element(row, row + k) - row);
+    start[nearest[i] + 1]++;
+  }
+  for (int p = 0; p < k; p++)
+    start[p + 1] += start[p];
+  std::vector<int> fill(start.begin(), start.end() - 1);
+  std::vector<float> region(n);
+  for (int i = 0; i < n; i++)
+    region[fill[nearest[i]]++] = d[(size_t)i * k + nearest[i]];
+  backend_for(k, [&](int p)
+              { std::sort(region.begin() + start[p], region.begin() + start[p + 1]); });
+
+  std::vector<float> &w = model->pivot_weight;
+  w.resize((size_t)n * k);
+  backend_for(STRESS_CHUNKS, [&](int c)
+              {
+                int lo = (int)((long long)n * c / STRESS_CHUNKS);
+                int hi = (int)((long long)n * (c + 1) / STRESS_CHUNKS);
+                for (int i = lo; i < hi; i++)
+                {
+                  for (int p = 0; p < k; p++)
+                  {
+                    float dist = d[(size_t)i * k + p];
+                    long count = std::upper_bound(region.begin() + start[p],
+                                                  region.begin() + start[p + 1], dist * 0.5f) -
+                                 (region.begin() + start[p]);
+                    w[(size_t)i * k + p] = std::max(count, 1L) / (dist * dist);
+                  }
+                }
+              });
+}
+
+/**
+ * @brief Shortest path distances from every pivot, one search per pivot on
+ *        the backend, conditioned for MDS.
+ *
+ * Distances are raised to a floor of 1/1000 of the mean edge weight, so
+ * that zero-weight edges do not collapse nodes, and nodes a pivot cannot
+ * reach get 1.5 times the longest distance found. A cancelled search
+ * leaves its column at the floor.
+ *
+ * @param adj Adjacency snapshot
+ * @param pivots Pivots
+ * @param d Receives the distances, node_count x pivot_count, by node
+ * @return The floor, for the edge terms
+ */
+static float pivot_distances(const Adjacency &adj, const std::vector<int> &pivots,
+                             std::vector<float> &d)
+{
+  int n = adj.node_count, k = (int)pivots.size();
+  d.assign((size_t)n * k, 0);
+  std::vector<DijkstraScratch> scratch(backend_slots());
+  backend_for(k, [&](int p)
+              {
+                DijkstraScratch &sc = scratch[backend_slot()];
+                if (!dijkstra_search(adj, &pivots[p], 1, -1, &sc))
+                  return;
+                for (int i = 0; i < n; i++)
+                  d[(size_t)i * k + p] = sc.dist[i];
+              });
+
+  double weight_sum = 0;
+  for (float w : adj.weights)
+    weight_sum += w;
+  float floor_d = adj.weights.empty() ? 1.0f : (float)(weight_sum / adj.weights.size()) * 1e-3f;
+  if (floor_d <= 0)
+    floor_d = 1e-3f;
+  float longest = 0;
+  for (float v : d)
+  {
+    if (v < FLT_MAX)
+      longest = std::max(longest, v);
+  }
+  float unreachable = longest > 0 ? longest * 1.5f : 1.0f;
+  for (float &v : d)
+    v = v == FLT_MAX ? unreachable : std::max(v, floor_d);
+  return floor_d;
+}
+
+/**
+ * @brief Centers a placement in a box and scales it to fill STRESS_MARGIN
+ *        of it, keeping the aspect ratio.
+ *
+ * @param x x-coordinates of the placement
+ * @param y y-coordinates of the placement
+ * @param box Drawing area
+ * @param out_x Receives the fitted x-coordinates
+ * @param out_y Receives the fitted y-coordinates
+ * @return Factor the placement was scaled by
+ */
+static float fit_box(const std::vector<float> &x, const std::vector<float> &y,
+                     const LayoutBox &box, std::vector<float> &out_x, std::vector<float> &out_y)
+{
+  int n = (int)x.size();
+  float x0 = FLT_MAX, y0 = FLT_MAX, x1 = -FLT_MAX, y1 = -FLT_MAX;
+  for (int i = 0; i < n; i++)
+  {
+    x0 = std::min(x0, x[i]);
+    x1 = std::max(x1, x[i]);
+    y0 = std::min(y0, y[i]);
+    y1 = std::max(y1, y[i]);
+  }
+  float width = (box.x1 - box.x0) * STRESS_MARGIN, height = (box.y1 - box.y0) * STRESS_MARGIN;
+  float fit = std::min(x1 > x0 ? width / (x1 - x0) : FLT_MAX,
+                       y1 > y0 ? height / (y1 - y0) : FLT_MAX);
+  if (fit == FLT_MAX)
+    fit = 1;
+  float cx = (box.x0 + box.x1) * 0.5f, cy = (box.y0 + box.y1) * 0.5f;
+  float mx = (x0 + x1) * 0.5f, my = (y0 + y1) * 0.5f;
+  out_x.resize(n);
+  out_y.resize(n);
+  for (int i = 0; i < n; i++)
+  {
+    out_x[i] = cx + (x[i] - mx) * fit;
+    out_y[i] = cy + (y[i] - my) * fit;
+  }
+  return fit;
+}
+
+/**
+ * @brief Builds the sparse stress model of a graph.
+ *
+ * Unreachable pivots are treated as 1.5 times the largest finite distance
+ * away, which keeps components apart. Distances are floored at a thousandth
+ * of the mean edge weight so that zero-weight edges get finite weights. The
+ * pivot-MDS placement is scaled to best match the distances and fitted into
+ * the box, and the distances are then scaled by the same factor.
+ *
+ * @param adj Adjacency snapshot
+ * @param box Drawing area the placement is fitted into
+ * @param seed Seed of the pivot choice
+ * @param model Receives the model
+ */
+void stress_build(const Adjacency &adj, const LayoutBox &box, unsigned int seed,
+                  StressModel *model)
+{
+  auto start = std::chrono::steady_clock::now();
+  int n = adj.node_count;
+  int k = std::min(STRESS_PIVOTS, n);
+  model->node_count = n;
+  model->pivot_count = k;
+  model->scale = 1;
+  if (n == 0)
+    return;
+  choose_pivots(n, k, seed, model->pivots);
+
+  std::vector<float> &d = model->pivot_dist;
+  float floor_d = pivot_distances(adj, model->pivots, d);
+  if (task_cancelled())
+    return;
+  task_progress(0.5f);
+
+  model->offsets = adj.offsets;
+  model->targets = adj.targets;
+  model->edge_dist.resize(adj.weights.size());
+  for (size_t e = 0; e < adj.weights.size(); e++)
+    model->edge_dist[e] = std::max(adj.weights[e], floor_d);
+  weigh_pivots(model);
+
+  std::vector<float> x, y;
+  pivot_mds(d, n, k, x, y);
+  if (task_cancelled())
+    return;
+  task_progress(0.8f);
+
+  // Factor from MDS units to weight units that minimizes the stress
+  double wdl = 0, wll = 0;
+  for (int i = 0; i < n; i++)
+  {
+    for_each_term(*model, i, [&](int j, float dist, float w)
+                  {
+                    double l = hypot(x[i] - x[j], y[i] - y[j]);
+                    wdl += w * dist * l;
+                    wll += w * l * l;
+                  });
+  }
+  double to_weight = wll > 0 ? wdl / wll : 1;
+
+  float fit = fit_box(x, y, box, model->x, model->y);
+
+  float scale = (float)(fit / to_weight);
+  model->scale = scale;
+  for (float &v : d)
+    v *= scale;
+  for (float &v : model->edge_dist)
+    v *= scale;
+  for (float &v : model->pivot_weight)
+    v /= scale * scale;
+  model->build_ms = std::chrono::duration<double, std::milli>(
+                        std::chrono::steady_clock::now() - start)
+                        .count();
+}
+
+/**
+ * @brief Pivot-MDS placement alone, without the stress terms.
+ *
+ * Takes the same pivots and distances as stress_build, so both give the same
+ * placement for the same seed, but skips the edge terms, the pivot
+ * weights and the scaling to edge weight units.
+ *
+ * @param adj Adjacency snapshot
+ * @param box Drawing area the placement is fitted into
+ * @param seed Seed of the pivot choice
+ * @param x Receives the x-coordinates, empty if cancelled
+ * @param y Receives the y-coordinates, empty if cancelled
+ */
+void stress_place(const Adjacency &adj, const LayoutBox &box, unsigned int seed,
+                  std::vector<float> *x, std::vector<float> *y)
+{
+  int n = adj.node_count;
+  int k = std::min(STRESS_PIVOTS, n);
+  x->clear();
+  y->clear();
+  if (n == 0)
+    return;
+  std::vector<int> pivots;
+  choose_pivots(n, k, seed, pivots);
+  std::vector<float> d;
+  pivot_distances(adj, pivots, d);
+  if (task_cancelled())
+    return;
+  task_progress(0.5f);
+
+  std::vector<float> mx, my;
+  pivot_mds(d, n, k, mx, my);
+  if (task_cancelled())
+    return;
+  fit_box(mx, my, box, *x, *y);
+}
+
+/**
+ * @brief Scale-free normalized stress from the term sums.
+ *
+ * @param sums Sums over all terms
+ * @return Stress after optimal scaling over the sum of w * d^2
+ */
+static double scale_free(const StressSums &sums)
+{
+  if (sums.wdd <= 0)
+    return 0;
+  double residual = sums.wll > 0 ? sums.wdd - sums.wdl * sums.wdl / sums.wll : sums.wdd;
+  return residual / sums.wdd;
+}
+
+/**
+ * @brief Runs one majorization step.
+ *
+ * Each node moves to the weighted mean of the points at the target distance
+ * from each of its term partners, in the direction it currently lies in. Two
+ * nodes at the same spot are pushed apart along x. The new positions are
+ * clamped to the box, which keeps nodes out of the menu panel.
+ *
+ * @param model Stress model of the current graph
+ * @param list Nodes; their positions are updated
+ * @param box Drawing area
+ * @param next Scratch for node_count positions
+ * @return Scale-free stress of the positions before the step
+ */
+double stress_step(const StressModel &model, Node *list, const LayoutBox &box,
+                   float (*next)[2])
+{
+  int n = model.node_count;
+  StressSums partial[STRESS_CHUNKS];
+  backend_for(STRESS_CHUNKS, [&](int c)
+              {
+                int lo = (int)((long long)n * c / STRESS_CHUNKS);
+                int hi = (int)((long long)n * (c + 1) / STRESS_CHUNKS);
+                StressSums sums = {0, 0, 0};
+                for (int i = lo; i < hi; i++)
+                {
+                  float xi = list[i].x, yi = list[i].y;
+                  float num_x = 0, num_y = 0, den = 0;
+                  for_each_term(model, i, [&](int j, float d, float w)
+                                {
+                                  float dx = xi - list[j].x, dy = yi - list[j].y;
+                                  float l = sqrtf(dx * dx + dy * dy);
+                                  if (l > 1e-9f)
+                                  {
+                                    num_x += w * (list[j].x + d * dx / l);
+                                    num_y += w * (list[j].y + d * dy / l);
+                                  }
+                                  else
+                                  {
+                                    num_x += w * (list[j].x + (i < j ? d : -d));
+                                    num_y += w * list[j].y;
+                                  }
+                                  den += w;
+                                  sums.wdd += (double)w * d * d;
+                                  sums.wdl += (double)w * d * l;
+                                  sums.wll += (double)w * l * l;
+                                });
+                  next[i][0] = den > 0 ? num_x / den : xi;
+                  next[i][1] = den > 0 ? num_y / den : yi;
+                }
+                partial[c] = sums;
+              });
+  backend_for(STRESS_CHUNKS, [&](int c)
+              {
+                int lo = (int)((long long)n * c / STRESS_CHUNKS);
+                int hi = (int)((long long)n * (c + 1) / STRESS_CHUNKS);
+                for (int i = lo; i < hi; i++)
+                {
+                  list[i].x = std::min(std::max(next[i][0], box.x0), box.x1);
+                  list[i].y = std::min(std::max(next[i][1], box.y0), box.y1);
+                }
+              });
+  StressSums total = {0, 0, 0};
+  for (int c = 0; c < STRESS_CHUNKS; c++)
+  {
+    total.wdd += partial[c].wdd;
+    total.wdl += partial[c].wdl;
+    total.wll += partial[c].wll;
+  }
+  return scale_free(total);
+}
+
+/**
+ * @brief Measures the stress of a drawing without moving it.
+ *
+ * @param model Stress model of the current graph
+ * @param list Nodes
+ * @return Scale-free stress
+ */
+double stress_measure(const StressModel &model, const Node *list)
+{
+  StressSums sums = {0, 0, 0};
+  for (int i = 0; i < model.node_count; i++)
+  {
+    for_each_term(model, i, [&](int j, float d, float w)
+                  {
+                    double l = hypot(list[i].x - list[j].x, list[i].y - list[j].y);
+                    sums.wdd += (double)w * d * d;
+                    sums.wdl += w * d * l;
+                    sums.wll += w * l * l;
+                  });
+  }
+  return scale_free(sums);
+}